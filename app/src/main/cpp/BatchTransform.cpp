@@ -0,0 +1,220 @@
+//
+//  BatchTransform.cpp
+//
+//  Scalar and NEON kernels and the choice between them and the x86 ones.
+//
+
+#include "BatchTransformKernels.h"
+
+#include <math.h>
+
+#if defined(__i386__) || defined(__x86_64__)
+#include <cpuid.h>
+#define BATCH_TRANSFORM_X86 1
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define BATCH_TRANSFORM_NEON 1
+#endif
+
+namespace {
+
+#if BATCH_TRANSFORM_NEON
+struct NeonOps {
+    typedef float32x4_t V;
+    typedef uint32x4_t M;
+    static const size_t WIDTH = 4;
+
+    static inline V load(const float *p) { return vld1q_f32(p); }
+    static inline void store(float *p, V v) { vst1q_f32(p, v); }
+    static inline V set1(float f) { return vdupq_n_f32(f); }
+    static inline V add(V a, V b) { return vaddq_f32(a, b); }
+    static inline V sub(V a, V b) { return vsubq_f32(a, b); }
+    static inline V mul(V a, V b) { return vmulq_f32(a, b); }
+    static inline M greater(V a, V b) { return vcgtq_f32(a, b); }
+    static inline V select(M m, V a, V b) { return vbslq_f32(m, a, b); }
+
+    static inline V div(V a, V b)
+    {
+#if defined(__aarch64__)
+        return vdivq_f32(a, b);
+#else
+        // ARMv7 has no vector divide: refine the estimate twice, which gets
+        // within an ulp or two of a / b.
+        V r = vrecpeq_f32(b);
+        r = vmulq_f32(vrecpsq_f32(b, r), r);
+        r = vmulq_f32(vrecpsq_f32(b, r), r);
+        return vmulq_f32(a, r);
+#endif
+    }
+};
+#endif // BATCH_TRANSFORM_NEON
+
+const BatchTransformKernels s_scalarKernels = {
+    transformPoints<ScalarOps>,
+    transformAabbs<ScalarOps>,
+    transformSpheres<ScalarOps>,
+    projectPoints<ScalarOps>
+};
+
+#if BATCH_TRANSFORM_NEON
+const BatchTransformKernels s_neonKernels = {
+    transformPoints<NeonOps>,
+    transformAabbs<NeonOps>,
+    transformSpheres<NeonOps>,
+    projectPoints<NeonOps>
+};
+#endif
+
+#if BATCH_TRANSFORM_X86
+bool cpuHasSse41()
+{
+    unsigned int eax, ebx, ecx, edx;
+    return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_SSE4_1) != 0;
+}
+
+// AVX2 needs the OS to save the YMM registers too (OSXSAVE, then XCR0 bits
+// 1 and 2), not only the CPUID bit.
+bool cpuHasAvx2()
+{
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || (ecx & bit_OSXSAVE) == 0 || (ecx & bit_AVX) == 0)
+    {
+        return false;
+    }
+    unsigned int xcr0Low, xcr0High;
+    __asm__ volatile("xgetbv" : "=a"(xcr0Low), "=d"(xcr0High) : "c"(0));
+    if ((xcr0Low & 6) != 6 || __get_cpuid_max(0, NULL) < 7)
+    {
+        return false;
+    }
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    return (ebx & bit_AVX2) != 0;
+}
+#endif // BATCH_TRANSFORM_X86
+
+const BatchTransformKernels *kernelsFor(BatchTransform::Isa isa)
+{
+    switch (isa)
+    {
+        case BatchTransform::ISA_SCALAR:
+            return &s_scalarKernels;
+#if BATCH_TRANSFORM_X86
+        case BatchTransform::ISA_SSE41:
+            return cpuHasSse41() ? &batchTransformSse41Kernels : NULL;
+        case BatchTransform::ISA_AVX2:
+            return cpuHasAvx2() ? &batchTransformAvx2Kernels : NULL;
+#endif
+#if BATCH_TRANSFORM_NEON
+        case BatchTransform::ISA_NEON:
+            return &s_neonKernels;
+#endif
+        default:
+            return NULL;
+    }
+}
+
+BatchTransform::Isa bestIsa()
+{
+    static const BatchTransform::Isa preferred[] = {
+        BatchTransform::ISA_AVX2, BatchTransform::ISA_SSE41, BatchTransform::ISA_NEON
+    };
+    for (size_t i = 0; i < sizeof(preferred) / sizeof(preferred[0]); ++i)
+    {
+        if (kernelsFor(preferred[i]))
+        {
+            return preferred[i];
+        }
+    }
+    return BatchTransform::ISA_SCALAR;
+}
+
+struct Selection {
+    BatchTransform::Isa isa;
+    const BatchTransformKernels *kernels;
+
+    Selection() : isa(bestIsa()), kernels(kernelsFor(isa)) { }
+};
+
+// Chosen on first use; thread-safe as a function-local static.
+Selection &selection()
+{
+    static Selection s_selection;
+    return s_selection;
+}
+
+// Length of the longest of the upper 3x3's columns.
+float largestAxisScale(const float *matrix)
+{
+    float largest = 0.0f;
+    for (int c = 0; c < 3; ++c)
+    {
+        const float *column = matrix + c * 4;
+        const float lengthSquared = column[0] * column[0] + column[1] * column[1] + column[2] * column[2];
+        largest = lengthSquared > largest ? lengthSquared : largest;
+    }
+    return sqrtf(largest);
+}
+
+} // namespace
+
+void BatchTransform::transformPoints(const float *matrix, const Points &in, const Points &out, size_t count)
+{
+    selection().kernels->transformPoints(matrix, in, out, count);
+}
+
+void BatchTransform::transformAabbs(const float *matrix, const Aabbs &in, const Aabbs &out, size_t count)
+{
+    selection().kernels->transformAabbs(matrix, in, out, count);
+}
+
+void BatchTransform::transformSpheres(const float *matrix, const Spheres &in, const Spheres &out, size_t count)
+{
+    selection().kernels->transformSpheres(matrix, largestAxisScale(matrix), in, out, count);
+}
+
+void BatchTransform::projectPoints(const float *viewProjection, const Points &in, const Viewport &viewport,
+                                   const ScreenPoints &out, size_t count)
+{
+    selection().kernels->projectPoints(viewProjection, in, viewport, out, count);
+}
+
+BatchTransform::Isa BatchTransform::isa()
+{
+    return selection().isa;
+}
+
+bool BatchTransform::isSupported(Isa isa)
+{
+    return kernelsFor(isa) != NULL;
+}
+
+bool BatchTransform::setIsa(Isa isa)
+{
+    const BatchTransformKernels *kernels = kernelsFor(isa);
+    if (!kernels)
+    {
+        return false;
+    }
+    selection().isa = isa;
+    selection().kernels = kernels;
+    return true;
+}
+
+const char *BatchTransform::isaName(Isa isa)
+{
+    switch (isa)
+    {
+        case ISA_SCALAR:
+            return "scalar";
+        case ISA_SSE41:
+            return "SSE4.1";
+        case ISA_AVX2:
+            return "AVX2";
+        case ISA_NEON:
+            return "NEON";
+        default:
+            return "unknown";
+    }
+}
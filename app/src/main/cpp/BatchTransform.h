@@ -0,0 +1,103 @@
+//
+//  BatchTransform.h
+//
+//  Transforms many points, bounding boxes or spheres by one matrix, and
+//  projects points to the screen, over structure-of-arrays data: each
+//  coordinate in its own float array, so a vector register holds the same
+//  coordinate of 4 (SSE4.1, NEON) or 8 (AVX2) elements and no shuffles are
+//  needed.
+//
+//  Matrices are column-major float[16], as glm::value_ptr() returns them.
+//  Arrays need no particular alignment, and an output may be the same array
+//  as the matching input.
+//
+//  The instruction set is picked on first use: on x86 the best of AVX2 and
+//  SSE4.1 the CPU has, on ARM NEON when the ABI has it, and otherwise the
+//  scalar kernels, which are also the reference the others are checked
+//  against (tools/batchtransform_bench).
+//
+
+#ifndef BatchTransform_h
+#define BatchTransform_h
+
+#include <stddef.h>
+
+class BatchTransform {
+public:
+    enum Isa {
+        ISA_SCALAR,
+        ISA_SSE41,
+        ISA_AVX2,
+        ISA_NEON,
+        ISA_COUNT
+    };
+
+    struct Points {
+        float *x;
+        float *y;
+        float *z;
+    };
+
+    struct Aabbs {
+        float *minX;
+        float *minY;
+        float *minZ;
+        float *maxX;
+        float *maxY;
+        float *maxZ;
+    };
+
+    struct Spheres {
+        float *x;
+        float *y;
+        float *z;
+        float *radius;
+    };
+
+    // Window coordinates with the origin at the top left, as dd's screen
+    // text uses them, and depth in [0, 1] for points inside the depth range.
+    struct ScreenPoints {
+        float *x;
+        float *y;
+        float *depth;
+    };
+
+    struct Viewport {
+        float x;
+        float y;
+        float width;
+        float height;
+    };
+
+    // 'matrix' has to be affine (bottom row 0, 0, 0, 1), like model and view
+    // matrices are; use projectPoints() for projections.
+    static void transformPoints(const float *matrix, const Points &in, const Points &out, size_t count);
+
+    // Boxes stay axis-aligned: each result is the smallest box around the
+    // transformed corners. Affine 'matrix' only.
+    static void transformAabbs(const float *matrix, const Aabbs &in, const Aabbs &out, size_t count);
+
+    // Radii are scaled by the matrix's largest axis scale, so the result
+    // still contains the transformed sphere under non-uniform scale. Affine
+    // 'matrix' only.
+    static void transformSpheres(const float *matrix, const Spheres &in, const Spheres &out, size_t count);
+
+    // World to window coordinates through a full view-projection matrix.
+    // Points on or behind the eye plane come out with depth -1 and x, y
+    // undefined; callers skip them like dd::projectedText() does.
+    static void projectPoints(const float *viewProjection, const Points &in, const Viewport &viewport,
+                              const ScreenPoints &out, size_t count);
+
+    // The instruction set the calls above use.
+    static Isa isa();
+    static bool isSupported(Isa isa);
+
+    // For benchmarks and tests: returns false, and changes nothing, if the
+    // CPU or build does not support 'isa'. Not safe while other threads are
+    // inside the calls above.
+    static bool setIsa(Isa isa);
+
+    static const char *isaName(Isa isa);
+};
+
+#endif /* BatchTransform_h */
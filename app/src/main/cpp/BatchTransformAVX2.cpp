@@ -0,0 +1,43 @@
+//
+//  BatchTransformAVX2.cpp
+//
+//  BatchTransform kernels for AVX2, 8 elements per step. Built with -mavx2
+//  (and not -mfma, so results match the SSE4.1 kernels) on x86 and only
+//  called when the CPU and OS have it; see BatchTransformKernels.h before
+//  including anything else here.
+//
+
+#if defined(__i386__) || defined(__x86_64__)
+
+#include "BatchTransformKernels.h"
+
+#include <immintrin.h>
+
+namespace {
+
+struct Avx2Ops {
+    typedef __m256 V;
+    typedef __m256 M;
+    static const size_t WIDTH = 8;
+
+    static inline V load(const float *p) { return _mm256_loadu_ps(p); }
+    static inline void store(float *p, V v) { _mm256_storeu_ps(p, v); }
+    static inline V set1(float f) { return _mm256_set1_ps(f); }
+    static inline V add(V a, V b) { return _mm256_add_ps(a, b); }
+    static inline V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+    static inline V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+    static inline V div(V a, V b) { return _mm256_div_ps(a, b); }
+    static inline M greater(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    static inline V select(M m, V a, V b) { return _mm256_blendv_ps(b, a, m); }
+};
+
+} // namespace
+
+extern const BatchTransformKernels batchTransformAvx2Kernels = {
+    transformPoints<Avx2Ops>,
+    transformAabbs<Avx2Ops>,
+    transformSpheres<Avx2Ops>,
+    projectPoints<Avx2Ops>
+};
+
+#endif // defined(__i386__) || defined(__x86_64__)
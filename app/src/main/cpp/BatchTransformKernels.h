@@ -0,0 +1,259 @@
+//
+//  BatchTransformKernels.h
+//
+//  The BatchTransform kernels, written once against a small set of vector
+//  operations and instantiated per instruction set: BatchTransform.cpp for
+//  scalar and NEON, BatchTransformSSE41.cpp and BatchTransformAVX2.cpp with
+//  their own compiler flags. Each of those supplies an ops struct:
+//
+//      V, M                       vector of WIDTH floats, comparison mask
+//      load, store                unaligned
+//      set1, add, sub, mul, div
+//      greater(a, b)              a > b per lane
+//      select(m, a, b)            m ? a : b per lane
+//
+//  Everything here has internal linkage, and the per-ISA files include
+//  nothing else with inline functions: an inline function compiled with
+//  -mavx2 that the linker merged with other files' copies could end up
+//  running on a CPU without AVX2.
+//
+
+#ifndef BatchTransformKernels_h
+#define BatchTransformKernels_h
+
+#include "BatchTransform.h"
+
+#include <float.h>
+
+// Entry points of the per-ISA files, picked by BatchTransform.cpp.
+struct BatchTransformKernels {
+    void (*transformPoints)(const float *matrix, const BatchTransform::Points &in, const BatchTransform::Points &out,
+                            size_t count);
+    void (*transformAabbs)(const float *matrix, const BatchTransform::Aabbs &in, const BatchTransform::Aabbs &out,
+                           size_t count);
+    // 'radiusScale' is the matrix's largest axis scale.
+    void (*transformSpheres)(const float *matrix, float radiusScale, const BatchTransform::Spheres &in,
+                             const BatchTransform::Spheres &out, size_t count);
+    void (*projectPoints)(const float *viewProjection, const BatchTransform::Points &in,
+                          const BatchTransform::Viewport &viewport, const BatchTransform::ScreenPoints &out,
+                          size_t count);
+};
+
+#if defined(__i386__) || defined(__x86_64__)
+extern const BatchTransformKernels batchTransformSse41Kernels;
+extern const BatchTransformKernels batchTransformAvx2Kernels;
+#endif
+
+namespace {
+
+struct ScalarOps {
+    typedef float V;
+    typedef bool M;
+    static const size_t WIDTH = 1;
+
+    static inline V load(const float *p) { return *p; }
+    static inline void store(float *p, V v) { *p = v; }
+    static inline V set1(float f) { return f; }
+    static inline V add(V a, V b) { return a + b; }
+    static inline V sub(V a, V b) { return a - b; }
+    static inline V mul(V a, V b) { return a * b; }
+    static inline V div(V a, V b) { return a / b; }
+    static inline M greater(V a, V b) { return a > b; }
+    static inline V select(M m, V a, V b) { return m ? a : b; }
+};
+
+// The matrix broadcast once per call rather than once per block.
+template<class S>
+struct SplatMatrix {
+    typename S::V m[16];
+
+    explicit SplatMatrix(const float *matrix)
+    {
+        for (int i = 0; i < 16; ++i)
+        {
+            m[i] = S::set1(matrix[i]);
+        }
+    }
+};
+
+// Row 'r' of m * (x, y, z, 1), in the same order for every instruction set
+// so they only differ where a compiler fuses the scalar multiply-adds.
+template<class S>
+inline typename S::V affineRow(const SplatMatrix<S> &m, int r, typename S::V x, typename S::V y, typename S::V z)
+{
+    return S::add(S::add(S::mul(m.m[r], x), S::mul(m.m[4 + r], y)), S::add(S::mul(m.m[8 + r], z), m.m[12 + r]));
+}
+
+template<class S>
+inline void transformPointsAt(const SplatMatrix<S> &m, const BatchTransform::Points &in,
+                              const BatchTransform::Points &out, size_t i)
+{
+    typedef typename S::V V;
+    const V x = S::load(in.x + i);
+    const V y = S::load(in.y + i);
+    const V z = S::load(in.z + i);
+    S::store(out.x + i, affineRow(m, 0, x, y, z));
+    S::store(out.y + i, affineRow(m, 1, x, y, z));
+    S::store(out.z + i, affineRow(m, 2, x, y, z));
+}
+
+template<class S>
+void transformPoints(const float *matrix, const BatchTransform::Points &in, const BatchTransform::Points &out,
+                     size_t count)
+{
+    const SplatMatrix<S> m(matrix);
+    size_t i = 0;
+    for (; i + S::WIDTH <= count; i += S::WIDTH)
+    {
+        transformPointsAt(m, in, out, i);
+    }
+    const SplatMatrix<ScalarOps> tail(matrix);
+    for (; i < count; ++i)
+    {
+        transformPointsAt(tail, in, out, i);
+    }
+}
+
+// Arvo's method on center and half extents: the center moves with the
+// matrix, the extents by its absolute value (translation left out).
+template<class S>
+inline void transformAabbsAt(const SplatMatrix<S> &m, const SplatMatrix<S> &absM, const BatchTransform::Aabbs &in,
+                             const BatchTransform::Aabbs &out, size_t i)
+{
+    typedef typename S::V V;
+    const V half = S::set1(0.5f);
+    const V minX = S::load(in.minX + i), maxX = S::load(in.maxX + i);
+    const V minY = S::load(in.minY + i), maxY = S::load(in.maxY + i);
+    const V minZ = S::load(in.minZ + i), maxZ = S::load(in.maxZ + i);
+    const V cx = S::mul(S::add(minX, maxX), half), ex = S::mul(S::sub(maxX, minX), half);
+    const V cy = S::mul(S::add(minY, maxY), half), ey = S::mul(S::sub(maxY, minY), half);
+    const V cz = S::mul(S::add(minZ, maxZ), half), ez = S::mul(S::sub(maxZ, minZ), half);
+
+    for (int r = 0; r < 3; ++r)
+    {
+        const V c = affineRow(m, r, cx, cy, cz);
+        const V e = S::add(S::add(S::mul(absM.m[r], ex), S::mul(absM.m[4 + r], ey)), S::mul(absM.m[8 + r], ez));
+        float *const outMin = r == 0 ? out.minX : (r == 1 ? out.minY : out.minZ);
+        float *const outMax = r == 0 ? out.maxX : (r == 1 ? out.maxY : out.maxZ);
+        S::store(outMin + i, S::sub(c, e));
+        S::store(outMax + i, S::add(c, e));
+    }
+}
+
+template<class S>
+void transformAabbs(const float *matrix, const BatchTransform::Aabbs &in, const BatchTransform::Aabbs &out,
+                    size_t count)
+{
+    float absMatrix[16];
+    for (int i = 0; i < 16; ++i)
+    {
+        absMatrix[i] = matrix[i] < 0.0f ? -matrix[i] : matrix[i];
+    }
+
+    const SplatMatrix<S> m(matrix), absM(absMatrix);
+    size_t i = 0;
+    for (; i + S::WIDTH <= count; i += S::WIDTH)
+    {
+        transformAabbsAt(m, absM, in, out, i);
+    }
+    const SplatMatrix<ScalarOps> tail(matrix), absTail(absMatrix);
+    for (; i < count; ++i)
+    {
+        transformAabbsAt(tail, absTail, in, out, i);
+    }
+}
+
+template<class S>
+inline void transformSpheresAt(const SplatMatrix<S> &m, typename S::V radiusScale,
+                               const BatchTransform::Spheres &in, const BatchTransform::Spheres &out, size_t i)
+{
+    typedef typename S::V V;
+    const V x = S::load(in.x + i);
+    const V y = S::load(in.y + i);
+    const V z = S::load(in.z + i);
+    const V radius = S::load(in.radius + i);
+    S::store(out.x + i, affineRow(m, 0, x, y, z));
+    S::store(out.y + i, affineRow(m, 1, x, y, z));
+    S::store(out.z + i, affineRow(m, 2, x, y, z));
+    S::store(out.radius + i, S::mul(radius, radiusScale));
+}
+
+template<class S>
+void transformSpheres(const float *matrix, float radiusScale, const BatchTransform::Spheres &in,
+                      const BatchTransform::Spheres &out, size_t count)
+{
+    const SplatMatrix<S> m(matrix);
+    const typename S::V scale = S::set1(radiusScale);
+    size_t i = 0;
+    for (; i + S::WIDTH <= count; i += S::WIDTH)
+    {
+        transformSpheresAt(m, scale, in, out, i);
+    }
+    const SplatMatrix<ScalarOps> tail(matrix);
+    for (; i < count; ++i)
+    {
+        transformSpheresAt(tail, radiusScale, in, out, i);
+    }
+}
+
+// The viewport folded into a scale and an offset per axis.
+template<class S>
+struct SplatViewport {
+    typename S::V originX, originY, halfWidth, halfHeight;
+
+    explicit SplatViewport(const BatchTransform::Viewport &viewport)
+        : originX(S::set1(viewport.x + 0.5f * viewport.width)),
+          originY(S::set1(viewport.y + 0.5f * viewport.height)),
+          halfWidth(S::set1(0.5f * viewport.width)),
+          halfHeight(S::set1(0.5f * viewport.height))
+    {
+    }
+};
+
+template<class S>
+inline void projectPointsAt(const SplatMatrix<S> &m, const SplatViewport<S> &viewport,
+                            const BatchTransform::Points &in, const BatchTransform::ScreenPoints &out, size_t i)
+{
+    typedef typename S::V V;
+    const V one = S::set1(1.0f);
+    const V half = S::set1(0.5f);
+    const V x = S::load(in.x + i);
+    const V y = S::load(in.y + i);
+    const V z = S::load(in.z + i);
+    const V clipX = affineRow(m, 0, x, y, z);
+    const V clipY = affineRow(m, 1, x, y, z);
+    const V clipZ = affineRow(m, 2, x, y, z);
+    const V clipW = affineRow(m, 3, x, y, z);
+
+    // Points behind the eye divide by 1 instead, so nothing overflows.
+    const typename S::M inFront = S::greater(clipW, S::set1(FLT_EPSILON));
+    const V invW = S::div(one, S::select(inFront, clipW, one));
+
+    // Window y grows down, clip y up.
+    S::store(out.x + i, S::add(viewport.originX, S::mul(S::mul(clipX, invW), viewport.halfWidth)));
+    S::store(out.y + i, S::sub(viewport.originY, S::mul(S::mul(clipY, invW), viewport.halfHeight)));
+    S::store(out.depth + i, S::select(inFront, S::add(S::mul(S::mul(clipZ, invW), half), half), S::set1(-1.0f)));
+}
+
+template<class S>
+void projectPoints(const float *viewProjection, const BatchTransform::Points &in,
+                   const BatchTransform::Viewport &viewport, const BatchTransform::ScreenPoints &out, size_t count)
+{
+    const SplatMatrix<S> m(viewProjection);
+    const SplatViewport<S> v(viewport);
+    size_t i = 0;
+    for (; i + S::WIDTH <= count; i += S::WIDTH)
+    {
+        projectPointsAt(m, v, in, out, i);
+    }
+    const SplatMatrix<ScalarOps> tail(viewProjection);
+    const SplatViewport<ScalarOps> tailViewport(viewport);
+    for (; i < count; ++i)
+    {
+        projectPointsAt(tail, tailViewport, in, out, i);
+    }
+}
+
+} // namespace
+
+#endif /* BatchTransformKernels_h */
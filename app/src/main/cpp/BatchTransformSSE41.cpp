@@ -0,0 +1,42 @@
+//
+//  BatchTransformSSE41.cpp
+//
+//  BatchTransform kernels for SSE4.1, 4 elements per step. Built with
+//  -msse4.1 on x86 and only called when the CPU has it; see
+//  BatchTransformKernels.h before including anything else here.
+//
+
+#if defined(__i386__) || defined(__x86_64__)
+
+#include "BatchTransformKernels.h"
+
+#include <smmintrin.h>
+
+namespace {
+
+struct Sse41Ops {
+    typedef __m128 V;
+    typedef __m128 M;
+    static const size_t WIDTH = 4;
+
+    static inline V load(const float *p) { return _mm_loadu_ps(p); }
+    static inline void store(float *p, V v) { _mm_storeu_ps(p, v); }
+    static inline V set1(float f) { return _mm_set1_ps(f); }
+    static inline V add(V a, V b) { return _mm_add_ps(a, b); }
+    static inline V sub(V a, V b) { return _mm_sub_ps(a, b); }
+    static inline V mul(V a, V b) { return _mm_mul_ps(a, b); }
+    static inline V div(V a, V b) { return _mm_div_ps(a, b); }
+    static inline M greater(V a, V b) { return _mm_cmpgt_ps(a, b); }
+    static inline V select(M m, V a, V b) { return _mm_blendv_ps(b, a, m); }
+};
+
+} // namespace
+
+extern const BatchTransformKernels batchTransformSse41Kernels = {
+    transformPoints<Sse41Ops>,
+    transformAabbs<Sse41Ops>,
+    transformSpheres<Sse41Ops>,
+    projectPoints<Sse41Ops>
+};
+
+#endif // defined(__i386__) || defined(__x86_64__)
@@ -0,0 +1,27 @@
+//
+//  Clock.h
+//
+//  Monotonic time helpers used for frame timing and setup measurements.
+//
+
+#ifndef Clock_h
+#define Clock_h
+
+#include <stdint.h>
+#include <time.h>
+
+inline double nowMillis()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec * 1000.0) + (ts.tv_nsec / 1000000.0);
+}
+
+inline int64_t nowNanos()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((int64_t)ts.tv_sec * 1000000000LL) + ts.tv_nsec;
+}
+
+#endif /* Clock_h */
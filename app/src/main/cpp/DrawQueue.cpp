@@ -0,0 +1,183 @@
+//
+//  DrawQueue.cpp
+//
+
+#include "DrawQueue.h"
+
+#include <string.h>
+
+static const int LAYER_SHIFT = 60;
+static const int TRANSLUCENT_SHIFT = 59;
+static const uint64_t ID_MASK = DrawQueue::MAX_SORT_ID - 1;
+static const uint64_t DEPTH_MASK = (1 << 24) - 1;
+
+static inline uint64_t depthBits(float depth)
+{
+    // Non-negative floats order the same as their bit patterns; keep the top
+    // 24 bits below the sign (8 exponent, 16 mantissa).
+    if (!(depth > 0.0f))
+    {
+        return 0;
+    }
+    uint32_t bits;
+    memcpy(&bits, &depth, sizeof(bits));
+    return (bits >> 7) & DEPTH_MASK;
+}
+
+uint64_t DrawQueue::makeKey(unsigned int layer, bool translucent, GLuint program, GLuint texture, float depth)
+{
+    uint64_t key = (uint64_t)(layer & (MAX_LAYERS - 1)) << LAYER_SHIFT;
+    if (!translucent)
+    {
+        key |= (program & ID_MASK) << 47;
+        key |= (texture & ID_MASK) << 35;
+        key |= depthBits(depth) << 11;
+    }
+    else
+    {
+        key |= (uint64_t)1 << TRANSLUCENT_SHIFT;
+        key |= (DEPTH_MASK - depthBits(depth)) << 35;
+        key |= (program & ID_MASK) << 23;
+        key |= (texture & ID_MASK) << 11;
+    }
+    return key;
+}
+
+DrawQueue::DrawQueue()
+{
+    memset(&mStats, 0, sizeof(mStats));
+}
+
+void DrawQueue::add(uint64_t key, const Draw &draw)
+{
+    Entry entry;
+    entry.key = key;
+    entry.index = (uint32_t)mDraws.size();
+    mKeys.push_back(entry);
+    mDraws.push_back(draw);
+}
+
+void DrawQueue::clear()
+{
+    mKeys.clear();
+    mDraws.clear();
+}
+
+void DrawQueue::sort()
+{
+    const size_t count = mKeys.size();
+    if (count < 2)
+    {
+        return;
+    }
+
+    // One read pass builds the histograms for all eight digits.
+    uint32_t histograms[8][256];
+    memset(histograms, 0, sizeof(histograms));
+    for (size_t i = 0; i < count; ++i)
+    {
+        const uint64_t key = mKeys[i].key;
+        for (int digit = 0; digit < 8; ++digit)
+        {
+            ++histograms[digit][(key >> (digit * 8)) & 0xff];
+        }
+    }
+
+    mScratch.resize(count);
+    Entry *src = &mKeys[0];
+    Entry *dst = &mScratch[0];
+
+    for (int digit = 0; digit < 8; ++digit)
+    {
+        uint32_t *histogram = histograms[digit];
+        const int shift = digit * 8;
+
+        // All keys share this digit; the pass would be a plain copy.
+        if (histogram[(src[0].key >> shift) & 0xff] == count)
+        {
+            continue;
+        }
+
+        uint32_t offset = 0;
+        for (int bucket = 0; bucket < 256; ++bucket)
+        {
+            const uint32_t bucketCount = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += bucketCount;
+        }
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            dst[histogram[(src[i].key >> shift) & 0xff]++] = src[i];
+        }
+
+        Entry *tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+
+    if (src != &mKeys[0])
+    {
+        mKeys.swap(mScratch);
+    }
+}
+
+void DrawQueue::submit(GLCommandBuffer &commands)
+{
+    memset(&mStats, 0, sizeof(mStats));
+
+    GLuint program = 0;
+    GLuint texture = 0;
+    GLuint vertexArray = 0;
+
+    for (size_t i = 0; i < mKeys.size(); ++i)
+    {
+        const Draw &draw = mDraws[mKeys[i].index];
+
+        if (draw.program != program)
+        {
+            program = draw.program;
+            commands.useProgram(program);
+            ++mStats.programChanges;
+        }
+        if (draw.texture != texture)
+        {
+            if (texture == 0)
+            {
+                commands.activeTexture(GL_TEXTURE0);
+            }
+            texture = draw.texture;
+            commands.bindTexture(GL_TEXTURE_2D, texture);
+            ++mStats.textureChanges;
+        }
+        if (draw.vertexArray != vertexArray)
+        {
+            vertexArray = draw.vertexArray;
+            commands.bindVertexArray(vertexArray);
+            ++mStats.vertexArrayChanges;
+        }
+
+        if (draw.indexType != 0)
+        {
+            commands.drawElements(draw.mode, draw.count, draw.indexType, draw.first);
+        }
+        else
+        {
+            commands.drawArrays(draw.mode, (GLint)draw.first, draw.count);
+        }
+        ++mStats.draws;
+    }
+
+    if (texture != 0)
+    {
+        commands.bindTexture(GL_TEXTURE_2D, 0);
+    }
+    if (vertexArray != 0)
+    {
+        commands.bindVertexArray(0);
+    }
+    if (program != 0)
+    {
+        commands.useProgram(0);
+    }
+}
@@ -0,0 +1,84 @@
+//
+//  DrawQueue.h
+//
+//  Collects the frame's draws, orders them by a 64-bit sort key and records
+//  them into a GLCommandBuffer, skipping program, texture and vertex array
+//  binds that are already current.
+//
+//  Key layout, most significant bits first:
+//
+//      opaque:       layer:4 | 0 | program:12 | texture:12 | depth:24 | unused:11
+//      translucent:  layer:4 | 1 | ~depth:24  | program:12 | texture:12 | unused:11
+//
+//  Layers are drawn in order and opaque before translucent within a layer.
+//  Opaque draws are grouped by state and then go front to back; translucent
+//  draws go back to front, which blending requires, and only share state
+//  between draws at the same depth. The sort is stable, so draws with equal
+//  keys keep their submission order.
+//
+
+#ifndef DrawQueue_h
+#define DrawQueue_h
+
+#include "GLCommandBuffer.h"
+
+#include <stdint.h>
+#include <vector>
+
+class DrawQueue {
+public:
+    struct Draw {
+        GLuint program;
+        GLuint texture; // GL_TEXTURE_2D on unit 0, 0 for none.
+        GLuint vertexArray;
+        GLenum mode;
+        GLsizei count;
+        GLenum indexType; // 0 for glDrawArrays.
+        uint32_t first; // First vertex, or byte offset into the index buffer.
+    };
+
+    struct Stats {
+        uint32_t draws;
+        uint32_t programChanges;
+        uint32_t textureChanges;
+        uint32_t vertexArrayChanges;
+    };
+
+    static const unsigned int MAX_LAYERS = 16;
+    // Program and texture ids only need to be distinct, not GL names; ids
+    // above this are folded into the key and just sort less well.
+    static const unsigned int MAX_SORT_ID = 4096;
+
+    // 'depth' is the view-space distance, >= 0.
+    static uint64_t makeKey(unsigned int layer, bool translucent, GLuint program, GLuint texture, float depth);
+
+    DrawQueue();
+
+    void add(uint64_t key, const Draw &draw);
+    void clear();
+
+    size_t size() const { return mKeys.size(); }
+
+    // Stable LSD radix sort on the keys, 8 bits per pass. Passes where every
+    // key has the same digit are skipped.
+    void sort();
+
+    // Records the draws in their current order and leaves the program, vertex
+    // array and texture bindings at zero. The queue keeps its contents.
+    void submit(GLCommandBuffer &commands);
+
+    const Stats &stats() const { return mStats; }
+
+private:
+    struct Entry {
+        uint64_t key;
+        uint32_t index;
+    };
+
+    std::vector<Entry> mKeys;
+    std::vector<Entry> mScratch;
+    std::vector<Draw> mDraws;
+    Stats mStats;
+};
+
+#endif /* DrawQueue_h */
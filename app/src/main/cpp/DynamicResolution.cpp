@@ -0,0 +1,159 @@
+//
+//  DynamicResolution.cpp
+//
+
+#include "DynamicResolution.h"
+
+#include <math.h>
+
+DynamicResolution::Config DynamicResolution::defaultConfig()
+{
+    Config config;
+    config.budgetMs = 1000.0 / 60.0;
+    config.minScale = 0.5f;
+    config.maxScale = 1.0f;
+    config.step = 1.0f / 16.0f;
+    config.smoothing = 0.1;
+    config.lowerAbove = 0.95;
+    config.raiseBelow = 0.8;
+    config.noiseMargin = 2.0;
+    config.settleFrames = 15;
+    config.probeFrames = 0;
+    config.probeMissAbove = 1.5;
+    return config;
+}
+
+DynamicResolution::Config DynamicResolution::frameIntervalConfig()
+{
+    Config config = defaultConfig();
+    config.lowerAbove = 1.05;
+    // A second at 60 Hz; a missed vsync doubles the interval.
+    config.probeFrames = 60;
+    return config;
+}
+
+DynamicResolution::DynamicResolution(const Config &config)
+        : mConfig(config)
+{
+    reset();
+}
+
+void DynamicResolution::reset()
+{
+    mScale = mConfig.maxScale;
+    mEstimateMs = 0.0;
+    mVarianceMs2 = 0.0;
+    mHasEstimate = false;
+    mFramesSinceChange = 0;
+    mChangeCount = 0;
+    mProbeFromScale = 0.0f;
+    mProbeFromEstimateMs = 0.0;
+    mProbeFromVarianceMs2 = 0.0;
+    mProbeWaitFrames = mConfig.probeFrames;
+}
+
+float DynamicResolution::quantize(float scale) const
+{
+    // Rounded down, so the new scale lands at or under the aim: one change
+    // is enough when lowering, and raising does not overshoot the band.
+    scale = floorf(scale / mConfig.step + 1e-3f) * mConfig.step;
+    if (scale < mConfig.minScale)
+    {
+        return mConfig.minScale;
+    }
+    return scale > mConfig.maxScale ? mConfig.maxScale : scale;
+}
+
+void DynamicResolution::addFrame(double cpuMs, double gpuMs)
+{
+    const double ms = gpuMs >= 0.0 ? gpuMs : cpuMs;
+    if (!mHasEstimate)
+    {
+        mEstimateMs = ms;
+        mVarianceMs2 = 0.0;
+        mHasEstimate = true;
+    }
+    else
+    {
+        const double smoothing = mConfig.smoothing;
+        const double deviation = ms - mEstimateMs;
+        mEstimateMs += smoothing * deviation;
+        mVarianceMs2 = (1.0 - smoothing) * (mVarianceMs2 + smoothing * deviation * deviation);
+    }
+
+    ++mFramesSinceChange;
+    if (mProbeFromScale > 0.0f)
+    {
+        if (ms > mConfig.budgetMs * mConfig.probeMissAbove)
+        {
+            // The frames measured at the probe's scale do not count.
+            setScale(mProbeFromScale);
+            mEstimateMs = mProbeFromEstimateMs;
+            mVarianceMs2 = mProbeFromVarianceMs2;
+            mProbeFromScale = 0.0f;
+            mProbeWaitFrames = mProbeWaitFrames * 2 < mConfig.probeFrames * 16 ? mProbeWaitFrames * 2
+                                                                                : mConfig.probeFrames * 16;
+            return;
+        }
+        if (mFramesSinceChange >= mConfig.settleFrames)
+        {
+            mProbeFromScale = 0.0f;
+            mProbeWaitFrames = mConfig.probeFrames;
+        }
+    }
+
+    if (mFramesSinceChange < mConfig.settleFrames || mEstimateMs <= 0.0)
+    {
+        return;
+    }
+
+    // The average still wanders with noisy frames; it has to be out of the
+    // band by this much before anything changes.
+    const double smoothing = mConfig.smoothing;
+    const double margin = mConfig.noiseMargin * sqrt(mVarianceMs2 * smoothing / (2.0 - smoothing));
+
+    const double budget = mConfig.budgetMs;
+    const double aim = budget * 0.5 * (mConfig.lowerAbove + mConfig.raiseBelow);
+    float scale = mScale;
+    if (mEstimateMs - margin > budget * mConfig.lowerAbove)
+    {
+        scale = quantize(float(mScale * sqrt(aim / mEstimateMs)));
+    }
+    else if (mEstimateMs + margin < budget * mConfig.raiseBelow)
+    {
+        // Raised only as far as the pessimistic side of the average allows.
+        scale = quantize(float(mScale * sqrt(aim / (mEstimateMs + margin))));
+        scale = scale > mScale ? scale : mScale;
+    }
+    else if (mConfig.probeFrames > 0 && mScale < mConfig.maxScale && mFramesSinceChange >= mProbeWaitFrames)
+    {
+        mProbeFromScale = mScale;
+        mProbeFromEstimateMs = mEstimateMs;
+        mProbeFromVarianceMs2 = mVarianceMs2;
+        scale = quantize(mScale + mConfig.step);
+    }
+    if (scale == mScale)
+    {
+        return;
+    }
+
+    const double ratio = double(scale) / double(mScale);
+    mEstimateMs *= ratio * ratio;
+    mVarianceMs2 *= ratio * ratio * ratio * ratio;
+    setScale(scale);
+}
+
+void DynamicResolution::setScale(float scale)
+{
+    mScale = scale;
+    mFramesSinceChange = 0;
+    ++mChangeCount;
+}
+
+void DynamicResolution::scaledSize(int width, int height, int &scaledWidth, int &scaledHeight) const
+{
+    scaledWidth = int(width * mScale + 0.5f);
+    scaledHeight = int(height * mScale + 0.5f);
+    scaledWidth = scaledWidth > 0 ? scaledWidth : 1;
+    scaledHeight = scaledHeight > 0 ? scaledHeight : 1;
+}
@@ -0,0 +1,95 @@
+//
+//  DynamicResolution.h
+//
+//  Picks the scale the scene renders at from measured frame times. Each
+//  frame's time goes into an exponential moving average; when the average
+//  leaves the band between raiseBelow and lowerAbove of the budget by more
+//  than its own noise, the scale moves to where the average would land in
+//  the middle of the band, taking the frame time to follow the pixel count
+//  (scale squared). The new scale is rounded to 'step', so only a few
+//  target sizes ever exist, and the average is rescaled by the same model
+//  rather than thrown away. After a change the controller waits
+//  settleFrames before the next one, which lets the measurements catch up.
+//  The noise allowance comes from a running variance of the frame times,
+//  so steady frames react at the band's edges and noisy ones do not
+//  oscillate between neighbouring steps.
+//
+//  Frame intervals under vsync never come in under the budget, so with
+//  them the band cannot raise the scale. There the controller probes:
+//  after probeFrames frames without a change it steps up once and steps
+//  back if a frame misses vsync before the probe has settled.
+//
+//  Only the scene's cost follows the scale; anything fixed (the overlay,
+//  the composite, CPU-bound frames) makes the model overshoot, which the
+//  next decision corrects. GL-free, so tools/dynres_sim can drive it with
+//  simulated frame times.
+//
+
+#ifndef DynamicResolution_h
+#define DynamicResolution_h
+
+class DynamicResolution {
+public:
+    struct Config {
+        double budgetMs;
+        float minScale;
+        float maxScale;
+        float step;
+        // Weight of the newest frame in the average.
+        double smoothing;
+        // As fractions of the budget.
+        double lowerAbove;
+        double raiseBelow;
+        // Standard deviations of the average it must be outside the band by.
+        double noiseMargin;
+        unsigned int settleFrames;
+        // Frames without a change before a probe one step up; 0 never
+        // probes. Each failed probe doubles the wait, up to 16 times.
+        unsigned int probeFrames;
+        // A probe fails on a frame over this fraction of the budget.
+        double probeMissAbove;
+    };
+
+    // A 60 Hz budget, scales 0.5 to 1 in steps of 1/16.
+    static Config defaultConfig();
+    // defaultConfig() for frame-to-frame intervals instead of GPU times.
+    // Under vsync a frame that fits takes a whole budget, so only frames
+    // that miss it lower the scale, and raising is left to probes.
+    static Config frameIntervalConfig();
+
+    explicit DynamicResolution(const Config &config = defaultConfig());
+
+    // Back to maxScale with no history.
+    void reset();
+
+    // One frame's time. 'gpuMs' is negative when the GPU was not timed;
+    // the CPU time stands in for it then.
+    void addFrame(double cpuMs, double gpuMs);
+
+    float scale() const { return mScale; }
+    // 'width' x 'height' at the current scale, at least 1 x 1.
+    void scaledSize(int width, int height, int &scaledWidth, int &scaledHeight) const;
+
+    double estimateMs() const { return mEstimateMs; }
+    unsigned int changeCount() const { return mChangeCount; }
+    const Config &config() const { return mConfig; }
+
+private:
+    float quantize(float scale) const;
+    void setScale(float scale);
+
+    Config mConfig;
+    float mScale;
+    double mEstimateMs;
+    double mVarianceMs2;
+    bool mHasEstimate;
+    unsigned int mFramesSinceChange;
+    unsigned int mChangeCount;
+    // While a probe settles: the scale, average and variance to go back to.
+    float mProbeFromScale; // 0 when not probing.
+    double mProbeFromEstimateMs;
+    double mProbeFromVarianceMs2;
+    unsigned int mProbeWaitFrames;
+};
+
+#endif /* DynamicResolution_h */
@@ -0,0 +1,455 @@
+//
+//  GLCommandBuffer.cpp
+//
+
+#include "GLCommandBuffer.h"
+
+#include <string.h>
+
+// Capture file layout:
+//
+//   uint32 magic ("GLCS"), uint32 version
+//   per frame: uint32 byteSize, uint32 commandCount, byteSize bytes of commands
+//
+static const uint32_t CAPTURE_MAGIC = 0x53434c47; // "GLCS"
+static const uint32_t CAPTURE_VERSION = 1;
+
+static const size_t COMMAND_ALIGNMENT = 8;
+static const size_t INITIAL_ARENA_SIZE = 64 * 1024;
+// Larger frames in a capture are taken as corrupt rather than allocated.
+static const uint32_t MAX_CAPTURE_FRAME_SIZE = 64 * 1024 * 1024;
+
+static inline size_t alignUp(size_t value)
+{
+    return (value + (COMMAND_ALIGNMENT - 1)) & ~(COMMAND_ALIGNMENT - 1);
+}
+
+GLCommandBuffer::GLCommandBuffer()
+        : mArena(INITIAL_ARENA_SIZE), mUsed(0), mCommandCount(0)
+{
+}
+
+void GLCommandBuffer::reset()
+{
+    mUsed = 0;
+    mCommandCount = 0;
+}
+
+void *GLCommandBuffer::allocate(size_t bytes)
+{
+    bytes = alignUp(bytes);
+    if (mUsed + bytes > mArena.size())
+    {
+        // Grow geometrically; after the first few frames this never happens.
+        size_t newSize = mArena.size() * 2;
+        while (newSize < mUsed + bytes)
+        {
+            newSize *= 2;
+        }
+        mArena.resize(newSize);
+    }
+
+    void *ptr = &mArena[mUsed];
+    mUsed += bytes;
+    return ptr;
+}
+
+template<typename T>
+T &GLCommandBuffer::record(Opcode opcode, size_t extraBytes, const void *extra)
+{
+    const size_t payloadSize = alignUp(sizeof(T) + extraBytes);
+
+    Command *command = (Command *)allocate(sizeof(Command) + payloadSize);
+    command->opcode = opcode;
+    command->size = (uint32_t)payloadSize;
+
+    // Padding is zeroed too, so captures never hold stale heap memory.
+    uint8_t *payload = (uint8_t *)(command + 1);
+    memset(payload, 0, sizeof(T));
+    if (extra != NULL && extraBytes > 0)
+    {
+        memcpy(payload + sizeof(T), extra, extraBytes);
+        memset(payload + sizeof(T) + extraBytes, 0, payloadSize - sizeof(T) - extraBytes);
+    }
+    else
+    {
+        memset(payload + sizeof(T), 0, payloadSize - sizeof(T));
+    }
+
+    ++mCommandCount;
+    return *(T *)payload;
+}
+
+void GLCommandBuffer::viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+    Viewport &cmd = record<Viewport>(CMD_VIEWPORT);
+    cmd.x = x;
+    cmd.y = y;
+    cmd.width = width;
+    cmd.height = height;
+}
+
+void GLCommandBuffer::clearColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a)
+{
+    ClearColor &cmd = record<ClearColor>(CMD_CLEAR_COLOR);
+    cmd.r = r;
+    cmd.g = g;
+    cmd.b = b;
+    cmd.a = a;
+}
+
+void GLCommandBuffer::clear(GLbitfield mask)
+{
+    record<Clear>(CMD_CLEAR).mask = mask;
+}
+
+void GLCommandBuffer::enable(GLenum cap)
+{
+    record<Capability>(CMD_ENABLE).cap = cap;
+}
+
+void GLCommandBuffer::disable(GLenum cap)
+{
+    record<Capability>(CMD_DISABLE).cap = cap;
+}
+
+void GLCommandBuffer::blendFunc(GLenum sfactor, GLenum dfactor)
+{
+    BlendFunc &cmd = record<BlendFunc>(CMD_BLEND_FUNC);
+    cmd.sfactor = sfactor;
+    cmd.dfactor = dfactor;
+}
+
+void GLCommandBuffer::useProgram(GLuint program)
+{
+    record<UseProgram>(CMD_USE_PROGRAM).program = program;
+}
+
+void GLCommandBuffer::activeTexture(GLenum texture)
+{
+    record<ActiveTexture>(CMD_ACTIVE_TEXTURE).texture = texture;
+}
+
+void GLCommandBuffer::bindTexture(GLenum target, GLuint texture)
+{
+    BindTexture &cmd = record<BindTexture>(CMD_BIND_TEXTURE);
+    cmd.target = target;
+    cmd.texture = texture;
+}
+
+void GLCommandBuffer::uniform1i(GLint location, GLint x)
+{
+    Uniform1i &cmd = record<Uniform1i>(CMD_UNIFORM_1I);
+    cmd.location = location;
+    cmd.x = x;
+}
+
+void GLCommandBuffer::uniform2f(GLint location, GLfloat x, GLfloat y)
+{
+    Uniform2f &cmd = record<Uniform2f>(CMD_UNIFORM_2F);
+    cmd.location = location;
+    cmd.x = x;
+    cmd.y = y;
+}
+
+void GLCommandBuffer::uniformMatrix4fv(GLint location, const GLfloat *value)
+{
+    UniformMatrix4fv &cmd = record<UniformMatrix4fv>(CMD_UNIFORM_MATRIX_4FV);
+    cmd.location = location;
+    memcpy(cmd.value, value, sizeof(cmd.value));
+}
+
+void GLCommandBuffer::bindVertexArray(GLuint array)
+{
+    record<BindVertexArray>(CMD_BIND_VERTEX_ARRAY).array = array;
+}
+
+void GLCommandBuffer::bindBuffer(GLenum target, GLuint buffer)
+{
+    BindBuffer &cmd = record<BindBuffer>(CMD_BIND_BUFFER);
+    cmd.target = target;
+    cmd.buffer = buffer;
+}
+
+void GLCommandBuffer::bufferData(GLenum target, size_t size, const void *data, GLenum usage)
+{
+    BufferData &cmd = record<BufferData>(CMD_BUFFER_DATA, data ? size : 0, data);
+    cmd.target = target;
+    cmd.usage = usage;
+    cmd.size = (uint32_t)size;
+    cmd.hasData = (data != NULL);
+}
+
+void GLCommandBuffer::bufferSubData(GLenum target, size_t offset, size_t size, const void *data)
+{
+    BufferSubData &cmd = record<BufferSubData>(CMD_BUFFER_SUB_DATA, size, data);
+    cmd.target = target;
+    cmd.offset = (uint32_t)offset;
+    cmd.size = (uint32_t)size;
+    cmd.pad = 0;
+}
+
+void GLCommandBuffer::vertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized,
+                                          GLsizei stride, size_t offset)
+{
+    VertexAttribPointer &cmd = record<VertexAttribPointer>(CMD_VERTEX_ATTRIB_POINTER);
+    cmd.index = index;
+    cmd.size = size;
+    cmd.type = type;
+    cmd.normalized = normalized;
+    cmd.stride = stride;
+    cmd.offset = (uint32_t)offset;
+}
+
+void GLCommandBuffer::enableVertexAttribArray(GLuint index)
+{
+    record<EnableVertexAttribArray>(CMD_ENABLE_VERTEX_ATTRIB_ARRAY).index = index;
+}
+
+void GLCommandBuffer::drawArrays(GLenum mode, GLint first, GLsizei count)
+{
+    DrawArrays &cmd = record<DrawArrays>(CMD_DRAW_ARRAYS);
+    cmd.mode = mode;
+    cmd.first = first;
+    cmd.count = count;
+}
+
+void GLCommandBuffer::drawElements(GLenum mode, GLsizei count, GLenum type, size_t offset)
+{
+    DrawElements &cmd = record<DrawElements>(CMD_DRAW_ELEMENTS);
+    cmd.mode = mode;
+    cmd.count = count;
+    cmd.type = type;
+    cmd.offset = (uint32_t)offset;
+}
+
+void GLCommandBuffer::disableVertexAttribArray(GLuint index)
+{
+    record<DisableVertexAttribArray>(CMD_DISABLE_VERTEX_ATTRIB_ARRAY).index = index;
+}
+
+void GLCommandBuffer::vertexAttrib4fv(GLuint index, const GLfloat *value)
+{
+    VertexAttrib4fv &cmd = record<VertexAttrib4fv>(CMD_VERTEX_ATTRIB_4FV);
+    cmd.index = index;
+    memcpy(cmd.value, value, sizeof(cmd.value));
+}
+
+void GLCommandBuffer::vertexAttribDivisor(GLuint index, GLuint divisor)
+{
+    VertexAttribDivisor &cmd = record<VertexAttribDivisor>(CMD_VERTEX_ATTRIB_DIVISOR);
+    cmd.index = index;
+    cmd.divisor = divisor;
+}
+
+void GLCommandBuffer::drawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instanceCount)
+{
+    DrawArraysInstanced &cmd = record<DrawArraysInstanced>(CMD_DRAW_ARRAYS_INSTANCED);
+    cmd.mode = mode;
+    cmd.first = first;
+    cmd.count = count;
+    cmd.instanceCount = instanceCount;
+}
+
+void GLCommandBuffer::bindFramebuffer(GLenum target, GLuint framebuffer)
+{
+    BindFramebuffer &cmd = record<BindFramebuffer>(CMD_BIND_FRAMEBUFFER);
+    cmd.target = target;
+    cmd.framebuffer = framebuffer;
+}
+
+void GLCommandBuffer::discardFramebuffer(GLenum target, GLsizei count, const GLenum *attachments)
+{
+    DiscardFramebuffer &cmd = record<DiscardFramebuffer>(CMD_DISCARD_FRAMEBUFFER);
+    cmd.target = target;
+    cmd.count = count < 3 ? count : 3;
+    memset(cmd.attachments, 0, sizeof(cmd.attachments));
+    memcpy(cmd.attachments, attachments, cmd.count * sizeof(GLenum));
+}
+
+void GLCommandBuffer::replay(GLCommandBackend &backend) const
+{
+    size_t pos = 0;
+    while (pos + sizeof(Command) <= mUsed)
+    {
+        const Command *command = (const Command *)&mArena[pos];
+        if (command->opcode >= NUM_OPCODES || command->size > mUsed - pos - sizeof(Command))
+        {
+            // Only a corrupt stream gets here; readFrame() rejects those.
+            break;
+        }
+        backend.execute(*command, command + 1);
+        pos += sizeof(Command) + command->size;
+    }
+}
+
+// Payload bytes 'command' needs, or 0 for an unknown opcode.
+static size_t payloadSize(const GLCommandBuffer::Command &command, const void *payload)
+{
+    switch (command.opcode)
+    {
+        case GLCommandBuffer::CMD_VIEWPORT: return sizeof(GLCommandBuffer::Viewport);
+        case GLCommandBuffer::CMD_CLEAR_COLOR: return sizeof(GLCommandBuffer::ClearColor);
+        case GLCommandBuffer::CMD_CLEAR: return sizeof(GLCommandBuffer::Clear);
+        case GLCommandBuffer::CMD_ENABLE:
+        case GLCommandBuffer::CMD_DISABLE: return sizeof(GLCommandBuffer::Capability);
+        case GLCommandBuffer::CMD_BLEND_FUNC: return sizeof(GLCommandBuffer::BlendFunc);
+        case GLCommandBuffer::CMD_USE_PROGRAM: return sizeof(GLCommandBuffer::UseProgram);
+        case GLCommandBuffer::CMD_ACTIVE_TEXTURE: return sizeof(GLCommandBuffer::ActiveTexture);
+        case GLCommandBuffer::CMD_BIND_TEXTURE: return sizeof(GLCommandBuffer::BindTexture);
+        case GLCommandBuffer::CMD_UNIFORM_1I: return sizeof(GLCommandBuffer::Uniform1i);
+        case GLCommandBuffer::CMD_UNIFORM_2F: return sizeof(GLCommandBuffer::Uniform2f);
+        case GLCommandBuffer::CMD_UNIFORM_MATRIX_4FV: return sizeof(GLCommandBuffer::UniformMatrix4fv);
+        case GLCommandBuffer::CMD_BIND_VERTEX_ARRAY: return sizeof(GLCommandBuffer::BindVertexArray);
+        case GLCommandBuffer::CMD_BIND_BUFFER: return sizeof(GLCommandBuffer::BindBuffer);
+        case GLCommandBuffer::CMD_VERTEX_ATTRIB_POINTER: return sizeof(GLCommandBuffer::VertexAttribPointer);
+        case GLCommandBuffer::CMD_ENABLE_VERTEX_ATTRIB_ARRAY: return sizeof(GLCommandBuffer::EnableVertexAttribArray);
+        case GLCommandBuffer::CMD_DRAW_ARRAYS: return sizeof(GLCommandBuffer::DrawArrays);
+        case GLCommandBuffer::CMD_DRAW_ELEMENTS: return sizeof(GLCommandBuffer::DrawElements);
+        case GLCommandBuffer::CMD_DISABLE_VERTEX_ATTRIB_ARRAY: return sizeof(GLCommandBuffer::DisableVertexAttribArray);
+        case GLCommandBuffer::CMD_VERTEX_ATTRIB_4FV: return sizeof(GLCommandBuffer::VertexAttrib4fv);
+        case GLCommandBuffer::CMD_VERTEX_ATTRIB_DIVISOR: return sizeof(GLCommandBuffer::VertexAttribDivisor);
+        case GLCommandBuffer::CMD_DRAW_ARRAYS_INSTANCED: return sizeof(GLCommandBuffer::DrawArraysInstanced);
+        case GLCommandBuffer::CMD_BIND_FRAMEBUFFER: return sizeof(GLCommandBuffer::BindFramebuffer);
+        case GLCommandBuffer::CMD_DISCARD_FRAMEBUFFER: return sizeof(GLCommandBuffer::DiscardFramebuffer);
+
+        // The trailing data is only read if the header fits.
+        case GLCommandBuffer::CMD_BUFFER_DATA:
+        {
+            const GLCommandBuffer::BufferData *cmd = (const GLCommandBuffer::BufferData *)payload;
+            if (command.size < sizeof(*cmd))
+            {
+                return sizeof(*cmd);
+            }
+            return sizeof(*cmd) + (cmd->hasData ? size_t(cmd->size) : 0);
+        }
+        case GLCommandBuffer::CMD_BUFFER_SUB_DATA:
+        {
+            const GLCommandBuffer::BufferSubData *cmd = (const GLCommandBuffer::BufferSubData *)payload;
+            if (command.size < sizeof(*cmd))
+            {
+                return sizeof(*cmd);
+            }
+            return sizeof(*cmd) + size_t(cmd->size);
+        }
+        default:
+            return 0;
+    }
+}
+
+bool GLCommandBuffer::validate() const
+{
+    size_t pos = 0;
+    uint32_t count = 0;
+    while (pos < mUsed)
+    {
+        if (mUsed - pos < sizeof(Command))
+        {
+            return false;
+        }
+        const Command *command = (const Command *)&mArena[pos];
+        pos += sizeof(Command);
+        if (command->size > mUsed - pos || command->size % COMMAND_ALIGNMENT != 0)
+        {
+            return false;
+        }
+        const size_t needed = payloadSize(*command, command + 1);
+        if (needed == 0 || needed > command->size)
+        {
+            return false;
+        }
+        pos += command->size;
+        ++count;
+    }
+    return count == mCommandCount;
+}
+
+bool GLCommandBuffer::writeHeader(FILE *f)
+{
+    const uint32_t header[2] = { CAPTURE_MAGIC, CAPTURE_VERSION };
+    return fwrite(header, sizeof(header), 1, f) == 1;
+}
+
+bool GLCommandBuffer::readHeader(FILE *f)
+{
+    uint32_t header[2];
+    return fread(header, sizeof(header), 1, f) == 1 &&
+           header[0] == CAPTURE_MAGIC && header[1] == CAPTURE_VERSION;
+}
+
+bool GLCommandBuffer::writeFrame(FILE *f) const
+{
+    const uint32_t frameHeader[2] = { (uint32_t)mUsed, mCommandCount };
+    if (fwrite(frameHeader, sizeof(frameHeader), 1, f) != 1)
+    {
+        return false;
+    }
+    return mUsed == 0 || fwrite(&mArena[0], 1, mUsed, f) == mUsed;
+}
+
+bool GLCommandBuffer::readFrame(FILE *f)
+{
+    reset();
+
+    uint32_t frameHeader[2];
+    if (fread(frameHeader, sizeof(frameHeader), 1, f) != 1)
+    {
+        return false;
+    }
+
+    if (frameHeader[0] > MAX_CAPTURE_FRAME_SIZE || frameHeader[0] % COMMAND_ALIGNMENT != 0)
+    {
+        return false;
+    }
+
+    void *data = allocate(frameHeader[0]);
+    if (frameHeader[0] > 0 && fread(data, 1, frameHeader[0], f) != frameHeader[0])
+    {
+        reset();
+        return false;
+    }
+    mCommandCount = frameHeader[1];
+
+    // Truncated commands, unknown opcodes and short payloads would have
+    // replay() read past the frame.
+    if (!validate())
+    {
+        reset();
+        return false;
+    }
+    return true;
+}
+
+const char *GLCommandBuffer::opcodeName(uint32_t opcode)
+{
+    static const char *names[NUM_OPCODES] = {
+            "None",
+            "Viewport",
+            "ClearColor",
+            "Clear",
+            "Enable",
+            "Disable",
+            "BlendFunc",
+            "UseProgram",
+            "ActiveTexture",
+            "BindTexture",
+            "Uniform1i",
+            "Uniform2f",
+            "UniformMatrix4fv",
+            "BindVertexArray",
+            "BindBuffer",
+            "BufferData",
+            "BufferSubData",
+            "VertexAttribPointer",
+            "EnableVertexAttribArray",
+            "DrawArrays",
+            "DrawElements",
+            "DisableVertexAttribArray",
+            "VertexAttrib4fv",
+            "VertexAttribDivisor",
+            "DrawArraysInstanced",
+            "BindFramebuffer",
+            "DiscardFramebuffer"
+    };
+    return opcode < NUM_OPCODES ? names[opcode] : "Unknown";
+}
@@ -0,0 +1,185 @@
+//
+//  GLCommandBuffer.h
+//
+//  A compact, recordable stream of GL commands. Each command is an opcode and
+//  a fixed-size payload (plus trailing data for buffer uploads) bump-allocated
+//  from one arena that is reused frame after frame.
+//
+//  Recording never touches GL, so any thread can fill a buffer. The render
+//  thread replays it through a GLCommandBackend. Because commands only hold
+//  values and offsets, a recorded frame can be written to disk as-is and
+//  replayed later, e.g. by tools/glreplay.
+//
+
+#ifndef GLCommandBuffer_h
+#define GLCommandBuffer_h
+
+#include <GLES2/gl2.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <vector>
+
+class GLCommandBackend;
+
+class GLCommandBuffer {
+public:
+    enum Opcode {
+        CMD_NONE = 0,
+        CMD_VIEWPORT,
+        CMD_CLEAR_COLOR,
+        CMD_CLEAR,
+        CMD_ENABLE,
+        CMD_DISABLE,
+        CMD_BLEND_FUNC,
+        CMD_USE_PROGRAM,
+        CMD_ACTIVE_TEXTURE,
+        CMD_BIND_TEXTURE,
+        CMD_UNIFORM_1I,
+        CMD_UNIFORM_2F,
+        CMD_UNIFORM_MATRIX_4FV,
+        CMD_BIND_VERTEX_ARRAY,
+        CMD_BIND_BUFFER,
+        CMD_BUFFER_DATA,
+        CMD_BUFFER_SUB_DATA,
+        CMD_VERTEX_ATTRIB_POINTER,
+        CMD_ENABLE_VERTEX_ATTRIB_ARRAY,
+        CMD_DRAW_ARRAYS,
+        CMD_DRAW_ELEMENTS,
+        CMD_DISABLE_VERTEX_ATTRIB_ARRAY,
+        CMD_VERTEX_ATTRIB_4FV,
+        CMD_VERTEX_ATTRIB_DIVISOR,
+        CMD_DRAW_ARRAYS_INSTANCED,
+        CMD_BIND_FRAMEBUFFER,
+        CMD_DISCARD_FRAMEBUFFER,
+        NUM_OPCODES
+    };
+
+    struct Command {
+        uint32_t opcode;
+        uint32_t size; // Payload bytes following this header, padded to 8.
+    };
+
+    // Payloads. Plain values only, no pointers, so a stream can be saved.
+    struct Viewport { GLint x, y; GLsizei width, height; };
+    struct ClearColor { GLfloat r, g, b, a; };
+    struct Clear { GLbitfield mask; };
+    struct Capability { GLenum cap; };
+    struct BlendFunc { GLenum sfactor, dfactor; };
+    struct UseProgram { GLuint program; };
+    struct ActiveTexture { GLenum texture; };
+    struct BindTexture { GLenum target; GLuint texture; };
+    struct Uniform1i { GLint location; GLint x; };
+    struct Uniform2f { GLint location; GLfloat x, y; };
+    struct UniformMatrix4fv { GLint location; GLfloat value[16]; };
+    struct BindVertexArray { GLuint array; };
+    struct BindBuffer { GLenum target; GLuint buffer; };
+    struct BufferData { GLenum target; GLenum usage; uint32_t size; uint32_t hasData; }; // + size bytes
+    struct BufferSubData { GLenum target; uint32_t offset; uint32_t size; uint32_t pad; }; // + size bytes
+    struct VertexAttribPointer { GLuint index; GLint size; GLenum type; GLboolean normalized; GLsizei stride; uint32_t offset; };
+    struct EnableVertexAttribArray { GLuint index; };
+    struct DrawArrays { GLenum mode; GLint first; GLsizei count; };
+    struct DrawElements { GLenum mode; GLsizei count; GLenum type; uint32_t offset; };
+    struct DisableVertexAttribArray { GLuint index; };
+    struct VertexAttrib4fv { GLuint index; GLfloat value[4]; };
+    struct VertexAttribDivisor { GLuint index; GLuint divisor; };
+    struct DrawArraysInstanced { GLenum mode; GLint first; GLsizei count; GLsizei instanceCount; };
+    struct BindFramebuffer { GLenum target; GLuint framebuffer; };
+    struct DiscardFramebuffer { GLenum target; GLsizei count; GLenum attachments[3]; };
+
+    GLCommandBuffer();
+
+    // Drops all commands but keeps the arena for the next frame.
+    void reset();
+
+    bool empty() const { return mUsed == 0; }
+    size_t byteSize() const { return mUsed; }
+    size_t capacity() const { return mArena.size(); }
+    uint32_t commandCount() const { return mCommandCount; }
+
+    void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+    void clearColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a);
+    void clear(GLbitfield mask);
+    void enable(GLenum cap);
+    void disable(GLenum cap);
+    void blendFunc(GLenum sfactor, GLenum dfactor);
+    void useProgram(GLuint program);
+    void activeTexture(GLenum texture);
+    void bindTexture(GLenum target, GLuint texture);
+    void uniform1i(GLint location, GLint x);
+    void uniform2f(GLint location, GLfloat x, GLfloat y);
+    void uniformMatrix4fv(GLint location, const GLfloat *value);
+    void bindVertexArray(GLuint array);
+    void bindBuffer(GLenum target, GLuint buffer);
+    // 'data' is copied into the stream; it may be null to only (re)allocate.
+    void bufferData(GLenum target, size_t size, const void *data, GLenum usage);
+    void bufferSubData(GLenum target, size_t offset, size_t size, const void *data);
+    void vertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized,
+                             GLsizei stride, size_t offset);
+    void enableVertexAttribArray(GLuint index);
+    void drawArrays(GLenum mode, GLint first, GLsizei count);
+    void drawElements(GLenum mode, GLsizei count, GLenum type, size_t offset);
+    void disableVertexAttribArray(GLuint index);
+    void vertexAttrib4fv(GLuint index, const GLfloat *value);
+    // Instancing; only replay these if GLESCommandBackend::hasInstancing().
+    void vertexAttribDivisor(GLuint index, GLuint divisor);
+    void drawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instanceCount);
+    // 0 is the window surface.
+    void bindFramebuffer(GLenum target, GLuint framebuffer);
+    // Up to 3 attachments of the bound framebuffer whose contents are no
+    // longer needed. A hint: dropped where the driver has no discard.
+    void discardFramebuffer(GLenum target, GLsizei count, const GLenum *attachments);
+
+    // Hands every command, in recording order, to 'backend'.
+    void replay(GLCommandBackend &backend) const;
+
+    // Capture file support. A capture is a small file header followed by one
+    // block per frame; see GLCommandBuffer.cpp for the layout. The stream is
+    // stored in native byte order, captures are not meant to change arch.
+    static bool writeHeader(FILE *f);
+    static bool readHeader(FILE *f);
+    bool writeFrame(FILE *f) const;
+    // Fails on a frame that is too large, truncated or holds commands
+    // replay() could not dispatch safely, leaving the buffer empty.
+    bool readFrame(FILE *f);
+
+    static const char *opcodeName(uint32_t opcode);
+
+private:
+    template<typename T>
+    T &record(Opcode opcode, size_t extraBytes = 0, const void *extra = NULL);
+
+    void *allocate(size_t bytes);
+    // Every command lies inside the stream, has a known opcode and a
+    // payload large enough for it, and their number is mCommandCount.
+    bool validate() const;
+
+    std::vector<uint8_t> mArena;
+    size_t mUsed;
+    uint32_t mCommandCount;
+};
+
+class GLCommandBackend {
+public:
+    virtual ~GLCommandBackend() {}
+
+    // 'payload' points at the opcode's payload struct from GLCommandBuffer.
+    virtual void execute(const GLCommandBuffer::Command &command, const void *payload) = 0;
+};
+
+// Replays into the current GLES context. Render thread only.
+class GLESCommandBackend : public GLCommandBackend {
+public:
+    // Resolves instanced drawing: core on ES 3.0+, else GL_EXT_instanced_arrays,
+    // GL_ANGLE_instanced_arrays or GL_NV_instanced_arrays. Needs a current
+    // context; call once before recording any instanced commands.
+    static void initialize();
+    static bool hasInstancing();
+    // glInvalidateFramebuffer on ES 3.0+, else GL_EXT_discard_framebuffer.
+    static bool hasDiscard();
+
+    virtual void execute(const GLCommandBuffer::Command &command, const void *payload);
+};
+
+#endif /* GLCommandBuffer_h */
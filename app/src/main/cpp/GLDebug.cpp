@@ -0,0 +1,138 @@
+//
+//  GLDebug.cpp
+//
+
+#include "GLDebug.h"
+
+#define GL_GLEXT_PROTOTYPES
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#include <EGL/egl.h>
+#include <android/log.h>
+#include <string.h>
+
+#define LOG_TAG "EglSample"
+
+#define LOG_INFO(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOG_ERROR(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+static bool s_callbackInstalled = false;
+static unsigned int s_errorCount = 0;
+static unsigned int s_frame = 0;
+
+#if GLDEBUG_MODE == GLDEBUG_FULL
+static void GL_APIENTRY debugMessageCallback(GLenum /* source */, GLenum type, GLuint id, GLenum severity,
+                                             GLsizei /* length */, const GLchar *message,
+                                             const void * /* userParam */)
+{
+    if (type == GL_DEBUG_TYPE_ERROR_KHR)
+    {
+        ++s_errorCount;
+        LOG_ERROR("GL error (id %u): %s", id, message);
+    }
+    else if (severity != GL_DEBUG_SEVERITY_NOTIFICATION_KHR)
+    {
+        LOG_INFO("GL debug (type 0x%x, id %u): %s", type, id, message);
+    }
+}
+#endif
+
+void GLDebug::initialize(bool useCallback)
+{
+    s_callbackInstalled = false;
+    s_frame = 0;
+
+#if GLDEBUG_MODE == GLDEBUG_FULL
+    const GLubyte *extensions = glGetString(GL_EXTENSIONS);
+    const bool hasDebug = extensions && strstr((const char *)extensions, "GL_KHR_debug") != NULL;
+
+    PFNGLDEBUGMESSAGECALLBACKKHRPROC debugMessageCallbackKHR = 0;
+    if (useCallback && hasDebug)
+    {
+        debugMessageCallbackKHR =
+                (PFNGLDEBUGMESSAGECALLBACKKHRPROC)eglGetProcAddress("glDebugMessageCallbackKHR");
+    }
+
+    if (debugMessageCallbackKHR)
+    {
+        // Synchronous, so the callback runs on the offending call's stack and
+        // a breakpoint in it shows the call site.
+        glEnable(GL_DEBUG_OUTPUT_KHR);
+        glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS_KHR);
+        debugMessageCallbackKHR(debugMessageCallback, NULL);
+        s_callbackInstalled = (glGetError() == GL_NO_ERROR);
+    }
+
+    LOG_INFO("GLDebug: full, %s", s_callbackInstalled ? "KHR_debug callback" : "per-call checks");
+#elif GLDEBUG_MODE == GLDEBUG_SAMPLED
+    (void)useCallback;
+    LOG_INFO("GLDebug: sampled every %d frames", GLDEBUG_SAMPLE_INTERVAL);
+#else
+    (void)useCallback;
+#endif
+}
+
+bool GLDebug::perCallChecks()
+{
+    return GLDEBUG_MODE == GLDEBUG_FULL && !s_callbackInstalled;
+}
+
+bool GLDebug::checkErrors(const char *file, int line)
+{
+    bool found = false;
+    for (GLenum error = glGetError(); error != GL_NO_ERROR; error = glGetError())
+    {
+        ++s_errorCount;
+        LOG_ERROR("%s at %s:%d", errorString(error), file, line);
+        found = true;
+    }
+    return found;
+}
+
+bool GLDebug::checkErrors(const char *site)
+{
+    bool found = false;
+    for (GLenum error = glGetError(); error != GL_NO_ERROR; error = glGetError())
+    {
+        ++s_errorCount;
+        LOG_ERROR("%s after %s", errorString(error), site);
+        found = true;
+    }
+    return found;
+}
+
+void GLDebug::endFrame()
+{
+#if GLDEBUG_MODE == GLDEBUG_SAMPLED
+    if (++s_frame % GLDEBUG_SAMPLE_INTERVAL == 0)
+    {
+        checkErrors("the last frames");
+    }
+#endif
+}
+
+unsigned int GLDebug::errorCount()
+{
+    return s_errorCount;
+}
+
+const char *GLDebug::errorString(unsigned int error)
+{
+    switch (error)
+    {
+        case GL_NO_ERROR:
+            return "GL_NO_ERROR";
+        case GL_INVALID_ENUM:
+            return "GL_INVALID_ENUM";
+        case GL_INVALID_VALUE:
+            return "GL_INVALID_VALUE";
+        case GL_INVALID_OPERATION:
+            return "GL_INVALID_OPERATION";
+        case GL_INVALID_FRAMEBUFFER_OPERATION:
+            return "GL_INVALID_FRAMEBUFFER_OPERATION";
+        case GL_OUT_OF_MEMORY:
+            return "GL_OUT_OF_MEMORY";
+        default:
+            return "Unknown GL error";
+    }
+}
@@ -0,0 +1,78 @@
+//
+//  GLDebug.h
+//
+//  GL error reporting with a build-time cost/coverage trade-off. Set
+//  GLDEBUG_MODE (e.g. from CMake) to one of:
+//
+//  GLDEBUG_OFF      No error queries at all; GL_CHECK() compiles to nothing.
+//                   Default for release (NDEBUG) builds.
+//  GLDEBUG_SAMPLED  One glGetError drain every GLDEBUG_SAMPLE_INTERVAL
+//                   frames, from GLDebug::endFrame(). Reports that something
+//                   failed, not where.
+//  GLDEBUG_FULL     Installs a KHR_debug message callback when the driver
+//                   has one. Otherwise GL_CHECK() and the command replay
+//                   check after every call and log the call site. Default
+//                   for debug builds.
+//
+//  glGetError can stall the pipeline on tiled GPUs, so the checks are kept
+//  off the release hot path entirely rather than behind a runtime flag.
+//
+
+#ifndef GLDebug_h
+#define GLDebug_h
+
+#define GLDEBUG_OFF 0
+#define GLDEBUG_SAMPLED 1
+#define GLDEBUG_FULL 2
+
+#ifndef GLDEBUG_MODE
+#if defined(NDEBUG)
+#define GLDEBUG_MODE GLDEBUG_OFF
+#else
+#define GLDEBUG_MODE GLDEBUG_FULL
+#endif
+#endif
+
+#ifndef GLDEBUG_SAMPLE_INTERVAL
+#define GLDEBUG_SAMPLE_INTERVAL 60
+#endif
+
+class GLDebug {
+public:
+    // Needs a current context. In full mode, installs the KHR_debug callback
+    // unless 'useCallback' is false (benchmarks use this to force per-call
+    // checks).
+    static void initialize(bool useCallback = true);
+
+    // True in full mode when no callback could be installed.
+    static bool perCallChecks();
+
+    // Drains glGetError, logging each error against 'site'. Returns true if
+    // any error was pending.
+    static bool checkErrors(const char *file, int line);
+    static bool checkErrors(const char *site);
+
+    // Call once per frame after the frame's GL work was issued.
+    static void endFrame();
+
+    // Errors seen since startup (callback and glGetError).
+    static unsigned int errorCount();
+
+    static const char *errorString(unsigned int error);
+};
+
+#if GLDEBUG_MODE == GLDEBUG_FULL
+#define GL_CHECK()                                          \
+    do                                                      \
+    {                                                       \
+        if (GLDebug::perCallChecks())                       \
+        {                                                   \
+            GLDebug::checkErrors(__FILE__, __LINE__);       \
+        }                                                   \
+    }                                                       \
+    while (0)
+#else
+#define GL_CHECK() do {} while (0)
+#endif
+
+#endif /* GLDebug_h */
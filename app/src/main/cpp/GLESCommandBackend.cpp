@@ -0,0 +1,280 @@
+//
+//  GLESCommandBackend.cpp
+//
+//  Kept apart from GLCommandBuffer.cpp so host tools can link the command
+//  buffer without a GLES library.
+//
+
+#define GL_GLEXT_PROTOTYPES
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#include <GLES2/gl2platform.h>
+#include <EGL/egl.h>
+
+#include "GLCommandBuffer.h"
+#include "GLDebug.h"
+
+#include <android/log.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#define LOG_TAG "EglSample"
+
+#define LOG_INFO(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOG_ERROR(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+typedef GLCommandBuffer CB;
+
+// The core ES 3.0 entry points and the *_instanced_arrays extension ones
+// share these signatures.
+typedef void (GL_APIENTRYP PFNGLVERTEXATTRIBDIVISORPROC_) (GLuint index, GLuint divisor);
+typedef void (GL_APIENTRYP PFNGLDRAWARRAYSINSTANCEDPROC_) (GLenum mode, GLint first, GLsizei count,
+                                                           GLsizei instanceCount);
+
+static PFNGLVERTEXATTRIBDIVISORPROC_ s_glVertexAttribDivisor = 0;
+static PFNGLDRAWARRAYSINSTANCEDPROC_ s_glDrawArraysInstanced = 0;
+
+// glInvalidateFramebuffer and glDiscardFramebufferEXT take the same
+// arguments, and GL_COLOR/GL_DEPTH/GL_STENCIL equal the _EXT names.
+typedef void (GL_APIENTRYP PFNGLDISCARDFRAMEBUFFERPROC_) (GLenum target, GLsizei numAttachments,
+                                                          const GLenum *attachments);
+
+static PFNGLDISCARDFRAMEBUFFERPROC_ s_glDiscardFramebuffer = 0;
+
+static bool resolveInstancing(const char *suffix)
+{
+    s_glVertexAttribDivisor =
+            (PFNGLVERTEXATTRIBDIVISORPROC_)eglGetProcAddress((std::string("glVertexAttribDivisor") + suffix).c_str());
+    s_glDrawArraysInstanced =
+            (PFNGLDRAWARRAYSINSTANCEDPROC_)eglGetProcAddress((std::string("glDrawArraysInstanced") + suffix).c_str());
+    return GLESCommandBackend::hasInstancing();
+}
+
+void GLESCommandBackend::initialize()
+{
+    s_glVertexAttribDivisor = 0;
+    s_glDrawArraysInstanced = 0;
+
+    // "OpenGL ES 3.1 ..." from a 3.x context.
+    const GLubyte *version = glGetString(GL_VERSION);
+    const char *number = version ? strpbrk((const char *)version, "0123456789") : NULL;
+    const bool core = number && atoi(number) >= 3;
+
+    const GLubyte *extensions = glGetString(GL_EXTENSIONS);
+    const std::string extensionList = extensions ? (const char *)extensions : "";
+
+    const char *source = NULL;
+    if (core && resolveInstancing(""))
+    {
+        source = "core";
+    }
+    else if (extensionList.find("GL_EXT_instanced_arrays") != std::string::npos && resolveInstancing("EXT"))
+    {
+        source = "GL_EXT_instanced_arrays";
+    }
+    else if (extensionList.find("GL_ANGLE_instanced_arrays") != std::string::npos && resolveInstancing("ANGLE"))
+    {
+        source = "GL_ANGLE_instanced_arrays";
+    }
+    else if (extensionList.find("GL_NV_instanced_arrays") != std::string::npos && resolveInstancing("NV"))
+    {
+        // NV only adds the divisor; the draw call comes from GL_NV_draw_instanced.
+        source = "GL_NV_instanced_arrays";
+    }
+    else
+    {
+        s_glVertexAttribDivisor = 0;
+        s_glDrawArraysInstanced = 0;
+    }
+
+    LOG_INFO("GLESCommandBackend: instanced arrays %s", source ? source : "not available");
+
+    s_glDiscardFramebuffer = 0;
+    if (core)
+    {
+        s_glDiscardFramebuffer = (PFNGLDISCARDFRAMEBUFFERPROC_)eglGetProcAddress("glInvalidateFramebuffer");
+    }
+    if (!s_glDiscardFramebuffer && extensionList.find("GL_EXT_discard_framebuffer") != std::string::npos)
+    {
+        s_glDiscardFramebuffer = (PFNGLDISCARDFRAMEBUFFERPROC_)eglGetProcAddress("glDiscardFramebufferEXT");
+    }
+    LOG_INFO("GLESCommandBackend: framebuffer discard %s", s_glDiscardFramebuffer ? "available" : "not available");
+}
+
+bool GLESCommandBackend::hasInstancing()
+{
+    return s_glVertexAttribDivisor != 0 && s_glDrawArraysInstanced != 0;
+}
+
+bool GLESCommandBackend::hasDiscard()
+{
+    return s_glDiscardFramebuffer != 0;
+}
+
+void GLESCommandBackend::execute(const GLCommandBuffer::Command &command, const void *payload)
+{
+    switch (command.opcode)
+    {
+        case CB::CMD_VIEWPORT:
+        {
+            const CB::Viewport &cmd = *(const CB::Viewport *)payload;
+            glViewport(cmd.x, cmd.y, cmd.width, cmd.height);
+            break;
+        }
+        case CB::CMD_CLEAR_COLOR:
+        {
+            const CB::ClearColor &cmd = *(const CB::ClearColor *)payload;
+            glClearColor(cmd.r, cmd.g, cmd.b, cmd.a);
+            break;
+        }
+        case CB::CMD_CLEAR:
+            glClear(((const CB::Clear *)payload)->mask);
+            break;
+        case CB::CMD_ENABLE:
+            glEnable(((const CB::Capability *)payload)->cap);
+            break;
+        case CB::CMD_DISABLE:
+            glDisable(((const CB::Capability *)payload)->cap);
+            break;
+        case CB::CMD_BLEND_FUNC:
+        {
+            const CB::BlendFunc &cmd = *(const CB::BlendFunc *)payload;
+            glBlendFunc(cmd.sfactor, cmd.dfactor);
+            break;
+        }
+        case CB::CMD_USE_PROGRAM:
+            glUseProgram(((const CB::UseProgram *)payload)->program);
+            break;
+        case CB::CMD_ACTIVE_TEXTURE:
+            glActiveTexture(((const CB::ActiveTexture *)payload)->texture);
+            break;
+        case CB::CMD_BIND_TEXTURE:
+        {
+            const CB::BindTexture &cmd = *(const CB::BindTexture *)payload;
+            glBindTexture(cmd.target, cmd.texture);
+            break;
+        }
+        case CB::CMD_UNIFORM_1I:
+        {
+            const CB::Uniform1i &cmd = *(const CB::Uniform1i *)payload;
+            glUniform1i(cmd.location, cmd.x);
+            break;
+        }
+        case CB::CMD_UNIFORM_2F:
+        {
+            const CB::Uniform2f &cmd = *(const CB::Uniform2f *)payload;
+            glUniform2f(cmd.location, cmd.x, cmd.y);
+            break;
+        }
+        case CB::CMD_UNIFORM_MATRIX_4FV:
+        {
+            const CB::UniformMatrix4fv &cmd = *(const CB::UniformMatrix4fv *)payload;
+            glUniformMatrix4fv(cmd.location, 1, GL_FALSE, cmd.value);
+            break;
+        }
+        case CB::CMD_BIND_VERTEX_ARRAY:
+            glBindVertexArrayOES(((const CB::BindVertexArray *)payload)->array);
+            break;
+        case CB::CMD_BIND_BUFFER:
+        {
+            const CB::BindBuffer &cmd = *(const CB::BindBuffer *)payload;
+            glBindBuffer(cmd.target, cmd.buffer);
+            break;
+        }
+        case CB::CMD_BUFFER_DATA:
+        {
+            const CB::BufferData &cmd = *(const CB::BufferData *)payload;
+            glBufferData(cmd.target, cmd.size, cmd.hasData ? (const void *)(&cmd + 1) : NULL, cmd.usage);
+            break;
+        }
+        case CB::CMD_BUFFER_SUB_DATA:
+        {
+            const CB::BufferSubData &cmd = *(const CB::BufferSubData *)payload;
+            glBufferSubData(cmd.target, cmd.offset, cmd.size, &cmd + 1);
+            break;
+        }
+        case CB::CMD_VERTEX_ATTRIB_POINTER:
+        {
+            const CB::VertexAttribPointer &cmd = *(const CB::VertexAttribPointer *)payload;
+            glVertexAttribPointer(cmd.index, cmd.size, cmd.type, cmd.normalized, cmd.stride,
+                                  (const GLvoid *)(size_t)cmd.offset);
+            break;
+        }
+        case CB::CMD_ENABLE_VERTEX_ATTRIB_ARRAY:
+            glEnableVertexAttribArray(((const CB::EnableVertexAttribArray *)payload)->index);
+            break;
+        case CB::CMD_DRAW_ARRAYS:
+        {
+            const CB::DrawArrays &cmd = *(const CB::DrawArrays *)payload;
+            glDrawArrays(cmd.mode, cmd.first, cmd.count);
+            break;
+        }
+        case CB::CMD_DRAW_ELEMENTS:
+        {
+            const CB::DrawElements &cmd = *(const CB::DrawElements *)payload;
+            glDrawElements(cmd.mode, cmd.count, cmd.type, (const GLvoid *)(size_t)cmd.offset);
+            break;
+        }
+        case CB::CMD_DISABLE_VERTEX_ATTRIB_ARRAY:
+            glDisableVertexAttribArray(((const CB::DisableVertexAttribArray *)payload)->index);
+            break;
+        case CB::CMD_VERTEX_ATTRIB_4FV:
+        {
+            const CB::VertexAttrib4fv &cmd = *(const CB::VertexAttrib4fv *)payload;
+            glVertexAttrib4fv(cmd.index, cmd.value);
+            break;
+        }
+        case CB::CMD_VERTEX_ATTRIB_DIVISOR:
+        {
+            const CB::VertexAttribDivisor &cmd = *(const CB::VertexAttribDivisor *)payload;
+            if (s_glVertexAttribDivisor)
+            {
+                s_glVertexAttribDivisor(cmd.index, cmd.divisor);
+            }
+            else
+            {
+                LOG_ERROR("GLESCommandBackend: VertexAttribDivisor without instancing support");
+            }
+            break;
+        }
+        case CB::CMD_DRAW_ARRAYS_INSTANCED:
+        {
+            const CB::DrawArraysInstanced &cmd = *(const CB::DrawArraysInstanced *)payload;
+            if (s_glDrawArraysInstanced)
+            {
+                s_glDrawArraysInstanced(cmd.mode, cmd.first, cmd.count, cmd.instanceCount);
+            }
+            else
+            {
+                LOG_ERROR("GLESCommandBackend: DrawArraysInstanced without instancing support");
+            }
+            break;
+        }
+        case CB::CMD_BIND_FRAMEBUFFER:
+        {
+            const CB::BindFramebuffer &cmd = *(const CB::BindFramebuffer *)payload;
+            glBindFramebuffer(cmd.target, cmd.framebuffer);
+            break;
+        }
+        case CB::CMD_DISCARD_FRAMEBUFFER:
+        {
+            const CB::DiscardFramebuffer &cmd = *(const CB::DiscardFramebuffer *)payload;
+            if (s_glDiscardFramebuffer)
+            {
+                s_glDiscardFramebuffer(cmd.target, cmd.count, cmd.attachments);
+            }
+            break;
+        }
+        default:
+            LOG_ERROR("GLESCommandBackend: unknown opcode %u", command.opcode);
+            break;
+    }
+
+#if GLDEBUG_MODE == GLDEBUG_FULL
+    if (GLDebug::perCallChecks())
+    {
+        GLDebug::checkErrors(GLCommandBuffer::opcodeName(command.opcode));
+    }
+#endif
+}
@@ -0,0 +1,142 @@
+//
+//  GpuTimer.cpp
+//
+
+#include "GpuTimer.h"
+
+#include <EGL/egl.h>
+#include <android/log.h>
+#include <string.h>
+
+#define LOG_TAG "EglSample"
+
+#define LOG_INFO(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOG_ERROR(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+#ifndef GL_TIME_ELAPSED_EXT
+#define GL_TIME_ELAPSED_EXT 0x88BF
+#endif
+#ifndef GL_GPU_DISJOINT_EXT
+#define GL_GPU_DISJOINT_EXT 0x8FBB
+#endif
+#ifndef GL_QUERY_RESULT_EXT
+#define GL_QUERY_RESULT_EXT 0x8866
+#endif
+#ifndef GL_QUERY_RESULT_AVAILABLE_EXT
+#define GL_QUERY_RESULT_AVAILABLE_EXT 0x8867
+#endif
+
+typedef void (GL_APIENTRYP PFNGLGENQUERIESPROC_) (GLsizei n, GLuint *ids);
+typedef void (GL_APIENTRYP PFNGLDELETEQUERIESPROC_) (GLsizei n, const GLuint *ids);
+typedef void (GL_APIENTRYP PFNGLBEGINQUERYPROC_) (GLenum target, GLuint id);
+typedef void (GL_APIENTRYP PFNGLENDQUERYPROC_) (GLenum target);
+typedef void (GL_APIENTRYP PFNGLGETQUERYOBJECTUIVPROC_) (GLuint id, GLenum pname, GLuint *params);
+typedef void (GL_APIENTRYP PFNGLGETQUERYOBJECTUI64VPROC_) (GLuint id, GLenum pname, khronos_uint64_t *params);
+
+static PFNGLGENQUERIESPROC_ s_glGenQueries = 0;
+static PFNGLDELETEQUERIESPROC_ s_glDeleteQueries = 0;
+static PFNGLBEGINQUERYPROC_ s_glBeginQuery = 0;
+static PFNGLENDQUERYPROC_ s_glEndQuery = 0;
+static PFNGLGETQUERYOBJECTUIVPROC_ s_glGetQueryObjectuiv = 0;
+static PFNGLGETQUERYOBJECTUI64VPROC_ s_glGetQueryObjectui64v = 0;
+
+GpuTimer::GpuTimer()
+        : mNext(0), mOldest(0), mActive(false), mAvailable(false)
+{
+    memset(mQueries, 0, sizeof(mQueries));
+    memset(mPending, 0, sizeof(mPending));
+}
+
+void GpuTimer::initialize()
+{
+    mAvailable = false;
+    mActive = false;
+    mNext = 0;
+    mOldest = 0;
+    memset(mPending, 0, sizeof(mPending));
+
+    const GLubyte *extensions = glGetString(GL_EXTENSIONS);
+    if (extensions && strstr((const char *)extensions, "GL_EXT_disjoint_timer_query") != NULL)
+    {
+        s_glGenQueries = (PFNGLGENQUERIESPROC_)eglGetProcAddress("glGenQueriesEXT");
+        s_glDeleteQueries = (PFNGLDELETEQUERIESPROC_)eglGetProcAddress("glDeleteQueriesEXT");
+        s_glBeginQuery = (PFNGLBEGINQUERYPROC_)eglGetProcAddress("glBeginQueryEXT");
+        s_glEndQuery = (PFNGLENDQUERYPROC_)eglGetProcAddress("glEndQueryEXT");
+        s_glGetQueryObjectuiv = (PFNGLGETQUERYOBJECTUIVPROC_)eglGetProcAddress("glGetQueryObjectuivEXT");
+        s_glGetQueryObjectui64v = (PFNGLGETQUERYOBJECTUI64VPROC_)eglGetProcAddress("glGetQueryObjectui64vEXT");
+        mAvailable = s_glGenQueries && s_glDeleteQueries && s_glBeginQuery && s_glEndQuery &&
+                s_glGetQueryObjectuiv && s_glGetQueryObjectui64v;
+    }
+    LOG_INFO("GpuTimer: GL_EXT_disjoint_timer_query %s", mAvailable ? "available" : "not available");
+
+    if (mAvailable)
+    {
+        s_glGenQueries(QUERY_COUNT, mQueries);
+
+        // Clears a disjoint reported before the first query.
+        GLint disjoint = 0;
+        glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+    }
+}
+
+void GpuTimer::destroy()
+{
+    if (mAvailable)
+    {
+        s_glDeleteQueries(QUERY_COUNT, mQueries);
+    }
+    memset(mQueries, 0, sizeof(mQueries));
+    memset(mPending, 0, sizeof(mPending));
+    mAvailable = false;
+    mActive = false;
+}
+
+void GpuTimer::begin()
+{
+    if (!mAvailable || mActive || mPending[mNext])
+    {
+        return;
+    }
+    s_glBeginQuery(GL_TIME_ELAPSED_EXT, mQueries[mNext]);
+    mActive = true;
+}
+
+void GpuTimer::end()
+{
+    if (!mActive)
+    {
+        return;
+    }
+    s_glEndQuery(GL_TIME_ELAPSED_EXT);
+    mPending[mNext] = true;
+    mNext = (mNext + 1) % QUERY_COUNT;
+    mActive = false;
+}
+
+bool GpuTimer::poll(double &ms)
+{
+    bool found = false;
+    while (mPending[mOldest])
+    {
+        GLuint available = 0;
+        s_glGetQueryObjectuiv(mQueries[mOldest], GL_QUERY_RESULT_AVAILABLE_EXT, &available);
+        if (!available)
+        {
+            break;
+        }
+        khronos_uint64_t nanoseconds = 0;
+        s_glGetQueryObjectui64v(mQueries[mOldest], GL_QUERY_RESULT_EXT, &nanoseconds);
+        mPending[mOldest] = false;
+        mOldest = (mOldest + 1) % QUERY_COUNT;
+        ms = double(nanoseconds) * 1e-6;
+        found = true;
+    }
+
+    if (found)
+    {
+        GLint disjoint = 0;
+        glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+        found = !disjoint;
+    }
+    return found;
+}
@@ -0,0 +1,55 @@
+//
+//  GpuTimer.h
+//
+//  GPU time of a stretch of GL calls, from GL_EXT_disjoint_timer_query.
+//  Results arrive a few frames late, so each frame's query comes from a
+//  small ring and poll() returns the newest one the GPU has finished,
+//  without waiting. Results from a disjoint interval (a power or clock
+//  change the driver reports) are dropped.
+//
+//  Typical use, on the render thread:
+//
+//      timer.begin();
+//      ... issue the frame ...
+//      timer.end();
+//      double ms;
+//      if (timer.poll(ms)) { ... }
+//
+
+#ifndef GpuTimer_h
+#define GpuTimer_h
+
+#define GL_GLEXT_PROTOTYPES
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+
+class GpuTimer {
+public:
+    GpuTimer();
+
+    // Needs a current context. Without the extension begin(), end() and
+    // poll() do nothing.
+    void initialize();
+    void destroy();
+
+    bool isAvailable() const { return mAvailable; }
+
+    // Skips the frame when every query in the ring is still in flight.
+    void begin();
+    void end();
+
+    // The newest finished query's time, if one finished since the last call.
+    bool poll(double &ms);
+
+private:
+    static const int QUERY_COUNT = 4;
+
+    GLuint mQueries[QUERY_COUNT];
+    bool mPending[QUERY_COUNT];
+    int mNext; // Next query to begin.
+    int mOldest; // Oldest pending query.
+    bool mActive;
+    bool mAvailable;
+};
+
+#endif /* GpuTimer_h */
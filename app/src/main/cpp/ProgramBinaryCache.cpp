@@ -0,0 +1,224 @@
+//
+//  ProgramBinaryCache.cpp
+//
+
+#include "ProgramBinaryCache.h"
+
+#include <EGL/egl.h>
+#include <android/log.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+#define LOG_TAG "EglSample"
+
+#define LOG_INFO(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOG_ERROR(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+// File layout: header followed by 'length' bytes of driver binary.
+struct ProgramBinaryHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t binaryFormat;
+    uint32_t length;
+};
+
+static const uint32_t PROGRAM_BINARY_MAGIC = 0x50474c45; // "ELGP"
+static const uint32_t PROGRAM_BINARY_VERSION = 1;
+
+static std::string s_directory;
+static std::string s_driverId;
+static bool s_supported = false;
+
+static PFNGLGETPROGRAMBINARYOESPROC s_glGetProgramBinaryOES = 0;
+static PFNGLPROGRAMBINARYOESPROC s_glProgramBinaryOES = 0;
+
+static uint64_t fnv1a(uint64_t hash, const std::string &data)
+{
+    for (size_t i = 0; i < data.size(); ++i)
+    {
+        hash ^= (unsigned char)data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    // Separator, so "ab"+"c" and "a"+"bc" don't collide.
+    hash ^= 0xff;
+    hash *= 0x100000001b3ULL;
+    return hash;
+}
+
+static std::string glString(GLenum name)
+{
+    const GLubyte *str = glGetString(name);
+    return str ? std::string((const char *)str) : std::string();
+}
+
+void ProgramBinaryCache::setDirectory(const std::string &directory)
+{
+    s_directory = directory;
+}
+
+void ProgramBinaryCache::initialize()
+{
+    s_supported = false;
+    s_driverId = glString(GL_VENDOR) + "|" + glString(GL_RENDERER) + "|" + glString(GL_VERSION);
+
+    const std::string extensions = glString(GL_EXTENSIONS);
+    if (extensions.find("GL_OES_get_program_binary") == std::string::npos)
+    {
+        LOG_INFO("ProgramBinaryCache: GL_OES_get_program_binary not supported");
+        return;
+    }
+
+    GLint numFormats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS_OES, &numFormats);
+    if (numFormats <= 0)
+    {
+        LOG_INFO("ProgramBinaryCache: driver exposes no program binary formats");
+        return;
+    }
+
+    s_glGetProgramBinaryOES = (PFNGLGETPROGRAMBINARYOESPROC)eglGetProcAddress("glGetProgramBinaryOES");
+    s_glProgramBinaryOES = (PFNGLPROGRAMBINARYOESPROC)eglGetProcAddress("glProgramBinaryOES");
+
+    s_supported = (s_glGetProgramBinaryOES != 0 && s_glProgramBinaryOES != 0);
+}
+
+bool ProgramBinaryCache::isEnabled()
+{
+    return s_supported && !s_directory.empty();
+}
+
+std::string ProgramBinaryCache::makeKey(const std::string &vertShaderSource,
+                                        const std::string &fragShaderSource,
+                                        const std::string &defines,
+                                        const std::string &attributeBindings)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    hash = fnv1a(hash, s_driverId);
+    hash = fnv1a(hash, attributeBindings);
+    hash = fnv1a(hash, defines);
+    hash = fnv1a(hash, vertShaderSource);
+    hash = fnv1a(hash, fragShaderSource);
+
+    char buffer[17];
+    snprintf(buffer, sizeof(buffer), "%016llx", (unsigned long long)hash);
+    return std::string(buffer);
+}
+
+std::string ProgramBinaryCache::pathForKey(const std::string &key)
+{
+    return s_directory + "/program_" + key + ".bin";
+}
+
+bool ProgramBinaryCache::load(const std::string &key, GLuint programPointer)
+{
+    if (!isEnabled())
+    {
+        return false;
+    }
+
+    const std::string path = pathForKey(key);
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f)
+    {
+        return false;
+    }
+
+    ProgramBinaryHeader header;
+    std::vector<unsigned char> binary;
+    bool ok = (fread(&header, sizeof(header), 1, f) == 1) &&
+              header.magic == PROGRAM_BINARY_MAGIC &&
+              header.version == PROGRAM_BINARY_VERSION &&
+              header.length > 0;
+    if (ok)
+    {
+        // The length has to match what follows the header before anything
+        // is allocated for it; a corrupt one could ask for gigabytes.
+        const long binaryStart = ftell(f);
+        ok = binaryStart >= 0 && fseek(f, 0, SEEK_END) == 0;
+        const long fileEnd = ok ? ftell(f) : -1;
+        ok = ok && fileEnd - binaryStart == long(header.length) && fseek(f, binaryStart, SEEK_SET) == 0;
+    }
+    if (ok)
+    {
+        binary.resize(header.length);
+        ok = (fread(&binary[0], 1, header.length, f) == header.length);
+    }
+    fclose(f);
+
+    if (ok)
+    {
+        s_glProgramBinaryOES(programPointer, header.binaryFormat, &binary[0], (GLint)header.length);
+
+        GLint status(GL_FALSE);
+        glGetProgramiv(programPointer, GL_LINK_STATUS, &status);
+        ok = (status == GL_TRUE);
+    }
+
+    if (!ok)
+    {
+        // Corrupt file or the driver no longer accepts it; drop the entry.
+        LOG_INFO("ProgramBinaryCache: rejected %s", path.c_str());
+        unlink(path.c_str());
+    }
+
+    return ok;
+}
+
+bool ProgramBinaryCache::store(const std::string &key, GLuint programPointer)
+{
+    if (!isEnabled())
+    {
+        return false;
+    }
+
+    GLint length = 0;
+    glGetProgramiv(programPointer, GL_PROGRAM_BINARY_LENGTH_OES, &length);
+    if (length <= 0)
+    {
+        return false;
+    }
+
+    std::vector<unsigned char> binary(length);
+    GLenum binaryFormat = 0;
+    GLsizei written = 0;
+    s_glGetProgramBinaryOES(programPointer, length, &written, &binaryFormat, &binary[0]);
+    if (written <= 0)
+    {
+        return false;
+    }
+
+    ProgramBinaryHeader header;
+    header.magic = PROGRAM_BINARY_MAGIC;
+    header.version = PROGRAM_BINARY_VERSION;
+    header.binaryFormat = binaryFormat;
+    header.length = (uint32_t)written;
+
+    // Write to a temporary and rename, so a crash mid-write never leaves a
+    // truncated binary behind for the next start.
+    const std::string path = pathForKey(key);
+    const std::string tmpPath = path + ".tmp";
+    FILE *f = fopen(tmpPath.c_str(), "wb");
+    if (!f)
+    {
+        LOG_ERROR("ProgramBinaryCache: unable to write %s", tmpPath.c_str());
+        return false;
+    }
+
+    bool ok = (fwrite(&header, sizeof(header), 1, f) == 1) &&
+              (fwrite(&binary[0], 1, written, f) == (size_t)written);
+    ok = (fclose(f) == 0) && ok;
+
+    if (ok)
+    {
+        ok = (rename(tmpPath.c_str(), path.c_str()) == 0);
+    }
+    if (!ok)
+    {
+        unlink(tmpPath.c_str());
+    }
+
+    return ok;
+}
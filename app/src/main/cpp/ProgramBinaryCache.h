@@ -0,0 +1,54 @@
+//
+//  ProgramBinaryCache.h
+//
+//  On-disk cache of linked program binaries (GL_OES_get_program_binary).
+//
+//  Programs are keyed by a hash of their shader sources, the defines they were
+//  built with, their attribute bindings and the driver vendor/renderer/version
+//  strings, so a driver update or a shader edit never picks up a stale binary,
+//  and a binary linked with other attribute locations is never reused.
+//
+
+#ifndef ProgramBinaryCache_h
+#define ProgramBinaryCache_h
+
+#define GL_GLEXT_PROTOTYPES
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#include <GLES2/gl2platform.h>
+
+#include <string>
+
+class ProgramBinaryCache {
+public:
+    // Directory the binaries are written to. Must be writable by the app,
+    // e.g. Context.getCacheDir(). The cache stays disabled until this is set.
+    static void setDirectory(const std::string &directory);
+
+    // Queries the driver for GL_OES_get_program_binary support.
+    // Has to be called with a current context, once per context.
+    static void initialize();
+
+    static bool isEnabled();
+
+    // 'attributeBindings' describes every glBindAttribLocation() made before
+    // linking, in any stable form; the locations are baked into the binary.
+    static std::string makeKey(const std::string &vertShaderSource,
+                               const std::string &fragShaderSource,
+                               const std::string &defines,
+                               const std::string &attributeBindings);
+
+    // Loads the binary stored for 'key' into 'programPointer'.
+    // Returns false if there is no entry, it is corrupt (its length does not
+    // match the file) or the driver rejected it; a corrupt or rejected entry
+    // is removed and the caller has to compile from source.
+    static bool load(const std::string &key, GLuint programPointer);
+
+    // Stores the binary of the linked program 'programPointer' under 'key'.
+    static bool store(const std::string &key, GLuint programPointer);
+
+private:
+    static std::string pathForKey(const std::string &key);
+};
+
+#endif /* ProgramBinaryCache_h */
@@ -0,0 +1,492 @@
+//
+//  RenderGraph.cpp
+//
+
+#include "RenderGraph.h"
+
+#include <android/log.h>
+#include <string.h>
+
+#define LOG_TAG "EglSample"
+
+#define LOG_INFO(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOG_ERROR(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+// The window's attachments, as GL_EXT_discard_framebuffer and ES 3.0's
+// glInvalidateFramebuffer both name them.
+#ifndef GL_COLOR_EXT
+#define GL_COLOR_EXT 0x1800
+#define GL_DEPTH_EXT 0x1801
+#define GL_STENCIL_EXT 0x1802
+#endif
+
+static bool sameDesc(const RenderTargetPool::Desc &a, const RenderTargetPool::Desc &b)
+{
+    return a.width == b.width && a.height == b.height && a.color == b.color && a.depth == b.depth;
+}
+
+RenderGraph::RenderGraph()
+        : mReordering(true), mInvalid(false), mCompiled(false), mPool(NULL)
+{
+    reset();
+}
+
+void RenderGraph::reset()
+{
+    mResources.clear();
+    mPasses.clear();
+    mOrder.clear();
+    mInvalid = false;
+    mCompiled = false;
+    memset(&mStats, 0, sizeof(mStats));
+
+    const RenderTargetPool::Desc none = { 0, 0, RenderTargetPool::COLOR_RGBA8, RenderTargetPool::DEPTH_NONE };
+    createTarget("window", none);
+    mResources[WINDOW].output = true;
+}
+
+int RenderGraph::createTarget(const char *name, const RenderTargetPool::Desc &desc)
+{
+    Resource resource;
+    resource.name = name;
+    resource.desc = desc;
+    resource.output = false;
+    resource.firstUse = -1;
+    resource.lastUse = -1;
+    resource.lastWrite = -1;
+    resource.target = -1;
+    mResources.push_back(resource);
+    mCompiled = false;
+    return int(mResources.size()) - 1;
+}
+
+void RenderGraph::markOutput(int resource)
+{
+    mResources[resource].output = true;
+    mCompiled = false;
+}
+
+int RenderGraph::addPass(const char *name, ExecuteFunction execute, void *userData)
+{
+    Pass pass;
+    pass.name = name;
+    pass.execute = execute;
+    pass.userData = userData;
+    pass.write = -1;
+    pass.live = false;
+    mPasses.push_back(pass);
+    mCompiled = false;
+    return int(mPasses.size()) - 1;
+}
+
+void RenderGraph::read(int pass, int resource)
+{
+    Pass &p = mPasses[pass];
+    if (resource == WINDOW)
+    {
+        LOG_ERROR("RenderGraph: pass '%s' reads the window", p.name.c_str());
+        mInvalid = true;
+        return;
+    }
+    for (size_t i = 0; i < p.reads.size(); ++i)
+    {
+        if (p.reads[i] == resource)
+        {
+            return;
+        }
+    }
+    p.reads.push_back(resource);
+    mCompiled = false;
+}
+
+void RenderGraph::write(int pass, int resource)
+{
+    Pass &p = mPasses[pass];
+    if (p.write >= 0 && p.write != resource)
+    {
+        LOG_ERROR("RenderGraph: pass '%s' writes both '%s' and '%s'", p.name.c_str(),
+                  mResources[p.write].name.c_str(), mResources[resource].name.c_str());
+        mInvalid = true;
+        return;
+    }
+    p.write = resource;
+    mCompiled = false;
+}
+
+bool RenderGraph::compile()
+{
+    mOrder.clear();
+    mCompiled = false;
+    if (mInvalid)
+    {
+        return false;
+    }
+
+    cull();
+
+    std::vector<std::vector<int> > dependents(mPasses.size());
+    std::vector<int> dependencyCounts(mPasses.size(), 0);
+    if (!addDependencies(dependents, dependencyCounts))
+    {
+        return false;
+    }
+    schedule(dependents, dependencyCounts);
+    computeLifetimes();
+    computeStats();
+
+    mCompiled = true;
+    return true;
+}
+
+void RenderGraph::cull()
+{
+    // Backwards through the declarations: a pass is live if something later
+    // and live needs what it writes. Writes add to a target rather than
+    // replace it, so earlier writers of a needed target are needed too.
+    std::vector<bool> needed(mResources.size(), false);
+    for (size_t r = 0; r < mResources.size(); ++r)
+    {
+        needed[r] = mResources[r].output;
+    }
+
+    mStats.passes = uint32_t(mPasses.size());
+    mStats.culledPasses = 0;
+    for (int pass = int(mPasses.size()) - 1; pass >= 0; --pass)
+    {
+        Pass &p = mPasses[pass];
+        p.live = p.write >= 0 && needed[p.write];
+        if (!p.live)
+        {
+            ++mStats.culledPasses;
+            continue;
+        }
+        for (size_t i = 0; i < p.reads.size(); ++i)
+        {
+            needed[p.reads[i]] = true;
+        }
+    }
+}
+
+bool RenderGraph::addDependencies(std::vector<std::vector<int> > &dependents, std::vector<int> &dependencyCounts)
+{
+    // Read after write, write after write and write after read, in
+    // declaration order.
+    std::vector<int> lastWriter(mResources.size(), -1);
+    std::vector<std::vector<int> > readersSinceWrite(mResources.size());
+    for (int pass = 0; pass < int(mPasses.size()); ++pass)
+    {
+        const Pass &p = mPasses[pass];
+        if (!p.live)
+        {
+            continue;
+        }
+
+        for (size_t i = 0; i < p.reads.size(); ++i)
+        {
+            const int resource = p.reads[i];
+            if (resource == p.write)
+            {
+                LOG_ERROR("RenderGraph: pass '%s' reads '%s', which it writes", p.name.c_str(),
+                          mResources[resource].name.c_str());
+                return false;
+            }
+            if (lastWriter[resource] < 0)
+            {
+                LOG_ERROR("RenderGraph: pass '%s' reads '%s' before anything writes it", p.name.c_str(),
+                          mResources[resource].name.c_str());
+                return false;
+            }
+            dependents[lastWriter[resource]].push_back(pass);
+            ++dependencyCounts[pass];
+            readersSinceWrite[resource].push_back(pass);
+        }
+
+        std::vector<int> &readers = readersSinceWrite[p.write];
+        if (lastWriter[p.write] >= 0)
+        {
+            dependents[lastWriter[p.write]].push_back(pass);
+            ++dependencyCounts[pass];
+        }
+        for (size_t i = 0; i < readers.size(); ++i)
+        {
+            dependents[readers[i]].push_back(pass);
+            ++dependencyCounts[pass];
+        }
+        readers.clear();
+        lastWriter[p.write] = pass;
+    }
+    return true;
+}
+
+void RenderGraph::schedule(std::vector<std::vector<int> > &dependents, std::vector<int> &dependencyCounts)
+{
+    // Every dependency points forward in declaration order, so picking the
+    // first ready pass reproduces that order; reordering prefers a ready
+    // pass on the framebuffer already bound.
+    std::vector<bool> scheduled(mPasses.size(), false);
+    int bound = -1;
+    for (;;)
+    {
+        int next = -1;
+        for (int pass = 0; pass < int(mPasses.size()); ++pass)
+        {
+            if (!mPasses[pass].live || scheduled[pass] || dependencyCounts[pass] > 0)
+            {
+                continue;
+            }
+            if (next < 0)
+            {
+                next = pass;
+                if (!mReordering)
+                {
+                    break;
+                }
+            }
+            if (mPasses[pass].write == bound)
+            {
+                next = pass;
+                break;
+            }
+        }
+        if (next < 0)
+        {
+            break;
+        }
+
+        scheduled[next] = true;
+        mOrder.push_back(next);
+        bound = mPasses[next].write;
+        for (size_t i = 0; i < dependents[next].size(); ++i)
+        {
+            --dependencyCounts[dependents[next][i]];
+        }
+    }
+}
+
+void RenderGraph::computeLifetimes()
+{
+    for (size_t r = 0; r < mResources.size(); ++r)
+    {
+        mResources[r].firstUse = -1;
+        mResources[r].lastUse = -1;
+        mResources[r].lastWrite = -1;
+        mResources[r].target = -1;
+    }
+
+    for (int position = 0; position < int(mOrder.size()); ++position)
+    {
+        const Pass &p = mPasses[mOrder[position]];
+        Resource &written = mResources[p.write];
+        if (written.firstUse < 0)
+        {
+            written.firstUse = position;
+        }
+        written.lastUse = position;
+        written.lastWrite = position;
+        for (size_t i = 0; i < p.reads.size(); ++i)
+        {
+            mResources[p.reads[i]].lastUse = position;
+        }
+    }
+}
+
+GLsizei RenderGraph::discardAttachments(int resource, bool color, GLenum attachments[3]) const
+{
+    GLsizei count = 0;
+    if (resource == WINDOW)
+    {
+        if (color)
+        {
+            attachments[count++] = GL_COLOR_EXT;
+        }
+        attachments[count++] = GL_DEPTH_EXT;
+        attachments[count++] = GL_STENCIL_EXT;
+        return count;
+    }
+
+    const RenderTargetPool::DepthFormat depth = mResources[resource].desc.depth;
+    if (color)
+    {
+        attachments[count++] = GL_COLOR_ATTACHMENT0;
+    }
+    if (depth != RenderTargetPool::DEPTH_NONE)
+    {
+        attachments[count++] = GL_DEPTH_ATTACHMENT;
+    }
+    if (depth == RenderTargetPool::DEPTH_24_STENCIL_8)
+    {
+        attachments[count++] = GL_STENCIL_ATTACHMENT;
+    }
+    return count;
+}
+
+void RenderGraph::computeStats()
+{
+    // What execute() will record, and what the pool will hold if it starts
+    // the frame with no free targets: acquire() takes a free target with the
+    // same description before creating one.
+    struct Physical {
+        RenderTargetPool::Desc desc;
+        bool inUse;
+    };
+    std::vector<Physical> physical;
+    std::vector<int> assigned(mResources.size(), -1);
+
+    mStats.framebufferBinds = 0;
+    mStats.discards = 0;
+    mStats.transientBytes = 0;
+    mStats.peakBytes = 0;
+
+    GLenum attachments[3];
+    int bound = -1;
+    for (int position = 0; position < int(mOrder.size()); ++position)
+    {
+        const Pass &p = mPasses[mOrder[position]];
+        const Resource &written = mResources[p.write];
+        if (p.write != bound)
+        {
+            ++mStats.framebufferBinds;
+            bound = p.write;
+        }
+
+        if (p.write != WINDOW && written.firstUse == position)
+        {
+            const size_t bytes = size_t(written.desc.width) * size_t(written.desc.height) *
+                    (RenderTargetPool::bytesPerPixel(written.desc.color) +
+                     RenderTargetPool::bytesPerPixel(written.desc.depth));
+            mStats.transientBytes += bytes;
+
+            size_t slot = 0;
+            while (slot < physical.size() &&
+                   (physical[slot].inUse || !sameDesc(physical[slot].desc, written.desc)))
+            {
+                ++slot;
+            }
+            if (slot == physical.size())
+            {
+                const Physical created = { written.desc, false };
+                physical.push_back(created);
+                mStats.peakBytes += bytes;
+            }
+            physical[slot].inUse = true;
+            assigned[p.write] = int(slot);
+
+            mStats.discards += discardAttachments(p.write, true, attachments) > 0 ? 1 : 0;
+        }
+        if (written.lastWrite == position)
+        {
+            mStats.discards += discardAttachments(p.write, false, attachments) > 0 ? 1 : 0;
+        }
+
+        if (p.write != WINDOW && written.lastUse == position)
+        {
+            physical[assigned[p.write]].inUse = false;
+        }
+        for (size_t i = 0; i < p.reads.size(); ++i)
+        {
+            if (mResources[p.reads[i]].lastUse == position)
+            {
+                physical[assigned[p.reads[i]]].inUse = false;
+            }
+        }
+    }
+    if (bound > WINDOW)
+    {
+        // execute() puts the window back.
+        ++mStats.framebufferBinds;
+    }
+}
+
+GLuint RenderGraph::texture(int resource) const
+{
+    const int handle = mResources[resource].target;
+    return handle >= 0 && mPool != NULL ? mPool->target(handle).colorTexture : 0;
+}
+
+void RenderGraph::execute(RenderTargetPool &pool, GLCommandBuffer &commands, GLsizei windowWidth,
+                          GLsizei windowHeight)
+{
+    if (!mCompiled)
+    {
+        LOG_ERROR("RenderGraph: execute() without a successful compile()");
+        return;
+    }
+
+    mPool = &pool;
+    GLenum attachments[3];
+    int bound = -1;
+    for (int position = 0; position < int(mOrder.size()); ++position)
+    {
+        Pass &p = mPasses[mOrder[position]];
+        Resource &written = mResources[p.write];
+
+        if (p.write != WINDOW && written.firstUse == position)
+        {
+            written.target = pool.acquire(written.desc);
+        }
+        // A target that could not be acquired leaves its writers and
+        // everything reading it out.
+        bool runnable = p.write == WINDOW || written.target >= 0;
+        for (size_t i = 0; i < p.reads.size() && runnable; ++i)
+        {
+            runnable = mResources[p.reads[i]].target >= 0;
+        }
+
+        if (runnable)
+        {
+            if (p.write != bound)
+            {
+                commands.bindFramebuffer(GL_FRAMEBUFFER,
+                                         p.write == WINDOW ? 0 : pool.target(written.target).framebuffer);
+                bound = p.write;
+            }
+            if (p.write == WINDOW)
+            {
+                commands.viewport(0, 0, windowWidth, windowHeight);
+            }
+            else
+            {
+                commands.viewport(0, 0, written.desc.width, written.desc.height);
+            }
+
+            if (p.write != WINDOW && written.firstUse == position)
+            {
+                // Whatever the pooled target held before is not this one's.
+                commands.discardFramebuffer(GL_FRAMEBUFFER, discardAttachments(p.write, true, attachments),
+                                            attachments);
+            }
+
+            p.execute(*this, commands, p.userData);
+
+            if (written.lastWrite == position)
+            {
+                const GLsizei count = discardAttachments(p.write, false, attachments);
+                if (count > 0)
+                {
+                    commands.discardFramebuffer(GL_FRAMEBUFFER, count, attachments);
+                }
+            }
+        }
+
+        if (p.write != WINDOW && written.lastUse == position && written.target >= 0)
+        {
+            pool.release(written.target);
+            written.target = -1;
+        }
+        for (size_t i = 0; i < p.reads.size(); ++i)
+        {
+            Resource &read = mResources[p.reads[i]];
+            if (read.lastUse == position && read.target >= 0)
+            {
+                pool.release(read.target);
+                read.target = -1;
+            }
+        }
+    }
+
+    if (bound > WINDOW)
+    {
+        commands.bindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+    mPool = NULL;
+}
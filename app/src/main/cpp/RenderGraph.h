@@ -0,0 +1,143 @@
+//
+//  RenderGraph.h
+//
+//  A frame described as passes and the targets they read and write, built
+//  anew each frame. compile() works out, without touching GL:
+//
+//    - which passes matter: those writing the window or a target marked as
+//      an output, and the passes those depend on. The rest are culled.
+//    - an order: dependencies first, and among the passes free to go next,
+//      one drawing to the framebuffer already bound, so independent passes
+//      on the same target do not bind back and forth.
+//    - each target's lifetime, so execute() acquires it from the
+//      RenderTargetPool at its first pass and releases it after its last;
+//      targets that are never alive at the same time share pooled memory.
+//    - where contents can be thrown away: a target's attachments before its
+//      first pass (it starts undefined), a target's depth after its last
+//      write (only color is ever read), and the window's depth and stencil
+//      after its last pass. Tilers then skip loading or storing them.
+//
+//  Typical use, once per frame on the render thread:
+//
+//      graph.reset();
+//      int scene = graph.createTarget("scene", desc);
+//      int pass = graph.addPass("scene", drawScene, this);
+//      graph.write(pass, scene);
+//      pass = graph.addPass("composite", composite, this);
+//      graph.read(pass, scene);
+//      graph.write(pass, RenderGraph::WINDOW);
+//      if (graph.compile())
+//      {
+//          graph.execute(pool, commands, width, height);
+//      }
+//
+//  A pass writes one target (GLES 2 has a single color attachment) and
+//  reads any number through texture(). Before a pass runs, its target is
+//  bound and the viewport covers it. The first pass writing a target must
+//  clear or cover all of it.
+//
+
+#ifndef RenderGraph_h
+#define RenderGraph_h
+
+#include "GLCommandBuffer.h"
+#include "RenderTargetPool.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class RenderGraph {
+public:
+    // Records one pass into 'commands'; 'userData' is the pointer given to
+    // addPass().
+    typedef void (*ExecuteFunction)(RenderGraph &graph, GLCommandBuffer &commands, void *userData);
+
+    // The window surface, always an output.
+    static const int WINDOW = 0;
+
+    struct Stats {
+        uint32_t passes; // Declared.
+        uint32_t culledPasses;
+        uint32_t framebufferBinds;
+        uint32_t discards;
+        // Attachment memory of the live targets if each had its own, and
+        // the most alive at once when they share.
+        size_t transientBytes;
+        size_t peakBytes;
+    };
+
+    RenderGraph();
+
+    void reset();
+
+    int createTarget(const char *name, const RenderTargetPool::Desc &desc);
+    // Keeps the target's writers even if no pass reads it.
+    void markOutput(int resource);
+
+    int addPass(const char *name, ExecuteFunction execute, void *userData);
+    void read(int pass, int resource);
+    void write(int pass, int resource);
+
+    // Returns false (logged) if a pass reads a target nothing wrote before
+    // it, or a pass writes more than one target.
+    bool compile();
+    // Off, passes run in declaration order (less the culled ones).
+    void setReordering(bool reorder) { mReordering = reorder; }
+
+    // Records the compiled passes. Needs a current context to create pooled
+    // targets; leaves the window bound. A pass whose target the pool cannot
+    // make is skipped, and so is every pass reading that target.
+    void execute(RenderTargetPool &pool, GLCommandBuffer &commands, GLsizei windowWidth, GLsizei windowHeight);
+
+    // For the passes: the pooled target or color texture behind a resource
+    // the running pass reads or writes.
+    int target(int resource) const { return mResources[resource].target; }
+    GLuint texture(int resource) const;
+
+    const Stats &stats() const { return mStats; }
+    // The compiled passes in execution order; culled passes are not in it.
+    const std::vector<int> &order() const { return mOrder; }
+    const char *passName(int pass) const { return mPasses[pass].name.c_str(); }
+
+private:
+    struct Resource {
+        std::string name;
+        RenderTargetPool::Desc desc;
+        bool output;
+        // From compile(), as positions in mOrder; -1 if unused.
+        int firstUse;
+        int lastUse;
+        int lastWrite;
+        // From execute(): the pool handle while alive.
+        int target;
+    };
+
+    struct Pass {
+        std::string name;
+        ExecuteFunction execute;
+        void *userData;
+        std::vector<int> reads;
+        int write; // -1 until write().
+        bool live;
+    };
+
+    void cull();
+    bool addDependencies(std::vector<std::vector<int> > &dependents, std::vector<int> &dependencyCounts);
+    void schedule(std::vector<std::vector<int> > &dependents, std::vector<int> &dependencyCounts);
+    void computeLifetimes();
+    void computeStats();
+    GLsizei discardAttachments(int resource, bool color, GLenum attachments[3]) const;
+
+    std::vector<Resource> mResources;
+    std::vector<Pass> mPasses;
+    std::vector<int> mOrder;
+    bool mReordering;
+    bool mInvalid;
+    bool mCompiled;
+    Stats mStats;
+    RenderTargetPool *mPool; // During execute().
+};
+
+#endif /* RenderGraph_h */
@@ -0,0 +1,407 @@
+//
+//  RenderTargetPool.cpp
+//
+
+#include "RenderTargetPool.h"
+
+#include <android/log.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#define LOG_TAG "EglSample"
+
+#define LOG_INFO(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOG_ERROR(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+#ifndef GL_DEPTH24_STENCIL8_OES
+#define GL_DEPTH24_STENCIL8_OES 0x88F0
+#endif
+
+// A quad over the whole viewport; the texture coordinates follow from the
+// position.
+static const std::string compositeVertShaderSource = R"(
+
+    attribute vec2 in_Position;
+
+    varying vec2 v_TexCoords;
+
+    void main()
+    {
+        gl_Position = vec4(in_Position, 0.0, 1.0);
+        v_TexCoords = in_Position * 0.5 + 0.5;
+    }
+
+    )";
+
+static const std::string compositeFragShaderSource = R"(
+
+#ifdef GL_ES
+    precision mediump float;
+#endif
+
+    uniform sampler2D u_colorTexture;
+
+    varying vec2 v_TexCoords;
+
+    void main()
+    {
+        gl_FragColor = texture2D(u_colorTexture, v_TexCoords);
+    }
+
+    )";
+
+enum {
+    ATTRIB_COMPOSITE_POSITION
+};
+
+static bool sameDesc(const RenderTargetPool::Desc &a, const RenderTargetPool::Desc &b)
+{
+    return a.width == b.width && a.height == b.height && a.color == b.color && a.depth == b.depth;
+}
+
+RenderTargetPool::RenderTargetPool()
+        : mFrame(0),
+          mMaxIdleFrames(DEFAULT_MAX_IDLE_FRAMES),
+          mPackedDepthStencil(false),
+          mShaderBatch(NULL),
+          mCompositeProgramId(-1),
+          mCompositeProgram(0),
+          mCompositeTextureLocation(-1),
+          mQuadBuffer(0),
+          mQuadVertexArray(0)
+{
+    memset(&mStats, 0, sizeof(mStats));
+    memset(&mFrameStats, 0, sizeof(mFrameStats));
+}
+
+RenderTargetPool::~RenderTargetPool()
+{
+}
+
+void RenderTargetPool::init(ShaderBatch &shaderBatch)
+{
+    // "OpenGL ES 3.1 ..." from a 3.x context, where DEPTH24_STENCIL8 is core.
+    const GLubyte *version = glGetString(GL_VERSION);
+    const char *number = version ? strpbrk((const char *)version, "0123456789") : NULL;
+    const GLubyte *extensions = glGetString(GL_EXTENSIONS);
+    mPackedDepthStencil = (number && atoi(number) >= 3) ||
+            (extensions && strstr((const char *)extensions, "GL_OES_packed_depth_stencil") != NULL);
+    LOG_INFO("RenderTargetPool: packed depth stencil %s", mPackedDepthStencil ? "available" : "not available");
+
+    std::vector<ShaderBatch::Attribute> attributes;
+    const ShaderBatch::Attribute position = { ATTRIB_COMPOSITE_POSITION, "in_Position" };
+    attributes.push_back(position);
+    mShaderBatch = &shaderBatch;
+    mCompositeProgramId = shaderBatch.add(compositeVertShaderSource, compositeFragShaderSource, attributes);
+    mCompositeProgram = 0;
+
+    static const GLfloat quad[] = { -1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f };
+    glGenBuffers(1, &mQuadBuffer);
+    glGenVertexArraysOES(1, &mQuadVertexArray);
+    glBindVertexArrayOES(mQuadVertexArray);
+    glBindBuffer(GL_ARRAY_BUFFER, mQuadBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(ATTRIB_COMPOSITE_POSITION);
+    glVertexAttribPointer(ATTRIB_COMPOSITE_POSITION, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat), (const GLvoid *)0);
+    glBindVertexArrayOES(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void RenderTargetPool::destroy()
+{
+    for (size_t handle = 0; handle < mSlots.size(); ++handle)
+    {
+        if (mSlots[handle].alive)
+        {
+            deleteTarget(int(handle));
+        }
+    }
+    mTargets.clear();
+    mSlots.clear();
+
+    glDeleteVertexArraysOES(1, &mQuadVertexArray);
+    glDeleteBuffers(1, &mQuadBuffer);
+    glDeleteProgram(mCompositeProgram);
+    mQuadVertexArray = 0;
+    mQuadBuffer = 0;
+    mCompositeProgram = 0;
+    mCompositeProgramId = -1;
+    mShaderBatch = NULL;
+}
+
+size_t RenderTargetPool::bytesPerPixel(ColorFormat color)
+{
+    return color == COLOR_RGB565 ? 2 : 4;
+}
+
+size_t RenderTargetPool::bytesPerPixel(DepthFormat depth)
+{
+    switch (depth)
+    {
+        case DEPTH_16:
+            return 2;
+        case DEPTH_24_STENCIL_8:
+            return 4;
+        default:
+            return 0;
+    }
+}
+
+int RenderTargetPool::acquire(const Desc &desc)
+{
+    int handle = findFree(desc);
+    if (handle < 0)
+    {
+        handle = add(desc);
+        if (handle < 0)
+        {
+            return -1;
+        }
+    }
+
+    Slot &slot = mSlots[handle];
+    slot.inUse = true;
+    slot.lastUsedFrame = mFrame;
+    ++mFrameStats.acquired;
+    ++mFrameStats.inUse;
+    return handle;
+}
+
+bool RenderTargetPool::prepare(const Desc &desc)
+{
+    return findFree(desc) >= 0 || add(desc) >= 0;
+}
+
+int RenderTargetPool::findFree(const Desc &desc) const
+{
+    for (size_t handle = 0; handle < mSlots.size(); ++handle)
+    {
+        const Slot &slot = mSlots[handle];
+        if (slot.alive && !slot.inUse && sameDesc(mTargets[handle].desc, desc))
+        {
+            return int(handle);
+        }
+    }
+    return -1;
+}
+
+int RenderTargetPool::add(const Desc &desc)
+{
+    Target target;
+    if (!create(desc, target))
+    {
+        return -1;
+    }
+
+    int freeSlot = -1;
+    for (size_t handle = 0; handle < mSlots.size() && freeSlot < 0; ++handle)
+    {
+        if (!mSlots[handle].alive)
+        {
+            freeSlot = int(handle);
+        }
+    }
+    if (freeSlot < 0)
+    {
+        freeSlot = int(mSlots.size());
+        mTargets.push_back(target);
+        mSlots.push_back(Slot());
+    }
+    mTargets[freeSlot] = target;
+    Slot &slot = mSlots[freeSlot];
+    slot.alive = true;
+    slot.inUse = false;
+    slot.lastUsedFrame = mFrame;
+
+    ++mFrameStats.created;
+    ++mFrameStats.totalCreated;
+    ++mFrameStats.targets;
+    mFrameStats.bytes += target.bytes;
+    if (mFrameStats.bytes > mFrameStats.peakBytes)
+    {
+        mFrameStats.peakBytes = mFrameStats.bytes;
+    }
+    return freeSlot;
+}
+
+void RenderTargetPool::release(int handle)
+{
+    if (!isInUse(handle))
+    {
+        LOG_ERROR("RenderTargetPool: release of a target not in use (%d)", handle);
+        return;
+    }
+    mSlots[handle].inUse = false;
+    --mFrameStats.inUse;
+}
+
+bool RenderTargetPool::isInUse(int handle) const
+{
+    return handle >= 0 && handle < int(mSlots.size()) && mSlots[handle].inUse;
+}
+
+bool RenderTargetPool::bind(GLCommandBuffer &commands, int handle) const
+{
+    if (!isInUse(handle))
+    {
+        LOG_ERROR("RenderTargetPool: bind of a target not in use (%d)", handle);
+        return false;
+    }
+    const Target &t = mTargets[handle];
+    commands.bindFramebuffer(GL_FRAMEBUFFER, t.framebuffer);
+    commands.viewport(0, 0, t.desc.width, t.desc.height);
+    return true;
+}
+
+void RenderTargetPool::bindWindow(GLCommandBuffer &commands, GLsizei width, GLsizei height)
+{
+    commands.bindFramebuffer(GL_FRAMEBUFFER, 0);
+    commands.viewport(0, 0, width, height);
+}
+
+bool RenderTargetPool::canComposite()
+{
+    if (0 == mCompositeProgram)
+    {
+        if (mShaderBatch == NULL || !mShaderBatch->isReady(mCompositeProgramId))
+        {
+            return false;
+        }
+        mCompositeProgram = mShaderBatch->program(mCompositeProgramId);
+        mCompositeTextureLocation = glGetUniformLocation(mCompositeProgram, "u_colorTexture");
+    }
+    return true;
+}
+
+bool RenderTargetPool::composite(GLCommandBuffer &commands, int handle, GLint x, GLint y, GLsizei width,
+                                 GLsizei height)
+{
+    if (!canComposite())
+    {
+        return false;
+    }
+    if (!isInUse(handle))
+    {
+        LOG_ERROR("RenderTargetPool: composite of a target not in use (%d)", handle);
+        return false;
+    }
+
+    commands.viewport(x, y, width, height);
+    commands.disable(GL_DEPTH_TEST);
+    commands.disable(GL_BLEND);
+    commands.useProgram(mCompositeProgram);
+    // Recorded with every composite, so captures replay it too.
+    commands.uniform1i(mCompositeTextureLocation, 0);
+    commands.activeTexture(GL_TEXTURE0);
+    commands.bindTexture(GL_TEXTURE_2D, mTargets[handle].colorTexture);
+    commands.bindVertexArray(mQuadVertexArray);
+    commands.drawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    commands.bindVertexArray(0);
+    commands.bindTexture(GL_TEXTURE_2D, 0);
+    commands.useProgram(0);
+    return true;
+}
+
+void RenderTargetPool::endFrame()
+{
+    for (size_t handle = 0; handle < mSlots.size(); ++handle)
+    {
+        const Slot &slot = mSlots[handle];
+        if (slot.alive && !slot.inUse && mFrame - slot.lastUsedFrame >= mMaxIdleFrames)
+        {
+            deleteTarget(int(handle));
+        }
+    }
+
+    mStats = mFrameStats;
+    mFrameStats.created = 0;
+    mFrameStats.destroyed = 0;
+    mFrameStats.acquired = 0;
+    ++mFrame;
+}
+
+bool RenderTargetPool::create(const Desc &desc, Target &target)
+{
+    if (desc.depth == DEPTH_24_STENCIL_8 && !mPackedDepthStencil)
+    {
+        LOG_ERROR("RenderTargetPool: depth-stencil target without GL_OES_packed_depth_stencil");
+        return false;
+    }
+
+    target.desc = desc;
+    target.framebuffer = 0;
+    target.colorTexture = 0;
+    target.depthRenderbuffer = 0;
+    target.bytes = size_t(desc.width) * size_t(desc.height) *
+            (bytesPerPixel(desc.color) + bytesPerPixel(desc.depth));
+
+    const GLenum format = desc.color == COLOR_RGBA8 ? GL_RGBA : GL_RGB;
+    const GLenum type = desc.color == COLOR_RGB565 ? GL_UNSIGNED_SHORT_5_6_5 : GL_UNSIGNED_BYTE;
+    glGenTextures(1, &target.colorTexture);
+    glBindTexture(GL_TEXTURE_2D, target.colorTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, desc.width, desc.height, 0, format, type, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &target.framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.colorTexture, 0);
+
+    if (desc.depth != DEPTH_NONE)
+    {
+        glGenRenderbuffers(1, &target.depthRenderbuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, target.depthRenderbuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER,
+                              desc.depth == DEPTH_16 ? GL_DEPTH_COMPONENT16 : GL_DEPTH24_STENCIL8_OES,
+                              desc.width, desc.height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, target.depthRenderbuffer);
+        if (desc.depth == DEPTH_24_STENCIL_8)
+        {
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_STENCIL_ATTACHMENT, GL_RENDERBUFFER,
+                                      target.depthRenderbuffer);
+        }
+    }
+
+    // Checked once here; a complete framebuffer stays complete while its
+    // attachments are left alone.
+    const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        LOG_ERROR("RenderTargetPool: %dx%d target incomplete (0x%04x)", desc.width, desc.height, status);
+        glDeleteFramebuffers(1, &target.framebuffer);
+        glDeleteRenderbuffers(1, &target.depthRenderbuffer);
+        glDeleteTextures(1, &target.colorTexture);
+        return false;
+    }
+    return true;
+}
+
+void RenderTargetPool::deleteTarget(int handle)
+{
+    Target &target = mTargets[handle];
+    glDeleteFramebuffers(1, &target.framebuffer);
+    glDeleteRenderbuffers(1, &target.depthRenderbuffer);
+    glDeleteTextures(1, &target.colorTexture);
+    target.framebuffer = 0;
+    target.depthRenderbuffer = 0;
+    target.colorTexture = 0;
+
+    Slot &slot = mSlots[handle];
+    if (slot.inUse)
+    {
+        --mFrameStats.inUse;
+    }
+    slot.alive = false;
+    slot.inUse = false;
+
+    ++mFrameStats.destroyed;
+    ++mFrameStats.totalDestroyed;
+    --mFrameStats.targets;
+    mFrameStats.bytes -= target.bytes;
+}
@@ -0,0 +1,165 @@
+//
+//  RenderTargetPool.h
+//
+//  Offscreen render targets, each a framebuffer with a color texture and an
+//  optional depth (or depth-stencil) renderbuffer, recycled across frames.
+//  acquire() hands out a free target with the same size and formats if the
+//  pool has one and only creates a target otherwise; release() gives it
+//  back. endFrame() deletes the free targets nobody acquired for
+//  maxIdleFrames() frames, so a pass that needs the same target every frame
+//  allocates once, while the sizes left behind by a resize go away.
+//
+//  Typical use, once per frame on the render thread:
+//
+//      int target = pool.acquire(desc);
+//      pool.bind(commands, target);
+//      ... record the pass ...
+//      RenderTargetPool::bindWindow(commands, width, height);
+//      pool.composite(commands, target, 0, 0, width, height);
+//      pool.release(target);
+//      ...
+//      commands.replay(backend);
+//      pool.endFrame();
+//
+//  Creating and deleting targets touches GL, so acquire() and endFrame()
+//  need the context current; binds and composites are recorded into a
+//  GLCommandBuffer. endFrame() deletes right away, so it has to come after
+//  the frame's commands are replayed, never between recording and replay.
+//  A target released while its pass is still recorded is safe to hand out
+//  again in the same frame: the commands replay in order, and the target
+//  is not deleted until endFrame().
+//
+
+#ifndef RenderTargetPool_h
+#define RenderTargetPool_h
+
+#include "GLCommandBuffer.h"
+#include "ShaderBatch.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+class RenderTargetPool {
+public:
+    enum ColorFormat {
+        COLOR_RGBA8,
+        COLOR_RGB8,
+        COLOR_RGB565
+    };
+
+    enum DepthFormat {
+        DEPTH_NONE,
+        DEPTH_16,
+        // Needs GL_OES_packed_depth_stencil; acquire() fails without it.
+        DEPTH_24_STENCIL_8
+    };
+
+    struct Desc {
+        GLsizei width;
+        GLsizei height;
+        ColorFormat color;
+        DepthFormat depth;
+    };
+
+    struct Target {
+        Desc desc;
+        GLuint framebuffer;
+        GLuint colorTexture; // GL_LINEAR, GL_CLAMP_TO_EDGE.
+        GLuint depthRenderbuffer; // 0 for DEPTH_NONE.
+        size_t bytes;
+    };
+
+    // As of the last endFrame(): counters for the frame it closed, the
+    // pool's state after its deletions, and totals since init().
+    struct Stats {
+        uint32_t created;
+        uint32_t destroyed;
+        uint32_t acquired;
+        uint32_t targets; // Alive, in use or free.
+        uint32_t inUse;
+        size_t bytes; // Estimated GPU memory of every alive target.
+        size_t peakBytes;
+        uint64_t totalCreated;
+        uint64_t totalDestroyed;
+    };
+
+    static const unsigned int DEFAULT_MAX_IDLE_FRAMES = 3;
+
+    RenderTargetPool();
+    ~RenderTargetPool();
+
+    // Queues the composite program on 'shaderBatch' and creates its quad.
+    // Needs a current context.
+    void init(ShaderBatch &shaderBatch);
+    // Deletes every target and the composite program, in use or not.
+    void destroy();
+
+    // Returns a target handle, or -1 (logged) if the driver cannot make one
+    // with these formats.
+    int acquire(const Desc &desc);
+    // Creates a free target with 'desc' unless the pool has one, so the
+    // next acquire() of it cannot fail. Returns false (logged) where
+    // acquire() would return -1.
+    bool prepare(const Desc &desc);
+    void release(int handle);
+    // Valid until the next acquire(); handles stay valid until release().
+    const Target &target(int handle) const { return mTargets[handle]; }
+
+    // Records binding the target (or the window) and a viewport covering it.
+    // Returns false (logged), recording nothing, for a handle not in use.
+    bool bind(GLCommandBuffer &commands, int handle) const;
+    static void bindWindow(GLCommandBuffer &commands, GLsizei width, GLsizei height);
+
+    // Records a draw of the target's color over (x, y, width, height) of the
+    // bound framebuffer, with blending and depth testing off. Leaves the
+    // viewport at that rectangle and the program, texture and vertex array
+    // unbound. Returns false until the composite program is ready, or
+    // (logged) for a handle not in use; nothing is recorded then.
+    bool composite(GLCommandBuffer &commands, int handle, GLint x, GLint y, GLsizei width, GLsizei height);
+    bool canComposite();
+
+    // Frees targets idle for maxIdleFrames() frames and starts the next
+    // frame's counters. 0 frees every released target each frame, which is
+    // the create-and-destroy behavior the pool replaces. Call it after the
+    // frame's commands have been replayed.
+    void endFrame();
+    void setMaxIdleFrames(unsigned int frames) { mMaxIdleFrames = frames; }
+    unsigned int maxIdleFrames() const { return mMaxIdleFrames; }
+
+    const Stats &stats() const { return mStats; }
+
+    static size_t bytesPerPixel(ColorFormat color);
+    static size_t bytesPerPixel(DepthFormat depth);
+
+private:
+    struct Slot {
+        bool alive;
+        bool inUse;
+        uint64_t lastUsedFrame;
+    };
+
+    int findFree(const Desc &desc) const;
+    // A new free target in the first dead slot, or -1.
+    int add(const Desc &desc);
+    bool isInUse(int handle) const;
+    bool create(const Desc &desc, Target &target);
+    void deleteTarget(int handle);
+
+    std::vector<Target> mTargets;
+    std::vector<Slot> mSlots;
+    uint64_t mFrame;
+    unsigned int mMaxIdleFrames;
+    Stats mStats;
+    Stats mFrameStats;
+    bool mPackedDepthStencil;
+
+    ShaderBatch *mShaderBatch;
+    int mCompositeProgramId;
+    GLuint mCompositeProgram;
+    GLint mCompositeTextureLocation;
+    GLuint mQuadBuffer;
+    GLuint mQuadVertexArray;
+};
+
+#endif /* RenderTargetPool_h */
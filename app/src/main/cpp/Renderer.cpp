@@ -19,11 +19,13 @@
 #include <pthread.h>
 #include <android/native_window.h> // requires ndk r5 or newer
 #include <EGL/egl.h> // requires ndk r5 or newer
+#include <EGL/eglext.h>
 #define GL_GLEXT_PROTOTYPES
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
 #include <GLES2/gl2platform.h>
 
+#include <string.h>
 #include <strings.h>
 #include <android/log.h>
 #include <string>
@@ -39,73 +41,14 @@
 #include "stb_image.h"
 
 #include "WorldDebugDrawer.h"
+#include "ProgramBinaryCache.h"
+#include "Clock.h"
+#include "GLDebug.h"
 
 #define LOG_TAG "EglSample"
 
 extern FILE *android_fopen(const char *fname, const char *mode);
 
-static void glErrorCheck()
-{
-    do                                                                           \
-    {                                                                          \
-      for (int error = glGetError(); error; error = glGetError())              \
-        {
-
-          switch (error)                                                       \
-            {                                                                  \
-            case GL_NO_ERROR:                                                  \
-              LOG_INFO(                            \
-                             "GL_NO_ERROR - No error has been recorded. The "  \
-                             "value of this symbolic constant is guaranteed "  \
-                             "to be 0.");                                      \
-              break;                                                           \
-            case GL_INVALID_ENUM:                                              \
-              LOG_ERROR(                              \
-                           "GL_INVALID_ENUM - An unacceptable value is "       \
-                           "specified for an enumerated argument. The "        \
-                           "offending command is ignored and has no other "    \
-                           "side effect than to set the error flag.");         \
-              break;                                                           \
-            case GL_INVALID_VALUE:                                             \
-              LOG_ERROR(                              \
-                           "GL_INVALID_VALUE - A numeric argument is out of "  \
-                           "range. The offending command is ignored and has "  \
-                           "no other side effect than to set the error "       \
-                           "flag.");                                           \
-              break;                                                           \
-            case GL_INVALID_OPERATION:                                         \
-              LOG_ERROR(                              \
-                           "GL_INVALID_OPERATION - The specified operation "   \
-                           "is not allowed in the current state. The "         \
-                           "offending command is ignored and has no other "    \
-                           "side effect than to set the error flag.");         \
-              break;                                                           \
-            case GL_INVALID_FRAMEBUFFER_OPERATION:                             \
-              LOG_ERROR(                              \
-                           "GL_INVALID_FRAMEBUFFER_OPERATION - The command "   \
-                           "is trying to render to or read from the "          \
-                           "framebuffer while the currently bound "            \
-                           "framebuffer is not framebuffer complete (i.e. "    \
-                           "the return value from glCheckFramebufferStatus "   \
-                           "is not GL_FRAMEBUFFER_COMPLETE). The offending "   \
-                           "command is ignored and has no other side effect "  \
-                           "than to set the error flag.");                     \
-              break;                                                           \
-            case GL_OUT_OF_MEMORY:                                             \
-              LOG_ERROR(                              \
-                           "GL_OUT_OF_MEMORY - There is not enough memory "    \
-                           "left to execute the command. The state of the GL " \
-                           "is undefined, except for the state of the error "  \
-                           "flags, after this error is recorded.");            \
-              break;                                                           \
-            default:                                                           \
-              LOG_ERROR( "Unknown (%x)", error);      \
-            }                                                                  \
-        }                                                                      \
-    }                                                                          \
-  while (0);
-}
-
 const std::string fragmentSource = R"(
 
 uniform sampler2D videoFrame;
@@ -146,6 +89,13 @@ enum {
 };
 GLint uniforms[NUM_UNIFORMS];
 
+// Draw queue layers, drawn in this order.
+enum {
+    LAYER_BACKGROUND,
+    LAYER_SCENE,
+    NUM_LAYERS
+};
+
 enum {
     ATTRIB_VERTEX,
     ATTRIB_COLOR,
@@ -264,11 +214,11 @@ enum {
 //    // Bind attribute locations.
 //    // This needs to be done prior to linking.
 //    glBindAttribLocation(programPointer, ATTRIB_VERTEX, "a_Position");
-//    glErrorCheck();
+//    GL_CHECK();
 //    glBindAttribLocation(programPointer, ATTRIB_COLOR, "a_Color");
-//    glErrorCheck();
+//    GL_CHECK();
 //    glBindAttribLocation(programPointer, ATTRIB_TEXTUREPOSITON, "a_Texture");
-//    glErrorCheck();
+//    GL_CHECK();
 ////    glBindAttribLocation(programPointer, ATTRIB_TEXTUREPOSITON, "inputTextureCoordinate");
 //
 //    // Link program.
@@ -331,96 +281,6 @@ enum {
 
 
 
-// - (BOOL)createFramebuffers
-static bool createFramebuffers(GLuint &framebuffer, GLuint &textureColorbuffer, GLuint width, GLuint height)
-{
-    bool ret = true;
-    // framebuffer configuration
-    // ----------------------
-    glGenFramebuffers(1, &framebuffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-    // create a color attachment texture
-    glGenTextures(1, &textureColorbuffer);
-    glBindTexture(GL_TEXTURE_2D, textureColorbuffer);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    // This is necessary for non-power-of-two textures
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textureColorbuffer, 0);
-//    // create a renderbuffer object for depth and stencil attachment (we won't be sampling these)
-//    unsigned int rbo;
-//    glGenRenderbuffers(1, &rbo);
-//    glBindRenderbuffer(GL_RENDERBUFFER, rbo);
-//    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8_OES, width, height); // use a single renderbuffer object for both a depth AND stencil buffer.
-//    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rbo); // now actually attach it
-    // now that we actually created the framebuffer and added all attachments we want to check if it is actually complete now
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-    {
-        LOG_ERROR("ERROR::FRAMEBUFFER:: Framebuffer is not complete!");
-        ret = false;
-    }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-    return ret;
-}
-
-// Replace the implementation of this method to do your own custom drawing.
-static const GLfloat squareVertices[] = {
-        -1.0f, -1.0f,
-        1.0f, -1.0f,
-        -1.0f,  1.0f,
-        1.0f,  1.0f,
-};
-
-static const GLfloat textureVertices[] = {
-        1.0f, 1.0f,
-        1.0f, 0.0f,
-        0.0f,  1.0f,
-        0.0f,  0.0f,
-};
-static void renderFrameBuffer(GLuint programPointer, GLuint texture)
-{
-//    glUseProgram(programPointer);
-//
-//    glActiveTexture(GL_TEXTURE0);
-//    glBindTexture(GL_TEXTURE_2D, texture);
-//
-//    // Update uniform values
-//    glUniform1i(uniforms[UNIFORM_VIDEOFRAME], 0);
-////    glUniform4f(uniforms[UNIFORM_INPUTCOLOR], thresholdColor[0], thresholdColor[1], thresholdColor[2], 1.0f);
-////    glUniform1f(uniforms[UNIFORM_THRESHOLD], thresholdSensitivity);
-//
-//    // Update attribute values.
-//    glVertexAttribPointer(ATTRIB_VERTEX, 2, GL_FLOAT, 0, 0, squareVertices);
-//    glEnableVertexAttribArray(ATTRIB_VERTEX);
-//    glVertexAttribPointer(ATTRIB_TEXTUREPOSITON, 2, GL_FLOAT, 0, 0, textureVertices);
-//    glEnableVertexAttribArray(ATTRIB_TEXTUREPOSITON);
-//
-//    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-}
-
-
-// - (void)destroyFramebuffer;
-//static void destroyFramebuffer()
-//{
-//	if (viewFramebuffer)
-//	{
-//		glDeleteFramebuffers(1, &viewFramebuffer);
-//		viewFramebuffer = 0;
-//	}
-//
-//	if (viewRenderbuffer)
-//	{
-//		glDeleteRenderbuffers(1, &viewRenderbuffer);
-//		viewRenderbuffer = 0;
-//	}
-//}
-
-
 static GLfloat _vertices[] = {  1.0, -1.0, 0.0,    1.0, 1.0, 1.0, 1.0,    1.0, 1.0, //right-top
                                 1.0,  1.0, 0.0,    1.0, 1.0, 1.0, 1.0,    1.0, 0.0, //right-bottom
                                -1.0,  1.0, 0.0,    1.0, 1.0, 1.0, 1.0,    0.0, 0.0, //left-bottom
@@ -439,35 +299,35 @@ static GLubyte _indices[] = {0, 1, 2,
 static void setupVertexBuffer(GLuint &vao, GLuint &vertexBuffer, GLuint &indexBuffer)
 {
     glGenVertexArraysOES(1, &vao);
-    glErrorCheck();
+    GL_CHECK();
     glBindVertexArrayOES(vao);
-    glErrorCheck();
+    GL_CHECK();
 
     glGenBuffers(GLsizei(1), &vertexBuffer);
-    glErrorCheck();
+    GL_CHECK();
     glBindBuffer(GLenum(GL_ARRAY_BUFFER), vertexBuffer);
-    glErrorCheck();
+    GL_CHECK();
 
     size_t v_count = 4;//_vertices.size() / 7;
     size_t v_size = sizeof(GLfloat)* 9;
     const void *vertices = (const void*)_vertices;
     glBufferData(GLenum(GL_ARRAY_BUFFER), v_count * v_size, vertices, GLenum(GL_STATIC_DRAW));
-    glErrorCheck();
+    GL_CHECK();
 
     glGenBuffers(GLsizei(1), &indexBuffer);
-    glErrorCheck();
+    GL_CHECK();
     glBindBuffer(GLenum(GL_ELEMENT_ARRAY_BUFFER), indexBuffer);
-    glErrorCheck();
+    GL_CHECK();
     size_t i_count = 6;//_indices.size();
     size_t i_size = sizeof(GLubyte);
     const void *indices = (const void*)_indices;
     glBufferData(GLenum(GL_ELEMENT_ARRAY_BUFFER), i_count * i_size, indices, GLenum(GL_STATIC_DRAW));
-    glErrorCheck();
+    GL_CHECK();
 
     GLsizei s1 = GLsizei(sizeof(GLfloat) * 9);
     int p1 = 0;
     glEnableVertexAttribArray(ATTRIB_VERTEX);
-    glErrorCheck();
+    GL_CHECK();
     glVertexAttribPointer(
             ATTRIB_VERTEX,
             3,
@@ -475,12 +335,12 @@ static void setupVertexBuffer(GLuint &vao, GLuint &vertexBuffer, GLuint &indexBu
             GLboolean(GL_FALSE),
             s1,
             (const GLvoid *)p1);
-    glErrorCheck();
+    GL_CHECK();
 
     GLsizei s2 = GLsizei(sizeof(GLfloat) * 9);
     int p2 = (3 * sizeof(GLfloat));
     glEnableVertexAttribArray(ATTRIB_COLOR);
-    glErrorCheck();
+    GL_CHECK();
     glVertexAttribPointer(
             ATTRIB_COLOR,
             4,
@@ -488,13 +348,13 @@ static void setupVertexBuffer(GLuint &vao, GLuint &vertexBuffer, GLuint &indexBu
             GLboolean(GL_FALSE),
             s2,
             (const GLvoid *)p2);
-    glErrorCheck();
+    GL_CHECK();
 
 
     GLsizei s3 = GLsizei(sizeof(GLfloat) * 9);
     int p3 = ((3 + 4) * sizeof(GLfloat));
     glEnableVertexAttribArray(ATTRIB_TEXTUREPOSITON);
-    glErrorCheck();
+    GL_CHECK();
     glVertexAttribPointer(
             ATTRIB_TEXTUREPOSITON,
             2,
@@ -502,7 +362,7 @@ static void setupVertexBuffer(GLuint &vao, GLuint &vertexBuffer, GLuint &indexBu
             GLboolean(GL_FALSE),
             s3,
             (const GLvoid *)p3);
-    glErrorCheck();
+    GL_CHECK();
 
     glBindVertexArrayOES(0);
     glBindBuffer(GLenum(GL_ARRAY_BUFFER), 0);
@@ -514,7 +374,8 @@ static void setupVertexBuffer(GLuint &vao, GLuint &vertexBuffer, GLuint &indexBu
 
 
 Renderer::Renderer()
-        : _msg(MSG_NONE), _display(0), _surface(0), _context(0), _angle(0), mDebugDrawer(new WorldDebugDrawer)
+        : _msg(MSG_NONE), _display(0), _surface(0), _context(0), _angle(0), mProgramId(-1), mProgram(0),
+          mDebugDrawer(new WorldDebugDrawer), mSceneTarget(-1), mFrameStartTime(0), mFrameIntervalMs(-1.0), mCaptureFile(NULL), mCaptureFramesLeft(0)
 {
     LOG_INFO("Renderer instance created");
     pthread_mutex_init(&_mutex, 0);
@@ -564,6 +425,17 @@ void Renderer::setWindow(ANativeWindow *window)
     return;
 }
 
+void Renderer::requestCapture(const std::string &path, int frameCount)
+{
+    // Picked up by the render thread at the start of the next frame.
+    pthread_mutex_lock(&_mutex);
+    mCapturePath = path;
+    mCaptureFramesLeft = frameCount;
+    pthread_mutex_unlock(&_mutex);
+
+    return;
+}
+
 
 
 void Renderer::renderLoop()
@@ -597,6 +469,7 @@ void Renderer::renderLoop()
         if (_display) {
 
             drawFrame();
+            submitFrame();
 
             if (!eglSwapBuffers(_display, _surface)) {
                 LOG_ERROR("eglSwapBuffers() returned error %d", eglGetError());
@@ -662,9 +535,20 @@ bool Renderer::initialize()
     EGLint ctxattr[] = {
             EGL_CONTEXT_MAJOR_VERSION, 2,
             EGL_CONTEXT_MINOR_VERSION, 0,
+            EGL_NONE, 0,
             EGL_NONE
     };
 
+#if GLDEBUG_MODE == GLDEBUG_FULL
+    // Some drivers only deliver KHR_debug messages on a debug context.
+    const char *eglExtensions = eglQueryString(display, EGL_EXTENSIONS);
+    if (eglExtensions && strstr(eglExtensions, "EGL_KHR_create_context"))
+    {
+        ctxattr[4] = EGL_CONTEXT_FLAGS_KHR;
+        ctxattr[5] = EGL_CONTEXT_OPENGL_DEBUG_BIT_KHR;
+    }
+#endif
+
     if (!(context = eglCreateContext(display, config, 0, ctxattr))) {
         LOG_ERROR("eglCreateContext() returned error %d", eglGetError());
         destroy();
@@ -688,64 +572,105 @@ bool Renderer::initialize()
     _surface = surface;
     _context = context;
 
-    if(Shader::load(vertexSource, fragmentSource, mProgram))
+    GLDebug::initialize();
+    ProgramBinaryCache::initialize();
+    GLESCommandBackend::initialize();
+    mShaderBatch.initialize();
+
+    // Queue every program first and submit them together; they finish
+    // compiling over the next frames while the buffers and textures load.
+    std::vector<ShaderBatch::Attribute> attributes;
+    attributes.push_back({ATTRIB_VERTEX, "a_Position"});
+    attributes.push_back({ATTRIB_COLOR, "a_Color"});
+    attributes.push_back({ATTRIB_TEXTUREPOSITON, "a_Texture"});
+    mProgram = 0;
+    mProgramId = mShaderBatch.add(vertexSource, fragmentSource, attributes);
+
+    mDebugDrawer->init(mShaderBatch);
+    mRenderTargets.init(mShaderBatch);
+    mGpuTimer.initialize();
+    mDynamicResolution = DynamicResolution(mGpuTimer.isAvailable() ? DynamicResolution::defaultConfig()
+                                                                   : DynamicResolution::frameIntervalConfig());
+    mFrameStartTime = 0.0;
+    mFrameIntervalMs = -1.0;
+
+    mShaderBatch.submit();
+
+    // A failed compile or link only shows once drawFrame() polls the batch
+    // (the batch logs it, and the scene is never drawn); the program has
+    // to exist by now, though.
+    if (mProgramId < 0 || mShaderBatch.program(mProgramId) == 0 || mShaderBatch.isFailed(mProgramId))
     {
-        GLint videoFrame = glGetUniformLocation(mProgram, "videoFrame");
-        uniforms[UNIFORM_VIDEOFRAME] = videoFrame;
+        LOG_ERROR("Unable to create the scene program");
+        destroy();
+        return false;
+    }
 
-        setupVertexBuffer(mVao, mVertexBuffer, mIndexBuffer);
+    setupVertexBuffer(mVao, mVertexBuffer, mIndexBuffer);
 
-        char const *filename = "img0.bmp";
-        int x;
-        int y;
-        int channels_in_file;
-        int desired_channels=4;
+    char const *filename = "img0.bmp";
+    int x;
+    int y;
+    int channels_in_file;
+    int desired_channels=4;
 
 
-        FILE *f = android_fopen(filename, "r");
-        void *buffer = (void*)stbi_load_from_file(f, &x, &y, &channels_in_file, desired_channels);
+    FILE *f = android_fopen(filename, "r");
+    void *buffer = (void*)stbi_load_from_file(f, &x, &y, &channels_in_file, desired_channels);
 
-        GLsizei bufferHeight = y;
-        GLsizei bufferWidth = x;
-        size_t currSize = bufferHeight * bufferWidth * channels_in_file;
-        unsigned char *outBuff = (unsigned char*)malloc(currSize);
+    GLsizei bufferHeight = y;
+    GLsizei bufferWidth = x;
+    size_t currSize = bufferHeight * bufferWidth * channels_in_file;
+    unsigned char *outBuff = (unsigned char*)malloc(currSize);
 //        memset(outBuff, 0, currSize);
-        memcpy(outBuff, buffer, currSize);
-
-        // Create a new texture from the camera frame data, display that using the shaders
-        glGenTextures(1, &mVideoFrameTexture);
-        glErrorCheck();
-        glBindTexture(GL_TEXTURE_2D, mVideoFrameTexture);
-        glErrorCheck();
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        // This is necessary for non-power-of-two textures
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-
-        // Using BGRA extension to pull in video frame data directly
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, (GLsizei)bufferWidth, (GLsizei)bufferHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, outBuff);
-        glErrorCheck();
-
-        free(outBuff);
-
-
-        mDebugDrawer->init();
+    memcpy(outBuff, buffer, currSize);
 
-        return true;
-    }
+    // Create a new texture from the camera frame data, display that using the shaders
+    glGenTextures(1, &mVideoFrameTexture);
+    GL_CHECK();
+    glBindTexture(GL_TEXTURE_2D, mVideoFrameTexture);
+    GL_CHECK();
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    // This is necessary for non-power-of-two textures
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
 
+    // Using BGRA extension to pull in video frame data directly
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, (GLsizei)bufferWidth, (GLsizei)bufferHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, outBuff);
+    GL_CHECK();
 
+    free(outBuff);
 
-    return false;
+    return true;
 }
 
 void Renderer::destroy() {
     LOG_INFO("Destroying context");
 
     mDebugDrawer->unInit();
+    mRenderTargets.destroy();
+    mGpuTimer.destroy();
+
+    // The batch leaves its programs to their owners; this one is ours even
+    // if it never finished linking.
+    const GLuint program = mShaderBatch.program(mProgramId);
+    if (program != 0)
+    {
+        glDeleteProgram(program);
+    }
+    mProgram = 0;
+    mProgramId = -1;
+    mShaderBatch.clear();
+    mCommands.reset();
+
+    if (mCaptureFile)
+    {
+        fclose(mCaptureFile);
+        mCaptureFile = NULL;
+        mCaptureFramesLeft = 0;
+    }
 
     eglMakeCurrent(_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
     eglDestroyContext(_display, _context);
@@ -759,32 +684,105 @@ void Renderer::destroy() {
     return;
 }
 
+void Renderer::drawScenePass(RenderGraph &, GLCommandBuffer &commands, void *userData)
+{
+    Renderer *renderer = (Renderer *)userData;
+
+    commands.clearColor(0.0, 0.0, 0.0, 1.0);
+    commands.clear(GL_COLOR_BUFFER_BIT);
+
+    if (renderer->mProgram != 0)
+    {
+        // The sampler is recorded once per frame rather than per draw, so a
+        // capture that starts on any frame still replays it.
+        commands.useProgram(renderer->mProgram);
+        commands.uniform1i(uniforms[UNIFORM_VIDEOFRAME], 0);
+        commands.useProgram(0);
+
+        DrawQueue::Draw quad;
+        quad.program = renderer->mProgram;
+        quad.texture = renderer->mVideoFrameTexture;
+        quad.vertexArray = renderer->mVao;
+        quad.mode = GL_TRIANGLES;
+        quad.count = 6;
+        quad.indexType = GL_UNSIGNED_BYTE;
+        quad.first = 0;
+        renderer->mDrawQueue.add(DrawQueue::makeKey(LAYER_BACKGROUND, false, renderer->mProgram,
+                                                    renderer->mVideoFrameTexture, 0.0f), quad);
+    }
+
+    renderer->mDrawQueue.sort();
+    renderer->mDrawQueue.submit(commands);
+    renderer->mDrawQueue.clear();
+}
+
+void Renderer::compositePass(RenderGraph &graph, GLCommandBuffer &commands, void *userData)
+{
+    Renderer *renderer = (Renderer *)userData;
+    renderer->mRenderTargets.composite(commands, graph.target(renderer->mSceneTarget), 0, 0, renderer->mWidth,
+                                       renderer->mHeight);
+}
+
+void Renderer::drawOverlayPass(RenderGraph &, GLCommandBuffer &commands, void *userData)
+{
+    Renderer *renderer = (Renderer *)userData;
+    renderer->mDebugDrawer->setViewport(renderer->mWidth, renderer->mHeight);
+    renderer->mDebugDrawer->draw(commands);
+}
+
 void Renderer::drawFrame()
 {
-    glViewport(0, 0, mWidth, mHeight);
+    const double now = nowMillis();
+    mFrameIntervalMs = mFrameStartTime > 0.0 ? now - mFrameStartTime : -1.0;
+    mFrameStartTime = now;
 
-    glClearColor(0.0, 0.0, 0.0, 1.0);
-    glClear(GL_COLOR_BUFFER_BIT);
+    // Finalizes programs whose compile finished since the last frame.
+    mShaderBatch.poll();
 
-    glUseProgram(mProgram);
-    glErrorCheck();
+    if (mProgram == 0 && mShaderBatch.isReady(mProgramId))
+    {
+        mProgram = mShaderBatch.program(mProgramId);
 
-    glActiveTexture(GL_TEXTURE0);
-    glErrorCheck();
-    glBindTexture(GL_TEXTURE_2D, mVideoFrameTexture);
-    glErrorCheck();
+        GLint videoFrame = glGetUniformLocation(mProgram, "videoFrame");
+        uniforms[UNIFORM_VIDEOFRAME] = videoFrame;
+    }
 
-    // Update uniform values
-    glUniform1i(uniforms[UNIFORM_VIDEOFRAME], 0);
-    glErrorCheck();
+    // Until the composite program is ready, or if the scene target cannot
+    // be made, the scene draws to the window.
+    mRenderGraph.reset();
+    int sceneOutput = RenderGraph::WINDOW;
+    if (mRenderTargets.canComposite())
+    {
+        // The composite scales the scene up to the window; the overlay
+        // stays at the window's resolution.
+        int sceneWidth, sceneHeight;
+        mDynamicResolution.scaledSize(mWidth, mHeight, sceneWidth, sceneHeight);
+        const RenderTargetPool::Desc desc = { sceneWidth, sceneHeight, RenderTargetPool::COLOR_RGBA8,
+                                              RenderTargetPool::DEPTH_NONE };
+        // Made before the graph is built: the graph would only skip the
+        // scene and its composite when the target fails.
+        if (mRenderTargets.prepare(desc))
+        {
+            mSceneTarget = mRenderGraph.createTarget("scene", desc);
+            sceneOutput = mSceneTarget;
+        }
+    }
 
-    glBindVertexArrayOES(mVao);
-    glErrorCheck();
-    glDrawElements(GLenum(GL_TRIANGLES), GLsizei(6), GLenum(GL_UNSIGNED_BYTE), 0);
-    glErrorCheck();
-    glBindVertexArrayOES(0);
+    int pass = mRenderGraph.addPass("scene", drawScenePass, this);
+    mRenderGraph.write(pass, sceneOutput);
+    if (sceneOutput != RenderGraph::WINDOW)
+    {
+        pass = mRenderGraph.addPass("composite", compositePass, this);
+        mRenderGraph.read(pass, mSceneTarget);
+        mRenderGraph.write(pass, RenderGraph::WINDOW);
+    }
+    pass = mRenderGraph.addPass("debug overlay", drawOverlayPass, this);
+    mRenderGraph.write(pass, RenderGraph::WINDOW);
 
-    mDebugDrawer->draw();
+    if (mRenderGraph.compile())
+    {
+        mRenderGraph.execute(mRenderTargets, mCommands, mWidth, mHeight);
+    }
 //    glMatrixMode(GL_MODELVIEW);
 //    glLoadIdentity();
 //    glTranslatef(0, 0, -3.0f);
@@ -802,177 +800,77 @@ void Renderer::drawFrame()
 //    _angle += 1.2f;
 }
 
-void* Renderer::threadStartCallback(void *myself)
+void Renderer::submitFrame()
 {
-    Renderer *renderer = (Renderer*)myself;
-
-    renderer->renderLoop();
-    pthread_exit(0);
-
-    return 0;
-}
-
-
-
-bool Shader::compileShader(GLuint &shader, GLenum type, const std::string &source)
-{
-    GLint status;
-    const GLchar *_source = (GLchar*)source.c_str();
-
-    if (!_source)
+    if (mCaptureFramesLeft > 0 && !mCaptureFile)
     {
-        LOG_ERROR("Failed to load vertex shader");
-        return false;
-    }
-
-    shader = glCreateShader(type);
-    glShaderSource(shader, 1, &_source, NULL);
-    glCompileShader(shader);
-
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
-    if (status == GL_FALSE)
-    {
-        glDeleteShader(shader);
-
-        GLint logLength;
-        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
-        if (logLength > 0)
+        mCaptureFile = fopen(mCapturePath.c_str(), "wb");
+        if (!mCaptureFile || !GLCommandBuffer::writeHeader(mCaptureFile))
         {
-            GLchar *log = (GLchar *)malloc(logLength);
-            glGetShaderInfoLog(shader, logLength, &logLength, log);
-            LOG_ERROR("Shader compile log:\n%s", log);
-            free(log);
+            LOG_ERROR("Unable to start capture %s", mCapturePath.c_str());
+            if (mCaptureFile)
+            {
+                fclose(mCaptureFile);
+                mCaptureFile = NULL;
+            }
+            mCaptureFramesLeft = 0;
         }
-
-        return false;
     }
 
-    return true;
-}
-bool Shader::linkProgram(GLuint programPointer)
-{
-    GLint status(GL_FALSE);
+    mGpuTimer.begin();
+    mCommands.replay(mBackend);
+    mGpuTimer.end();
+    GLDebug::endFrame();
 
-    glLinkProgram(programPointer);
+    // Only once the frame's commands have run can its idle targets go.
+    mRenderTargets.endFrame();
 
-    glGetProgramiv(programPointer, GL_LINK_STATUS, &status);
-    if (status == GL_FALSE)
+    // GPU times arrive a few frames late; the controller only gets frames
+    // measured the same way. Without the timer the last whole frame
+    // interval stands in, swap included: a GPU-bound frame waits in
+    // eglSwapBuffers(), not in drawFrame() or the replay.
+    double gpuMs;
+    if (!mGpuTimer.isAvailable())
     {
-        GLint logLength;
-        glGetProgramiv(programPointer, GL_INFO_LOG_LENGTH, &logLength);
-        if (logLength > 0)
+        if (mFrameIntervalMs >= 0.0)
         {
-            GLchar *log = (GLchar *)malloc(logLength);
-            glGetProgramInfoLog(programPointer, logLength, &logLength, log);
-            LOG_ERROR("Program link log:\n%s", log);
-            free(log);
+            mDynamicResolution.addFrame(mFrameIntervalMs, -1.0);
         }
-
-        return false;
     }
-
-    return true;
-}
-
-bool Shader::validateProgram(GLuint programPointer)
-{
-    GLint status(GL_FALSE);
-
-    glValidateProgram(programPointer);
-
-    glGetProgramiv(programPointer, GL_VALIDATE_STATUS, &status);
-    if (status == GL_FALSE)
+    else if (mGpuTimer.poll(gpuMs))
     {
-        GLint logLength;
-        glGetProgramiv(programPointer, GL_INFO_LOG_LENGTH, &logLength);
-        if (logLength > 0)
-        {
-            GLchar *log = (GLchar *)malloc(logLength);
-            glGetProgramInfoLog(programPointer, logLength, &logLength, log);
-            LOG_ERROR("Program validate log:\n%s", log);
-            free(log);
-        }
-        return false;
-    }
-
-    return true;
-}
-
-//bool Shader::load(const std::string &vertShaderSource, const std::string &fragShaderSource, GLuint &programPointer);
-bool Shader::load(const std::string &vertShaderSource, const std::string &fragShaderSource, GLuint &programPointer)
-{
-    GLuint vertexShader(0), fragShader(0);
-
-    programPointer = glCreateProgram();
-
-    if(!compileShader(vertexShader, GL_VERTEX_SHADER, vertShaderSource))
-    {
-        return false;
+        mDynamicResolution.addFrame(mFrameIntervalMs, gpuMs);
     }
 
-    if(!compileShader(fragShader, GL_FRAGMENT_SHADER, fragShaderSource))
+    if (mCaptureFile)
     {
-        return false;
-    }
-
-
-    // Attach vertex shader to program.
-    glAttachShader(programPointer, vertexShader);
-
-    // Attach fragment shader to program.
-    glAttachShader(programPointer, fragShader);
-
-    // Bind attribute locations.
-    // This needs to be done prior to linking.
-    glBindAttribLocation(programPointer, ATTRIB_VERTEX, "a_Position");
-    glErrorCheck();
-    glBindAttribLocation(programPointer, ATTRIB_COLOR, "a_Color");
-    glErrorCheck();
-    glBindAttribLocation(programPointer, ATTRIB_TEXTUREPOSITON, "a_Texture");
-    glErrorCheck();
-//    glBindAttribLocation(programPointer, ATTRIB_TEXTUREPOSITON, "inputTextureCoordinate");
-
-    // Link program.
-    if(!linkProgram(programPointer))
-    {
-        LOG_ERROR("Failed to link program: %d", programPointer);
-
-        if (vertexShader) {
-            glDeleteShader(vertexShader);
-            vertexShader = 0;
-        }
-        if (fragShader) {
-            glDeleteShader(fragShader);
-            fragShader = 0;
+        if (!mCommands.writeFrame(mCaptureFile))
+        {
+            LOG_ERROR("Capture %s: write failed", mCapturePath.c_str());
+            mCaptureFramesLeft = 0;
         }
-        if (programPointer) {
-            glDeleteProgram(programPointer);
-            programPointer = 0;
+        else
+        {
+            --mCaptureFramesLeft;
         }
 
-        return false;
+        if (mCaptureFramesLeft <= 0)
+        {
+            fclose(mCaptureFile);
+            mCaptureFile = NULL;
+            LOG_INFO("Capture written to %s", mCapturePath.c_str());
+        }
     }
 
-    if(!validateProgram(programPointer))
-    {
-        return false;
-    }
+    mCommands.reset();
+}
 
-    // Get uniform locations.
-//    GLint videoFrame = glGetUniformLocation(programPointer, "videoFrame");
-//    uniforms[UNIFORM_VIDEOFRAME] = videoFrame;
-//    uniforms[UNIFORM_INPUTCOLOR] = glGetUniformLocation(programPointer, "inputColor");
-//    uniforms[UNIFORM_THRESHOLD] = glGetUniformLocation(programPointer, "threshold");
+void* Renderer::threadStartCallback(void *myself)
+{
+    Renderer *renderer = (Renderer*)myself;
 
-    // Release vertex and fragment shaders.
-    if (vertexShader)
-    {
-        glDeleteShader(vertexShader);
-    }
-    if (fragShader)
-    {
-        glDeleteShader(fragShader);
-    }
+    renderer->renderLoop();
+    pthread_exit(0);
 
-    return true;
-}
\ No newline at end of file
+    return 0;
+}
@@ -21,6 +21,16 @@
 #include <EGL/egl.h> // requires ndk r5 or newer
 #include <GLES/gl.h>
 #include "WorldDebugDrawer.h"
+#include "ShaderBatch.h"
+#include "GLCommandBuffer.h"
+#include "DrawQueue.h"
+#include "RenderTargetPool.h"
+#include "RenderGraph.h"
+#include "DynamicResolution.h"
+#include "GpuTimer.h"
+
+#include <stdio.h>
+#include <string>
 
 class WorldDebugDrawer;
 
@@ -36,6 +46,10 @@ public:
     void stop();
     void setWindow(ANativeWindow* window);
 
+    // Writes the next 'frameCount' recorded frames to 'path' for offline
+    // replay (see tools/glreplay).
+    void requestCapture(const std::string &path, int frameCount);
+
 
 private:
 
@@ -65,6 +79,12 @@ private:
     void destroy();
 
     void drawFrame();
+    void submitFrame();
+
+    // drawFrame()'s RenderGraph passes; 'userData' is the Renderer.
+    static void drawScenePass(RenderGraph &graph, GLCommandBuffer &commands, void *userData);
+    static void compositePass(RenderGraph &graph, GLCommandBuffer &commands, void *userData);
+    static void drawOverlayPass(RenderGraph &graph, GLCommandBuffer &commands, void *userData);
 
     // Helper method for starting the thread
     static void* threadStartCallback(void *myself);
@@ -72,9 +92,10 @@ private:
     EGLint mWidth;
     EGLint mHeight;
 
+    ShaderBatch mShaderBatch;
+    int mProgramId;
+
     GLuint mProgram;
-    GLuint mFrameBuffer;
-    GLuint mTexture;
 
     GLuint mVao;
     GLuint mVertexBuffer;
@@ -83,17 +104,32 @@ private:
 
     WorldDebugDrawer *mDebugDrawer;
 
-};
+    // Scene draws, sorted by state each frame before they are recorded.
+    DrawQueue mDrawQueue;
 
-class Shader {
-    static bool compileShader(GLuint &shader, GLenum type, const std::string &source);
-    static bool linkProgram(GLuint programPointer);
-    static bool validateProgram(GLuint programPointer);
-public:
-    static bool load(const std::string &vertShaderSource, const std::string &fragShaderSource, GLuint &programPointer);
-private:
+    // The scene renders into a pooled target that is composited to the
+    // window; the debug overlay draws straight to the window. The graph is
+    // rebuilt every frame.
+    RenderTargetPool mRenderTargets;
+    RenderGraph mRenderGraph;
+    int mSceneTarget;
 
-};
+    // The scene target's size follows the frame time: GPU time of the
+    // replay where it can be timed, else the interval from one drawFrame()
+    // to the next, which includes the wait in eglSwapBuffers().
+    DynamicResolution mDynamicResolution;
+    GpuTimer mGpuTimer;
+    double mFrameStartTime;
+    double mFrameIntervalMs; // Negative until there are two frames.
+
+    // drawFrame() records into mCommands; submitFrame() replays it.
+    GLCommandBuffer mCommands;
+    GLESCommandBackend mBackend;
 
+    std::string mCapturePath;
+    FILE *mCaptureFile;
+    int mCaptureFramesLeft;
+
+};
 
 #endif // RENDERER_H
@@ -0,0 +1,327 @@
+//
+//  ShaderBatch.cpp
+//
+
+#include "ShaderBatch.h"
+#include "ProgramBinaryCache.h"
+#include "Clock.h"
+
+#include <EGL/egl.h>
+#include <android/log.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define LOG_TAG "EglSample"
+
+#define LOG_INFO(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOG_ERROR(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+typedef void (GL_APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC_) (GLuint count);
+
+static void logShaderInfo(GLuint shader)
+{
+    GLint logLength(0);
+    glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
+    if (logLength > 0)
+    {
+        GLchar *log = (GLchar *)malloc(logLength);
+        glGetShaderInfoLog(shader, logLength, &logLength, log);
+        LOG_ERROR("Shader compile log:\n%s", log);
+        free(log);
+    }
+}
+
+static void logProgramInfo(GLuint program, const char *what)
+{
+    GLint logLength(0);
+    glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
+    if (logLength > 0)
+    {
+        GLchar *log = (GLchar *)malloc(logLength);
+        glGetProgramInfoLog(program, logLength, &logLength, log);
+        LOG_ERROR("Program %s log:\n%s", what, log);
+        free(log);
+    }
+}
+
+static GLuint submitShader(GLenum type, const std::string &source)
+{
+    const GLchar *_source = (const GLchar *)source.c_str();
+
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &_source, NULL);
+    glCompileShader(shader);
+
+    // Deliberately no GL_COMPILE_STATUS query here, it would wait for the compiler.
+    return shader;
+}
+
+ShaderBatch::ShaderBatch()
+        : mPendingCount(0), mSubmitTime(0), mCacheHits(0), mCacheMisses(0), mCacheHitMs(0),
+          mParallelCompile(false)
+{
+}
+
+ShaderBatch::~ShaderBatch()
+{
+}
+
+void ShaderBatch::initialize()
+{
+    const GLubyte *extensions = glGetString(GL_EXTENSIONS);
+    mParallelCompile = extensions &&
+            std::string((const char *)extensions).find("GL_KHR_parallel_shader_compile") != std::string::npos;
+
+    if (mParallelCompile)
+    {
+        PFNGLMAXSHADERCOMPILERTHREADSKHRPROC_ maxThreads =
+                (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC_)eglGetProcAddress("glMaxShaderCompilerThreadsKHR");
+        if (maxThreads)
+        {
+            // Let the driver pick the number of compiler threads.
+            maxThreads(0xFFFFFFFF);
+        }
+    }
+
+    LOG_INFO("ShaderBatch: KHR_parallel_shader_compile %s", mParallelCompile ? "available" : "not available");
+}
+
+// One "index name" line per binding, for the program cache key.
+static std::string attributeBindings(const std::vector<ShaderBatch::Attribute> &attributes)
+{
+    std::string bindings;
+    char index[16];
+    for (size_t i = 0; i < attributes.size(); ++i)
+    {
+        snprintf(index, sizeof(index), "%u ", attributes[i].index);
+        bindings += index;
+        bindings += attributes[i].name;
+        bindings += '\n';
+    }
+    return bindings;
+}
+
+int ShaderBatch::add(const std::string &vertShaderSource, const std::string &fragShaderSource,
+                     const std::vector<Attribute> &attributes, const std::string &defines)
+{
+    Entry entry;
+    entry.vertShaderSource = vertShaderSource;
+    entry.fragShaderSource = fragShaderSource;
+    entry.defines = defines;
+    entry.attributes = attributes;
+    entry.vertexShader = 0;
+    entry.fragShader = 0;
+    entry.program = 0;
+    entry.status = STATUS_QUEUED;
+
+    mEntries.push_back(entry);
+    return int(mEntries.size() - 1);
+}
+
+void ShaderBatch::submit()
+{
+    mSubmitTime = nowMillis();
+    mCacheHits = 0;
+    mCacheMisses = 0;
+    mCacheHitMs = 0.0;
+
+    // First pass: resolve cache hits and kick off every shader compile, so
+    // the driver sees all the work before we ask for the first result.
+    for (size_t i = 0; i < mEntries.size(); ++i)
+    {
+        Entry &entry = mEntries[i];
+        if (entry.status != STATUS_QUEUED)
+        {
+            continue;
+        }
+
+        entry.program = glCreateProgram();
+        entry.cacheKey = ProgramBinaryCache::makeKey(entry.vertShaderSource, entry.fragShaderSource, entry.defines,
+                                                     attributeBindings(entry.attributes));
+        const double loadStart = nowMillis();
+        if (ProgramBinaryCache::load(entry.cacheKey, entry.program))
+        {
+            entry.status = STATUS_READY;
+            ++mCacheHits;
+            mCacheHitMs += nowMillis() - loadStart;
+            continue;
+        }
+        ++mCacheMisses;
+
+        entry.vertexShader = submitShader(GL_VERTEX_SHADER, entry.defines + entry.vertShaderSource);
+        entry.fragShader = submitShader(GL_FRAGMENT_SHADER, entry.defines + entry.fragShaderSource);
+        entry.status = STATUS_COMPILING;
+        ++mPendingCount;
+    }
+
+    // Second pass: links. A failed compile simply shows up as a failed link.
+    for (size_t i = 0; i < mEntries.size(); ++i)
+    {
+        Entry &entry = mEntries[i];
+        if (entry.status != STATUS_COMPILING)
+        {
+            continue;
+        }
+
+        glAttachShader(entry.program, entry.vertexShader);
+        glAttachShader(entry.program, entry.fragShader);
+        for (size_t a = 0; a < entry.attributes.size(); ++a)
+        {
+            glBindAttribLocation(entry.program, entry.attributes[a].index, entry.attributes[a].name);
+        }
+        glLinkProgram(entry.program);
+    }
+
+    if (mPendingCount == 0)
+    {
+        logSetupTimes();
+    }
+}
+
+bool ShaderBatch::poll()
+{
+    if (mPendingCount == 0)
+    {
+        return true;
+    }
+
+    for (size_t i = 0; i < mEntries.size(); ++i)
+    {
+        Entry &entry = mEntries[i];
+        if (entry.status == STATUS_COMPILING && isComplete(entry))
+        {
+            finalize(entry);
+            --mPendingCount;
+        }
+    }
+
+    if (mPendingCount == 0)
+    {
+        logSetupTimes();
+    }
+
+    return mPendingCount == 0;
+}
+
+bool ShaderBatch::isPending() const
+{
+    return mPendingCount > 0;
+}
+
+bool ShaderBatch::isReady(int id) const
+{
+    return id >= 0 && id < int(mEntries.size()) && mEntries[id].status == STATUS_READY;
+}
+
+bool ShaderBatch::isFailed(int id) const
+{
+    return id >= 0 && id < int(mEntries.size()) && mEntries[id].status == STATUS_FAILED;
+}
+
+GLuint ShaderBatch::program(int id) const
+{
+    return (id >= 0 && id < int(mEntries.size())) ? mEntries[id].program : 0;
+}
+
+void ShaderBatch::clear()
+{
+    for (size_t i = 0; i < mEntries.size(); ++i)
+    {
+        releaseShaders(mEntries[i]);
+    }
+    mEntries.clear();
+    mPendingCount = 0;
+}
+
+void ShaderBatch::logSetupTimes() const
+{
+    // Misses take the rest of the time since submit(): their cache
+    // lookups, compiles, links and the binaries stored for them.
+    LOG_INFO("ShaderBatch: %d cache hits in %.2f ms, %d misses compiled in %.2f ms", mCacheHits, mCacheHitMs,
+             mCacheMisses, nowMillis() - mSubmitTime - mCacheHitMs);
+}
+
+bool ShaderBatch::isComplete(const Entry &entry) const
+{
+    if (!mParallelCompile)
+    {
+        // Without the extension any status query blocks anyway.
+        return true;
+    }
+
+    GLint completed(GL_FALSE);
+    glGetProgramiv(entry.program, GL_COMPLETION_STATUS_KHR, &completed);
+    return completed == GL_TRUE;
+}
+
+void ShaderBatch::finalize(Entry &entry)
+{
+    GLint status(GL_FALSE);
+    glGetProgramiv(entry.program, GL_LINK_STATUS, &status);
+
+    if (status == GL_FALSE)
+    {
+        // Only now look at the individual compile results, for the log.
+        GLint compiled(GL_FALSE);
+        glGetShaderiv(entry.vertexShader, GL_COMPILE_STATUS, &compiled);
+        if (compiled == GL_FALSE)
+        {
+            logShaderInfo(entry.vertexShader);
+        }
+        glGetShaderiv(entry.fragShader, GL_COMPILE_STATUS, &compiled);
+        if (compiled == GL_FALSE)
+        {
+            logShaderInfo(entry.fragShader);
+        }
+        logProgramInfo(entry.program, "link");
+
+        LOG_ERROR("Failed to link program: %d", entry.program);
+
+        releaseShaders(entry);
+        glDeleteProgram(entry.program);
+        entry.program = 0;
+        entry.status = STATUS_FAILED;
+        return;
+    }
+
+#ifndef NDEBUG
+    glValidateProgram(entry.program);
+    glGetProgramiv(entry.program, GL_VALIDATE_STATUS, &status);
+    if (status == GL_FALSE)
+    {
+        logProgramInfo(entry.program, "validate");
+    }
+#endif
+
+    releaseShaders(entry);
+
+    ProgramBinaryCache::store(entry.cacheKey, entry.program);
+
+    entry.status = STATUS_READY;
+}
+
+void ShaderBatch::releaseShaders(Entry &entry)
+{
+    if (entry.vertexShader)
+    {
+        if (entry.program)
+        {
+            glDetachShader(entry.program, entry.vertexShader);
+        }
+        glDeleteShader(entry.vertexShader);
+        entry.vertexShader = 0;
+    }
+    if (entry.fragShader)
+    {
+        if (entry.program)
+        {
+            glDetachShader(entry.program, entry.fragShader);
+        }
+        glDeleteShader(entry.fragShader);
+        entry.fragShader = 0;
+    }
+}
@@ -0,0 +1,100 @@
+//
+//  ShaderBatch.h
+//
+//  Submits the compile and link of several programs up front and checks their
+//  status lazily, so the driver can compile them on its own threads
+//  (KHR_parallel_shader_compile) while the render thread keeps going.
+//
+//  Typical use:
+//
+//      int id = batch.add(vertSource, fragSource, attributes);
+//      batch.submit();
+//      ...
+//      // once per frame:
+//      batch.poll();
+//      if (batch.isReady(id)) { glUseProgram(batch.program(id)); ... }
+//
+
+#ifndef ShaderBatch_h
+#define ShaderBatch_h
+
+#define GL_GLEXT_PROTOTYPES
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#include <GLES2/gl2platform.h>
+
+#include <string>
+#include <vector>
+
+class ShaderBatch {
+public:
+    struct Attribute {
+        GLuint index;
+        const char *name;
+    };
+
+    enum ProgramStatus {
+        STATUS_QUEUED = 0,
+        STATUS_COMPILING,
+        STATUS_READY,
+        STATUS_FAILED
+    };
+
+    ShaderBatch();
+    ~ShaderBatch();
+
+    // Queries KHR_parallel_shader_compile. Needs a current context.
+    void initialize();
+
+    // Queues a program. Attribute locations are bound before linking so
+    // vertex arrays can be set up without waiting for the link to finish.
+    // Returns the id used with the queries below.
+    int add(const std::string &vertShaderSource, const std::string &fragShaderSource,
+            const std::vector<Attribute> &attributes, const std::string &defines = std::string());
+
+    // Creates, compiles and links every queued program without querying any
+    // status. Programs found in the ProgramBinaryCache are ready immediately.
+    void submit();
+
+    // Finalizes the programs the driver has finished with. Never blocks when
+    // KHR_parallel_shader_compile is available; without it, the first call
+    // waits for all pending programs. Returns true once nothing is pending.
+    bool poll();
+
+    bool isPending() const;
+    bool isReady(int id) const;
+    bool isFailed(int id) const;
+    GLuint program(int id) const;
+
+    // Forgets all entries. Programs stay alive; their owners delete them.
+    void clear();
+
+private:
+    struct Entry {
+        std::string vertShaderSource;
+        std::string fragShaderSource;
+        std::string defines;
+        std::string cacheKey;
+        std::vector<Attribute> attributes;
+        GLuint vertexShader;
+        GLuint fragShader;
+        GLuint program;
+        ProgramStatus status;
+    };
+
+    bool isComplete(const Entry &entry) const;
+    void finalize(Entry &entry);
+    void releaseShaders(Entry &entry);
+    void logSetupTimes() const;
+
+    std::vector<Entry> mEntries;
+    int mPendingCount;
+    double mSubmitTime;
+    // Of the last submit().
+    int mCacheHits;
+    int mCacheMisses;
+    double mCacheHitMs;
+    bool mParallelCompile;
+};
+
+#endif /* ShaderBatch_h */
@@ -0,0 +1,62 @@
+//
+//  StreamBuffer.cpp
+//
+
+#include "StreamBuffer.h"
+
+StreamBuffer::StreamBuffer()
+        : mTarget(GL_ARRAY_BUFFER), mBuffer(0), mCapacity(0), mOffset(0), mOrphanCount(0), mWriteCount(0)
+{
+}
+
+StreamBuffer::~StreamBuffer()
+{
+}
+
+void StreamBuffer::init(GLenum target, size_t batchSize, unsigned int segments)
+{
+    mTarget = target;
+    mCapacity = batchSize * (segments > 0 ? segments : 1);
+    mOffset = 0;
+
+    glGenBuffers(1, &mBuffer);
+    glBindBuffer(mTarget, mBuffer);
+    glBufferData(mTarget, mCapacity, NULL, GL_STREAM_DRAW);
+
+    resetStats();
+}
+
+void StreamBuffer::destroy()
+{
+    if (mBuffer != 0)
+    {
+        glDeleteBuffers(1, &mBuffer);
+        mBuffer = 0;
+    }
+    mCapacity = 0;
+    mOffset = 0;
+}
+
+size_t StreamBuffer::write(GLCommandBuffer &commands, const void *data, size_t size, size_t alignment)
+{
+    size_t offset = ((mOffset + alignment - 1) / alignment) * alignment;
+    if (offset + size > mCapacity)
+    {
+        // Everything before this point may still be in flight; give the
+        // driver the chance to hand us new storage instead of waiting.
+        commands.bufferData(mTarget, mCapacity, NULL, GL_STREAM_DRAW);
+        offset = 0;
+        ++mOrphanCount;
+    }
+
+    commands.bufferSubData(mTarget, offset, size, data);
+    mOffset = offset + size;
+    ++mWriteCount;
+    return offset;
+}
+
+void StreamBuffer::resetStats()
+{
+    mOrphanCount = 0;
+    mWriteCount = 0;
+}
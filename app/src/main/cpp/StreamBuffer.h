@@ -0,0 +1,55 @@
+//
+//  StreamBuffer.h
+//
+//  A vertex buffer for data rewritten every frame. Writes are appended to a
+//  ring of 'segments' batch-sized slots; when the next write does not fit,
+//  the storage is orphaned (glBufferData with NULL) and writing restarts at
+//  the front. A write therefore never touches bytes a queued draw may still
+//  read, so the driver never has to wait for the GPU, and it only has to
+//  hand out fresh storage once per 'segments' full batches.
+//
+//  Uploads are recorded into a GLCommandBuffer like the draws that use them.
+//
+
+#ifndef StreamBuffer_h
+#define StreamBuffer_h
+
+#include "GLCommandBuffer.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+class StreamBuffer {
+public:
+    StreamBuffer();
+    ~StreamBuffer();
+
+    // Creates the buffer and leaves it bound to 'target'. Render thread,
+    // needs a current context.
+    void init(GLenum target, size_t batchSize, unsigned int segments);
+    void destroy();
+
+    GLuint buffer() const { return mBuffer; }
+    size_t capacity() const { return mCapacity; }
+
+    // Records an upload of 'size' bytes and returns their byte offset, a
+    // multiple of 'alignment' (use the vertex stride, so draws can start at
+    // offset / stride). The buffer has to be bound to the target when the
+    // commands replay.
+    size_t write(GLCommandBuffer &commands, const void *data, size_t size, size_t alignment);
+
+    // Counters since the last call to resetStats().
+    uint32_t orphanCount() const { return mOrphanCount; }
+    uint32_t writeCount() const { return mWriteCount; }
+    void resetStats();
+
+private:
+    GLenum mTarget;
+    GLuint mBuffer;
+    size_t mCapacity;
+    size_t mOffset;
+    uint32_t mOrphanCount;
+    uint32_t mWriteCount;
+};
+
+#endif /* StreamBuffer_h */
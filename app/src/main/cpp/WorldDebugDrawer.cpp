@@ -8,20 +8,23 @@
 
 #define DEBUG_DRAW_IMPLEMENTATION
 #include "WorldDebugDrawer.h"
+#include "Clock.h"
 //#include "Camera.h"
 //#include "SDL.h"
 //#include "ShaderProgram.h"
 //#include "World.h"
+#include "include/glm/gtc/matrix_transform.hpp"
 #include "include/glm/gtc/type_ptr.hpp"
 //#define FORMATSTRING "{\"njli::WorldDebugDrawer\":[]}"
 //#include "ImGuizmo.h"
 //#include "JsonJLI.h"
 //#include "NJLIInterface.h"
 #include "include/glm/glm.hpp"
-#include "Renderer.h"
 //#include "imgui.h"
 //#include "uSynergy.h"
+#include <algorithm>
 #include <string>
+#include <string.h>
 
 //glm::vec3 bulletToGlm(const btVector3 &v)
 //{
@@ -83,75 +86,27 @@
 //namespace njli
 //{
 
-static GLfloat modelView[] = {1.0, 0.0, 0.0, 0.0,
-                              0.0, 1.0, 0.0, 0.0,
-                              0.0, 0.0, 1.0, 0.0,
-                              0.0, 0.0, 0.0, 1.0};
-static GLfloat orthographicProjection[] = {1.0, 0.0, 0.0, 0.0,
-                                           0.0, 1.0, 0.0, 0.0,
-                                           0.0, 0.0, 1.0, 0.0,
-                                           0.0, 0.0, 0.0, 1.0};
-
-//    static const std::string textVertShaderSrc = R"(
-//    #version 100
-//
-//    attribute vec2 in_Position;
-//    attribute vec2 in_TexCoords;
-//    attribute vec3 in_Color;
-//
-//    uniform vec2 u_screenDimensions;
-//
-//    varying vec2 v_TexCoords;
-//    varying vec4 v_Color;
-//
-//    void main()
-//    {
-//        // Map to normalized clip coordinates:
-//        float x = ((2.0 * (in_Position.x - 0.5)) / u_screenDimensions.x) - 1.0;
-//        float y = 1.0 - ((2.0 * (in_Position.y - 0.5)) / u_screenDimensions.y);
-//
-//        gl_Position = vec4(x, y, 0.0, 1.0);
-//        v_TexCoords = in_TexCoords;
-//        v_Color     = vec4(in_Color, 1.0);
-//    }
-//
-//    )";
-//
-//    static const std::string textFragShaderSrc = R"(
-//    #version 100
-//
-//#ifdef GL_ES
-//    precision mediump float;
-//#endif
-//
-//    varying vec2 v_TexCoords;
-//    varying vec4 v_Color;
-//
-//    uniform sampler2D u_glyphTexture;
-//
-//    void main()
-//    {
-//        vec4 out_FragColor = texture2D(u_glyphTexture, v_TexCoords) * v_Color;
-//        gl_FragColor = vec4(1.0, 0, 0, 1.0);
-//    }
-//
-//    )";
-
-    static const std::string linePointVertShaderSource = R"(
+    // Packed vertices carry color and point size as unnormalized bytes.
+    static const std::string linePointVertShaderSource = std::string(
+#if DEBUG_DRAW_PACKED_VERTEX
+    "#define COLOR_SCALE (1.0 / 255.0)\n"
+#else
+    "#define COLOR_SCALE 1.0\n"
+#endif
+    ) + R"(
     
     attribute vec3 in_Position;
     attribute vec4 in_ColorPointSize;
     
-    uniform mat4 modelView;
-    uniform mat4 projection;
+    uniform mat4 u_mvp;
     
     varying vec4 v_Color;
     
     void main()
     {
-        gl_Position  = (modelView * projection) * vec4(in_Position, 1.0);
+        gl_Position  = u_mvp * vec4(in_Position, 1.0);
         gl_PointSize = in_ColorPointSize.w;
-        v_Color      = vec4(in_ColorPointSize.xyz, 1.0);
+        v_Color      = vec4(in_ColorPointSize.xyz * COLOR_SCALE, 1.0);
     }
     
     )";
@@ -172,20 +127,167 @@ static GLfloat orthographicProjection[] = {1.0, 0.0, 0.0, 0.0,
     
     )";
 
+    // One instance of a unit mesh per dd::ShapeInstance: three rows of its
+    // transform and color + param. Cones scale their apex ring (z = 0) by
+    // param; the other meshes get param 1, or sit at z = 1 (circles).
+    static const std::string shapeVertShaderSource = R"(
+    
+    attribute vec3 in_Position;
+    attribute vec4 in_Row0;
+    attribute vec4 in_Row1;
+    attribute vec4 in_Row2;
+    attribute vec4 in_ColorParam;
+    
+    uniform mat4 u_mvp;
+    
+    varying vec4 v_Color;
+    
+    void main()
+    {
+        vec4 local   = vec4(in_Position.xy * mix(in_ColorParam.w, 1.0, in_Position.z), in_Position.z, 1.0);
+        vec3 world   = vec3(dot(in_Row0, local), dot(in_Row1, local), dot(in_Row2, local));
+        gl_Position  = u_mvp * vec4(world, 1.0);
+        v_Color      = vec4(in_ColorParam.xyz, 1.0);
+    }
+    
+    )";
+
+    // dd's glyph quads, in screen pixels with the origin at the top left.
+    // The atlas is luminance only: coverage becomes alpha.
+    static const std::string textVertShaderSource = R"(
+    
+    attribute vec2 in_Position;
+    attribute vec2 in_TexCoords;
+    attribute vec3 in_Color;
+    
+    uniform mat4 u_projection;
+    
+    varying vec2 v_TexCoords;
+    varying vec3 v_Color;
+    
+    void main()
+    {
+        gl_Position = u_projection * vec4(in_Position, 0.0, 1.0);
+        v_TexCoords = in_TexCoords;
+        v_Color     = in_Color;
+    }
+    
+    )";
+
+    static const std::string textFragShaderSource = R"(
+    
+#ifdef GL_ES
+    precision mediump float;
+#endif
+    
+    uniform sampler2D u_glyphTexture;
+    
+    varying vec2 v_TexCoords;
+    varying vec3 v_Color;
+    
+    void main()
+    {
+        gl_FragColor = vec4(v_Color, texture2D(u_glyphTexture, v_TexCoords).r);
+    }
+    
+    )";
+
+    // Bound before linking, so the VAO can be set up while the program compiles.
+    enum {
+        ATTRIB_LINEPOINT_POSITION,
+        ATTRIB_LINEPOINT_COLORPOINTSIZE
+    };
+
+    // in_Position and in_ColorPointSize from the buffer bound to GL_ARRAY_BUFFER.
+    static void setupLinePointAttributes()
+    {
+        glEnableVertexAttribArray(ATTRIB_LINEPOINT_POSITION); // in_Position (vec3)
+        glVertexAttribPointer(ATTRIB_LINEPOINT_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(dd::DrawVertex),
+                              (const GLvoid *)offsetof(dd::DrawVertex, line.x));
+
+        glEnableVertexAttribArray(ATTRIB_LINEPOINT_COLORPOINTSIZE); // in_ColorPointSize (vec4)
+#if DEBUG_DRAW_PACKED_VERTEX
+        glVertexAttribPointer(ATTRIB_LINEPOINT_COLORPOINTSIZE, 4, GL_UNSIGNED_BYTE, GL_FALSE, sizeof(dd::DrawVertex),
+                              (const GLvoid *)offsetof(dd::DrawVertex, point.color));
+#else
+        glVertexAttribPointer(ATTRIB_LINEPOINT_COLORPOINTSIZE, 4, GL_FLOAT, GL_FALSE, sizeof(dd::DrawVertex),
+                              (const GLvoid *)offsetof(dd::DrawVertex, point.r));
+#endif
+    }
+
+    enum {
+        ATTRIB_SHAPE_POSITION,
+        ATTRIB_SHAPE_ROW0,
+        ATTRIB_SHAPE_ROW1,
+        ATTRIB_SHAPE_ROW2,
+        ATTRIB_SHAPE_COLORPARAM
+    };
+
+    enum {
+        ATTRIB_TEXT_POSITION,
+        ATTRIB_TEXT_TEXCOORDS,
+        ATTRIB_TEXT_COLOR
+    };
+
     WorldDebugDrawer::WorldDebugDrawer()
         :
 //        m_DebugMode(btIDebugDraw::DBG_MAX_DEBUG_DRAW_MODE),
           m_Initialized(false),
 //          m_LinePointShaderProgram(NULL),
 //          m_TextShaderProgram(NULL),
+            mShaderBatch(NULL),
+            mLinePointProgramId(-1),
             mLinePointShaderProgram(0),
+            mMvpLocation(-1),
+            mMvpVersion(0),
+            mCommands(NULL),
+            mContext(NULL),
           m_mat4Buffer(new float[16]),
-          m_textMat4Buffer(new float[16]), linePointVAO(0), linePointVBO(0)//,
-//          textVAO(0),
-//          textVBO(0)
+          m_textMat4Buffer(new float[16]), linePointVAO(0),
+            mShapeInstancing(true),
+            mShapeProgramId(-1),
+            mShapeShaderProgram(0),
+            mShapeMvpLocation(-1),
+            mShapeMvpVersion(0),
+            shapeVAO(0),
+            shapeMeshVBO(0),
+            mDrawCallCount(0),
+            mTextProgramId(-1),
+            mTextShaderProgram(0),
+            mTextProjectionLocation(-1),
+            mTextGlyphTextureLocation(-1),
+            mViewportWidth(1),
+            mViewportHeight(1),
+            mTextProjectionPending(false),
+            textVAO(0),
+            mGlyphCacheOffset(0),
+            mGlyphCacheValid(false),
+            mGlyphBatchCount(0),
+            mGlyphUploadCount(0),
+            mGlyphReuseCount(0),
+            mStaticContext(NULL),
+            mStaticPreviousContext(NULL),
+            mRecordingHandle(-1),
+            mCapture(NULL),
+            mViewProjection(1.0f),
+            mViewProjectionVersion(1)
     {
     }
 
+    WorldDebugDrawer::StaticGeometry::StaticGeometry()
+        : vao(0),
+          vbo(0),
+          inUse(false),
+          released(false),
+          uploadPending(false)
+    {
+        for (int range = 0; range < RANGE_COUNT; ++range)
+        {
+            first[range] = 0;
+            count[range] = 0;
+        }
+    }
+
     WorldDebugDrawer::~WorldDebugDrawer()
     {
         delete[] m_textMat4Buffer;
@@ -193,11 +295,20 @@ static GLfloat orthographicProjection[] = {1.0, 0.0, 0.0, 0.0,
 
         glDeleteVertexArraysOES(1, &linePointVAO);
 
-        glDeleteBuffers(1, &linePointVBO);
+        linePointStream.destroy();
 
-//        glDeleteVertexArraysOES(1, &textVAO);
-//
-//        glDeleteBuffers(1, &textVBO);
+        glDeleteVertexArraysOES(1, &shapeVAO);
+        glDeleteBuffers(1, &shapeMeshVBO);
+        shapeStream.destroy();
+
+        glDeleteVertexArraysOES(1, &textVAO);
+        textStream.destroy();
+
+        for (size_t i = 0; i < mStaticGeometry.size(); ++i)
+        {
+            mStaticGeometry[i].released = true;
+        }
+        deleteStaticGeometry();
     }
 
 //    const char *WorldDebugDrawer::getClassName() const
@@ -217,7 +328,17 @@ static GLfloat orthographicProjection[] = {1.0, 0.0, 0.0, 0.0,
 
     void WorldDebugDrawer::beginDraw() { /*newFrameImgui();*/ }
 
-    void WorldDebugDrawer::endDraw() { /*renderImgui();*/ }
+    void WorldDebugDrawer::endDraw()
+    {
+        if (mCapture != NULL)
+        {
+            // Recording static geometry; nothing was drawn.
+            return;
+        }
+        // init() leaves depth testing on; put it back for whatever draws next.
+        mCommands->enable(GL_DEPTH_TEST);
+        /*renderImgui();*/
+    }
 
     void WorldDebugDrawer::drawPointList(const dd::DrawVertex *points,
                                          int count, bool depthEnabled)
@@ -225,54 +346,46 @@ static GLfloat orthographicProjection[] = {1.0, 0.0, 0.0, 0.0,
 //        SDL_assert(points != nullptr);
 //        SDL_assert(count > 0 && count <= DEBUG_DRAW_VERTEX_BUFFER_SIZE);
 
-        glBindVertexArrayOES(linePointVAO);
-
-//        m_LinePointShaderProgram->use();
-        glUseProgram(mLinePointShaderProgram);
+        if (mCapture != NULL)
+        {
+            std::vector<dd::DrawVertex> &range =
+                    mCapture->vertices[depthEnabled ? StaticGeometry::POINTS_DEPTH : StaticGeometry::POINTS_NO_DEPTH];
+            range.insert(range.end(), points, points + count);
+            return;
+        }
 
+        mCommands->bindVertexArray(linePointVAO);
 
+//        m_LinePointShaderProgram->use();
+        mCommands->useProgram(mLinePointShaderProgram);
 
 //        m_Camera->render(m_LinePointShaderProgram, true);
-        GLint modelViewLocation = glGetUniformLocation(mLinePointShaderProgram, "modelView");
-        glUniformMatrix4fv(modelViewLocation, 1, GL_FALSE, modelView);
-
-        GLint projectionLocation = glGetUniformLocation(mLinePointShaderProgram, "projection");
-        glUniformMatrix4fv(projectionLocation, 1, GL_FALSE, orthographicProjection);
-
-        GLboolean _depthEnabled = glIsEnabled(GL_DEPTH_TEST);
+        uploadViewProjection(*mCommands, mMvpLocation, mMvpVersion);
 
         if (depthEnabled)
         {
-            glEnable(GL_DEPTH_TEST);
+            mCommands->enable(GL_DEPTH_TEST);
         }
         else
         {
-            glDisable(GL_DEPTH_TEST);
+            mCommands->disable(GL_DEPTH_TEST);
         }
 
-        // NOTE: Could also use glBufferData to take advantage of the buffer
-        // orphaning trick...
-        glBindBuffer(GL_ARRAY_BUFFER, linePointVBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(dd::DrawVertex),
-                        points);
+        // Appends to the ring instead of overwriting the previous batch,
+        // which the GPU may still be reading.
+        mCommands->bindBuffer(GL_ARRAY_BUFFER, linePointStream.buffer());
+        const size_t offset = linePointStream.write(*mCommands, points, count * sizeof(dd::DrawVertex),
+                                                    sizeof(dd::DrawVertex));
 
         // Issue the draw call:
-        glDrawArrays(GL_POINTS, 0, count);
+        mCommands->drawArrays(GL_POINTS, GLint(offset / sizeof(dd::DrawVertex)), count);
+        ++mDrawCallCount;
 
-        glUseProgram(0);
+        mCommands->useProgram(0);
 
-        glBindVertexArrayOES(0);
+        mCommands->bindVertexArray(0);
 
-        if (_depthEnabled)
-        {
-            glEnable(GL_DEPTH_TEST);
-        }
-        else
-        {
-            glDisable(GL_DEPTH_TEST);
-        }
-
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        mCommands->bindBuffer(GL_ARRAY_BUFFER, 0);
     }
 
     void WorldDebugDrawer::drawLineList(const dd::DrawVertex *lines, int count,
@@ -281,94 +394,243 @@ static GLfloat orthographicProjection[] = {1.0, 0.0, 0.0, 0.0,
         assert(lines != nullptr);
         assert(count > 0 && count <= DEBUG_DRAW_VERTEX_BUFFER_SIZE);
 
-        glBindVertexArrayOES(linePointVAO);
+        if (mCapture != NULL)
+        {
+            std::vector<dd::DrawVertex> &range =
+                    mCapture->vertices[depthEnabled ? StaticGeometry::LINES_DEPTH : StaticGeometry::LINES_NO_DEPTH];
+            range.insert(range.end(), lines, lines + count);
+            return;
+        }
+
+        mCommands->bindVertexArray(linePointVAO);
 
 //        m_LinePointShaderProgram->use();
-        glUseProgram(mLinePointShaderProgram);
+        mCommands->useProgram(mLinePointShaderProgram);
 
 //        m_Camera->render(m_LinePointShaderProgram, true);
-
-        GLint modelViewLocation = glGetUniformLocation(mLinePointShaderProgram, "modelView");
-        glUniformMatrix4fv(modelViewLocation, 1, GL_FALSE, modelView);
-
-        GLint projectionLocation = glGetUniformLocation(mLinePointShaderProgram, "projection");
-        glUniformMatrix4fv(projectionLocation, 1, GL_FALSE, orthographicProjection);
-
-        GLboolean _depthEnabled = glIsEnabled(GL_DEPTH_TEST);
+        uploadViewProjection(*mCommands, mMvpLocation, mMvpVersion);
 
         if (depthEnabled)
         {
-            glEnable(GL_DEPTH_TEST);
+            mCommands->enable(GL_DEPTH_TEST);
         }
         else
         {
-            glDisable(GL_DEPTH_TEST);
+            mCommands->disable(GL_DEPTH_TEST);
         }
 
-        // NOTE: Could also use glBufferData to take advantage of the buffer
-        // orphaning trick...
-        glBindBuffer(GL_ARRAY_BUFFER, linePointVBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(dd::DrawVertex),
-                        lines);
+        // Appends to the ring instead of overwriting the previous batch,
+        // which the GPU may still be reading.
+        mCommands->bindBuffer(GL_ARRAY_BUFFER, linePointStream.buffer());
+        const size_t offset = linePointStream.write(*mCommands, lines, count * sizeof(dd::DrawVertex),
+                                                    sizeof(dd::DrawVertex));
 
         // Issue the draw call:
-        glDrawArrays(GL_LINES, 0, count);
+        mCommands->drawArrays(GL_LINES, GLint(offset / sizeof(dd::DrawVertex)), count);
+        ++mDrawCallCount;
 
-        glUseProgram(0);
+        mCommands->useProgram(0);
 
-        glBindVertexArrayOES(0);
+        mCommands->bindVertexArray(0);
+
+        mCommands->bindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    static bool shapeParamLess(const dd::ShapeInstance &a, const dd::ShapeInstance &b)
+    {
+        return a.param < b.param;
+    }
+
+    bool WorldDebugDrawer::supportsShapeInstances()
+    {
+        // Asked once per context; the static geometry recording context is
+        // the one created while a handle is being recorded.
+        return mShapeInstancing && mRecordingHandle < 0;
+    }
+
+    void WorldDebugDrawer::drawShapeList(dd::ShapeType type, const dd::ShapeInstance *shapes, int count,
+                                         bool depthEnabled)
+    {
+        assert(shapes != nullptr);
+        assert(count > 0 && count <= DEBUG_DRAW_SHAPE_BATCH_SIZE);
 
-        if (_depthEnabled)
+        if (0 == mShapeShaderProgram)
         {
-            glEnable(GL_DEPTH_TEST);
+            // The shape program failed to build; see flushContext().
+            return;
+        }
+
+        mCommands->bindVertexArray(shapeVAO);
+
+        mCommands->useProgram(mShapeShaderProgram);
+
+        uploadViewProjection(*mCommands, mShapeMvpLocation, mShapeMvpVersion);
+
+        if (depthEnabled)
+        {
+            mCommands->enable(GL_DEPTH_TEST);
+        }
+        else
+        {
+            mCommands->disable(GL_DEPTH_TEST);
+        }
+
+        if (GLESCommandBackend::hasInstancing())
+        {
+            if (type == dd::ShapeCircle && !std::is_sorted(shapes, shapes + count, shapeParamLess))
+            {
+                // One draw per step count rather than per change of it.
+                mShapeScratch.assign(shapes, shapes + count);
+                std::stable_sort(mShapeScratch.begin(), mShapeScratch.end(), shapeParamLess);
+                shapes = &mShapeScratch[0];
+            }
+
+            mCommands->bindBuffer(GL_ARRAY_BUFFER, shapeStream.buffer());
+            const size_t offset = shapeStream.write(*mCommands, shapes, count * sizeof(dd::ShapeInstance),
+                                                    sizeof(dd::ShapeInstance));
+
+            for (int first = 0; first < count;)
+            {
+                // Circles with different step counts use different rings of
+                // the mesh; every other type is one draw.
+                int last = count;
+                GLint firstVertex = mShapeFirst[type];
+                GLsizei vertexCount = mShapeVertexCount[type];
+                if (type == dd::ShapeCircle)
+                {
+                    const float steps = shapes[first].param;
+                    last = first + 1;
+                    while (last < count && shapes[last].param == steps)
+                    {
+                        ++last;
+                    }
+                    firstVertex += dd::shapeMeshFirst(int(steps));
+                    vertexCount = GLsizei(steps) * 2;
+                }
+
+                bindShapeInstances(offset + first * sizeof(dd::ShapeInstance));
+                mCommands->drawArraysInstanced(GL_LINES, firstVertex, vertexCount, last - first);
+                ++mDrawCallCount;
+                first = last;
+            }
         }
         else
         {
-            glDisable(GL_DEPTH_TEST);
+            // No instanced arrays: the instance goes in as constant
+            // attributes, one draw per shape.
+            for (int i = 0; i < count; ++i)
+            {
+                const dd::ShapeInstance &shape = shapes[i];
+                GLfloat colorParam[4] = { shape.color[0], shape.color[1], shape.color[2], shape.param };
+                mCommands->vertexAttrib4fv(ATTRIB_SHAPE_ROW0, shape.transform);
+                mCommands->vertexAttrib4fv(ATTRIB_SHAPE_ROW1, shape.transform + 4);
+                mCommands->vertexAttrib4fv(ATTRIB_SHAPE_ROW2, shape.transform + 8);
+                mCommands->vertexAttrib4fv(ATTRIB_SHAPE_COLORPARAM, colorParam);
+
+                GLint firstVertex = mShapeFirst[type];
+                GLsizei vertexCount = mShapeVertexCount[type];
+                if (type == dd::ShapeCircle)
+                {
+                    firstVertex += dd::shapeMeshFirst(int(shape.param));
+                    vertexCount = GLsizei(shape.param) * 2;
+                }
+                mCommands->drawArrays(GL_LINES, firstVertex, vertexCount);
+                ++mDrawCallCount;
+            }
         }
 
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        mCommands->useProgram(0);
+
+        mCommands->bindVertexArray(0);
+
+        mCommands->bindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    void WorldDebugDrawer::bindShapeInstances(size_t offset)
+    {
+        // The rows and color + param are consecutive vec4s of dd::ShapeInstance.
+        for (GLuint i = 0; i < 4; ++i)
+        {
+            mCommands->vertexAttribPointer(ATTRIB_SHAPE_ROW0 + i, 4, GL_FLOAT, GL_FALSE,
+                                           sizeof(dd::ShapeInstance), offset + i * 4 * sizeof(GLfloat));
+            mCommands->vertexAttribDivisor(ATTRIB_SHAPE_ROW0 + i, 1);
+        }
     }
+
     void WorldDebugDrawer::drawGlyphList(const dd::DrawVertex *glyphs,
                                          int count,
                                          dd::GlyphTextureHandle glyphTex)
     {
-//        assert(glyphs != nullptr);
-//        assert(count > 0 && count <= DEBUG_DRAW_VERTEX_BUFFER_SIZE);
-//
-//        glBindVertexArrayOES(textVAO);
-//
-//        m_TextShaderProgram->use();
-//        GLfloat width = njli::World::getInstance()->getViewportDimensions().x();
-//        GLfloat height =
-//            njli::World::getInstance()->getViewportDimensions().y();
-//        m_TextShaderProgram->setUniformValue("u_glyphTexture", (GLuint)0);
-//        m_TextShaderProgram->setUniformValue("u_screenDimensions", width,
-//                                             height);
-//
-//        if (glyphTex != nullptr)
-//        {
-//            glActiveTexture(GL_TEXTURE0);
-//            glBindTexture(
-//                GL_TEXTURE_2D,
-//                static_cast<GLuint>(reinterpret_cast<std::size_t>(glyphTex)));
-//        }
-//
-//        glEnable(GL_BLEND);
-//        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-//        glDisable(GL_DEPTH_TEST);
-//
-//        glBindBuffer(GL_ARRAY_BUFFER, textVBO);
-//        glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(dd::DrawVertex),
-//                        glyphs);
-//
-//        glDrawArrays(GL_TRIANGLES, 0, count); // Issue the draw call
-//
-//        glDisable(GL_BLEND);
-//        glUseProgram(0);
-//        glBindVertexArrayOES(0);
-//        glBindBuffer(GL_ARRAY_BUFFER, 0);
-//        glBindTexture(GL_TEXTURE_2D, 0);
+        assert(glyphs != nullptr);
+        assert(count > 0 && count <= DEBUG_DRAW_VERTEX_BUFFER_SIZE);
+
+        if (0 == mTextShaderProgram || glyphTex == nullptr)
+        {
+            return;
+        }
+
+        mCommands->bindVertexArray(textVAO);
+
+        mCommands->useProgram(mTextShaderProgram);
+
+        // Uniforms stay with the program, so once per frame is enough. The
+        // atlas is always on unit 0; recording that with the projection lets
+        // a capture starting on any frame replay it.
+        if (mTextProjectionPending)
+        {
+            mCommands->uniformMatrix4fv(mTextProjectionLocation, glm::value_ptr(mTextProjection));
+            mCommands->uniform1i(mTextGlyphTextureLocation, 0);
+            mTextProjectionPending = false;
+        }
+
+        mCommands->activeTexture(GL_TEXTURE0);
+        mCommands->bindTexture(GL_TEXTURE_2D, static_cast<GLuint>(reinterpret_cast<std::size_t>(glyphTex)));
+
+        mCommands->enable(GL_BLEND);
+        mCommands->blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        mCommands->disable(GL_DEPTH_TEST);
+
+        mCommands->bindBuffer(GL_ARRAY_BUFFER, textStream.buffer());
+
+        // A stats overlay is mostly the same text frame after frame: if the
+        // batch matches the last upload, which is still where it was put,
+        // draw that again instead of uploading it.
+        const size_t size = count * sizeof(dd::DrawVertex);
+        size_t offset;
+        if (mGlyphBatchCount == 0 && mGlyphCacheValid && mGlyphCache.size() == size_t(count) &&
+            memcmp(&mGlyphCache[0], glyphs, size) == 0)
+        {
+            offset = mGlyphCacheOffset;
+            ++mGlyphReuseCount;
+        }
+        else
+        {
+            offset = textStream.write(*mCommands, glyphs, size, sizeof(dd::DrawVertex));
+            ++mGlyphUploadCount;
+
+            // Only a frame's first batch is kept; any later one may have
+            // orphaned the storage the kept one is in.
+            mGlyphCacheValid = (mGlyphBatchCount == 0);
+            if (mGlyphCacheValid)
+            {
+                mGlyphCache.assign(glyphs, glyphs + count);
+                mGlyphCacheOffset = offset;
+            }
+        }
+        ++mGlyphBatchCount;
+
+        mCommands->drawArrays(GL_TRIANGLES, GLint(offset / sizeof(dd::DrawVertex)), count);
+        ++mDrawCallCount;
+
+        mCommands->disable(GL_BLEND);
+
+        mCommands->bindTexture(GL_TEXTURE_2D, 0);
+
+        mCommands->useProgram(0);
+
+        mCommands->bindVertexArray(0);
+
+        mCommands->bindBuffer(GL_ARRAY_BUFFER, 0);
     }
 
     void WorldDebugDrawer::destroyGlyphTexture(dd::GlyphTextureHandle glyphTex)
@@ -466,13 +728,16 @@ static GLfloat orthographicProjection[] = {1.0, 0.0, 0.0, 0.0,
 //
 //    int WorldDebugDrawer::getDebugMode() const { return m_DebugMode; }
 
-    void WorldDebugDrawer::init()
+    void WorldDebugDrawer::init(ShaderBatch &shaderBatch)
     {
         if (!m_Initialized)
         {
             m_Initialized = true;
 
-            dd::initialize(this);
+            // Made current here so a single drawer works without further
+            // setup; other threads/views call dd::makeCurrent(context()).
+            mContext = dd::createContext(this);
+            dd::makeCurrent(mContext);
 
             glEnable(GL_CULL_FACE);
             glEnable(GL_DEPTH_TEST);
@@ -490,7 +755,31 @@ static GLfloat orthographicProjection[] = {1.0, 0.0, 0.0, 0.0,
 //                                           linePointFragShaderSource);
 //            m_TextShaderProgram->load(textVertShaderSrc, textFragShaderSrc);
 
-            Shader::load(linePointVertShaderSource, linePointFragShaderSource, mLinePointShaderProgram);
+            std::vector<ShaderBatch::Attribute> attributes;
+            attributes.push_back({ATTRIB_LINEPOINT_POSITION, "in_Position"});
+            attributes.push_back({ATTRIB_LINEPOINT_COLORPOINTSIZE, "in_ColorPointSize"});
+            mShaderBatch = &shaderBatch;
+            mLinePointShaderProgram = 0;
+            mLinePointProgramId = shaderBatch.add(linePointVertShaderSource, linePointFragShaderSource, attributes);
+
+            if (mShapeInstancing)
+            {
+                std::vector<ShaderBatch::Attribute> shapeAttributes;
+                shapeAttributes.push_back({ATTRIB_SHAPE_POSITION, "in_Position"});
+                shapeAttributes.push_back({ATTRIB_SHAPE_ROW0, "in_Row0"});
+                shapeAttributes.push_back({ATTRIB_SHAPE_ROW1, "in_Row1"});
+                shapeAttributes.push_back({ATTRIB_SHAPE_ROW2, "in_Row2"});
+                shapeAttributes.push_back({ATTRIB_SHAPE_COLORPARAM, "in_ColorParam"});
+                mShapeShaderProgram = 0;
+                mShapeProgramId = shaderBatch.add(shapeVertShaderSource, linePointFragShaderSource, shapeAttributes);
+            }
+
+            std::vector<ShaderBatch::Attribute> textAttributes;
+            textAttributes.push_back({ATTRIB_TEXT_POSITION, "in_Position"});
+            textAttributes.push_back({ATTRIB_TEXT_TEXCOORDS, "in_TexCoords"});
+            textAttributes.push_back({ATTRIB_TEXT_COLOR, "in_Color"});
+            mTextShaderProgram = 0;
+            mTextProgramId = shaderBatch.add(textVertShaderSource, textFragShaderSource, textAttributes);
 
             setupVertexBuffers();
 
@@ -504,23 +793,69 @@ static GLfloat orthographicProjection[] = {1.0, 0.0, 0.0, 0.0,
         {
             m_Initialized = false;
 
-            if(0 == mLinePointShaderProgram)
+            if(0 != mLinePointShaderProgram)
             {
                 glDeleteProgram(mLinePointShaderProgram);
                 mLinePointShaderProgram = 0;
             }
+            if (0 != mShapeShaderProgram)
+            {
+                glDeleteProgram(mShapeShaderProgram);
+                mShapeShaderProgram = 0;
+            }
+            if (0 != mTextShaderProgram)
+            {
+                glDeleteProgram(mTextShaderProgram);
+                mTextShaderProgram = 0;
+            }
+            mShaderBatch = NULL;
+            mLinePointProgramId = -1;
+            mShapeProgramId = -1;
+            mTextProgramId = -1;
+            mGlyphCacheValid = false;
+
+            if (mRecordingHandle >= 0)
+            {
+                dd::makeCurrent(mStaticPreviousContext);
+                mRecordingHandle = -1;
+            }
+            for (size_t i = 0; i < mStaticGeometry.size(); ++i)
+            {
+                mStaticGeometry[i].released = true;
+            }
+            deleteStaticGeometry();
+            mStaticGeometry.clear();
+            if (mStaticContext != NULL)
+            {
+                dd::destroyContext(mStaticContext);
+                mStaticContext = NULL;
+            }
 
 //            njli::ShaderProgram::destroy(m_TextShaderProgram);
 //            njli::ShaderProgram::destroy(m_LinePointShaderProgram);
 
 //            unInitImgui();
 
-            dd::shutdown();
+            dd::destroyContext(mContext);
+            mContext = NULL;
         }
     }
 
-    void WorldDebugDrawer::draw()//Camera *camera)
+    void WorldDebugDrawer::draw(GLCommandBuffer &commands)//Camera *camera)
     {
+        mDrawCallCount = 0;
+        mGlyphBatchCount = 0;
+        mGlyphUploadCount = 0;
+        mGlyphReuseCount = 0;
+        linePointStream.resetStats();
+
+        // The last frame's commands have been replayed by now.
+        deleteStaticGeometry();
+
+        // dd::screenText() positions are pixels from the top-left corner.
+        mTextProjection = glm::ortho(0.0f, GLfloat(mViewportWidth), GLfloat(mViewportHeight), 0.0f, -1.0f, 1.0f);
+        mTextProjectionPending = true;
+
 //        m_Camera = camera;
 //
 //        if (m_Camera && m_Camera->hasParent())
@@ -529,9 +864,316 @@ static GLfloat orthographicProjection[] = {1.0, 0.0, 0.0, 0.0,
 //                .getOpenGLMatrix(m_textMat4Buffer);
 //        }
 
+        if (mContext == NULL)
+        {
+            return;
+        }
+
+        // dd:: calls act on the thread's current context; flush ours and
+        // leave whichever was current as it was.
+        const dd::ContextHandle previousContext = dd::currentContext();
+        dd::makeCurrent(mContext);
+        flushContext(commands);
+        dd::makeCurrent(previousContext);
+    }
+
+    void WorldDebugDrawer::setViewProjection(const glm::mat4 &projection, const glm::mat4 &view)
+    {
+        setViewProjection(projection * view);
+    }
+
+    void WorldDebugDrawer::setViewProjection(const glm::mat4 &viewProjection)
+    {
+        if (viewProjection != mViewProjection)
+        {
+            mViewProjection = viewProjection;
+            ++mViewProjectionVersion;
+        }
+    }
+
+    void WorldDebugDrawer::uploadViewProjection(GLCommandBuffer &commands, GLint location,
+                                                unsigned int &uploadedVersion)
+    {
+        // Uniforms stay with the program, so only a new matrix is recorded.
+        if (uploadedVersion != mViewProjectionVersion)
+        {
+            commands.uniformMatrix4fv(location, glm::value_ptr(mViewProjection));
+            uploadedVersion = mViewProjectionVersion;
+        }
+    }
+
+    bool WorldDebugDrawer::frameStats(dd::FrameStats &stats) const
+    {
+        const dd::ContextHandle previousContext = dd::currentContext();
+        dd::makeCurrent(mContext);
+        const bool found = dd::getFrameStats(stats);
+        dd::makeCurrent(previousContext);
+        return found;
+    }
+
+    void WorldDebugDrawer::flushContext(GLCommandBuffer &commands)
+    {
+        if (0 == mLinePointShaderProgram)
+        {
+            if (mShaderBatch == NULL || mShaderBatch->isFailed(mLinePointProgramId))
+            {
+                // Nothing will ever draw the queue; don't let it fill up.
+                dd::clear();
+                return;
+            }
+            if (!mShaderBatch->isReady(mLinePointProgramId))
+            {
+                // Still compiling, keep the queue for a later frame.
+                return;
+            }
+            mLinePointShaderProgram = mShaderBatch->program(mLinePointProgramId);
+            mMvpLocation = glGetUniformLocation(mLinePointShaderProgram, "u_mvp");
+            mMvpVersion = 0;
+        }
+
+        if (mShapeProgramId >= 0 && 0 == mShapeShaderProgram)
+        {
+            if (mShaderBatch->isFailed(mShapeProgramId))
+            {
+                // dd already queues shapes as instances for this context;
+                // they are dropped instead of drawn from here on.
+                mShapeProgramId = -1;
+            }
+            else if (!mShaderBatch->isReady(mShapeProgramId))
+            {
+                return;
+            }
+            else
+            {
+                mShapeShaderProgram = mShaderBatch->program(mShapeProgramId);
+                mShapeMvpLocation = glGetUniformLocation(mShapeShaderProgram, "u_mvp");
+                mShapeMvpVersion = 0;
+            }
+        }
+
+        if (mTextProgramId >= 0 && 0 == mTextShaderProgram)
+        {
+            if (mShaderBatch->isFailed(mTextProgramId))
+            {
+                // Text is skipped; the rest still draws.
+                mTextProgramId = -1;
+            }
+            else if (!mShaderBatch->isReady(mTextProgramId))
+            {
+                return;
+            }
+            else
+            {
+                mTextShaderProgram = mShaderBatch->program(mTextProgramId);
+                mTextProjectionLocation = glGetUniformLocation(mTextShaderProgram, "u_projection");
+                mTextGlyphTextureLocation = glGetUniformLocation(mTextShaderProgram, "u_glyphTexture");
+            }
+        }
+
+        drawStaticGeometry(commands);
+
         if (dd::hasPendingDraws())
         {
-            dd::flush(0);
+            // The RenderInterface callbacks record into 'commands', which
+            // copies the vertex batches; dd can reuse its buffer right away.
+            // A real clock, so timed primitives live for their duration
+            // (zero would drop everything after one frame).
+            mCommands = &commands;
+            dd::flush(static_cast<ddI64>(nowMillis()));
+            mCommands = NULL;
+        }
+    }
+
+    int WorldDebugDrawer::beginStaticGeometry(int handle)
+    {
+        if (!m_Initialized || mRecordingHandle >= 0)
+        {
+            return -1;
+        }
+
+        if (handle < 0)
+        {
+            // Slots are reused once draw() has deleted their buffers.
+            handle = 0;
+            while (handle < int(mStaticGeometry.size()) && mStaticGeometry[handle].inUse)
+            {
+                ++handle;
+            }
+            if (handle == int(mStaticGeometry.size()))
+            {
+                mStaticGeometry.push_back(StaticGeometry());
+            }
+            mStaticGeometry[handle] = StaticGeometry();
+            mStaticGeometry[handle].inUse = true;
+        }
+        else if (handle >= int(mStaticGeometry.size()) || !mStaticGeometry[handle].inUse ||
+                 mStaticGeometry[handle].released)
+        {
+            return -1;
+        }
+
+        mRecordingHandle = handle;
+        if (mStaticContext == NULL)
+        {
+            mStaticContext = dd::createContext(this);
+        }
+        mStaticPreviousContext = dd::currentContext();
+        dd::makeCurrent(mStaticContext);
+        return handle;
+    }
+
+    void WorldDebugDrawer::endStaticGeometry()
+    {
+        if (mRecordingHandle < 0)
+        {
+            return;
+        }
+
+        StaticGeometry &geometry = mStaticGeometry[mRecordingHandle];
+        for (int range = 0; range < StaticGeometry::RANGE_COUNT; ++range)
+        {
+            geometry.vertices[range].clear();
+        }
+
+        // drawLineList()/drawPointList() append to 'geometry' instead of
+        // recording draws. At time zero the timed primitives go out once
+        // and are dropped with the rest, and so is the text.
+        mCapture = &geometry;
+        dd::flush(0, dd::FlushLines | dd::FlushPoints);
+        mCapture = NULL;
+        geometry.uploadPending = true;
+
+        dd::makeCurrent(mStaticPreviousContext);
+        mStaticPreviousContext = NULL;
+        mRecordingHandle = -1;
+    }
+
+    void WorldDebugDrawer::releaseStaticGeometry(int handle)
+    {
+        if (handle < 0 || handle >= int(mStaticGeometry.size()) || !mStaticGeometry[handle].inUse ||
+            handle == mRecordingHandle)
+        {
+            return;
+        }
+        StaticGeometry &geometry = mStaticGeometry[handle];
+        geometry.released = true;
+        for (int range = 0; range < StaticGeometry::RANGE_COUNT; ++range)
+        {
+            std::vector<dd::DrawVertex>().swap(geometry.vertices[range]);
+        }
+    }
+
+    void WorldDebugDrawer::deleteStaticGeometry()
+    {
+        for (size_t i = 0; i < mStaticGeometry.size(); ++i)
+        {
+            StaticGeometry &geometry = mStaticGeometry[i];
+            if (geometry.inUse && geometry.released)
+            {
+                glDeleteVertexArraysOES(1, &geometry.vao);
+                glDeleteBuffers(1, &geometry.vbo);
+                geometry = StaticGeometry();
+            }
+        }
+    }
+
+    void WorldDebugDrawer::drawStaticGeometry(GLCommandBuffer &commands)
+    {
+        bool programBound = false;
+        for (size_t i = 0; i < mStaticGeometry.size(); ++i)
+        {
+            StaticGeometry &geometry = mStaticGeometry[i];
+            if (!geometry.inUse || geometry.released)
+            {
+                continue;
+            }
+
+            if (geometry.uploadPending)
+            {
+                geometry.uploadPending = false;
+
+                GLsizei vertexCount = 0;
+                for (int range = 0; range < StaticGeometry::RANGE_COUNT; ++range)
+                {
+                    geometry.first[range] = vertexCount;
+                    geometry.count[range] = GLsizei(geometry.vertices[range].size());
+                    vertexCount += geometry.count[range];
+                }
+
+                if (vertexCount > 0 && 0 == geometry.vbo)
+                {
+                    // Same layout as linePointVAO, on a buffer of its own.
+                    glGenBuffers(1, &geometry.vbo);
+                    glGenVertexArraysOES(1, &geometry.vao);
+                    glBindVertexArrayOES(geometry.vao);
+                    glBindBuffer(GL_ARRAY_BUFFER, geometry.vbo);
+                    setupLinePointAttributes();
+                    glBindVertexArrayOES(0);
+                    glBindBuffer(GL_ARRAY_BUFFER, 0);
+                }
+
+                if (vertexCount > 0)
+                {
+                    // Uploaded once; the CPU copy goes.
+                    commands.bindBuffer(GL_ARRAY_BUFFER, geometry.vbo);
+                    commands.bufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(dd::DrawVertex), NULL, GL_STATIC_DRAW);
+                    for (int range = 0; range < StaticGeometry::RANGE_COUNT; ++range)
+                    {
+                        if (geometry.count[range] > 0)
+                        {
+                            commands.bufferSubData(GL_ARRAY_BUFFER, geometry.first[range] * sizeof(dd::DrawVertex),
+                                                   geometry.count[range] * sizeof(dd::DrawVertex),
+                                                   &geometry.vertices[range][0]);
+                        }
+                    }
+                    commands.bindBuffer(GL_ARRAY_BUFFER, 0);
+                }
+                for (int range = 0; range < StaticGeometry::RANGE_COUNT; ++range)
+                {
+                    std::vector<dd::DrawVertex>().swap(geometry.vertices[range]);
+                }
+            }
+
+            bool vaoBound = false;
+            for (int range = 0; range < StaticGeometry::RANGE_COUNT; ++range)
+            {
+                if (0 == geometry.count[range])
+                {
+                    continue;
+                }
+                if (!programBound)
+                {
+                    commands.useProgram(mLinePointShaderProgram);
+                    uploadViewProjection(commands, mMvpLocation, mMvpVersion);
+                    programBound = true;
+                }
+                if (!vaoBound)
+                {
+                    commands.bindVertexArray(geometry.vao);
+                    vaoBound = true;
+                }
+
+                const bool depthEnabled =
+                        range == StaticGeometry::LINES_DEPTH || range == StaticGeometry::POINTS_DEPTH;
+                if (depthEnabled)
+                {
+                    commands.enable(GL_DEPTH_TEST);
+                }
+                else
+                {
+                    commands.disable(GL_DEPTH_TEST);
+                }
+                commands.drawArrays(range < StaticGeometry::POINTS_DEPTH ? GL_LINES : GL_POINTS,
+                                    geometry.first[range], geometry.count[range]);
+                ++mDrawCallCount;
+            }
+        }
+
+        if (programBound)
+        {
+            commands.useProgram(0);
+            commands.bindVertexArray(0);
+            commands.enable(GL_DEPTH_TEST);
         }
     }
 
@@ -772,14 +1414,11 @@ static GLfloat orthographicProjection[] = {1.0, 0.0, 0.0, 0.0,
         glGenVertexArraysOES(1, &linePointVAO);
         glBindVertexArrayOES(linePointVAO);
         {
-            glGenBuffers(1, &linePointVBO);
-            glBindBuffer(GL_ARRAY_BUFFER, linePointVBO);
             // RenderInterface will never be called with a batch larger than
-            // DEBUG_DRAW_VERTEX_BUFFER_SIZE vertexes, so we can allocate the
-            // same amount here.
-            glBufferData(GL_ARRAY_BUFFER,
-                         DEBUG_DRAW_VERTEX_BUFFER_SIZE * sizeof(dd::DrawVertex),
-                         nullptr, GL_STREAM_DRAW);
+            // DEBUG_DRAW_VERTEX_BUFFER_SIZE vertexes, so that is one segment.
+            linePointStream.init(GL_ARRAY_BUFFER,
+                                 DEBUG_DRAW_VERTEX_BUFFER_SIZE * sizeof(dd::DrawVertex),
+                                 DEBUG_DRAW_STREAM_SEGMENTS);
 
             // Set the vertex format expected by 3D points and lines:
 //            int inPositionAttrib =
@@ -787,91 +1426,121 @@ static GLfloat orthographicProjection[] = {1.0, 0.0, 0.0, 0.0,
 //            int inColorPointSize =
 //                m_LinePointShaderProgram->getAttributeLocation(
 //                    "in_ColorPointSize");
-            GLint inPositionAttrib = glGetAttribLocation(mLinePointShaderProgram, "in_Position");
-            GLint inColorPointSize = glGetAttribLocation(mLinePointShaderProgram, "in_ColorPointSize");
+            setupLinePointAttributes();
+
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+        glBindVertexArrayOES(0);
+
+        if (mShapeInstancing)
+        {
+            setupShapeBuffers();
+        }
 
-            glEnableVertexAttribArray(inPositionAttrib); // in_Position (vec3)
+        //
+        // Text rendering vertex buffer:
+        //
+        glGenVertexArraysOES(1, &textVAO);
+        glBindVertexArrayOES(textVAO);
+        {
+            // Text comes in one batch per flush unless it overflows
+            // DEBUG_DRAW_VERTEX_BUFFER_SIZE vertexes.
+            textStream.init(GL_ARRAY_BUFFER,
+                            DEBUG_DRAW_VERTEX_BUFFER_SIZE * sizeof(dd::DrawVertex),
+                            DEBUG_DRAW_STREAM_SEGMENTS);
+
+            // Set the vertex format expected by the 2D text:
+            glEnableVertexAttribArray(ATTRIB_TEXT_POSITION); // in_Position (vec2)
             glVertexAttribPointer(
-                /* index     = */ inPositionAttrib,
-                /* size      = */ 3,
+                /* index     = */ ATTRIB_TEXT_POSITION,
+                /* size      = */ 2,
                 /* type      = */ GL_FLOAT,
                 /* normalize = */ GL_FALSE,
                 /* stride    = */ sizeof(dd::DrawVertex),
                 /* offset    = */
-                (const GLvoid *)offsetof(dd::DrawVertex, line.x));
+                (const GLvoid *)offsetof(dd::DrawVertex, glyph.x));
+
+#if DEBUG_DRAW_PACKED_VERTEX
+            // Texture coordinates are 16-bit and colors 8-bit normalized.
+            const GLenum texCoordType = GL_UNSIGNED_SHORT;
+            const GLenum colorType = GL_UNSIGNED_BYTE;
+            const GLboolean packedNormalize = GL_TRUE;
+            const size_t colorOffset = offsetof(dd::DrawVertex, glyph.color);
+#else
+            const GLenum texCoordType = GL_FLOAT;
+            const GLenum colorType = GL_FLOAT;
+            const GLboolean packedNormalize = GL_FALSE;
+            const size_t colorOffset = offsetof(dd::DrawVertex, glyph.r);
+#endif
 
-            glEnableVertexAttribArray(
-                inColorPointSize); // in_ColorPointSize (vec4)
+            glEnableVertexAttribArray(ATTRIB_TEXT_TEXCOORDS); // in_TexCoords (vec2)
             glVertexAttribPointer(
-                /* index     = */ inColorPointSize,
-                /* size      = */ 4,
-                /* type      = */ GL_FLOAT,
-                /* normalize = */ GL_FALSE,
+                /* index     = */ ATTRIB_TEXT_TEXCOORDS,
+                /* size      = */ 2,
+                /* type      = */ texCoordType,
+                /* normalize = */ packedNormalize,
+                /* stride    = */ sizeof(dd::DrawVertex),
+                /* offset    = */
+                (const GLvoid *)offsetof(dd::DrawVertex, glyph.u));
+
+            glEnableVertexAttribArray(ATTRIB_TEXT_COLOR); // in_Color (vec3)
+            glVertexAttribPointer(
+                /* index     = */ ATTRIB_TEXT_COLOR,
+                /* size      = */ 3,
+                /* type      = */ colorType,
+                /* normalize = */ packedNormalize,
                 /* stride    = */ sizeof(dd::DrawVertex),
                 /* offset    = */
-                (const GLvoid *)offsetof(dd::DrawVertex, line.r));
+                (const GLvoid *)colorOffset);
 
             glBindBuffer(GL_ARRAY_BUFFER, 0);
         }
         glBindVertexArrayOES(0);
+    }
 
-        //
-        // Text rendering vertex buffer:
-        //
-//        glGenVertexArraysOES(1, &textVAO);
-//        glBindVertexArrayOES(textVAO);
-//        {
-//            glGenBuffers(1, &textVBO);
-//            glBindBuffer(GL_ARRAY_BUFFER, textVBO);
-//
-//            // NOTE: A more optimized implementation might consider combining
-//            // both the lines/points and text buffers to save some memory!
-//            glBufferData(GL_ARRAY_BUFFER,
-//                         DEBUG_DRAW_VERTEX_BUFFER_SIZE * sizeof(dd::DrawVertex),
-//                         nullptr, GL_STREAM_DRAW);
-//
-//            // Set the vertex format expected by the 2D text:
-//            std::size_t offset = 0;
-//
-//            int in_Position =
-//                m_TextShaderProgram->getAttributeLocation("in_Position");
-//            int in_TexCoords =
-//                m_TextShaderProgram->getAttributeLocation("in_TexCoords");
-//            int in_Color =
-//                m_TextShaderProgram->getAttributeLocation("in_Color");
-//
-//            glEnableVertexAttribArray(in_Position); // in_Position (vec2)
-//            glVertexAttribPointer(
-//                /* index     = */ in_Position,
-//                /* size      = */ 2,
-//                /* type      = */ GL_FLOAT,
-//                /* normalize = */ GL_FALSE,
-//                /* stride    = */ sizeof(dd::DrawVertex),
-//                /* offset    = */ (const GLvoid *)offset);
-//            offset += sizeof(float) * 2;
-//
-//            glEnableVertexAttribArray(in_TexCoords); // in_TexCoords (vec2)
-//            glVertexAttribPointer(
-//                /* index     = */ in_TexCoords,
-//                /* size      = */ 2,
-//                /* type      = */ GL_FLOAT,
-//                /* normalize = */ GL_FALSE,
-//                /* stride    = */ sizeof(dd::DrawVertex),
-//                /* offset    = */ (const GLvoid *)offset);
-//            offset += sizeof(float) * 2;
-//
-//            glEnableVertexAttribArray(in_Color); // in_Color (vec4)
-//            glVertexAttribPointer(
-//                /* index     = */ in_Color,
-//                /* size      = */ 3,
-//                /* type      = */ GL_FLOAT,
-//                /* normalize = */ GL_FALSE,
-//                /* stride    = */ sizeof(dd::DrawVertex),
-//                /* offset    = */ (const GLvoid *)offset);
-//
-//            glBindBuffer(GL_ARRAY_BUFFER, 0);
-//        }
-//        glBindVertexArrayOES(0);
+    void WorldDebugDrawer::setupShapeBuffers()
+    {
+        // The unit meshes, back to back, uploaded once:
+        GLsizei vertexCount = 0;
+        for (int type = 0; type < dd::ShapeTypeCount; ++type)
+        {
+            mShapeFirst[type] = vertexCount;
+            mShapeVertexCount[type] = dd::shapeMesh(dd::ShapeType(type), NULL);
+            vertexCount += mShapeVertexCount[type];
+        }
+        std::vector<GLfloat> positions(vertexCount * 3);
+        for (int type = 0; type < dd::ShapeTypeCount; ++type)
+        {
+            dd::shapeMesh(dd::ShapeType(type), &positions[mShapeFirst[type] * 3]);
+        }
+
+        glGenVertexArraysOES(1, &shapeVAO);
+        glBindVertexArrayOES(shapeVAO);
+        {
+            glGenBuffers(1, &shapeMeshVBO);
+            glBindBuffer(GL_ARRAY_BUFFER, shapeMeshVBO);
+            glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(GLfloat), &positions[0], GL_STATIC_DRAW);
+
+            glEnableVertexAttribArray(ATTRIB_SHAPE_POSITION); // in_Position (vec3)
+            glVertexAttribPointer(ATTRIB_SHAPE_POSITION, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (const GLvoid *)0);
+
+            // Per-instance attributes come from the stream, pointed at each
+            // batch by bindShapeInstances(). Without instancing they stay
+            // disabled and drawShapeList() sets them as constants.
+            shapeStream.init(GL_ARRAY_BUFFER,
+                             DEBUG_DRAW_SHAPE_BATCH_SIZE * sizeof(dd::ShapeInstance),
+                             DEBUG_DRAW_STREAM_SEGMENTS);
+            if (GLESCommandBackend::hasInstancing())
+            {
+                for (GLuint i = ATTRIB_SHAPE_ROW0; i <= ATTRIB_SHAPE_COLORPARAM; ++i)
+                {
+                    glEnableVertexAttribArray(i);
+                }
+            }
+
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+        glBindVertexArrayOES(0);
     }
 
     // From Carbon HIToolbox/Events.h
@@ -17,12 +17,54 @@
 //#include "GraphicsPlatform.h"
 //#include "Util.h"
 //#include "btIDebugDraw.h"
+
+// Vertices dd batches before calling drawLineList()/drawPointList(). Big
+// enough that a heavy frame of debug lines (32k) goes out in one draw per
+// depth mode; text needs a buffer of this many vertices (16 bytes each
+// packed, 28 not).
+#ifndef DEBUG_DRAW_VERTEX_BUFFER_SIZE
+#define DEBUG_DRAW_VERTEX_BUFFER_SIZE 65536
+#endif
+
+// dd::DrawVertex with RGBA8 colors (point size in A) and 16-bit texture
+// coordinates: 16 bytes a vertex uploaded instead of 28.
+#ifndef DEBUG_DRAW_PACKED_VERTEX
+#define DEBUG_DRAW_PACKED_VERTEX 1
+#endif
+
+// Hard cap of the growable line queue. Queues only grow this far during a
+// burst (a navmesh or a physics broadphase dump) and shrink back after.
+#ifndef DEBUG_DRAW_MAX_LINES
+#define DEBUG_DRAW_MAX_LINES 262144
+#endif
+
+// Drops are counted in dd::getFrameStats() and logged once per frame.
+#ifndef DEBUG_DRAW_OVERFLOWED
+#include <android/log.h>
+#define DEBUG_DRAW_OVERFLOWED(message) __android_log_print(ANDROID_LOG_WARN, "EglSample", "%s", message)
+#endif
+
+// Batches the line/point StreamBuffer holds before it orphans its storage.
+#ifndef DEBUG_DRAW_STREAM_SEGMENTS
+#define DEBUG_DRAW_STREAM_SEGMENTS 3
+#endif
+
+// Lets physics/AI/streaming threads call dd:: directly (with the drawer's
+// context current); their submissions are merged by draw().
+#ifndef DEBUG_DRAW_THREAD_QUEUES
+#define DEBUG_DRAW_THREAD_QUEUES 1
+#endif
+
 #include "debug_draw.hpp"
 #include "glm/glm.hpp"
+#include "ShaderBatch.h"
+#include "GLCommandBuffer.h"
+#include "StreamBuffer.h"
 //#if defined(USE_USYNERGY_LIBRARY)
 //#include "uSynergy.h"
 //#endif
 #include <thread>
+#include <vector>
 //#include "SDL.h"
 
 //namespace njli
@@ -44,6 +86,8 @@
     virtual void drawLineList(const dd::DrawVertex *, int, bool);
     virtual void drawGlyphList(const dd::DrawVertex *, int,
                                dd::GlyphTextureHandle);
+    virtual bool supportsShapeInstances();
+    virtual void drawShapeList(dd::ShapeType, const dd::ShapeInstance *, int, bool);
     virtual void destroyGlyphTexture(dd::GlyphTextureHandle);
     virtual dd::GlyphTextureHandle createGlyphTexture(int, int, const void *);
 
@@ -58,9 +102,62 @@
 //    virtual int getDebugMode() const;
 
      inline bool isInitialized()const{return m_Initialized;}
-    void init();
+    // Queues the line/point program on 'shaderBatch'; drawing starts once
+    // the batch reports it ready.
+    void init(ShaderBatch &shaderBatch);
     void unInit();
-    void draw();//Camera *camera);
+    // Spheres, cones, circles and boxes are drawn as instances of unit
+    // meshes uploaded at init() (the default), or expanded to lines by dd
+    // when off. Set before init(). Instanced draws need
+    // GLESCommandBackend::initialize() to have run first; without instanced
+    // arrays each shape is its own draw.
+    void setShapeInstancing(bool enabled) { mShapeInstancing = enabled; }
+    // The camera lines, points and shapes are drawn with, world space to
+    // clip space; identity (dd coordinates are clip space) until set. The
+    // product is taken here, once, and uploaded only when it changes. For
+    // culling as well, pass the same matrix to dd::setCullFrustum().
+    void setViewProjection(const glm::mat4 &projection, const glm::mat4 &view);
+    void setViewProjection(const glm::mat4 &viewProjection);
+    // Size in pixels of the surface dd::screenText() positions are on.
+    // The text projection is built from it once per draw().
+    void setViewport(GLsizei width, GLsizei height) { mViewportWidth = width; mViewportHeight = height; }
+    // Records the queued debug primitives into 'commands'. Call on the
+    // thread that called init(); drawers on different threads can draw in
+    // parallel.
+    void draw(GLCommandBuffer &commands);//Camera *camera);
+
+    // This drawer's debug-draw context. Make it current (dd::makeCurrent)
+    // on any thread that adds dd:: primitives for this drawer; init() makes
+    // it current on its own thread.
+    dd::ContextHandle context() const { return mContext; }
+
+    // Statistics of the last draw().
+    unsigned int drawCallCount() const { return mDrawCallCount; }
+    unsigned int streamOrphanCount() const { return linePointStream.orphanCount(); }
+    // Glyph batches of the last draw() that were uploaded, and that were
+    // drawn again from the previous upload because nothing had changed.
+    unsigned int glyphUploadCount() const { return mGlyphUploadCount; }
+    unsigned int glyphReuseCount() const { return mGlyphReuseCount; }
+    // Queue high-water marks, capacities and drops (dd::getFrameStats()).
+    bool frameStats(dd::FrameStats &stats) const;
+
+    // Retained debug geometry, for overlays that never change (grids, world
+    // axes, static bounds). dd:: lines and points queued between
+    // beginStaticGeometry() and endStaticGeometry() are uploaded once, by the
+    // next draw(), to a vertex buffer of their own, and every draw() after
+    // that redraws them with one draw call per primitive and depth mode
+    // until the handle is released. Shapes are expanded to lines; text and
+    // durations are ignored.
+    //
+    // beginStaticGeometry() makes a recording context current on the calling
+    // thread and returns the handle being recorded: a new one for -1, or
+    // 'handle', whose contents are replaced when the recording ends.
+    // endStaticGeometry() puts back the context that was current. Call both
+    // on the draw() thread, after init(); unInit() releases every handle.
+    int beginStaticGeometry(int handle = -1);
+    void endStaticGeometry();
+    // The buffer is deleted by the next draw(), once nothing uses it.
+    void releaseStaticGeometry(int handle);
 
     /**
      Add a point in 3D space to the debug draw queue.
@@ -356,6 +453,17 @@
 
   protected:
     void setupVertexBuffers();
+    void setupShapeBuffers();
+    // Points the shape VAO's per-instance attributes at 'offset' in shapeStream.
+    void bindShapeInstances(size_t offset);
+    // draw() with mContext current.
+    void flushContext(GLCommandBuffer &commands);
+    // Records u_mvp for the bound program if it hasn't seen the current
+    // view-projection yet.
+    void uploadViewProjection(GLCommandBuffer &commands, GLint location, unsigned int &uploadedVersion);
+    // Uploads and draws the retained geometry, deletes the released.
+    void drawStaticGeometry(GLCommandBuffer &commands);
+    void deleteStaticGeometry();
 
 //    void initImgui();
 //    void unInitImgui();
@@ -371,16 +479,88 @@
 //      ShaderProgram *m_LinePointShaderProgram;
 //      ShaderProgram *m_TextShaderProgram;
 
+    ShaderBatch *mShaderBatch;
+    int mLinePointProgramId;
     GLuint mLinePointShaderProgram;
+    GLint mMvpLocation;
+    // mViewProjectionVersion the program's u_mvp holds.
+    unsigned int mMvpVersion;
+
+    // Only set while dd::flush() runs inside draw().
+    GLCommandBuffer *mCommands;
+
+    dd::ContextHandle mContext;
 
       GLfloat *m_mat4Buffer;
       GLfloat *m_textMat4Buffer;
 
     GLuint linePointVAO;
-    GLuint linePointVBO;
-
-//    GLuint textVAO;
-//    GLuint textVBO;
+    StreamBuffer linePointStream;
+
+    bool mShapeInstancing;
+    int mShapeProgramId;
+    GLuint mShapeShaderProgram;
+    GLint mShapeMvpLocation;
+    unsigned int mShapeMvpVersion;
+    // Every unit mesh in one static buffer, dd::ShapeType ranges of GL_LINES vertices.
+    GLuint shapeVAO;
+    GLuint shapeMeshVBO;
+    GLint mShapeFirst[dd::ShapeTypeCount];
+    GLsizei mShapeVertexCount[dd::ShapeTypeCount];
+    StreamBuffer shapeStream;
+    std::vector<dd::ShapeInstance> mShapeScratch;
+    unsigned int mDrawCallCount;
+
+    int mTextProgramId;
+    GLuint mTextShaderProgram;
+    GLint mTextProjectionLocation;
+    GLint mTextGlyphTextureLocation;
+    GLsizei mViewportWidth;
+    GLsizei mViewportHeight;
+    // Screen pixels to clip space, rebuilt by draw() and uploaded with the
+    // frame's first glyph batch.
+    glm::mat4 mTextProjection;
+    bool mTextProjectionPending;
+    GLuint textVAO;
+    StreamBuffer textStream;
+    // The first glyph batch of the last frame that had text, and where it
+    // sits in textStream. Valid until anything else is written there.
+    std::vector<dd::DrawVertex> mGlyphCache;
+    size_t mGlyphCacheOffset;
+    bool mGlyphCacheValid;
+    unsigned int mGlyphBatchCount;
+    unsigned int mGlyphUploadCount;
+    unsigned int mGlyphReuseCount;
+
+    // One beginStaticGeometry() handle: a VBO of GL_LINES and GL_POINTS
+    // ranges, with a VAO pointing the line/point attributes at it.
+    struct StaticGeometry {
+        enum { LINES_DEPTH, LINES_NO_DEPTH, POINTS_DEPTH, POINTS_NO_DEPTH, RANGE_COUNT };
+        StaticGeometry();
+        // What the recording flush produced, until draw() uploads it.
+        std::vector<dd::DrawVertex> vertices[RANGE_COUNT];
+        GLint first[RANGE_COUNT];
+        GLsizei count[RANGE_COUNT];
+        GLuint vao;
+        GLuint vbo;
+        bool inUse;
+        bool released;
+        bool uploadPending;
+    };
+    std::vector<StaticGeometry> mStaticGeometry;
+    // Shapes can't be instanced into a static buffer, so this context has
+    // dd expand them; created by the first beginStaticGeometry().
+    dd::ContextHandle mStaticContext;
+    dd::ContextHandle mStaticPreviousContext;
+    // The handle between beginStaticGeometry() and endStaticGeometry(), and
+    // the geometry drawLineList()/drawPointList() append to while the
+    // recording context flushes.
+    int mRecordingHandle;
+    StaticGeometry *mCapture;
+
+    glm::mat4 mViewProjection;
+    // Bumped by every setViewProjection() that changes the matrix.
+    unsigned int mViewProjectionVersion;
 
 //#if defined(USE_USYNERGY_LIBRARY)
 //    uSynergyContext _synergyCtx;
@@ -0,0 +1,415 @@
+//
+//  FastMath.h
+//
+//  Float approximations of rsqrt, sin, cos, atan2 and exp with stated
+//  maximum errors, in a scalar form and in 4- and 8-wide forms that take
+//  and return the native vector types:
+//
+//      float        FastMath::sin(float)
+//      __m128       FastMath::sin(__m128)         when built with SSE2
+//      float32x4_t  FastMath::sin(float32x4_t)    when built with NEON
+//      __m256       FastMath::sin(__m256)         when built with AVX2
+//
+//  All forms run the same range reduction and polynomials (Cephes' single
+//  precision minimax fits) in the same order. rsqrt starts from the
+//  hardware estimate where there is one and refines it with Newton steps.
+//
+//  Maximum errors, the constants below, are what an exhaustive run of
+//  tools/fastmath_accuracy measured over every float, rounded up:
+//
+//      rsqrt(x)        x in [FLT_MIN, FLT_MAX]         relative  4.8e-6, 3.0e-7 SIMD
+//      sin(x), cos(x)  |x| <= SIN_COS_MAX_ARGUMENT     absolute  1.0e-7
+//      atan2(y, x)     finite, not both zero           absolute  3.0e-7 radians
+//      exp(x)          x in [EXP_MIN_ARGUMENT,         relative  1.0e-7
+//                            EXP_MAX_ARGUMENT]
+//
+//  Outside those: rsqrt of 0, negatives and denormals, and sin/cos of
+//  larger arguments, are unspecified but never trap; exp returns +inf above
+//  the range and 0 below it; atan2 returns 0 for (0, 0) and does not tell
+//  -0 from +0. NaN inputs are not supported. ARMv7 NEON flushes denormals
+//  and has no divide, so the 4-wide atan2 there also needs the larger of
+//  |x| and |y| in [FLT_MIN, 2^126].
+//
+//  Needs no libm. Everything has internal linkage: a file built with -mavx2
+//  must not share out-of-line copies with files built without it.
+//
+
+#ifndef FastMath_h
+#define FastMath_h
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FASTMATH_SSE2 1
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define FASTMATH_AVX2 1
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define FASTMATH_NEON 1
+#endif
+
+namespace FastMath {
+
+static const float RSQRT_MAX_RELATIVE_ERROR = 4.8e-6f;
+static const float RSQRT_SIMD_MAX_RELATIVE_ERROR = 3.0e-7f;
+static const float SIN_COS_MAX_ARGUMENT = 8192.0f;
+static const float SIN_COS_MAX_ABSOLUTE_ERROR = 1.0e-7f;
+static const float ATAN2_MAX_ABSOLUTE_ERROR = 3.0e-7f;
+static const float EXP_MIN_ARGUMENT = -87.33654f;
+static const float EXP_MAX_ARGUMENT = 88.37626f;
+static const float EXP_MAX_RELATIVE_ERROR = 1.0e-7f;
+
+namespace detail {
+
+//
+// One struct per instruction set with the operations the functions below
+// are written in. V is the float vector, I the int32 vector and M a lane
+// mask.
+//
+
+struct ScalarOps {
+    typedef float V;
+    typedef int32_t I;
+    typedef bool M;
+    static const int RSQRT_STEPS = 2;
+
+    static inline uint32_t bits(V a)
+    {
+        uint32_t b;
+        memcpy(&b, &a, sizeof(b));
+        return b;
+    }
+
+    static inline V fromBits(uint32_t b)
+    {
+        V a;
+        memcpy(&a, &b, sizeof(a));
+        return a;
+    }
+
+    static inline V set1(float f) { return f; }
+    static inline V add(V a, V b) { return a + b; }
+    static inline V sub(V a, V b) { return a - b; }
+    static inline V mul(V a, V b) { return a * b; }
+    static inline V div(V a, V b) { return a / b; }
+    static inline V min(V a, V b) { return a < b ? a : b; }
+    static inline V max(V a, V b) { return a > b ? a : b; }
+    static inline M lt(V a, V b) { return a < b; }
+    static inline M gt(V a, V b) { return a > b; }
+    static inline V select(M m, V a, V b) { return m ? a : b; }
+    static inline V abs(V a) { return fromBits(bits(a) & 0x7FFFFFFFu); }
+
+    // Nearest, ties away from zero. Clamped, since converting an out of
+    // range float is undefined in C++ (SIMD conversions saturate instead).
+    static inline I roundToInt(V a)
+    {
+        a = min(max(a, -2.0e9f), 2.0e9f);
+        return static_cast<I>(a + fromBits((bits(a) & 0x80000000u) | 0x3F000000u));
+    }
+
+    static inline V toFloat(I i) { return static_cast<V>(i); }
+    static inline I addInt(I i, int32_t n) { return i + n; }
+    static inline M bitSet(I i, int32_t bit) { return (i & bit) != 0; }
+
+    // 2^n for n in [-126, 127].
+    static inline V pow2(I n) { return fromBits(static_cast<uint32_t>(n + 127) << 23); }
+
+    // Lomont's constant for the Quake III estimate, 3.4e-2 relative error.
+    static inline V rsqrtEstimate(V a) { return fromBits(0x5F375A86u - (bits(a) >> 1)); }
+};
+
+#if FASTMATH_SSE2
+struct Sse2Ops {
+    typedef __m128 V;
+    typedef __m128i I;
+    typedef __m128 M;
+    // _mm_rsqrt_ps is good to 1.5 * 2^-12.
+    static const int RSQRT_STEPS = 1;
+
+    static inline V set1(float f) { return _mm_set1_ps(f); }
+    static inline V add(V a, V b) { return _mm_add_ps(a, b); }
+    static inline V sub(V a, V b) { return _mm_sub_ps(a, b); }
+    static inline V mul(V a, V b) { return _mm_mul_ps(a, b); }
+    static inline V div(V a, V b) { return _mm_div_ps(a, b); }
+    static inline V min(V a, V b) { return _mm_min_ps(a, b); }
+    static inline V max(V a, V b) { return _mm_max_ps(a, b); }
+    static inline M lt(V a, V b) { return _mm_cmplt_ps(a, b); }
+    static inline M gt(V a, V b) { return _mm_cmpgt_ps(a, b); }
+    static inline V select(M m, V a, V b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+    static inline V abs(V a) { return _mm_and_ps(a, _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF))); }
+    static inline I roundToInt(V a) { return _mm_cvtps_epi32(a); }
+    static inline V toFloat(I i) { return _mm_cvtepi32_ps(i); }
+    static inline I addInt(I i, int32_t n) { return _mm_add_epi32(i, _mm_set1_epi32(n)); }
+
+    static inline M bitSet(I i, int32_t bit)
+    {
+        const __m128i b = _mm_set1_epi32(bit);
+        return _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(i, b), b));
+    }
+
+    static inline V pow2(I n) { return _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(n, _mm_set1_epi32(127)), 23)); }
+    static inline V rsqrtEstimate(V a) { return _mm_rsqrt_ps(a); }
+};
+#endif // FASTMATH_SSE2
+
+#if FASTMATH_AVX2
+struct Avx2Ops {
+    typedef __m256 V;
+    typedef __m256i I;
+    typedef __m256 M;
+    static const int RSQRT_STEPS = 1;
+
+    static inline V set1(float f) { return _mm256_set1_ps(f); }
+    static inline V add(V a, V b) { return _mm256_add_ps(a, b); }
+    static inline V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+    static inline V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+    static inline V div(V a, V b) { return _mm256_div_ps(a, b); }
+    static inline V min(V a, V b) { return _mm256_min_ps(a, b); }
+    static inline V max(V a, V b) { return _mm256_max_ps(a, b); }
+    static inline M lt(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static inline M gt(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    static inline V select(M m, V a, V b) { return _mm256_blendv_ps(b, a, m); }
+    static inline V abs(V a) { return _mm256_and_ps(a, _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF))); }
+    static inline I roundToInt(V a) { return _mm256_cvtps_epi32(a); }
+    static inline V toFloat(I i) { return _mm256_cvtepi32_ps(i); }
+    static inline I addInt(I i, int32_t n) { return _mm256_add_epi32(i, _mm256_set1_epi32(n)); }
+
+    static inline M bitSet(I i, int32_t bit)
+    {
+        const __m256i b = _mm256_set1_epi32(bit);
+        return _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(i, b), b));
+    }
+
+    static inline V pow2(I n)
+    {
+        return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(n, _mm256_set1_epi32(127)), 23));
+    }
+
+    static inline V rsqrtEstimate(V a) { return _mm256_rsqrt_ps(a); }
+};
+#endif // FASTMATH_AVX2
+
+#if FASTMATH_NEON
+struct NeonOps {
+    typedef float32x4_t V;
+    typedef int32x4_t I;
+    typedef uint32x4_t M;
+    // vrsqrteq_f32 is only good to about 2^-8.
+    static const int RSQRT_STEPS = 2;
+
+    static inline V set1(float f) { return vdupq_n_f32(f); }
+    static inline V add(V a, V b) { return vaddq_f32(a, b); }
+    static inline V sub(V a, V b) { return vsubq_f32(a, b); }
+    static inline V mul(V a, V b) { return vmulq_f32(a, b); }
+    static inline V min(V a, V b) { return vminq_f32(a, b); }
+    static inline V max(V a, V b) { return vmaxq_f32(a, b); }
+    static inline M lt(V a, V b) { return vcltq_f32(a, b); }
+    static inline M gt(V a, V b) { return vcgtq_f32(a, b); }
+    static inline V select(M m, V a, V b) { return vbslq_f32(m, a, b); }
+    static inline V abs(V a) { return vabsq_f32(a); }
+    static inline V toFloat(I i) { return vcvtq_f32_s32(i); }
+    static inline I addInt(I i, int32_t n) { return vaddq_s32(i, vdupq_n_s32(n)); }
+    static inline M bitSet(I i, int32_t bit) { return vtstq_s32(i, vdupq_n_s32(bit)); }
+    static inline V pow2(I n) { return vreinterpretq_f32_s32(vshlq_n_s32(vaddq_s32(n, vdupq_n_s32(127)), 23)); }
+    static inline V rsqrtEstimate(V a) { return vrsqrteq_f32(a); }
+
+    static inline V div(V a, V b)
+    {
+#if defined(__aarch64__)
+        return vdivq_f32(a, b);
+#else
+        // ARMv7 has no vector divide: refine the estimate twice.
+        V r = vrecpeq_f32(b);
+        r = vmulq_f32(vrecpsq_f32(b, r), r);
+        r = vmulq_f32(vrecpsq_f32(b, r), r);
+        return vmulq_f32(a, r);
+#endif
+    }
+
+    static inline I roundToInt(V a)
+    {
+#if defined(__aarch64__)
+        return vcvtnq_s32_f32(a);
+#else
+        // Truncation after adding 0.5 with the sign of 'a'.
+        const uint32x4_t sign = vandq_u32(vreinterpretq_u32_f32(a), vdupq_n_u32(0x80000000u));
+        const V half = vreinterpretq_f32_u32(vorrq_u32(sign, vreinterpretq_u32_f32(vdupq_n_f32(0.5f))));
+        return vcvtq_s32_f32(vaddq_f32(a, half));
+#endif
+    }
+};
+#endif // FASTMATH_NEON
+
+//
+// The functions, once for every set of operations.
+//
+
+template<class S>
+static inline typename S::V rsqrt(typename S::V x)
+{
+    typedef typename S::V V;
+    const V halfX = S::mul(S::set1(0.5f), x);
+    V r = S::rsqrtEstimate(x);
+    for (int step = 0; step < S::RSQRT_STEPS; ++step)
+    {
+        r = S::mul(r, S::sub(S::set1(1.5f), S::mul(S::mul(halfX, r), r)));
+    }
+    return r;
+}
+
+// sin and cos of x - k * pi/2, |x - k * pi/2| <= pi/4. pi/2 is split into
+// three floats so k * part stays exact up to SIN_COS_MAX_ARGUMENT.
+template<class S>
+static inline void sinCosReduced(typename S::V x, typename S::V &s, typename S::V &c, typename S::I &k)
+{
+    typedef typename S::V V;
+    k = S::roundToInt(S::mul(x, S::set1(0.63661977236758134f)));
+    const V kf = S::toFloat(k);
+    V r = S::sub(x, S::mul(kf, S::set1(1.5703125f)));
+    r = S::sub(r, S::mul(kf, S::set1(4.837512969970703125e-4f)));
+    r = S::sub(r, S::mul(kf, S::set1(7.54978995489188216e-8f)));
+    const V z = S::mul(r, r);
+
+    V ps = S::add(S::mul(S::set1(-1.9515295891e-4f), z), S::set1(8.3321608736e-3f));
+    ps = S::add(S::mul(ps, z), S::set1(-1.6666654611e-1f));
+    s = S::add(S::mul(S::mul(ps, z), r), r);
+
+    V pc = S::add(S::mul(S::set1(2.443315711809948e-5f), z), S::set1(-1.388731625493765e-3f));
+    pc = S::add(S::mul(pc, z), S::set1(4.166664568298827e-2f));
+    c = S::add(S::sub(S::set1(1.0f), S::mul(S::set1(0.5f), z)), S::mul(S::mul(pc, z), z));
+}
+
+template<class S>
+static inline typename S::V sin(typename S::V x)
+{
+    typename S::V s, c;
+    typename S::I k;
+    sinCosReduced<S>(x, s, c, k);
+    // Quadrants 0..3: sin r, cos r, -sin r, -cos r.
+    const typename S::V v = S::select(S::bitSet(k, 1), c, s);
+    return S::select(S::bitSet(k, 2), S::sub(S::set1(0.0f), v), v);
+}
+
+template<class S>
+static inline typename S::V cos(typename S::V x)
+{
+    typename S::V s, c;
+    typename S::I k;
+    sinCosReduced<S>(x, s, c, k);
+    // Quadrants 0..3: cos r, -sin r, -cos r, sin r.
+    const typename S::V v = S::select(S::bitSet(k, 1), s, c);
+    return S::select(S::bitSet(S::addInt(k, 1), 2), S::sub(S::set1(0.0f), v), v);
+}
+
+template<class S>
+static inline typename S::V atan2(typename S::V y, typename S::V x)
+{
+    typedef typename S::V V;
+    const V zero = S::set1(0.0f);
+    const V ax = S::abs(x);
+    const V ay = S::abs(y);
+    const V large = S::max(ax, ay);
+    const V small = S::min(ax, ay);
+
+    // atan of t in [0, 1], from atan((t - 1) / (t + 1)) + pi/4 above
+    // tan(pi/8).
+    V t = S::select(S::gt(large, zero), S::div(small, large), zero);
+    const typename S::M upper = S::gt(t, S::set1(0.41421356237309503f));
+    t = S::select(upper, S::div(S::sub(t, S::set1(1.0f)), S::add(t, S::set1(1.0f))), t);
+    const V z = S::mul(t, t);
+    V p = S::add(S::mul(S::set1(8.05374449538e-2f), z), S::set1(-1.38776856032e-1f));
+    p = S::add(S::mul(p, z), S::set1(1.99777106478e-1f));
+    p = S::add(S::mul(p, z), S::set1(-3.33329491539e-1f));
+    V a = S::add(S::mul(S::mul(p, z), t), t);
+    a = S::add(a, S::select(upper, S::set1(0.78539816339744831f), zero));
+
+    // Back to the octant, half plane and sign of (x, y).
+    a = S::select(S::gt(ay, ax), S::sub(S::set1(1.5707963267948966f), a), a);
+    a = S::select(S::lt(x, zero), S::sub(S::set1(3.1415926535897932f), a), a);
+    return S::select(S::lt(y, zero), S::sub(zero, a), a);
+}
+
+template<class S>
+static inline typename S::V exp(typename S::V x)
+{
+    typedef typename S::V V;
+    const typename S::M over = S::gt(x, S::set1(EXP_MAX_ARGUMENT));
+    const typename S::M under = S::lt(x, S::set1(EXP_MIN_ARGUMENT));
+    x = S::min(S::max(x, S::set1(EXP_MIN_ARGUMENT)), S::set1(EXP_MAX_ARGUMENT));
+
+    // exp(x) = 2^n * exp(r), |r| <= ln(2) / 2; ln(2) in two parts.
+    const typename S::I n = S::roundToInt(S::mul(x, S::set1(1.44269504088896341f)));
+    const V nf = S::toFloat(n);
+    V r = S::sub(x, S::mul(nf, S::set1(0.693359375f)));
+    r = S::sub(r, S::mul(nf, S::set1(-2.12194440e-4f)));
+    const V z = S::mul(r, r);
+
+    V p = S::add(S::mul(S::set1(1.9875691500e-4f), r), S::set1(1.3981999507e-3f));
+    p = S::add(S::mul(p, r), S::set1(8.3334519073e-3f));
+    p = S::add(S::mul(p, r), S::set1(4.1665795894e-2f));
+    p = S::add(S::mul(p, r), S::set1(1.6666665459e-1f));
+    p = S::add(S::mul(p, r), S::set1(5.0000001201e-1f));
+    p = S::add(S::add(S::mul(p, z), r), S::set1(1.0f));
+
+    V result = S::mul(p, S::pow2(n));
+    result = S::select(over, S::set1(__builtin_huge_valf()), result);
+    return S::select(under, S::set1(0.0f), result);
+}
+
+} // namespace detail
+
+//
+// Scalar forms.
+//
+
+static inline float abs(float x) { return detail::ScalarOps::abs(x); }
+static inline float rsqrt(float x) { return detail::rsqrt<detail::ScalarOps>(x); }
+static inline float sin(float x) { return detail::sin<detail::ScalarOps>(x); }
+static inline float cos(float x) { return detail::cos<detail::ScalarOps>(x); }
+static inline float atan2(float y, float x) { return detail::atan2<detail::ScalarOps>(y, x); }
+static inline float exp(float x) { return detail::exp<detail::ScalarOps>(x); }
+
+static inline void sinCos(float x, float &s, float &c)
+{
+    s = detail::sin<detail::ScalarOps>(x);
+    c = detail::cos<detail::ScalarOps>(x);
+}
+
+//
+// Vector forms, for the instruction sets the file is built for.
+//
+
+#if FASTMATH_SSE2
+static inline __m128 rsqrt(__m128 x) { return detail::rsqrt<detail::Sse2Ops>(x); }
+static inline __m128 sin(__m128 x) { return detail::sin<detail::Sse2Ops>(x); }
+static inline __m128 cos(__m128 x) { return detail::cos<detail::Sse2Ops>(x); }
+static inline __m128 atan2(__m128 y, __m128 x) { return detail::atan2<detail::Sse2Ops>(y, x); }
+static inline __m128 exp(__m128 x) { return detail::exp<detail::Sse2Ops>(x); }
+#endif // FASTMATH_SSE2
+
+#if FASTMATH_AVX2
+static inline __m256 rsqrt(__m256 x) { return detail::rsqrt<detail::Avx2Ops>(x); }
+static inline __m256 sin(__m256 x) { return detail::sin<detail::Avx2Ops>(x); }
+static inline __m256 cos(__m256 x) { return detail::cos<detail::Avx2Ops>(x); }
+static inline __m256 atan2(__m256 y, __m256 x) { return detail::atan2<detail::Avx2Ops>(y, x); }
+static inline __m256 exp(__m256 x) { return detail::exp<detail::Avx2Ops>(x); }
+#endif // FASTMATH_AVX2
+
+#if FASTMATH_NEON
+static inline float32x4_t rsqrt(float32x4_t x) { return detail::rsqrt<detail::NeonOps>(x); }
+static inline float32x4_t sin(float32x4_t x) { return detail::sin<detail::NeonOps>(x); }
+static inline float32x4_t cos(float32x4_t x) { return detail::cos<detail::NeonOps>(x); }
+static inline float32x4_t atan2(float32x4_t y, float32x4_t x) { return detail::atan2<detail::NeonOps>(y, x); }
+static inline float32x4_t exp(float32x4_t x) { return detail::exp<detail::NeonOps>(x); }
+#endif // FASTMATH_NEON
+
+} // namespace FastMath
+
+#endif /* FastMath_h */
@@ -73,8 +73,9 @@
 //
 // DEBUG_DRAW_USE_STD_MATH
 //  If defined to nonzero, use cmath/math.h. If you redefine it to zero before
-//  the DD implementation, it will force the use of local replacements
-//  for the library. This might be useful if you want to avoid the dependency.
+//  the DD implementation, it will use the approximations in FastMath.h
+//  instead, which state their maximum errors and need no libm. This might be
+//  useful if you want to avoid the dependency.
 //  It is defined to zero by default (i.e. we use cmath by default).
 //
 // DEBUG_DRAW_XYZ_TYPE_DEFINED
@@ -169,6 +170,12 @@
 // own tunned values to save memory or fit all of your debug data.
 // These are hard constraints. If not enough, change and recompile.
 //
+// The queues don't reserve this much up front: each starts empty, is
+// allocated with DEBUG_DRAW_INITIAL_XYZ entries on first use and doubles
+// whenever it fills, up to the max. A queue that stayed below a quarter of
+// its capacity for DEBUG_DRAW_SHRINK_FLUSHES flushes in a row is shrunk
+// back, so a burst doesn't keep its memory. See dd::getFrameStats().
+//
 #ifndef DEBUG_DRAW_MAX_STRINGS
     #define DEBUG_DRAW_MAX_STRINGS 512
 #endif // DEBUG_DRAW_MAX_STRINGS
@@ -181,19 +188,78 @@
     #define DEBUG_DRAW_MAX_LINES 32768
 #endif // DEBUG_DRAW_MAX_LINES
 
+// Shape instances, per shape type. Only used if the RenderInterface
+// draws them, see RenderInterface::supportsShapeInstances().
+#ifndef DEBUG_DRAW_MAX_SHAPES
+    #define DEBUG_DRAW_MAX_SHAPES 4096
+#endif // DEBUG_DRAW_MAX_SHAPES
+
+#ifndef DEBUG_DRAW_INITIAL_STRINGS
+    #define DEBUG_DRAW_INITIAL_STRINGS 32
+#endif // DEBUG_DRAW_INITIAL_STRINGS
+
+#ifndef DEBUG_DRAW_INITIAL_POINTS
+    #define DEBUG_DRAW_INITIAL_POINTS 256
+#endif // DEBUG_DRAW_INITIAL_POINTS
+
+#ifndef DEBUG_DRAW_INITIAL_LINES
+    #define DEBUG_DRAW_INITIAL_LINES 1024
+#endif // DEBUG_DRAW_INITIAL_LINES
+
+#ifndef DEBUG_DRAW_INITIAL_SHAPES
+    #define DEBUG_DRAW_INITIAL_SHAPES 64
+#endif // DEBUG_DRAW_INITIAL_SHAPES
+
+#ifndef DEBUG_DRAW_SHRINK_FLUSHES
+    #define DEBUG_DRAW_SHRINK_FLUSHES 120
+#endif // DEBUG_DRAW_SHRINK_FLUSHES
+
 //
-// Size in vertexes of a local buffer we use to sort elements
-// drawn with and without depth testing before submitting them to
-// the RenderInterface. A larger buffer will require less flushes
-// (e.g. RenderInterface calls) when drawing large amounts of
-// primitives. Less will obviously save more memory. Each DrawVertex
-// is about 32 bytes in size, we declare a local static array with
-// this many entries.
+// Size in vertexes of the largest batch handed to the RenderInterface.
+// A larger value will require less flushes (e.g. RenderInterface calls)
+// when drawing large amounts of primitives. Text is expanded into a
+// buffer of this many vertexes (about 32 bytes each), allocated the
+// first time a context draws text.
 //
 #ifndef DEBUG_DRAW_VERTEX_BUFFER_SIZE
     #define DEBUG_DRAW_VERTEX_BUFFER_SIZE 4096
 #endif // DEBUG_DRAW_VERTEX_BUFFER_SIZE
 
+// Largest batch of shape instances handed to the RenderInterface.
+#ifndef DEBUG_DRAW_SHAPE_BATCH_SIZE
+    #define DEBUG_DRAW_SHAPE_BATCH_SIZE 1024
+#endif // DEBUG_DRAW_SHAPE_BATCH_SIZE
+
+//
+// Set DEBUG_DRAW_THREAD_QUEUES to 1 to allow threads other than a context's
+// owner (the thread that created it) to add points, lines and text to it.
+// Each such thread gets its own lock-free single-producer ring per context,
+// allocated on its first submission, so submitting never takes a lock.
+// dd::flush() drains every ring into the main queues before drawing. A ring
+// holds DEBUG_DRAW_THREAD_QUEUE_SIZE points/lines and
+// DEBUG_DRAW_THREAD_QUEUE_STRINGS strings (both powers of two); further
+// submissions are dropped until the next flush. At most DEBUG_DRAW_MAX_THREADS
+// live threads can submit to one context; when a thread exits, the next flush
+// drains its ring and hands it to the next new thread. A ring stays allocated
+// while its thread lives, even after the context is gone. Producers must be
+// done with a context before it is destroyed. Requires C++11.
+//
+#ifndef DEBUG_DRAW_THREAD_QUEUES
+    #define DEBUG_DRAW_THREAD_QUEUES 0
+#endif // DEBUG_DRAW_THREAD_QUEUES
+
+#ifndef DEBUG_DRAW_MAX_THREADS
+    #define DEBUG_DRAW_MAX_THREADS 16
+#endif // DEBUG_DRAW_MAX_THREADS
+
+#ifndef DEBUG_DRAW_THREAD_QUEUE_SIZE
+    #define DEBUG_DRAW_THREAD_QUEUE_SIZE 4096
+#endif // DEBUG_DRAW_THREAD_QUEUE_SIZE
+
+#ifndef DEBUG_DRAW_THREAD_QUEUE_STRINGS
+    #define DEBUG_DRAW_THREAD_QUEUE_STRINGS 64
+#endif // DEBUG_DRAW_THREAD_QUEUE_STRINGS
+
 //
 // This macro is called with an error message if any of the above
 // sizes is overflowed during runtime. In a debug build, you might
@@ -207,14 +273,35 @@
 
 //
 // Use <math.h> and <float.h> for trigonometry functions by default.
-// If you wish to avoid those dependencies, DD provides local approximations
-// of the required functions as a portable replacement. Just define
-// DEBUG_DRAW_USE_STD_MATH to zero before including this file.
+// If you wish to avoid those dependencies, DD uses the approximations in
+// FastMath.h as a portable replacement. Just define DEBUG_DRAW_USE_STD_MATH
+// to zero before including this file.
 //
 #ifndef DEBUG_DRAW_USE_STD_MATH
     #define DEBUG_DRAW_USE_STD_MATH 1
 #endif // DEBUG_DRAW_USE_STD_MATH
 
+//
+// Spheres and cones that are expanded to lines on the CPU compute their
+// rings four points at a time with SSE or NEON when the compiler targets
+// either, and frustum culling (setCullFrustum()) tests four primitives at a
+// time. Define DEBUG_DRAW_USE_SIMD to zero to force the scalar loops.
+//
+#ifndef DEBUG_DRAW_USE_SIMD
+    #define DEBUG_DRAW_USE_SIMD 1
+#endif // DEBUG_DRAW_USE_SIMD
+
+//
+// Lays dd::DrawVertex out in 16 bytes instead of 28: positions stay floats,
+// colors become RGBA8 and glyph texture coordinates 16-bit normalized. A
+// point's size goes in the A byte of its color, in whole pixels (0 to 255).
+// The renderer reads the 'color' members instead of r, g, b and size then.
+// Must be the same for every file that includes this one.
+//
+#ifndef DEBUG_DRAW_PACKED_VERTEX
+    #define DEBUG_DRAW_PACKED_VERTEX 0
+#endif // DEBUG_DRAW_PACKED_VERTEX
+
 // ========================================================
 // Overridable Debug Draw types:
 // ========================================================
@@ -505,6 +592,34 @@ void xzSquareGrid(float mins, float maxs,
 // The only drawing type the user has to interface with.
 // ========================================================
 
+#if DEBUG_DRAW_PACKED_VERTEX
+
+// 'color' is R, G, B, A bytes in memory order; draw it as normalized
+// GL_UNSIGNED_BYTE x4. A is the size of points and 255 otherwise.
+union DrawVertex
+{
+    struct
+    {
+        float x, y, z;
+        ddU32 color;
+    } point;
+
+    struct
+    {
+        float x, y, z;
+        ddU32 color;
+    } line;
+
+    struct
+    {
+        float x, y;
+        unsigned short u, v; // Normalized to 0..65535
+        ddU32 color;
+    } glyph;
+};
+
+#else // !DEBUG_DRAW_PACKED_VERTEX
+
 union DrawVertex
 {
     struct
@@ -528,6 +643,50 @@ union DrawVertex
     } glyph;
 };
 
+#endif // DEBUG_DRAW_PACKED_VERTEX
+
+// ========================================================
+// Debug Draw shape instances (optional):
+// ========================================================
+
+//
+// Spheres, cones, circles and boxes can be queued as one instance of a unit
+// wireframe mesh instead of hundreds of lines, if the RenderInterface says it
+// can draw them (see supportsShapeInstances()). The meshes come from
+// shapeMesh(); the renderer uploads them once and draws each instance as
+//
+//   local = (mesh.x * s, mesh.y * s, mesh.z), s = mix(param, 1, mesh.z)
+//   world = transform * (local, 1)
+//
+// so only cones use the taper: their apex ring is at z = 0, their base at z = 1.
+//
+enum ShapeType
+{
+    ShapeSphere,
+    ShapeCone,
+    ShapeBox,
+    ShapeCircle,
+    ShapeTypeCount
+};
+
+// The circle mesh holds a ring for each step count from 3 to this, and
+// instances pick one with 'param'. shapeMeshFirst() gives where it starts.
+enum { ShapeCircleMaxSteps = 64 };
+
+struct ShapeInstance
+{
+    float transform[12]; // Rows of the 3x4 unit shape to world transform
+    float color[3];
+    float param;         // ShapeCone: apex radius / base radius, ShapeCircle: steps, else 1
+};
+
+// Writes the unit mesh of 'type' as GL_LINES positions (3 floats each) to
+// 'xyz' if not null, and returns its vertex count.
+int shapeMesh(ShapeType type, float * xyz);
+
+// First vertex of the ring with 'steps' segments in the ShapeCircle mesh.
+inline int shapeMeshFirst(const int steps) { return steps * (steps - 1) - 6; }
+
 //
 // Opaque handle to a texture object.
 // Used by the debug text drawing functions.
@@ -535,6 +694,14 @@ union DrawVertex
 struct OpaqueTextureType;
 typedef OpaqueTextureType * GlyphTextureHandle;
 
+//
+// Opaque handle to a Debug Draw context.
+// A context owns all the debug draw state: the queues, the vertex buffer,
+// the RenderInterface, the glyph texture and the flush time. See createContext().
+//
+struct OpaqueContextType;
+typedef OpaqueContextType * ContextHandle;
+
 // ========================================================
 // Debug Draw rendering callbacks:
 // Implementation is provided by the user so we don't
@@ -555,14 +722,14 @@ public:
 
     //
     // Create/free the glyph bitmap texture used by the debug text drawing functions.
-    // The debug renderer currently only creates one of those on startup.
+    // Each context creates one, from its first flush that has text to draw.
     //
     // You're not required to implement these two if you don't care about debug text drawing.
     // Default no-op stubs are provided by default, which disable debug text rendering.
     //
     // Texture dimensions are in pixels, data format is always 8-bits per pixel (Grayscale/GL_RED).
     // The pixel values range from 255 for a pixel within a glyph to 0 for a transparent pixel.
-    // If createGlyphTexture() returns null, the renderer will disable all text drawing functions.
+    // If createGlyphTexture() returns null, the context drops all text from then on.
     //
     virtual GlyphTextureHandle createGlyphTexture(int width, int height, const void * pixels);
     virtual void destroyGlyphTexture(GlyphTextureHandle glyphTex);
@@ -575,6 +742,15 @@ public:
     virtual void drawLineList (const DrawVertex * lines,  int count, bool depthEnabled);
     virtual void drawGlyphList(const DrawVertex * glyphs, int count, GlyphTextureHandle glyphTex);
 
+    //
+    // Optional instanced shapes. If supportsShapeInstances() returns true (it is
+    // asked once, when the context is created), sphere(), cone(), circle(), box()
+    // and aabb() queue ShapeInstances for drawShapeList(), grouped by type, instead
+    // of expanding to lines. Circles with different step counts can share a batch.
+    //
+    virtual bool supportsShapeInstances();
+    virtual void drawShapeList(ShapeType type, const ShapeInstance * shapes, int count, bool depthEnabled);
+
     // User defined cleanup. Nothing by default.
     virtual ~RenderInterface() = 0;
 };
@@ -592,14 +768,35 @@ enum FlushFlags
     FlushAll    = (FlushPoints | FlushLines | FlushText)
 };
 
-// Initialize with the user-supplied renderer interface.
-// Given object must remain valid until after dd::shutdown() is called!
-// If 'renderer' is null, the Debug Draw functions become no-ops, but
-// can still be safely called.
-void initialize(RenderInterface * renderer);
+//
+// Every other dd:: function acts on the calling thread's current context,
+// and is a no-op when there is none. Separate renderers or views each create
+// their own context and make it current around their dd:: calls; contexts
+// share nothing, so they can be flushed independently and from different
+// threads at the same time. One context must not be used by two threads at
+// once unless DEBUG_DRAW_THREAD_QUEUES is enabled (see above).
+//
 
-// After this is called, it is safe to dispose the RenderInterface instance
-// you passed to dd::initialize(). Shutdown will also attempt to free the glyph texture.
+// Creates a context drawing through 'renderer', which must remain valid until
+// the context is destroyed. The calling thread becomes the context's owner,
+// the thread that flushes it. Does not make it current. The glyph texture is
+// created by the first flush with text, from a font bitmap decoded once per
+// process, so contexts that never draw text never decode or upload it.
+ContextHandle createContext(RenderInterface * renderer);
+
+// Frees the context's glyph texture and queues. Clears it from the calling
+// thread's current context if it was current there.
+void destroyContext(ContextHandle ctx);
+
+// Sets/gets the calling thread's current context. Null unbinds.
+void makeCurrent(ContextHandle ctx);
+ContextHandle currentContext();
+
+// Shorthands for a single-context program: initialize() creates a context
+// and makes it current (destroying any context current before), shutdown()
+// destroys the current context. If 'renderer' is null, the Debug Draw
+// functions become no-ops, but can still be safely called.
+void initialize(RenderInterface * renderer);
 void shutdown();
 
 // Test if there's data in the debug draw queue and dd::flush() should be called.
@@ -610,12 +807,49 @@ bool hasPendingDraws();
 // Pass the current application time in milliseconds to remove
 // timed objects that have expired. Passing zero removes all
 // objects after they get drawn, regardless of lifetime.
+// Objects with a duration wait in a timing wheel and are only
+// looked at again when they expire, so long-lived ones cost
+// nothing per flush but their drawing.
 void flush(ddI64 currTimeMillis, int flags = FlushAll);
 
 // Manually removes all queued debug render data without drawing.
 // This is not normally called. To draw stuff, call dd::flush() instead.
 void clear();
 
+// Usage of one queue at the last dd::flush().
+struct QueueStats
+{
+    int   highWater;  // Entries queued when the flush started (the frame's peak)
+    int   capacity;   // Entries allocated after the flush
+    int   maxEntries; // DEBUG_DRAW_MAX_XYZ
+    ddU32 dropped;    // Submissions dropped since the flush before, queue full at maxEntries
+    ddU32 culled;     // Entries outside the cull frustum since the flush before (see setCullFrustum())
+};
+
+struct FrameStats
+{
+    QueueStats points;
+    QueueStats lines;
+    QueueStats strings;
+    QueueStats shapes; // All shape types together; maxEntries is per type
+};
+
+// Fills 'stats' for the current context. False if there is none.
+bool getFrameStats(FrameStats & stats);
+
+// Optional frustum culling for the current context. While a frustum is set:
+//  - dd::flush() drops lines, points and shape instances wholly outside it
+//    before they are copied to the RenderInterface.
+//  - One-frame spheres, cones, circles, boxes and arrows added on the owner
+//    thread are tested before they are expanded or queued.
+//  - projectedText() drops one-frame labels whose anchor is outside it.
+// Something is only dropped when it lies wholly outside one of the planes, so
+// a few primitives near the corners are kept. 'vpMatrix' is the view *
+// projection transform, as projectedText() takes. Owner thread only; set it
+// once a frame before adding primitives, as the camera moves.
+void setCullFrustum(ddMat4x4Param vpMatrix);
+void clearCullFrustum();
+
 } // namespace dd {}
 
 // ================== End of header file ==================
@@ -661,18 +895,30 @@ void clear();
 //
 #if DEBUG_DRAW_CXX11_SUPPORTED
     #include <utility>
-    #define DD_MOVE(expr) std::move(expr)
-    #define DD_NULL       nullptr
+    #define DD_MOVE(expr)   std::move(expr)
+    #define DD_NULL         nullptr
+    #define DD_THREAD_LOCAL thread_local
 #else // !C++11
     #include <cstddef>
-    #define DD_MOVE(expr) expr
-    #define DD_NULL       NULL
+    #define DD_MOVE(expr)   expr
+    #define DD_NULL         NULL
+    #define DD_THREAD_LOCAL // Current context is process-wide.
 #endif // DEBUG_DRAW_CXX11_SUPPORTED
 
+//
+// Per-thread submission rings:
+//
+#if DEBUG_DRAW_THREAD_QUEUES
+    #include <atomic>
+#endif // DEBUG_DRAW_THREAD_QUEUES
+
 //
 // These are internal and only required for the glyph bitmap texture setup,
 // but the user can still override and provided custom allocators if needed.
 //
+#include <cstring> // memcpy for growing queues
+#include <new>     // Placement new for timed queues of strings
+
 #ifndef DD_MALLOC
     #include <cstdlib>
     #define DD_MALLOC std::malloc
@@ -704,19 +950,36 @@ void clear();
 #else // !DEBUG_DRAW_USE_STD_MATH
     #define DD_EPSILON       1e-14
     #define DD_PI            3.1415926535897931f
-    #define DD_FABS(x)       fastFabs(x)
-    #define DD_FSIN(radians) fastSin(radians)
-    #define DD_FCOS(radians) fastCos(radians)
-    #define DD_INV_FSQRT(x)  fastInvSqrt(x)
+    // Bounded-error replacements with no libm dependency, see FastMath.h.
+    #include "FastMath.h"
+    #define DD_FABS(x)       FastMath::abs(x)
+    #define DD_FSIN(radians) FastMath::sin(radians)
+    #define DD_FCOS(radians) FastMath::cos(radians)
+    #define DD_INV_FSQRT(x)  FastMath::rsqrt(x)
 #endif // DEBUG_DRAW_USE_STD_MATH
 
+//
+// SIMD for the shape rings, frustum culling and packed vertex colors:
+//
+#if DEBUG_DRAW_USE_SIMD && (defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1))
+    #include <xmmintrin.h>
+    #define DD_SIMD_SSE 1
+    #if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+        #include <emmintrin.h>
+        #define DD_SIMD_SSE2 1
+    #endif // __SSE2__
+#elif DEBUG_DRAW_USE_SIMD && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+    #include <arm_neon.h>
+    #define DD_SIMD_NEON 1
+#endif // DEBUG_DRAW_USE_SIMD
+
 //
 // Misc helpers:
 //
 #define DD_TAU              (DD_PI * 2.0f)
 #define DD_DEG2RAD(degrees) (static_cast<float>(degrees) * DD_PI / 180.0f)
 #define DD_ARRAY_LEN(arr)   (static_cast<int>(sizeof(arr) / sizeof((arr)[0])))
-#define DD_CHECK_INIT       if (g_renderInterface == DD_NULL) { return; }
+#define DD_CHECK_INIT       if (t_currentContext == DD_NULL) { return; }
 
 namespace dd
 {
@@ -1537,6 +1800,15 @@ UByte * decompressFontBitmap()
     return uncompressedData;
 }
 
+// The decoded font bitmap, shared by every context for the life of the
+// process (bitmapDecompressSize bytes). Decoded by the first call; null if
+// that failed.
+const UByte * fontBitmap()
+{
+    static const UByte * const bitmap = decompressFontBitmap();
+    return bitmap;
+}
+
 // ========================================================
 // Internal Debug Draw queue and helper types/functions:
 // ========================================================
@@ -1552,629 +1824,2553 @@ struct DebugString
     bool   centered;
 };
 
-struct DebugPoint
+// A string drawn on the last flush and where its glyphs went in the vertex
+// buffer. If the same string comes at the same place on the next flush,
+// its glyphs are still there and are used as they are.
+struct GlyphRun
 {
-    ddI64  expiryDateMillis;
-    ddVec3 position;
     ddVec3 color;
-    float  size;
-    bool   depthEnabled;
+    float  posX;
+    float  posY;
+    float  scaling;
+    ddStr  text;
+    bool   centered;
+    int    firstVert;
+    int    vertCount;
 };
 
-struct DebugLine
+// Drop counters and the last published stats of one primitive type.
+struct QueueUsage
 {
-    ddI64  expiryDateMillis;
-    ddVec3 posFrom;
-    ddVec3 posTo;
-    ddVec3 color;
-    bool   depthEnabled;
-};
-
-// Debug strings queue (2D screen-space strings + 3D projected labels):
-static int g_debugStringsCount = 0;
-static DebugString g_debugStrings[DEBUG_DRAW_MAX_STRINGS];
-
-// 3D debug points queue:
-static int g_debugPointsCount = 0;
-static DebugPoint g_debugPoints[DEBUG_DRAW_MAX_POINTS];
-
-// 3D debug lines queue:
-static int g_debugLinesCount = 0;
-static DebugLine g_debugLines[DEBUG_DRAW_MAX_LINES];
+    ddU32      dropped; // Since the last flush
+    ddU32      culled;  // Since the last flush
+    QueueStats last;    // What getFrameStats() reports
 
-// Temporary vertex buffer we use to expand the lines/points before calling on RenderInterface.
-static int g_vertexBufferUsed = 0;
-static DrawVertex g_vertexBuffer[DEBUG_DRAW_VERTEX_BUFFER_SIZE];
-
-// Latest time value (in milliseconds) from dd::flush().
-static ddI64 g_currentTimeMillis = 0;
-
-// Ref to the external renderer. Can be null for a no-op debug draw.
-static RenderInterface * g_renderInterface = DD_NULL;
-
-// Our built-in glyph bitmap. If kept null, no text is rendered.
-static GlyphTextureHandle g_glyphTex = DD_NULL;
+    QueueUsage() : dropped(0), culled(0)
+    {
+        last.highWater  = 0;
+        last.capacity   = 0;
+        last.maxEntries = 0;
+        last.dropped    = 0;
+        last.culled     = 0;
+    }
+};
 
-// ========================================================
-// Fast approximations of math functions used by DD.
-// ========================================================
+// Largest count an allocation had at a flush over the last few flushes.
+struct ShrinkWindow
+{
+    int peak;
+    int flushes;
 
-// We only need these if the user didn't want the math.h dependency.
-#if !DEBUG_DRAW_USE_STD_MATH
+    ShrinkWindow() : peak(0), flushes(0) { }
 
-union Float2UInt
-{
-    float asFloat;
-    ddU32 asUInt;
+    // At the start of each flush, with the entries queued for it.
+    void note(const int queued)
+    {
+        if (queued > peak)
+        {
+            peak = queued;
+        }
+    }
 };
 
-inline float roundFloat(float x)
+// Next capacity when a queue with 'capacity' entries is full; 0 if it is at the cap.
+inline int grownCapacity(const int capacity, const int initialEntries, const int maxEntries)
 {
-    // Probably slower than std::floor(), also depends of FPU settings,
-    // but we only need this for that special sin/cos() case anyways...
-    const int i = static_cast<int>(x);
-    return (x >= 0.0f) ? static_cast<float>(i) : static_cast<float>(i - 1);
+    if (capacity >= maxEntries)
+    {
+        return 0;
+    }
+    const int grown = (capacity == 0) ? initialEntries : capacity * 2;
+    return (grown < maxEntries) ? grown : maxEntries;
 }
 
-inline float fastFabs(float x)
+// Called once at the end of each flush. Returns the capacity the queue
+// should shrink to, or 0 to keep its current one.
+inline int shrunkCapacity(ShrinkWindow & window, const int capacity, const int initialEntries)
 {
-    // Mask-off the sign bit
-    Float2UInt i;
-    i.asFloat = x;
-    i.asUInt &= 0x7FFFFFFF;
-    return i.asFloat;
+    if (++window.flushes < DEBUG_DRAW_SHRINK_FLUSHES)
+    {
+        return 0;
+    }
+
+    const int peak = window.peak;
+    window.peak    = 0;
+    window.flushes = 0;
+    if (capacity <= initialEntries || (peak * 4) > capacity)
+    {
+        return 0;
+    }
+
+    // Twice the peak leaves room to grow again before the next window ends.
+    int shrunk = initialEntries;
+    while (shrunk < (peak * 2))
+    {
+        shrunk *= 2;
+    }
+    return (shrunk < capacity) ? shrunk : 0;
 }
 
-inline float fastInvSqrt(float x)
+// Destroys the first 'capacity' objects of DD_MALLOC storage and frees it.
+template<typename T>
+void freeObjects(T * items, const int capacity)
 {
-    // Modified version of the emblematic Q_rsqrt() from Quake 3.
-    // See: http://en.wikipedia.org/wiki/Fast_inverse_square_root
-    Float2UInt i;
-    float y, r;
-    y = x * 0.5f;
-    i.asFloat = x;
-    i.asUInt = 0x5F3759DF - (i.asUInt >> 1);
-    r = i.asFloat;
-    r = r * (1.5f - (r * r * y));
-    return r;
+    if (items == DD_NULL)
+    {
+        return;
+    }
+    for (int i = 0; i < capacity; ++i)
+    {
+        items[i].~T();
+    }
+    DD_MFREE(items);
 }
 
-inline float fastSin(float radians)
+// New DD_MALLOC storage of 'newCapacity' (>= count) objects: the first 'count'
+// moved from 'items', the rest default constructed. Frees 'items' (of
+// 'capacity' objects, may be null). Null, with 'items' left alone, if
+// DD_MALLOC fails.
+template<typename T>
+T * reallocObjects(T * items, const int count, const int capacity, const int newCapacity)
 {
-    static const float A = -2.39e-08;
-    static const float B =  2.7526e-06;
-    static const float C =  1.98409e-04;
-    static const float D =  8.3333315e-03;
-    static const float E =  1.666666664e-01;
-    static const float HALFPI = DD_PI * 0.5f;
-
-    if (radians < 0.0f || radians >= DD_TAU)
+    T * newItems = static_cast<T *>(DD_MALLOC(newCapacity * sizeof(T)));
+    if (newItems == DD_NULL)
     {
-        radians -= roundFloat(radians / DD_TAU) * DD_TAU;
+        return DD_NULL;
     }
-
-    if (radians < DD_PI)
+    for (int i = 0; i < count; ++i)
     {
-        if (radians > HALFPI)
-        {
-            radians = DD_PI - radians;
-        }
+        new (&newItems[i]) T(DD_MOVE(items[i]));
     }
-    else
+    for (int i = count; i < newCapacity; ++i)
     {
-        radians = (radians > (DD_PI + HALFPI)) ? (radians - DD_TAU) : (DD_PI - radians);
+        new (&newItems[i]) T();
     }
-
-    const float s = radians * radians;
-    return radians * (((((A * s + B) * s - C) * s + D) * s - E) * s + 1.0f);
+    freeObjects(items, capacity);
+    return newItems;
 }
 
-inline float fastCos(float radians)
+//
+// One-frame points, lines and shapes (durationMillis <= 0) are queued already
+// expanded to what the RenderInterface takes, bucketed by depth mode:
+// depth-tested entries fill the arrays from the front, depth-less ones from
+// the back. Each mode is then one contiguous run of items that flush() hands
+// to the RenderInterface as is, and the whole queue is dropped after it.
+// Depth-less entries sit in reverse queue order.
+//
+template<typename T, int ItemsPerEntry>
+struct DebugQueue
 {
-    static const float A = -2.605e-07;
-    static const float B =  2.47609e-05;
-    static const float C =  1.3888397e-03;
-    static const float D =  4.16666418e-02;
-    static const float E =  4.999999963e-01;
-    static const float HALFPI = DD_PI * 0.5f;
+    int          capacity;       // Entries allocated
+    int          initialEntries;
+    int          maxEntries;
+    int          depthCount;     // Entries in [0, depthCount)
+    int          depthlessCount; // Entries in [capacity - depthlessCount, capacity)
+    T *          items;
+    ShrinkWindow shrink;
+
+    DebugQueue(const int initial, const int max)
+        : capacity(0), initialEntries(initial), maxEntries(max)
+        , depthCount(0), depthlessCount(0), items(DD_NULL)
+    { }
+
+    ~DebugQueue()
+    {
+        DD_MFREE(items);
+    }
+
+    int count() const { return depthCount + depthlessCount; }
 
-    if (radians < 0.0f || radians >= DD_TAU)
+    // Null if the queue is full and can't grow.
+    T * push(const bool depthEnabled)
     {
-        radians -= roundFloat(radians / DD_TAU) * DD_TAU;
+        if (count() == capacity)
+        {
+            const int grown = grownCapacity(capacity, initialEntries, maxEntries);
+            if (grown == 0 || !resize(grown))
+            {
+                return DD_NULL;
+            }
+        }
+
+        const int index = depthEnabled ? depthCount++ : (capacity - ++depthlessCount);
+        return &items[index * ItemsPerEntry];
     }
 
-    float d;
-    if (radians < DD_PI)
+    // 'entryCount' entries in a row, in queue order even when depth-less.
+    // Null if they don't all fit within maxEntries.
+    T * pushRun(const bool depthEnabled, const int entryCount)
     {
-        if (radians > HALFPI)
+        int newCapacity = capacity;
+        while ((newCapacity - count()) < entryCount)
+        {
+            newCapacity = grownCapacity(newCapacity, initialEntries, maxEntries);
+            if (newCapacity == 0)
+            {
+                return DD_NULL;
+            }
+        }
+        if (newCapacity != capacity && !resize(newCapacity))
+        {
+            return DD_NULL;
+        }
+
+        int index;
+        if (depthEnabled)
         {
-            radians = DD_PI - radians;
-            d = -1.0f;
+            index = depthCount;
+            depthCount += entryCount;
         }
         else
         {
-            d = 1.0f;
+            depthlessCount += entryCount;
+            index = capacity - depthlessCount;
         }
+        return &items[index * ItemsPerEntry];
     }
-    else
+
+    // Moves both runs to new storage of 'newCapacity' (>= count()) entries.
+    bool resize(const int newCapacity)
     {
-        if (radians > (DD_PI + HALFPI))
+        T * newItems = static_cast<T *>(DD_MALLOC(newCapacity * ItemsPerEntry * sizeof(T)));
+        if (newItems == DD_NULL)
         {
-            radians = radians - DD_TAU;
-            d = 1.0f;
+            return false;
         }
-        else
+
+        if (items != DD_NULL)
         {
-            radians = DD_PI - radians;
-            d = -1.0f;
+            std::memcpy(newItems, items, depthCount * ItemsPerEntry * sizeof(T));
+            std::memcpy(newItems + (newCapacity - depthlessCount) * ItemsPerEntry,
+                        items + (capacity - depthlessCount) * ItemsPerEntry,
+                        depthlessCount * ItemsPerEntry * sizeof(T));
+            DD_MFREE(items);
         }
-    }
 
-    const float s = radians * radians;
-    return d * (((((A * s + B) * s - C) * s + D) * s - E) * s + 1.0f);
-}
+        items    = newItems;
+        capacity = newCapacity;
+        return true;
+    }
 
-#endif // DEBUG_DRAW_USE_STD_MATH
+    void trim()
+    {
+        const int shrunk = shrunkCapacity(shrink, capacity, initialEntries);
+        if (shrunk != 0)
+        {
+            resize(shrunk);
+        }
+    }
 
-// ========================================================
-// ddVec3 helpers:
-// ========================================================
+    void clear()
+    {
+        depthCount     = 0;
+        depthlessCount = 0;
+    }
+};
 
-enum { X, Y, Z, W };
+typedef DebugQueue<DrawVertex,    1> DebugPointQueue;
+typedef DebugQueue<DrawVertex,    2> DebugLineQueue;
+typedef DebugQueue<ShapeInstance, 1> DebugShapeQueue; // One array per ShapeType
 
-inline void vecSet(ddVec3 & dest, const float x, const float y, const float z)
+//
+// Entries with a lifetime sit in a hierarchical timing wheel keyed by their
+// expiry time, in 1 millisecond ticks: 256 one-tick slots, then three levels
+// of 64 slots, each slot spanning a whole turn of the level below (about 18.6
+// hours in all; entries further out wait in the last slot and are placed
+// again when it comes round). A flush visits the one-tick slots of the ticks
+// since the last flush, pulling a coarser slot down a level whenever a finer
+// one wraps, so an entry is touched when it expires and at most once per
+// level before, never on the frames in between.
+//
+enum
 {
-    dest[X] = x;
-    dest[Y] = y;
-    dest[Z] = z;
-}
+    WheelLevel0Bits  = 8,
+    WheelLevelNBits  = 6,
+    WheelLevels      = 4,
+    WheelLevel0Slots = 1 << WheelLevel0Bits,
+    WheelLevelNSlots = 1 << WheelLevelNBits,
+    WheelSlots       = WheelLevel0Slots + ((WheelLevels - 1) * WheelLevelNSlots),
+    WheelPending     = WheelSlots, // Entries taken out of a slot, being expired or placed again
+    WheelNil         = -1
+};
 
-inline void vecCopy(ddVec3 & dest, ddVec3Param src)
+// Span, in ticks, of everything below level 'level' + 1.
+inline ddI64 wheelSpan(const int level)
 {
-    dest[X] = src[X];
-    dest[Y] = src[Y];
-    dest[Z] = src[Z];
+    return ddI64(1) << (WheelLevel0Bits + (level * WheelLevelNBits));
 }
 
-inline void vecAdd(ddVec3 & result, ddVec3Param a, ddVec3Param b)
+// Slot of an entry expiring on 'expiryTick' when 'nextTick' is the next one to be visited.
+inline int wheelSlot(const ddI64 expiryTick, const ddI64 nextTick)
 {
-    result[X] = a[X] + b[X];
-    result[Y] = a[Y] + b[Y];
-    result[Z] = a[Z] + b[Z];
-}
+    const ddI64 delta = expiryTick - nextTick;
+    if (delta < 0)
+    {
+        return static_cast<int>(nextTick & (WheelLevel0Slots - 1));
+    }
+    if (delta < WheelLevel0Slots)
+    {
+        return static_cast<int>(expiryTick & (WheelLevel0Slots - 1));
+    }
 
-inline void vecSub(ddVec3 & result, ddVec3Param a, ddVec3Param b)
-{
-    result[X] = a[X] - b[X];
-    result[Y] = a[Y] - b[Y];
-    result[Z] = a[Z] - b[Z];
+    int level = 1;
+    while (level < (WheelLevels - 1) && delta >= wheelSpan(level))
+    {
+        ++level;
+    }
+    const ddI64 tick = (delta < wheelSpan(level)) ? expiryTick : (nextTick + wheelSpan(level) - 1);
+    const int shift  = WheelLevel0Bits + ((level - 1) * WheelLevelNBits);
+    return WheelLevel0Slots + ((level - 1) * WheelLevelNSlots) +
+           static_cast<int>((tick >> shift) & (WheelLevelNSlots - 1));
 }
 
-inline void vecScale(ddVec3 & result, ddVec3Param v, const float s)
+// Place of a timed entry in its slot's list. Entries are named by
+// (index in their run * Runs + run), which survives reallocating a run.
+struct WheelLink
 {
-    result[X] = v[X] * s;
-    result[Y] = v[Y] * s;
-    result[Z] = v[Z] * s;
-}
+    ddI64 expiryMillis;
+    int   next;
+    int   prev;
+    int   slot;
+};
 
-inline void vecNormalize(ddVec3 & result, ddVec3Param v)
+//
+// Timed entries of one type, packed into 'Runs' arrays (one per depth mode
+// for points and lines) that are drawn as is. Expiring an entry moves the
+// last one of its run into the hole, so the runs stay dense.
+//
+template<typename T, int ItemsPerEntry, int Runs>
+struct TimedQueue
 {
-    const float lenSqr = v[X] * v[X] + v[Y] * v[Y] + v[Z] * v[Z];
-    const float invLen = DD_INV_FSQRT(lenSqr);
-    result[X] = v[X] * invLen;
-    result[Y] = v[Y] * invLen;
-    result[Z] = v[Z] * invLen;
-}
+    struct Run
+    {
+        T *          items;
+        WheelLink *  links;
+        int          count;
+        int          capacity;
+        ShrinkWindow shrink;
+    };
 
-inline void vecOrthogonalBasis(ddVec3 & left, ddVec3 & up, ddVec3Param v)
-{
-    // Produces two orthogonal vectors for normalized vector v.
-    float lenSqr, invLen;
-    if (DD_FABS(v[Z]) > 0.7f)
+    Run   runs[Runs];
+    int   initialEntries; // Per run
+    int   maxEntries;     // Per run
+    ddI64 nextTick;       // Next tick advance() visits
+    int   heads[WheelSlots + 1];
+
+    TimedQueue(const int initial, const int max)
+        : initialEntries(initial), maxEntries(max), nextTick(0)
     {
-        lenSqr = v[Y] * v[Y] + v[Z] * v[Z];
-        invLen = DD_INV_FSQRT(lenSqr);
-        up[X] = 0.0f;
-        up[Y] =  v[Z] * invLen;
-        up[Z] = -v[Y] * invLen;
-        left[X] = lenSqr * invLen;
-        left[Y] = -v[X] * up[Z];
-        left[Z] =  v[X] * up[Y];
+        for (int r = 0; r < Runs; ++r)
+        {
+            runs[r].items    = DD_NULL;
+            runs[r].links    = DD_NULL;
+            runs[r].count    = 0;
+            runs[r].capacity = 0;
+        }
+        clear();
     }
-    else
+
+    ~TimedQueue()
     {
-        lenSqr = v[X] * v[X] + v[Y] * v[Y];
-        invLen = DD_INV_FSQRT(lenSqr);
-        left[X] = -v[Y] * invLen;
-        left[Y] =  v[X] * invLen;
-        left[Z] = 0.0f;
-        up[X] = -v[Z] * left[Y];
-        up[Y] =  v[Z] * left[X];
-        up[Z] = lenSqr * invLen;
+        for (int r = 0; r < Runs; ++r)
+        {
+            freeStorage(runs[r].items, runs[r].links, runs[r].capacity);
+        }
     }
-}
 
-// ========================================================
-// ddMat4x4 helpers:
-// ========================================================
+    int count() const
+    {
+        int total = 0;
+        for (int r = 0; r < Runs; ++r)
+        {
+            total += runs[r].count;
+        }
+        return total;
+    }
 
-inline void matTransformPointXYZ(ddVec3 & result, ddVec3Param p, ddMat4x4Param m)
+    int capacity() const
+    {
+        int total = 0;
+        for (int r = 0; r < Runs; ++r)
+        {
+            total += runs[r].capacity;
+        }
+        return total;
+    }
+
+    WheelLink & link(const int entry) { return runs[entry % Runs].links[entry / Runs]; }
+
+    // ItemsPerEntry items to fill in. Null if the run is full and can't grow.
+    T * push(const ddI64 expiryMillis, const int run)
+    {
+        Run & r = runs[run];
+        if (r.count == r.capacity)
+        {
+            const int grown = grownCapacity(r.capacity, initialEntries, maxEntries);
+            if (grown == 0 || !resize(r, grown))
+            {
+                return DD_NULL;
+            }
+        }
+
+        const int index = r.count++;
+        r.links[index].expiryMillis = expiryMillis;
+        insert((index * Runs) + run, wheelSlot(expiryMillis, nextTick));
+        return &r.items[index * ItemsPerEntry];
+    }
+
+    // Moves a run to new storage of 'newCapacity' (>= its count) entries.
+    // Every item is constructed, as callers assign to the ones they push.
+    bool resize(Run & r, const int newCapacity)
+    {
+        const int itemCount  = newCapacity * ItemsPerEntry;
+        T * newItems         = static_cast<T *>(DD_MALLOC(itemCount * sizeof(T)));
+        WheelLink * newLinks = static_cast<WheelLink *>(DD_MALLOC(newCapacity * sizeof(WheelLink)));
+        if (newItems == DD_NULL || newLinks == DD_NULL)
+        {
+            freeStorage(newItems, newLinks, 0);
+            return false;
+        }
+
+        const int moved = r.count * ItemsPerEntry;
+        for (int i = 0; i < moved; ++i)
+        {
+            new (&newItems[i]) T(DD_MOVE(r.items[i]));
+        }
+        for (int i = moved; i < itemCount; ++i)
+        {
+            new (&newItems[i]) T();
+        }
+        if (r.count > 0)
+        {
+            std::memcpy(newLinks, r.links, r.count * sizeof(WheelLink));
+        }
+
+        freeStorage(r.items, r.links, r.capacity);
+        r.items    = newItems;
+        r.links    = newLinks;
+        r.capacity = newCapacity;
+        return true;
+    }
+
+    // Destroys the first 'capacity' entries of 'items' and frees both.
+    static void freeStorage(T * items, WheelLink * links, const int capacity)
+    {
+        if (items != DD_NULL)
+        {
+            for (int i = 0; i < capacity * ItemsPerEntry; ++i)
+            {
+                items[i].~T();
+            }
+            DD_MFREE(items);
+        }
+        if (links != DD_NULL)
+        {
+            DD_MFREE(links);
+        }
+    }
+
+    void insert(const int entry, const int slot)
+    {
+        WheelLink & l = link(entry);
+        l.slot = slot;
+        l.prev = WheelNil;
+        l.next = heads[slot];
+        if (l.next != WheelNil)
+        {
+            link(l.next).prev = entry;
+        }
+        heads[slot] = entry;
+    }
+
+    // Takes the first entry out of 'slot'. WheelNil if it's empty.
+    int pop(const int slot)
+    {
+        const int entry = heads[slot];
+        if (entry != WheelNil)
+        {
+            heads[slot] = link(entry).next;
+            if (heads[slot] != WheelNil)
+            {
+                link(heads[slot]).prev = WheelNil;
+            }
+        }
+        return entry;
+    }
+
+    // Drops a popped entry, filling its place with the last one of its run.
+    void remove(const int entry)
+    {
+        Run & r         = runs[entry % Runs];
+        const int index = entry / Runs;
+        const int last  = --r.count;
+        if (index == last)
+        {
+            return;
+        }
+
+        for (int i = 0; i < ItemsPerEntry; ++i)
+        {
+            r.items[(index * ItemsPerEntry) + i] = DD_MOVE(r.items[(last * ItemsPerEntry) + i]);
+        }
+        const WheelLink & moved = r.links[index] = r.links[last];
+        if (moved.prev != WheelNil)
+        {
+            link(moved.prev).next = entry;
+        }
+        else
+        {
+            heads[moved.slot] = entry;
+        }
+        if (moved.next != WheelNil)
+        {
+            link(moved.next).prev = entry;
+        }
+    }
+
+    // Moves a slot's entries into the pending list, then expires or places
+    // each again. A moved entry keeps its links, so the list stays walkable.
+    void drain(const int slot, const ddI64 nowMillis)
+    {
+        heads[WheelPending] = heads[slot];
+        heads[slot]         = WheelNil;
+        for (int entry = heads[WheelPending]; entry != WheelNil; entry = link(entry).next)
+        {
+            link(entry).slot = WheelPending;
+        }
+
+        for (int entry = pop(WheelPending); entry != WheelNil; entry = pop(WheelPending))
+        {
+            const ddI64 expiry = link(entry).expiryMillis;
+            if (expiry <= nowMillis)
+            {
+                remove(entry);
+            }
+            else
+            {
+                insert(entry, wheelSlot(expiry, nextTick));
+            }
+        }
+    }
+
+    // Expires everything due at or before 'nowMillis'.
+    void advance(const ddI64 nowMillis)
+    {
+        if (count() == 0)
+        {
+            nextTick = (nowMillis + 1 > nextTick) ? nowMillis + 1 : nextTick;
+            return;
+        }
+
+        // After a long gap (first flush, app paused) re-placing everything
+        // once is cheaper than visiting every tick in between.
+        if ((nowMillis - nextTick) >= wheelSpan(1))
+        {
+            nextTick = nowMillis + 1;
+            for (int slot = 0; slot < WheelSlots; ++slot)
+            {
+                if (heads[slot] != WheelNil)
+                {
+                    drain(slot, nowMillis);
+                }
+            }
+            return;
+        }
+
+        for (; nextTick <= nowMillis; ++nextTick)
+        {
+            // Whenever a level wraps, its next slot down from the level above:
+            for (int level = 1; level < WheelLevels; ++level)
+            {
+                const int shift = WheelLevel0Bits + ((level - 1) * WheelLevelNBits);
+                if ((nextTick & ((ddI64(1) << shift) - 1)) != 0)
+                {
+                    break;
+                }
+                const int slot = WheelLevel0Slots + ((level - 1) * WheelLevelNSlots) +
+                                 static_cast<int>((nextTick >> shift) & (WheelLevelNSlots - 1));
+                if (heads[slot] != WheelNil)
+                {
+                    drain(slot, nextTick - 1);
+                }
+            }
+
+            const int slot = static_cast<int>(nextTick & (WheelLevel0Slots - 1));
+            if (heads[slot] != WheelNil)
+            {
+                drain(slot, nextTick);
+            }
+        }
+    }
+
+    void trim()
+    {
+        for (int r = 0; r < Runs; ++r)
+        {
+            const int shrunk = shrunkCapacity(runs[r].shrink, runs[r].capacity, initialEntries);
+            if (shrunk != 0)
+            {
+                resize(runs[r], shrunk);
+            }
+        }
+    }
+
+    void noteQueued()
+    {
+        for (int r = 0; r < Runs; ++r)
+        {
+            runs[r].shrink.note(runs[r].count);
+        }
+    }
+
+    void clear()
+    {
+        for (int r = 0; r < Runs; ++r)
+        {
+            runs[r].count = 0;
+        }
+        for (int slot = 0; slot <= WheelSlots; ++slot)
+        {
+            heads[slot] = WheelNil;
+        }
+    }
+};
+
+typedef TimedQueue<DebugString, 1, 1> TimedStringQueue;
+typedef TimedQueue<DrawVertex,  1, 2> TimedPointQueue; // Run 0 depth-tested, run 1 depth-less
+typedef TimedQueue<DrawVertex,  2, 2> TimedLineQueue;
+typedef TimedQueue<ShapeInstance, 1, 2> TimedShapeQueue;
+
+// The one-frame and timed instances of one ShapeType.
+struct ShapeQueues
+{
+    DebugShapeQueue queue;
+    TimedShapeQueue timed;
+
+    ShapeQueues()
+        : queue(DEBUG_DRAW_INITIAL_SHAPES, DEBUG_DRAW_MAX_SHAPES)
+        , timed(DEBUG_DRAW_INITIAL_SHAPES, DEBUG_DRAW_MAX_SHAPES)
+    { }
+
+    int count() const { return queue.count() + timed.count(); }
+};
+
+#if DEBUG_DRAW_THREAD_QUEUES
+struct ThreadQueue;
+#endif // DEBUG_DRAW_THREAD_QUEUES
+
+// What a ContextHandle points to.
+struct ContextImpl
+{
+    // One-frame debug strings (2D screen-space strings + 3D projected labels):
+    int debugStringsCount;
+    int debugStringsCapacity;
+    DebugString * debugStrings;
+    ShrinkWindow debugStringsShrink;
+
+    // One-frame 3D debug points and lines:
+    DebugPointQueue debugPoints;
+    DebugLineQueue debugLines;
+
+    // Everything with a lifetime:
+    TimedStringQueue timedStrings;
+    TimedPointQueue timedPoints;
+    TimedLineQueue timedLines;
+
+    // Spheres, cones, circles and boxes, when the RenderInterface draws them
+    // as instances (shapeInstances); otherwise they are queued as lines.
+    ShapeQueues shapes[ShapeTypeCount];
+    bool shapeInstances;
+
+    QueueUsage stringsUsage;
+    QueueUsage pointsUsage;
+    QueueUsage linesUsage;
+    QueueUsage shapesUsage;
+
+    // Temporary vertex buffer we use to expand the glyphs, and to gather the
+    // lines and points that pass culling, before calling on RenderInterface.
+    // DEBUG_DRAW_VERTEX_BUFFER_SIZE entries once first needed, null before.
+    int vertexBufferUsed;
+    DrawVertex * vertexBuffer;
+
+    // The shape instances that pass culling, DEBUG_DRAW_SHAPE_BATCH_SIZE
+    // entries once first needed.
+    ShapeInstance * shapeBuffer;
+
+    // Frustum from setCullFrustum(): six normalized planes (nx, ny, nz, d),
+    // a point p is inside where dot(n, p) + d >= 0 for all of them.
+    float cullPlanes[6][4];
+    bool cullEnabled;
+
+    // The strings of the last flush, in drawing order. Only valid if their
+    // glyphs all fit in vertexBuffer at once (glyphRunsSplit false).
+    int glyphRunCount;
+    int glyphRunCapacity;
+    GlyphRun * glyphRuns;
+    bool glyphRunsSplit;
+
+    // Latest time value (in milliseconds) from dd::flush().
+    ddI64 currentTimeMillis;
+
+    // Ref to the external renderer. Can be null for a no-op debug draw.
+    RenderInterface * renderInterface;
+
+    // Our built-in glyph bitmap, created by the first flush with text.
+    // glyphTexFailed is set if that fails; text is dropped from then on.
+    GlyphTextureHandle glyphTex;
+    bool glyphTexFailed;
+
+    #if DEBUG_DRAW_THREAD_QUEUES
+    // Rings of the threads, other than the owner, that submitted to this context.
+    const void * ownerThread;
+    ddU32 serial;
+    std::atomic<int> threadQueueCount;
+    std::atomic<ThreadQueue *> threadQueues[DEBUG_DRAW_MAX_THREADS];
+    #endif // DEBUG_DRAW_THREAD_QUEUES
+
+    explicit ContextImpl(RenderInterface * renderer)
+        : debugStringsCount(0)
+        , debugStringsCapacity(0)
+        , debugStrings(DD_NULL)
+        , debugPoints(DEBUG_DRAW_INITIAL_POINTS, DEBUG_DRAW_MAX_POINTS)
+        , debugLines(DEBUG_DRAW_INITIAL_LINES, DEBUG_DRAW_MAX_LINES)
+        , timedStrings(DEBUG_DRAW_INITIAL_STRINGS, DEBUG_DRAW_MAX_STRINGS)
+        , timedPoints(DEBUG_DRAW_INITIAL_POINTS, DEBUG_DRAW_MAX_POINTS)
+        , timedLines(DEBUG_DRAW_INITIAL_LINES, DEBUG_DRAW_MAX_LINES)
+        , shapeInstances(false)
+        , vertexBufferUsed(0)
+        , vertexBuffer(DD_NULL)
+        , shapeBuffer(DD_NULL)
+        , cullEnabled(false)
+        , glyphRunCount(0)
+        , glyphRunCapacity(0)
+        , glyphRuns(DD_NULL)
+        , glyphRunsSplit(false)
+        , currentTimeMillis(0)
+        , renderInterface(renderer)
+        , glyphTex(DD_NULL)
+        , glyphTexFailed(false)
+    { }
+
+    ~ContextImpl()
+    {
+        freeObjects(debugStrings, debugStringsCapacity);
+        freeObjects(glyphRuns, glyphRunCapacity);
+        DD_MFREE(vertexBuffer);
+        DD_MFREE(shapeBuffer);
+    }
+
+    int shapesCount() const
+    {
+        int count = 0;
+        for (int type = 0; type < ShapeTypeCount; ++type)
+        {
+            count += shapes[type].count();
+        }
+        return count;
+    }
+
+    // Moves the queued strings to new storage of 'newCapacity' (>= debugStringsCount) entries.
+    // False, keeping the old storage, if it can't be allocated.
+    bool resizeStrings(const int newCapacity)
+    {
+        DebugString * newStrings = reallocObjects(debugStrings, debugStringsCount, debugStringsCapacity, newCapacity);
+        if (newStrings == DD_NULL)
+        {
+            return false;
+        }
+        debugStrings         = newStrings;
+        debugStringsCapacity = newCapacity;
+        return true;
+    }
+};
+
+// The calling thread's current context.
+static DD_THREAD_LOCAL ContextImpl * t_currentContext = DD_NULL;
+
+// Room for one more string, growing the queue if needed. False at
+// DEBUG_DRAW_MAX_STRINGS or if the queue can't grow.
+bool reserveString(ContextImpl & ctx)
+{
+    if (ctx.debugStringsCount < ctx.debugStringsCapacity)
+    {
+        return true;
+    }
+    const int grown = grownCapacity(ctx.debugStringsCapacity, DEBUG_DRAW_INITIAL_STRINGS, DEBUG_DRAW_MAX_STRINGS);
+    return grown != 0 && ctx.resizeStrings(grown);
+}
+
+// Storage for a new string on the owner thread: one-frame strings go on the
+// plain queue, the rest on the timing wheel. Null, counted as dropped, at
+// DEBUG_DRAW_MAX_STRINGS or when the queue can't grow.
+DebugString * pushString(ContextImpl & ctx, const int durationMillis)
+{
+    DebugString * dstr = DD_NULL;
+    const ddI64 expiry = ctx.currentTimeMillis + durationMillis;
+    if ((ctx.debugStringsCount + ctx.timedStrings.count()) < DEBUG_DRAW_MAX_STRINGS)
+    {
+        if (durationMillis > 0)
+        {
+            dstr = ctx.timedStrings.push(expiry, 0);
+        }
+        else if (reserveString(ctx))
+        {
+            dstr = &ctx.debugStrings[ctx.debugStringsCount++];
+        }
+    }
+
+    if (dstr == DD_NULL)
+    {
+        ++ctx.stringsUsage.dropped;
+        return DD_NULL;
+    }
+    dstr->expiryDateMillis = expiry;
+    return dstr;
+}
+
+// Same as pushString() for points, lines (two vertexes per entry) and shapes.
+template<typename T, int ItemsPerEntry, typename Timed>
+T * pushEntry(ContextImpl & ctx, DebugQueue<T, ItemsPerEntry> & queue, Timed & timed,
+              QueueUsage & usage, const int durationMillis, const bool depthEnabled)
+{
+    T * entry = DD_NULL;
+    if ((queue.count() + timed.count()) < queue.maxEntries)
+    {
+        entry = (durationMillis > 0) ? timed.push(ctx.currentTimeMillis + durationMillis, depthEnabled ? 0 : 1)
+                                     : queue.push(depthEnabled);
+    }
+
+    if (entry == DD_NULL)
+    {
+        ++usage.dropped;
+    }
+    return entry;
+}
+
+// Reports the first drop of each flush only, so a frame that overruns the
+// cap doesn't flood the log.
+void reportDropped(const QueueUsage & usage, const char * message)
+{
+    (void)message; // DEBUG_DRAW_OVERFLOWED may ignore it.
+    if (usage.dropped == 1)
+    {
+        DEBUG_DRAW_OVERFLOWED(message);
+    }
+}
+
+// Publishes what getFrameStats() reports for a type and starts counting drops anew.
+void recordFrameStats(QueueUsage & usage, const int queued, const int capacity, const int maxEntries)
+{
+    usage.last.highWater  = queued;
+    usage.last.capacity   = capacity;
+    usage.last.maxEntries = maxEntries;
+    usage.last.dropped    = usage.dropped;
+    usage.last.culled     = usage.culled;
+    usage.dropped         = 0;
+    usage.culled          = 0;
+}
+
+// Gives back memory a past burst left behind. Once per flush.
+void trimQueues(ContextImpl & ctx)
+{
+    const int shrunk = shrunkCapacity(ctx.debugStringsShrink, ctx.debugStringsCapacity, DEBUG_DRAW_INITIAL_STRINGS);
+    if (shrunk != 0)
+    {
+        ctx.resizeStrings(shrunk); // Else the larger storage stays.
+    }
+    ctx.debugPoints.trim();
+    ctx.debugLines.trim();
+    ctx.timedStrings.trim();
+    ctx.timedPoints.trim();
+    ctx.timedLines.trim();
+    for (int type = 0; type < ShapeTypeCount; ++type)
+    {
+        ctx.shapes[type].queue.trim();
+        ctx.shapes[type].timed.trim();
+    }
+}
+
+// ========================================================
+// ddVec3 helpers:
+// ========================================================
+
+enum { X, Y, Z, W };
+
+inline void vecSet(ddVec3 & dest, const float x, const float y, const float z)
+{
+    dest[X] = x;
+    dest[Y] = y;
+    dest[Z] = z;
+}
+
+inline void vecCopy(ddVec3 & dest, ddVec3Param src)
+{
+    dest[X] = src[X];
+    dest[Y] = src[Y];
+    dest[Z] = src[Z];
+}
+
+inline void vecAdd(ddVec3 & result, ddVec3Param a, ddVec3Param b)
+{
+    result[X] = a[X] + b[X];
+    result[Y] = a[Y] + b[Y];
+    result[Z] = a[Z] + b[Z];
+}
+
+inline void vecSub(ddVec3 & result, ddVec3Param a, ddVec3Param b)
+{
+    result[X] = a[X] - b[X];
+    result[Y] = a[Y] - b[Y];
+    result[Z] = a[Z] - b[Z];
+}
+
+inline void vecScale(ddVec3 & result, ddVec3Param v, const float s)
+{
+    result[X] = v[X] * s;
+    result[Y] = v[Y] * s;
+    result[Z] = v[Z] * s;
+}
+
+inline void vecNormalize(ddVec3 & result, ddVec3Param v)
+{
+    const float lenSqr = v[X] * v[X] + v[Y] * v[Y] + v[Z] * v[Z];
+    const float invLen = DD_INV_FSQRT(lenSqr);
+    result[X] = v[X] * invLen;
+    result[Y] = v[Y] * invLen;
+    result[Z] = v[Z] * invLen;
+}
+
+inline void vecOrthogonalBasis(ddVec3 & left, ddVec3 & up, ddVec3Param v)
+{
+    // Produces two orthogonal vectors for normalized vector v.
+    float lenSqr, invLen;
+    if (DD_FABS(v[Z]) > 0.7f)
+    {
+        lenSqr = v[Y] * v[Y] + v[Z] * v[Z];
+        invLen = DD_INV_FSQRT(lenSqr);
+        up[X] = 0.0f;
+        up[Y] =  v[Z] * invLen;
+        up[Z] = -v[Y] * invLen;
+        left[X] = lenSqr * invLen;
+        left[Y] = -v[X] * up[Z];
+        left[Z] =  v[X] * up[Y];
+    }
+    else
+    {
+        lenSqr = v[X] * v[X] + v[Y] * v[Y];
+        invLen = DD_INV_FSQRT(lenSqr);
+        left[X] = -v[Y] * invLen;
+        left[Y] =  v[X] * invLen;
+        left[Z] = 0.0f;
+        up[X] = -v[Z] * left[Y];
+        up[Y] =  v[Z] * left[X];
+        up[Z] = lenSqr * invLen;
+    }
+}
+
+// ========================================================
+// ddMat4x4 helpers:
+// ========================================================
+
+inline void matTransformPointXYZ(ddVec3 & result, ddVec3Param p, ddMat4x4Param m)
+{
+    result[X] = (m[0] * p[X]) + (m[4] * p[Y]) + (m[8]  * p[Z]) + m[12]; // p[W] assumed to be 1
+    result[Y] = (m[1] * p[X]) + (m[5] * p[Y]) + (m[9]  * p[Z]) + m[13];
+    result[Z] = (m[2] * p[X]) + (m[6] * p[Y]) + (m[10] * p[Z]) + m[14];
+}
+
+inline void matTransformPointXYZW(float result[4], ddVec3Param p, ddMat4x4Param m)
+{
+    result[X] = (m[0] * p[X]) + (m[4] * p[Y]) + (m[8]  * p[Z]) + m[12]; // p[W] assumed to be 1
+    result[Y] = (m[1] * p[X]) + (m[5] * p[Y]) + (m[9]  * p[Z]) + m[13];
+    result[Z] = (m[2] * p[X]) + (m[6] * p[Y]) + (m[10] * p[Z]) + m[14];
+    result[W] = (m[3] * p[X]) + (m[7] * p[Y]) + (m[11] * p[Z]) + m[15];
+}
+
+inline float matTransformPointXYZW2(ddVec3 & result, const float p[3], ddMat4x4Param m)
+{
+    result[X] = (m[0] * p[X]) + (m[4] * p[Y]) + (m[8]  * p[Z]) + m[12]; // p[W] assumed to be 1
+    result[Y] = (m[1] * p[X]) + (m[5] * p[Y]) + (m[9]  * p[Z]) + m[13];
+    result[Z] = (m[2] * p[X]) + (m[6] * p[Y]) + (m[10] * p[Z]) + m[14];
+    float rw  = (m[3] * p[X]) + (m[7] * p[Y]) + (m[11] * p[Z]) + m[15];
+    return rw;
+}
+
+// ========================================================
+// DrawVertex writers:
+// ========================================================
+
+// A color as the vertices store it, converted once per primitive. 'a' is
+// the point size, or 255 for lines and glyphs.
+#if DEBUG_DRAW_PACKED_VERTEX
+
+struct VertColor
+{
+    ddU32 rgba;
+};
+
+inline VertColor vertColor(ddVec3Param color, const float a)
+{
+    VertColor c;
+    #if defined(DD_SIMD_SSE2)
+    const __m128 scaled = _mm_mul_ps(_mm_setr_ps(color[X], color[Y], color[Z], a),
+                                     _mm_setr_ps(255.0f, 255.0f, 255.0f, 1.0f));
+    const __m128 clamped = _mm_min_ps(_mm_max_ps(scaled, _mm_setzero_ps()), _mm_set1_ps(255.0f));
+    const __m128i words  = _mm_packs_epi32(_mm_cvtps_epi32(clamped), _mm_setzero_si128());
+    c.rgba = static_cast<ddU32>(_mm_cvtsi128_si32(_mm_packus_epi16(words, words)));
+    #elif defined(DD_SIMD_NEON)
+    const float32x4_t rgba    = { color[X], color[Y], color[Z], a };
+    const float32x4_t scale   = { 255.0f, 255.0f, 255.0f, 1.0f };
+    const float32x4_t clamped = vminq_f32(vmaxq_f32(vmulq_f32(rgba, scale), vdupq_n_f32(0.0f)), vdupq_n_f32(255.0f));
+    const uint16x4_t  words   = vmovn_u32(vcvtq_u32_f32(vaddq_f32(clamped, vdupq_n_f32(0.5f))));
+    c.rgba = vget_lane_u32(vreinterpret_u32_u8(vmovn_u16(vcombine_u16(words, words))), 0);
+    #else // !DD_SIMD_SSE2 && !DD_SIMD_NEON
+    const float scaled[4] = { color[X] * 255.0f, color[Y] * 255.0f, color[Z] * 255.0f, a };
+    UByte bytes[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        const float v = (scaled[i] < 0.0f) ? 0.0f : (scaled[i] > 255.0f) ? 255.0f : scaled[i];
+        bytes[i] = static_cast<UByte>(v + 0.5f);
+    }
+    std::memcpy(&c.rgba, bytes, sizeof(c.rgba));
+    #endif // DD_SIMD_SSE2 / DD_SIMD_NEON
+    return c;
+}
+
+inline void setPointVert(DrawVertex & v, ddVec3Param pos, const VertColor & c)
+{
+    v.point.x     = pos[X];
+    v.point.y     = pos[Y];
+    v.point.z     = pos[Z];
+    v.point.color = c.rgba;
+}
+
+inline void setLineVert(DrawVertex & v, ddVec3Param pos, const VertColor & c)
+{
+    v.line.x     = pos[X];
+    v.line.y     = pos[Y];
+    v.line.z     = pos[Z];
+    v.line.color = c.rgba;
+}
+
+inline void setGlyphVert(DrawVertex & v, const float x, const float y, const float u, const float t,
+                         const VertColor & c)
+{
+    v.glyph.x     = x;
+    v.glyph.y     = y;
+    v.glyph.u     = static_cast<unsigned short>(u * 65535.0f + 0.5f);
+    v.glyph.v     = static_cast<unsigned short>(t * 65535.0f + 0.5f);
+    v.glyph.color = c.rgba;
+}
+
+#else // !DEBUG_DRAW_PACKED_VERTEX
+
+struct VertColor
+{
+    float r, g, b, a;
+};
+
+inline VertColor vertColor(ddVec3Param color, const float a)
+{
+    const VertColor c = { color[X], color[Y], color[Z], a };
+    return c;
+}
+
+inline void setPointVert(DrawVertex & v, ddVec3Param pos, const VertColor & c)
+{
+    v.point.x    = pos[X];
+    v.point.y    = pos[Y];
+    v.point.z    = pos[Z];
+    v.point.r    = c.r;
+    v.point.g    = c.g;
+    v.point.b    = c.b;
+    v.point.size = c.a;
+}
+
+inline void setLineVert(DrawVertex & v, ddVec3Param pos, const VertColor & c)
+{
+    v.line.x = pos[X];
+    v.line.y = pos[Y];
+    v.line.z = pos[Z];
+    v.line.r = c.r;
+    v.line.g = c.g;
+    v.line.b = c.b;
+}
+
+inline void setGlyphVert(DrawVertex & v, const float x, const float y, const float u, const float t,
+                         const VertColor & c)
+{
+    v.glyph.x = x;
+    v.glyph.y = y;
+    v.glyph.u = u;
+    v.glyph.v = t;
+    v.glyph.r = c.r;
+    v.glyph.g = c.g;
+    v.glyph.b = c.b;
+}
+
+#endif // DEBUG_DRAW_PACKED_VERTEX
+
+// ========================================================
+// Frustum culling (setCullFrustum()):
+// ========================================================
+
+//
+// Four primitives to test at once, as separate arrays: each is the segment
+// from p0 to p1 swept by a sphere of radius r. Points and spheres have
+// p1 = p0, lines r = 0.
+//
+struct CullBatch
+{
+    float x0[4], y0[4], z0[4];
+    float x1[4], y1[4], z1[4];
+    float r[4];
+
+    void set(const int i, const float * p0, const float * p1, const float radius)
+    {
+        x0[i] = p0[X]; y0[i] = p0[Y]; z0[i] = p0[Z];
+        x1[i] = p1[X]; y1[i] = p1[Y]; z1[i] = p1[Z];
+        r[i]  = radius;
+    }
+};
+
+#if defined(DD_SIMD_SSE)
+// Bits of the lanes not wholly outside a cull plane, see visibleMask().
+inline int visibleLanes(const ContextImpl & ctx, const __m128 x0, const __m128 y0, const __m128 z0,
+                        const __m128 x1, const __m128 y1, const __m128 z1, const __m128 negR)
+{
+    __m128 outside = _mm_setzero_ps();
+    for (int p = 0; p < 6; ++p)
+    {
+        const __m128 nx = _mm_set1_ps(ctx.cullPlanes[p][0]);
+        const __m128 ny = _mm_set1_ps(ctx.cullPlanes[p][1]);
+        const __m128 nz = _mm_set1_ps(ctx.cullPlanes[p][2]);
+        const __m128 d  = _mm_set1_ps(ctx.cullPlanes[p][3]);
+        const __m128 d0 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, x0), _mm_mul_ps(ny, y0)), _mm_add_ps(_mm_mul_ps(nz, z0), d));
+        const __m128 d1 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, x1), _mm_mul_ps(ny, y1)), _mm_add_ps(_mm_mul_ps(nz, z1), d));
+        outside = _mm_or_ps(outside, _mm_and_ps(_mm_cmplt_ps(d0, negR), _mm_cmplt_ps(d1, negR)));
+    }
+    return ~_mm_movemask_ps(outside) & 0xF;
+}
+
+// x, y and z of four DrawVertex positions, as lanes.
+inline void loadPositions(const DrawVertex * const verts[4], const int index, __m128 & x, __m128 & y, __m128 & z)
+{
+    __m128 w; // The first color channel, unused.
+    x = _mm_loadu_ps(&verts[0][index].line.x);
+    y = _mm_loadu_ps(&verts[1][index].line.x);
+    z = _mm_loadu_ps(&verts[2][index].line.x);
+    w = _mm_loadu_ps(&verts[3][index].line.x);
+    _MM_TRANSPOSE4_PS(x, y, z, w);
+}
+#elif defined(DD_SIMD_NEON)
+inline int visibleLanes(const ContextImpl & ctx, const float32x4_t x0, const float32x4_t y0, const float32x4_t z0,
+                        const float32x4_t x1, const float32x4_t y1, const float32x4_t z1, const float32x4_t negR)
+{
+    uint32x4_t outside = vdupq_n_u32(0);
+    for (int p = 0; p < 6; ++p)
+    {
+        const float * plane = ctx.cullPlanes[p];
+        const float32x4_t d  = vdupq_n_f32(plane[3]);
+        const float32x4_t d0 = vaddq_f32(vaddq_f32(vmulq_n_f32(x0, plane[0]), vmulq_n_f32(y0, plane[1])),
+                                         vaddq_f32(vmulq_n_f32(z0, plane[2]), d));
+        const float32x4_t d1 = vaddq_f32(vaddq_f32(vmulq_n_f32(x1, plane[0]), vmulq_n_f32(y1, plane[1])),
+                                         vaddq_f32(vmulq_n_f32(z1, plane[2]), d));
+        outside = vorrq_u32(outside, vandq_u32(vcltq_f32(d0, negR), vcltq_f32(d1, negR)));
+    }
+    static const ddU32 laneBits[4] = { 1, 2, 4, 8 };
+    const uint32x4_t bits = vandq_u32(outside, vld1q_u32(laneBits));
+    const uint32x2_t half = vorr_u32(vget_low_u32(bits), vget_high_u32(bits));
+    return ~(vget_lane_u32(half, 0) | vget_lane_u32(half, 1)) & 0xF;
+}
+
+inline void loadPositions(const DrawVertex * const verts[4], const int index,
+                          float32x4_t & x, float32x4_t & y, float32x4_t & z)
+{
+    const float32x4x2_t t0 = vtrnq_f32(vld1q_f32(&verts[0][index].line.x), vld1q_f32(&verts[1][index].line.x));
+    const float32x4x2_t t1 = vtrnq_f32(vld1q_f32(&verts[2][index].line.x), vld1q_f32(&verts[3][index].line.x));
+    x = vcombine_f32(vget_low_f32(t0.val[0]),  vget_low_f32(t1.val[0]));
+    y = vcombine_f32(vget_low_f32(t0.val[1]),  vget_low_f32(t1.val[1]));
+    z = vcombine_f32(vget_high_f32(t0.val[0]), vget_high_f32(t1.val[0]));
+}
+#endif // DD_SIMD_SSE / DD_SIMD_NEON
+
+// Bit i is set if primitive i of the batch is not wholly outside any of the
+// cull planes, that is unless both ends are more than r behind the same one.
+int visibleMask(const ContextImpl & ctx, const CullBatch & batch)
+{
+    #if defined(DD_SIMD_SSE)
+    return visibleLanes(ctx, _mm_loadu_ps(batch.x0), _mm_loadu_ps(batch.y0), _mm_loadu_ps(batch.z0),
+                        _mm_loadu_ps(batch.x1), _mm_loadu_ps(batch.y1), _mm_loadu_ps(batch.z1),
+                        _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(batch.r)));
+    #elif defined(DD_SIMD_NEON)
+    return visibleLanes(ctx, vld1q_f32(batch.x0), vld1q_f32(batch.y0), vld1q_f32(batch.z0),
+                        vld1q_f32(batch.x1), vld1q_f32(batch.y1), vld1q_f32(batch.z1),
+                        vnegq_f32(vld1q_f32(batch.r)));
+    #else // !DD_SIMD_SSE && !DD_SIMD_NEON
+    int mask = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+        bool outside = false;
+        for (int p = 0; p < 6 && !outside; ++p)
+        {
+            const float * plane = ctx.cullPlanes[p];
+            const float d0 = ((plane[0] * batch.x0[i]) + (plane[1] * batch.y0[i])) + ((plane[2] * batch.z0[i]) + plane[3]);
+            const float d1 = ((plane[0] * batch.x1[i]) + (plane[1] * batch.y1[i])) + ((plane[2] * batch.z1[i]) + plane[3]);
+            outside = (d0 < -batch.r[i]) && (d1 < -batch.r[i]);
+        }
+        mask |= outside ? 0 : (1 << i);
+    }
+    return mask;
+    #endif // DD_SIMD_SSE / DD_SIMD_NEON
+}
+
+// visibleMask() of four queued points or lines, straight from the queue:
+// vertex 0 and vertex 'last' of each are the ends, r is zero.
+int visibleEntries(const ContextImpl & ctx, const DrawVertex * const entries[4], const int last)
+{
+    #if defined(DD_SIMD_SSE)
+    __m128 x0, y0, z0, x1, y1, z1;
+    loadPositions(entries, 0, x0, y0, z0);
+    loadPositions(entries, last, x1, y1, z1);
+    return visibleLanes(ctx, x0, y0, z0, x1, y1, z1, _mm_setzero_ps());
+    #elif defined(DD_SIMD_NEON)
+    float32x4_t x0, y0, z0, x1, y1, z1;
+    loadPositions(entries, 0, x0, y0, z0);
+    loadPositions(entries, last, x1, y1, z1);
+    return visibleLanes(ctx, x0, y0, z0, x1, y1, z1, vdupq_n_f32(0.0f));
+    #else // !DD_SIMD_SSE && !DD_SIMD_NEON
+    CullBatch batch;
+    for (int i = 0; i < 4; ++i)
+    {
+        batch.set(i, &entries[i][0].line.x, &entries[i][last].line.x, 0.0f);
+    }
+    return visibleMask(ctx, batch);
+    #endif // DD_SIMD_SSE / DD_SIMD_NEON
+}
+
+inline bool sphereVisible(const ContextImpl & ctx, ddVec3Param center, const float radius)
+{
+    CullBatch batch;
+    for (int i = 0; i < 4; ++i)
+    {
+        batch.set(i, &center[X], &center[X], radius);
+    }
+    return (visibleMask(ctx, batch) & 1) != 0;
+}
+
+// Bounding sphere of a shape instance, from its unit mesh (see shapeMesh()).
+// dd's instance transforms have orthogonal columns, so the longest one
+// bounds how much the transform scales.
+void shapeBounds(const ShapeType type, const ShapeInstance & shape, float center[3], float & radius)
+{
+    const float * m = shape.transform;
+
+    float localZ = 0.0f; // Center of the unit mesh, on its z axis.
+    float localRadius = 1.0f;
+    if (type == ShapeCone)
+    {
+        // Rings of radius 'param' at z = 0 and 1 at z = 1.
+        const float ring = (DD_FABS(shape.param) > 1.0f) ? DD_FABS(shape.param) : 1.0f;
+        localZ = 0.5f;
+        const float radiusSqr = (ring * ring) + 0.25f;
+        localRadius = radiusSqr * DD_INV_FSQRT(radiusSqr);
+    }
+    else if (type == ShapeBox)
+    {
+        localRadius = 0.8660254f; // sqrt(3 * 0.5^2)
+    }
+
+    center[X] = m[3]  + (m[2]  * localZ);
+    center[Y] = m[7]  + (m[6]  * localZ);
+    center[Z] = m[11] + (m[10] * localZ);
+
+    const float scale0 = (m[0] * m[0]) + (m[4] * m[4]) + (m[8]  * m[8]);
+    const float scale1 = (m[1] * m[1]) + (m[5] * m[5]) + (m[9]  * m[9]);
+    const float scale2 = (m[2] * m[2]) + (m[6] * m[6]) + (m[10] * m[10]);
+    const float maxScale = (scale0 > scale1) ? (scale0 > scale2 ? scale0 : scale2) : (scale1 > scale2 ? scale1 : scale2);
+    radius = (maxScale > 0.0f) ? localRadius * maxScale * DD_INV_FSQRT(maxScale) : 0.0f;
+}
+
+// ========================================================
+// Misc local functions for draw queue management:
+// ========================================================
+
+enum DrawMode
+{
+    DrawModePoints,
+    DrawModeLines,
+    DrawModeText
+};
+
+// Allocates the vertex buffer on first use. False if out of memory.
+bool reserveVertexBuffer(ContextImpl & ctx)
+{
+    if (ctx.vertexBuffer == DD_NULL)
+    {
+        ctx.vertexBuffer = static_cast<DrawVertex *>(DD_MALLOC(DEBUG_DRAW_VERTEX_BUFFER_SIZE * sizeof(DrawVertex)));
+    }
+    return ctx.vertexBuffer != DD_NULL;
+}
+
+void flushDebugVerts(ContextImpl & ctx, const DrawMode mode, const bool depthEnabled)
+{
+    if (ctx.vertexBufferUsed == 0)
+    {
+        return;
+    }
+
+    switch (mode)
+    {
+    case DrawModePoints :
+        ctx.renderInterface->drawPointList(ctx.vertexBuffer, ctx.vertexBufferUsed, depthEnabled);
+        break;
+    case DrawModeLines :
+        ctx.renderInterface->drawLineList(ctx.vertexBuffer, ctx.vertexBufferUsed, depthEnabled);
+        break;
+    case DrawModeText :
+        ctx.renderInterface->drawGlyphList(ctx.vertexBuffer, ctx.vertexBufferUsed, ctx.glyphTex);
+        break;
+    } // switch (mode)
+
+    ctx.vertexBufferUsed = 0;
+}
+
+
+void pushGlyphVerts(ContextImpl & ctx, const DrawVertex verts[4])
+{
+    static const int indexes[6] = { 0, 1, 2, 2, 1, 3 };
+
+    // Make room for one more glyph (2 tris):
+    if ((ctx.vertexBufferUsed + 6) >= DEBUG_DRAW_VERTEX_BUFFER_SIZE)
+    {
+        flushDebugVerts(ctx, DrawModeText, false);
+        ctx.glyphRunsSplit = true; // What the runs point to is gone.
+    }
+
+    for (int i = 0; i < 6; ++i)
+    {
+        ctx.vertexBuffer[ctx.vertexBufferUsed++].glyph = verts[indexes[i]].glyph;
+    }
+}
+
+void pushStringGlyphs(ContextImpl & ctx, float x, float y, const char * text, ddVec3Param color, const float scaling)
+{
+    // Invariants for all characters:
+    const float initialX    = x;
+    const float scaleU      = static_cast<float>(getFontCharSet().bitmapWidth);
+    const float scaleV      = static_cast<float>(getFontCharSet().bitmapHeight);
+    const float fixedWidth  = static_cast<float>(getFontCharSet().charWidth);
+    const float fixedHeight = static_cast<float>(getFontCharSet().charHeight);
+    const float tabW        = fixedWidth  * 4.0f * scaling; // TAB = 4 spaces.
+    const float chrW        = fixedWidth  * scaling;
+    const float chrH        = fixedHeight * scaling;
+    const VertColor glyphColor = vertColor(color, 255.0f);
+
+    for (; *text != '\0'; ++text)
+    {
+        const int charVal = *text;
+        if (charVal >= FontCharSet::MaxChars)
+        {
+            continue;
+        }
+        if (charVal == ' ')
+        {
+            x += chrW;
+            continue;
+        }
+        if (charVal == '\t')
+        {
+            x += tabW;
+            continue;
+        }
+        if (charVal == '\n')
+        {
+            y += chrH;
+            x  = initialX;
+            continue;
+        }
+
+        const FontChar fontChar = getFontCharSet().chars[charVal];
+        const float u0 = (fontChar.x + 0.5f) / scaleU;
+        const float v0 = (fontChar.y + 0.5f) / scaleV;
+        const float u1 = u0 + (fixedWidth  / scaleU);
+        const float v1 = v0 + (fixedHeight / scaleV);
+
+        DrawVertex verts[4];
+        setGlyphVert(verts[0], x,        y,        u0, v0, glyphColor);
+        setGlyphVert(verts[1], x,        y + chrH, u0, v1, glyphColor);
+        setGlyphVert(verts[2], x + chrW, y,        u1, v0, glyphColor);
+        setGlyphVert(verts[3], x + chrW, y + chrH, u1, v1, glyphColor);
+
+        pushGlyphVerts(ctx, verts);
+        x += chrW;
+    }
+}
+
+float calcTextWidth(const char * text, const float scaling)
+{
+    const float fixedWidth = static_cast<float>(getFontCharSet().charWidth);
+    const float tabW = fixedWidth * 4.0f * scaling; // TAB = 4 spaces.
+    const float chrW = fixedWidth * scaling;
+
+    float x = 0.0f;
+    for (; *text != '\0'; ++text)
+    {
+        // Tabs are handled differently (4 spaces)
+        if (*text == '\t')
+        {
+            x += tabW;
+        }
+        else // Non-tab char (including whitespace)
+        {
+            x += chrW;
+        }
+    }
+
+    return x;
+}
+
+bool sameGlyphRun(const GlyphRun & run, const DebugString & dstr)
+{
+    return run.posX     == dstr.posX     &&
+           run.posY     == dstr.posY     &&
+           run.scaling  == dstr.scaling  &&
+           run.centered == dstr.centered &&
+           run.color[X] == dstr.color[X] &&
+           run.color[Y] == dstr.color[Y] &&
+           run.color[Z] == dstr.color[Z] &&
+           std::strcmp(run.text.c_str(), dstr.text.c_str()) == 0;
+}
+
+// Room for a run per string of this flush. False if it can't be allocated.
+bool reserveGlyphRuns(ContextImpl & ctx, const int count)
+{
+    if (count <= ctx.glyphRunCapacity)
+    {
+        return true;
+    }
+
+    int newCapacity = (ctx.glyphRunCapacity == 0) ? DEBUG_DRAW_INITIAL_STRINGS : ctx.glyphRunCapacity;
+    while (newCapacity < count)
+    {
+        newCapacity *= 2;
+    }
+    GlyphRun * newRuns = reallocObjects(ctx.glyphRuns, ctx.glyphRunCount, ctx.glyphRunCapacity, newCapacity);
+    if (newRuns == DD_NULL)
+    {
+        return false;
+    }
+    ctx.glyphRuns        = newRuns;
+    ctx.glyphRunCapacity = newCapacity;
+    return true;
+}
+
+// Expands the strings after the 'runCount' already pushed this flush.
+void pushDebugStrings(ContextImpl & ctx, const DebugString * strings, const int count, int & runCount)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        const DebugString & dstr = strings[i];
+
+        // Unchanged since the last flush, and nothing written over it since.
+        const int index = runCount++;
+        if (index < ctx.glyphRunCount && !ctx.glyphRunsSplit &&
+            ctx.glyphRuns[index].firstVert == ctx.vertexBufferUsed &&
+            sameGlyphRun(ctx.glyphRuns[index], dstr))
+        {
+            ctx.vertexBufferUsed += ctx.glyphRuns[index].vertCount;
+            continue;
+        }
+
+        const int firstVert = ctx.vertexBufferUsed;
+        if (dstr.centered)
+        {
+            // 3D Labels are centered at the point of origin, e.g. center-aligned.
+            const float offset = calcTextWidth(dstr.text.c_str(), dstr.scaling) * 0.5f;
+            pushStringGlyphs(ctx, dstr.posX - offset, dstr.posY, dstr.text.c_str(), dstr.color, dstr.scaling);
+        }
+        else
+        {
+            // Left-aligned
+            pushStringGlyphs(ctx, dstr.posX, dstr.posY, dstr.text.c_str(), dstr.color, dstr.scaling);
+        }
+
+        if (ctx.glyphRunsSplit)
+        {
+            continue; // Nothing will be reused until the text fits again.
+        }
+
+        GlyphRun & run = ctx.glyphRuns[index];
+        run.posX      = dstr.posX;
+        run.posY      = dstr.posY;
+        run.scaling   = dstr.scaling;
+        run.centered  = dstr.centered;
+        run.text      = dstr.text;
+        run.firstVert = firstVert;
+        run.vertCount = ctx.vertexBufferUsed - firstVert;
+        vecCopy(run.color, dstr.color);
+    }
+}
+
+// Creates the glyph texture on first use. False if there is none to draw with.
+bool setupGlyphTexture(ContextImpl & ctx)
 {
-    result[X] = (m[0] * p[X]) + (m[4] * p[Y]) + (m[8]  * p[Z]) + m[12]; // p[W] assumed to be 1
-    result[Y] = (m[1] * p[X]) + (m[5] * p[Y]) + (m[9]  * p[Z]) + m[13];
-    result[Z] = (m[2] * p[X]) + (m[6] * p[Y]) + (m[10] * p[Z]) + m[14];
+    if (ctx.glyphTex != DD_NULL)
+    {
+        return true;
+    }
+    if (ctx.glyphTexFailed || ctx.renderInterface == DD_NULL)
+    {
+        return false;
+    }
+
+    const UByte * bitmap = fontBitmap();
+    if (bitmap != DD_NULL) // Else failed to decompress. No font rendering available.
+    {
+        ctx.glyphTex = ctx.renderInterface->createGlyphTexture(
+                             getFontCharSet().bitmapWidth,
+                             getFontCharSet().bitmapHeight,
+                             bitmap);
+    }
+
+    ctx.glyphTexFailed = (ctx.glyphTex == DD_NULL);
+    return !ctx.glyphTexFailed;
 }
 
-inline void matTransformPointXYZW(float result[4], ddVec3Param p, ddMat4x4Param m)
+void drawDebugStrings(ContextImpl & ctx)
 {
-    result[X] = (m[0] * p[X]) + (m[4] * p[Y]) + (m[8]  * p[Z]) + m[12]; // p[W] assumed to be 1
-    result[Y] = (m[1] * p[X]) + (m[5] * p[Y]) + (m[9]  * p[Z]) + m[13];
-    result[Z] = (m[2] * p[X]) + (m[6] * p[Y]) + (m[10] * p[Z]) + m[14];
-    result[W] = (m[3] * p[X]) + (m[7] * p[Y]) + (m[11] * p[Z]) + m[15];
+    if (ctx.debugStringsCount == 0 && ctx.timedStrings.count() == 0)
+    {
+        return;
+    }
+
+    if (!setupGlyphTexture(ctx) || !reserveVertexBuffer(ctx))
+    {
+        return;
+    }
+
+    if (!reserveGlyphRuns(ctx, ctx.debugStringsCount + ctx.timedStrings.runs[0].count))
+    {
+        // The strings still draw, only nothing of them is kept to reuse.
+        ctx.glyphRunsSplit = true;
+    }
+
+    int runCount = 0;
+    pushDebugStrings(ctx, ctx.debugStrings, ctx.debugStringsCount, runCount);
+    pushDebugStrings(ctx, ctx.timedStrings.runs[0].items, ctx.timedStrings.runs[0].count, runCount);
+
+    // A split flush leaves no runs; the next one starts over.
+    ctx.glyphRunCount  = ctx.glyphRunsSplit ? 0 : runCount;
+    ctx.glyphRunsSplit = false;
+    flushDebugVerts(ctx, DrawModeText, false);
+}
+
+// drawQueuedVerts() with a cull frustum set: gathers the entries that pass
+// into the vertex buffer, four at a time, and hands it over whenever full.
+void drawCulledVerts(ContextImpl & ctx, const DrawMode mode, const DrawVertex * verts, const int count,
+                     const int vertsPerEntry, const bool depthEnabled, QueueUsage & usage)
+{
+    const int maxBatch   = DEBUG_DRAW_VERTEX_BUFFER_SIZE - (DEBUG_DRAW_VERTEX_BUFFER_SIZE % vertsPerEntry);
+    const int entryCount = count / vertsPerEntry;
+    const int last       = vertsPerEntry - 1; // Second end of a line, or the point again.
+
+    // The last flush's glyphs are about to be overwritten.
+    ctx.glyphRunCount = 0;
+
+    for (int first = 0; first < entryCount; first += 4)
+    {
+        // The last few are tested with copies of the final entry in the spare lanes.
+        const int n = (entryCount - first < 4) ? (entryCount - first) : 4;
+        const DrawVertex * entries[4];
+        for (int i = 0; i < 4; ++i)
+        {
+            entries[i] = verts + (first + (i < n ? i : n - 1)) * vertsPerEntry;
+        }
+        const int mask = visibleEntries(ctx, entries, last);
+
+        for (int i = 0; i < n; ++i)
+        {
+            if (mask & (1 << i))
+            {
+                if (ctx.vertexBufferUsed + vertsPerEntry > maxBatch)
+                {
+                    flushDebugVerts(ctx, mode, depthEnabled);
+                }
+                for (int v = 0; v < vertsPerEntry; ++v)
+                {
+                    ctx.vertexBuffer[ctx.vertexBufferUsed++] = entries[i][v];
+                }
+            }
+            else
+            {
+                ++usage.culled;
+            }
+        }
+    }
+    flushDebugVerts(ctx, mode, depthEnabled);
+}
+
+// Hands 'count' queued vertices to the RenderInterface in batches of at most
+// DEBUG_DRAW_VERTEX_BUFFER_SIZE, split on whole entries.
+void drawQueuedVerts(ContextImpl & ctx, const DrawMode mode, const DrawVertex * verts, int count,
+                     const int vertsPerEntry, const bool depthEnabled, QueueUsage & usage)
+{
+    if (ctx.cullEnabled && count > 0 && reserveVertexBuffer(ctx))
+    {
+        drawCulledVerts(ctx, mode, verts, count, vertsPerEntry, depthEnabled, usage);
+        return;
+    }
+
+    const int maxBatch = DEBUG_DRAW_VERTEX_BUFFER_SIZE - (DEBUG_DRAW_VERTEX_BUFFER_SIZE % vertsPerEntry);
+    while (count > 0)
+    {
+        const int batch = (count < maxBatch) ? count : maxBatch;
+        if (mode == DrawModePoints)
+        {
+            ctx.renderInterface->drawPointList(verts, batch, depthEnabled);
+        }
+        else
+        {
+            ctx.renderInterface->drawLineList(verts, batch, depthEnabled);
+        }
+        verts += batch;
+        count -= batch;
+    }
+}
+
+template<int VertsPerEntry, typename Timed>
+void drawDebugQueue(ContextImpl & ctx, const DrawMode mode, const DebugQueue<DrawVertex, VertsPerEntry> & queue,
+                    const Timed & timed, QueueUsage & usage)
+{
+    // Depth-tested runs first, then the depth-less ones, as before bucketing.
+    drawQueuedVerts(ctx, mode, queue.items, queue.depthCount * VertsPerEntry, VertsPerEntry, true, usage);
+    drawQueuedVerts(ctx, mode, timed.runs[0].items, timed.runs[0].count * VertsPerEntry, VertsPerEntry, true, usage);
+    drawQueuedVerts(ctx, mode, queue.items + (queue.capacity - queue.depthlessCount) * VertsPerEntry,
+                    queue.depthlessCount * VertsPerEntry, VertsPerEntry, false, usage);
+    drawQueuedVerts(ctx, mode, timed.runs[1].items, timed.runs[1].count * VertsPerEntry, VertsPerEntry, false, usage);
+}
+
+void drawDebugPoints(ContextImpl & ctx)
+{
+    drawDebugQueue(ctx, DrawModePoints, ctx.debugPoints, ctx.timedPoints, ctx.pointsUsage);
+}
+
+void drawDebugLines(ContextImpl & ctx)
+{
+    drawDebugQueue(ctx, DrawModeLines, ctx.debugLines, ctx.timedLines, ctx.linesUsage);
+}
+
+// drawQueuedShapes() with a cull frustum set: tests the instances' bounding
+// spheres four at a time and gathers the ones that pass in shapeBuffer.
+void drawCulledShapes(ContextImpl & ctx, const ShapeType type, const ShapeInstance * shapes, const int count,
+                      const bool depthEnabled)
+{
+    int used = 0;
+    for (int first = 0; first < count; first += 4)
+    {
+        const int n = (count - first < 4) ? (count - first) : 4;
+        CullBatch batch;
+        for (int i = 0; i < 4; ++i)
+        {
+            float center[3], radius;
+            shapeBounds(type, shapes[first + (i < n ? i : n - 1)], center, radius);
+            batch.set(i, center, center, radius);
+        }
+        const int mask = visibleMask(ctx, batch);
+
+        for (int i = 0; i < n; ++i)
+        {
+            if (mask & (1 << i))
+            {
+                if (used == DEBUG_DRAW_SHAPE_BATCH_SIZE)
+                {
+                    ctx.renderInterface->drawShapeList(type, ctx.shapeBuffer, used, depthEnabled);
+                    used = 0;
+                }
+                ctx.shapeBuffer[used++] = shapes[first + i];
+            }
+            else
+            {
+                ++ctx.shapesUsage.culled;
+            }
+        }
+    }
+    if (used > 0)
+    {
+        ctx.renderInterface->drawShapeList(type, ctx.shapeBuffer, used, depthEnabled);
+    }
+}
+
+// Shape instances go out in batches of at most DEBUG_DRAW_SHAPE_BATCH_SIZE.
+void drawQueuedShapes(ContextImpl & ctx, const ShapeType type, const ShapeInstance * shapes, int count,
+                      const bool depthEnabled)
+{
+    if (ctx.cullEnabled && count > 0)
+    {
+        if (ctx.shapeBuffer == DD_NULL)
+        {
+            ctx.shapeBuffer = static_cast<ShapeInstance *>(DD_MALLOC(DEBUG_DRAW_SHAPE_BATCH_SIZE * sizeof(ShapeInstance)));
+        }
+        if (ctx.shapeBuffer != DD_NULL)
+        {
+            drawCulledShapes(ctx, type, shapes, count, depthEnabled);
+            return;
+        }
+    }
+
+    while (count > 0)
+    {
+        const int batch = (count < DEBUG_DRAW_SHAPE_BATCH_SIZE) ? count : DEBUG_DRAW_SHAPE_BATCH_SIZE;
+        ctx.renderInterface->drawShapeList(type, shapes, batch, depthEnabled);
+        shapes += batch;
+        count  -= batch;
+    }
+}
+
+void drawDebugShapes(ContextImpl & ctx)
+{
+    for (int type = 0; type < ShapeTypeCount; ++type)
+    {
+        const ShapeType shapeType = static_cast<ShapeType>(type);
+        const DebugShapeQueue & queue = ctx.shapes[type].queue;
+        const TimedShapeQueue & timed = ctx.shapes[type].timed;
+        drawQueuedShapes(ctx, shapeType, queue.items, queue.depthCount, true);
+        drawQueuedShapes(ctx, shapeType, timed.runs[0].items, timed.runs[0].count, true);
+        drawQueuedShapes(ctx, shapeType, queue.items + (queue.capacity - queue.depthlessCount),
+                         queue.depthlessCount, false);
+        drawQueuedShapes(ctx, shapeType, timed.runs[1].items, timed.runs[1].count, false);
+    }
+}
+
+#if DEBUG_DRAW_THREAD_QUEUES
+
+// ========================================================
+// Per-thread submission rings (DEBUG_DRAW_THREAD_QUEUES):
+// ========================================================
+
+// A point or line added off the owner thread. Expiry is kept relative
+// until the entry is merged, since only the owner thread owns the clock.
+struct ThreadEntry
+{
+    DrawVertex verts[2];
+    int        vertCount; // 1 for a point, 2 for a line
+    int        durationMillis;
+    bool       depthEnabled;
+};
+
+// Ring with one producer (the owning thread) and one consumer (the thread
+// calling dd::flush()). Head and tail are padded apart so the two sides
+// don't keep stealing the same cache line from each other.
+template<typename T, int Size>
+struct SpscRing
+{
+    std::atomic<ddU32> head; // Next slot to write, advanced by the producer
+    char               headPad[64 - sizeof(std::atomic<ddU32>)];
+    std::atomic<ddU32> tail; // Next slot to read, advanced by the consumer
+    char               tailPad[64 - sizeof(std::atomic<ddU32>)];
+    T                  slots[Size];
+
+    SpscRing() : head(0), tail(0) { }
+
+    // Producer: slot to fill, or null if the ring is full. publish() makes it visible.
+    T * reserve()
+    {
+        const ddU32 h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) == static_cast<ddU32>(Size))
+        {
+            return DD_NULL;
+        }
+        return &slots[h & (Size - 1)];
+    }
+
+    void publish()
+    {
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+};
+
+enum ThreadQueueState
+{
+    ThreadQueueOwned,   // Its thread submits through it
+    ThreadQueueRetired, // Its thread exited; the next flush drains it
+    ThreadQueueFree     // Drained, for the next thread that registers
+};
+
+struct ThreadQueue
+{
+    std::atomic<const void *> ownerThread; // See currentThread(); null once retired
+    std::atomic<int>          state;       // ThreadQueueState
+    std::atomic<int>          refs;        // The context's, plus the owning thread's
+    ThreadQueue *             nextOfThread; // The owning thread's rings in other contexts
+    SpscRing<ThreadEntry, DEBUG_DRAW_THREAD_QUEUE_SIZE>    entries;
+    SpscRing<DebugString, DEBUG_DRAW_THREAD_QUEUE_STRINGS> strings;
+
+    ThreadQueue() : ownerThread(DD_NULL), state(ThreadQueueOwned), refs(1), nextOfThread(DD_NULL) { }
+};
+
+// Drops a reference to 'queue', deleting it with the last one. The context
+// and the owning thread each hold one, so whichever goes last frees it.
+inline void releaseThreadQueue(ThreadQueue * queue)
+{
+    if (queue->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        delete queue;
+    }
+}
+
+// The calling thread's rings, retired when it exits.
+struct ThreadQueueList
+{
+    ThreadQueue * head;
+
+    ThreadQueueList() : head(DD_NULL) { }
+
+    ~ThreadQueueList()
+    {
+        while (head != DD_NULL)
+        {
+            ThreadQueue * queue = head;
+            head = queue->nextOfThread;
+            queue->ownerThread.store(DD_NULL, std::memory_order_relaxed);
+            queue->state.store(ThreadQueueRetired, std::memory_order_release);
+            releaseThreadQueue(queue);
+        }
+    }
+};
+
+// Unique per live thread.
+inline const void * currentThread()
+{
+    static thread_local char token;
+    return &token;
+}
+
+inline bool onOwnerThread(const ContextImpl & ctx)
+{
+    return ctx.ownerThread == currentThread();
+}
+
+// Tells a context apart from an earlier one allocated at the same address.
+static std::atomic<ddU32> g_contextSerial(0);
+
+// The calling thread's ring in the context it last submitted to.
+static thread_local ddU32 t_threadQueueSerial   = 0;
+static thread_local ThreadQueue * t_threadQueue = DD_NULL;
+static thread_local ThreadQueueList t_threadQueues;
+
+// The calling thread's ring in 'ctx', registering one on first use: a ring
+// an exited thread left behind if a flush has drained one, else a new slot.
+// Null if all DEBUG_DRAW_MAX_THREADS slots of 'ctx' are taken.
+ThreadQueue * currentThreadQueue(ContextImpl & ctx)
+{
+    if (t_threadQueueSerial == ctx.serial)
+    {
+        return t_threadQueue;
+    }
+
+    // The thread may be switching between contexts; look for its old ring first.
+    const void * thread = currentThread();
+    int count = ctx.threadQueueCount.load(std::memory_order_acquire);
+    if (count > DEBUG_DRAW_MAX_THREADS)
+    {
+        count = DEBUG_DRAW_MAX_THREADS;
+    }
+
+    ThreadQueue * queue = DD_NULL;
+    for (int i = 0; i < count && queue == DD_NULL; ++i)
+    {
+        ThreadQueue * candidate = ctx.threadQueues[i].load(std::memory_order_acquire);
+        if (candidate != DD_NULL && candidate->ownerThread.load(std::memory_order_relaxed) == thread &&
+            candidate->state.load(std::memory_order_acquire) == ThreadQueueOwned)
+        {
+            queue = candidate;
+        }
+    }
+    if (queue != DD_NULL)
+    {
+        t_threadQueueSerial = ctx.serial;
+        t_threadQueue       = queue;
+        return queue;
+    }
+
+    for (int i = 0; i < count && queue == DD_NULL; ++i)
+    {
+        ThreadQueue * candidate = ctx.threadQueues[i].load(std::memory_order_acquire);
+        int expected = ThreadQueueFree;
+        if (candidate != DD_NULL &&
+            candidate->state.compare_exchange_strong(expected, ThreadQueueOwned, std::memory_order_acq_rel))
+        {
+            queue = candidate;
+            queue->ownerThread.store(thread, std::memory_order_relaxed);
+        }
+    }
+
+    if (queue == DD_NULL)
+    {
+        const int slot = ctx.threadQueueCount.fetch_add(1, std::memory_order_relaxed);
+        if (slot < DEBUG_DRAW_MAX_THREADS)
+        {
+            queue = new ThreadQueue();
+            queue->ownerThread.store(thread, std::memory_order_relaxed);
+            ctx.threadQueues[slot].store(queue, std::memory_order_release);
+        }
+        else
+        {
+            DEBUG_DRAW_OVERFLOWED("DEBUG_DRAW_MAX_THREADS limit reached! Dropping debug draws from this thread.");
+        }
+    }
+
+    if (queue != DD_NULL)
+    {
+        queue->refs.fetch_add(1, std::memory_order_relaxed);
+        queue->nextOfThread  = t_threadQueues.head;
+        t_threadQueues.head = queue;
+    }
+
+    t_threadQueueSerial = ctx.serial;
+    t_threadQueue       = queue;
+    return queue;
+}
+
+// Owner thread only. Moves everything the producers published so far into
+// the main queues, as if it had been added now.
+void mergeThreadQueues(ContextImpl & ctx)
+{
+    int count = ctx.threadQueueCount.load(std::memory_order_relaxed);
+    if (count > DEBUG_DRAW_MAX_THREADS)
+    {
+        count = DEBUG_DRAW_MAX_THREADS;
+    }
+
+    bool overflowed = false;
+    for (int i = 0; i < count; ++i)
+    {
+        ThreadQueue * queue = ctx.threadQueues[i].load(std::memory_order_acquire);
+        if (queue == DD_NULL)
+        {
+            continue; // Still registering.
+        }
+        // Read before draining, so everything a retired ring's thread
+        // published is seen before the ring is handed on.
+        const int state = queue->state.load(std::memory_order_acquire);
+        if (state == ThreadQueueFree)
+        {
+            continue;
+        }
+
+        SpscRing<ThreadEntry, DEBUG_DRAW_THREAD_QUEUE_SIZE> & entries = queue->entries;
+        const ddU32 entriesHead = entries.head.load(std::memory_order_acquire);
+        for (ddU32 t = entries.tail.load(std::memory_order_relaxed); t != entriesHead; ++t)
+        {
+            const ThreadEntry & entry = entries.slots[t & (DEBUG_DRAW_THREAD_QUEUE_SIZE - 1)];
+            DrawVertex * v = (entry.vertCount == 2)
+                ? pushEntry(ctx, ctx.debugLines, ctx.timedLines, ctx.linesUsage, entry.durationMillis, entry.depthEnabled)
+                : pushEntry(ctx, ctx.debugPoints, ctx.timedPoints, ctx.pointsUsage, entry.durationMillis, entry.depthEnabled);
+            if (v == DD_NULL)
+            {
+                const ddU32 dropped = (entry.vertCount == 2) ? ctx.linesUsage.dropped : ctx.pointsUsage.dropped;
+                overflowed = (dropped == 1) || overflowed; // First drop this flush.
+                continue;
+            }
+            v[0] = entry.verts[0];
+            if (entry.vertCount == 2)
+            {
+                v[1] = entry.verts[1];
+            }
+        }
+        entries.tail.store(entriesHead, std::memory_order_release);
+
+        SpscRing<DebugString, DEBUG_DRAW_THREAD_QUEUE_STRINGS> & strings = queue->strings;
+        const ddU32 stringsHead = strings.head.load(std::memory_order_acquire);
+        for (ddU32 t = strings.tail.load(std::memory_order_relaxed); t != stringsHead; ++t)
+        {
+            DebugString & src          = strings.slots[t & (DEBUG_DRAW_THREAD_QUEUE_STRINGS - 1)];
+            const ddI64 durationMillis = src.expiryDateMillis;
+            DebugString * dstr         = pushString(ctx, static_cast<int>(durationMillis));
+            if (dstr == DD_NULL)
+            {
+                overflowed = (ctx.stringsUsage.dropped == 1) || overflowed;
+                continue;
+            }
+            *dstr                  = DD_MOVE(src);
+            dstr->expiryDateMillis = ctx.currentTimeMillis + durationMillis;
+        }
+        strings.tail.store(stringsHead, std::memory_order_release);
+
+        if (state == ThreadQueueRetired)
+        {
+            queue->state.store(ThreadQueueFree, std::memory_order_release);
+        }
+    }
+
+    if (overflowed)
+    {
+        DEBUG_DRAW_OVERFLOWED("DEBUG_DRAW_MAX_XYZ limit reached merging thread queues! Dropped some debug draws.");
+    }
+}
+
+void destroyThreadQueues(ContextImpl & ctx)
+{
+    int count = ctx.threadQueueCount.exchange(0);
+    if (count > DEBUG_DRAW_MAX_THREADS)
+    {
+        count = DEBUG_DRAW_MAX_THREADS;
+    }
+    for (int i = 0; i < count; ++i)
+    {
+        ThreadQueue * queue = ctx.threadQueues[i].exchange(DD_NULL);
+        if (queue != DD_NULL)
+        {
+            releaseThreadQueue(queue);
+        }
+    }
+}
+
+#endif // DEBUG_DRAW_THREAD_QUEUES
+
+// Storage for a new point (vertCount 1) or line (vertCount 2): the main
+// queue on the owner thread, the calling thread's ring otherwise. Null if
+// full. Finish with commitVerts() once the vertices are written.
+DrawVertex * beginVerts(ContextImpl & ctx, const int vertCount, const int durationMillis, const bool depthEnabled)
+{
+    #if DEBUG_DRAW_THREAD_QUEUES
+    if (!onOwnerThread(ctx))
+    {
+        ThreadQueue * queue = currentThreadQueue(ctx);
+        ThreadEntry * entry = (queue != DD_NULL) ? queue->entries.reserve() : DD_NULL;
+        if (entry == DD_NULL)
+        {
+            if (queue != DD_NULL)
+            {
+                DEBUG_DRAW_OVERFLOWED("DEBUG_DRAW_THREAD_QUEUE_SIZE limit reached! Dropping further debug draws from this thread.");
+            }
+            return DD_NULL;
+        }
+        entry->vertCount      = vertCount;
+        entry->durationMillis = durationMillis;
+        entry->depthEnabled   = depthEnabled;
+        return entry->verts;
+    }
+    #endif // DEBUG_DRAW_THREAD_QUEUES
+
+    if (vertCount == 1)
+    {
+        DrawVertex * v = pushEntry(ctx, ctx.debugPoints, ctx.timedPoints, ctx.pointsUsage, durationMillis, depthEnabled);
+        if (v == DD_NULL)
+        {
+            reportDropped(ctx.pointsUsage, "DEBUG_DRAW_MAX_POINTS limit reached! Dropping further debug point draws.");
+        }
+        return v;
+    }
+
+    DrawVertex * v = pushEntry(ctx, ctx.debugLines, ctx.timedLines, ctx.linesUsage, durationMillis, depthEnabled);
+    if (v == DD_NULL)
+    {
+        reportDropped(ctx.linesUsage, "DEBUG_DRAW_MAX_LINES limit reached! Dropping further debug line draws.");
+    }
+    return v;
+}
+
+// Storage for 'lineCount' one-frame lines in a row, which shapes expanded on
+// the CPU write straight into. Null off the owner thread, for timed lines, or
+// if they don't all fit; the caller then goes through line(), which drops
+// whatever is over the cap one line at a time.
+DrawVertex * reserveLines(ContextImpl & ctx, const int lineCount, const int durationMillis, const bool depthEnabled)
+{
+    #if DEBUG_DRAW_THREAD_QUEUES
+    if (!onOwnerThread(ctx))
+    {
+        return DD_NULL;
+    }
+    #endif // DEBUG_DRAW_THREAD_QUEUES
+
+    if (durationMillis > 0 ||
+        (ctx.debugLines.count() + ctx.timedLines.count() + lineCount) > ctx.debugLines.maxEntries)
+    {
+        return DD_NULL;
+    }
+    return ctx.debugLines.pushRun(depthEnabled, lineCount);
 }
 
-inline float matTransformPointXYZW2(ddVec3 & result, const float p[3], ddMat4x4Param m)
+void commitVerts(ContextImpl & ctx)
 {
-    result[X] = (m[0] * p[X]) + (m[4] * p[Y]) + (m[8]  * p[Z]) + m[12]; // p[W] assumed to be 1
-    result[Y] = (m[1] * p[X]) + (m[5] * p[Y]) + (m[9]  * p[Z]) + m[13];
-    result[Z] = (m[2] * p[X]) + (m[6] * p[Y]) + (m[10] * p[Z]) + m[14];
-    float rw  = (m[3] * p[X]) + (m[7] * p[Y]) + (m[11] * p[Z]) + m[15];
-    return rw;
+    #if DEBUG_DRAW_THREAD_QUEUES
+    if (!onOwnerThread(ctx))
+    {
+        t_threadQueue->entries.publish();
+    }
+    #else // !DEBUG_DRAW_THREAD_QUEUES
+    (void)ctx;
+    #endif // DEBUG_DRAW_THREAD_QUEUES
 }
 
-// ========================================================
-// Misc local functions for draw queue management:
-// ========================================================
-
-enum DrawMode
+// Same as beginVerts(ctx)/commitVerts(ctx) for debug strings.
+DebugString * beginString(ContextImpl & ctx, const int durationMillis)
 {
-    DrawModePoints,
-    DrawModeLines,
-    DrawModeText
-};
+    #if DEBUG_DRAW_THREAD_QUEUES
+    if (!onOwnerThread(ctx))
+    {
+        ThreadQueue * queue = currentThreadQueue(ctx);
+        DebugString * dstr = (queue != DD_NULL) ? queue->strings.reserve() : DD_NULL;
+        if (dstr == DD_NULL)
+        {
+            if (queue != DD_NULL)
+            {
+                DEBUG_DRAW_OVERFLOWED("DEBUG_DRAW_THREAD_QUEUE_STRINGS limit reached! Dropping further debug string draws from this thread.");
+            }
+            return DD_NULL;
+        }
+        dstr->expiryDateMillis = durationMillis; // Made absolute when merged.
+        return dstr;
+    }
+    #endif // DEBUG_DRAW_THREAD_QUEUES
 
-void flushDebugVerts(const DrawMode mode, const bool depthEnabled)
-{
-    if (g_vertexBufferUsed == 0)
+    // No glyph texture to draw with. Other threads' strings are dropped by
+    // the flush instead, as only the owner may look at the flag.
+    if (ctx.glyphTexFailed)
     {
-        return;
+        return DD_NULL;
     }
 
-    switch (mode)
+    DebugString * dstr = pushString(ctx, durationMillis);
+    if (dstr == DD_NULL)
     {
-    case DrawModePoints :
-        g_renderInterface->drawPointList(g_vertexBuffer, g_vertexBufferUsed, depthEnabled);
-        break;
-    case DrawModeLines :
-        g_renderInterface->drawLineList(g_vertexBuffer, g_vertexBufferUsed, depthEnabled);
-        break;
-    case DrawModeText :
-        g_renderInterface->drawGlyphList(g_vertexBuffer, g_vertexBufferUsed, g_glyphTex);
-        break;
-    } // switch (mode)
+        reportDropped(ctx.stringsUsage, "DEBUG_DRAW_MAX_STRINGS limit reached! Dropping further debug string draws.");
+    }
+    return dstr;
+}
 
-    g_vertexBufferUsed = 0;
+void commitString(ContextImpl & ctx)
+{
+    #if DEBUG_DRAW_THREAD_QUEUES
+    if (!onOwnerThread(ctx))
+    {
+        t_threadQueue->strings.publish();
+    }
+    #else // !DEBUG_DRAW_THREAD_QUEUES
+    (void)ctx;
+    #endif // DEBUG_DRAW_THREAD_QUEUES
 }
 
-void pushPointVert(const DebugPoint & point)
+// True if shapes go in as instances: the renderer draws them, and this is
+// the owner thread (the thread rings only carry vertexes, so shapes from
+// other threads are still expanded to lines).
+bool shapeInstancing(const ContextImpl & ctx)
 {
-    // Make room for one more vert:
-    if ((g_vertexBufferUsed + 1) >= DEBUG_DRAW_VERTEX_BUFFER_SIZE)
+    #if DEBUG_DRAW_THREAD_QUEUES
+    if (!onOwnerThread(ctx))
     {
-        flushDebugVerts(DrawModePoints, point.depthEnabled);
+        return false;
     }
+    #endif // DEBUG_DRAW_THREAD_QUEUES
+    return ctx.shapeInstances;
+}
 
-    DrawVertex & v = g_vertexBuffer[g_vertexBufferUsed++];
-    v.point.x    = point.position[X];
-    v.point.y    = point.position[Y];
-    v.point.z    = point.position[Z];
-    v.point.r    = point.color[X];
-    v.point.g    = point.color[Y];
-    v.point.b    = point.color[Z];
-    v.point.size = point.size;
+// True if primitives added now are tested against the cull frustum. Timed
+// ones are left for the flushes to cull, as the view may still turn to them,
+// and other threads' ones too, as only the owner may read the frustum.
+bool cullsSubmissions(const ContextImpl & ctx, const int durationMillis)
+{
+    if (durationMillis != 0)
+    {
+        return false;
+    }
+    #if DEBUG_DRAW_THREAD_QUEUES
+    if (!onOwnerThread(ctx))
+    {
+        return false;
+    }
+    #endif // DEBUG_DRAW_THREAD_QUEUES
+    return ctx.cullEnabled;
 }
 
-void pushLineVert(const DebugLine & line)
+// True if a primitive inside the sphere should be dropped before it is
+// expanded or queued (see cullsSubmissions()), counting it in 'usage'.
+bool cullSubmission(ContextImpl & ctx, QueueUsage & usage, ddVec3Param center, const float radius,
+                    const int durationMillis)
 {
-    // Make room for two more verts:
-    if ((g_vertexBufferUsed + 2) >= DEBUG_DRAW_VERTEX_BUFFER_SIZE)
+    if (!cullsSubmissions(ctx, durationMillis) || sphereVisible(ctx, center, radius))
     {
-        flushDebugVerts(DrawModeLines, line.depthEnabled);
+        return false;
     }
+    ++usage.culled;
+    return true;
+}
 
-    DrawVertex & v0 = g_vertexBuffer[g_vertexBufferUsed++];
-    DrawVertex & v1 = g_vertexBuffer[g_vertexBufferUsed++];
+inline float vecLength(ddVec3Param v)
+{
+    const float lenSqr = (v[X] * v[X]) + (v[Y] * v[Y]) + (v[Z] * v[Z]);
+    return (lenSqr > 0.0f) ? lenSqr * DD_INV_FSQRT(lenSqr) : 0.0f;
+}
 
-    v0.line.x = line.posFrom[X];
-    v0.line.y = line.posFrom[Y];
-    v0.line.z = line.posFrom[Z];
-    v0.line.r = line.color[X];
-    v0.line.g = line.color[Y];
-    v0.line.b = line.color[Z];
+// Queues one shape instance. 'transform' is the rows of the 3x4 unit-to-world matrix.
+void pushShape(ContextImpl & ctx, const ShapeType type, const float transform[12], ddVec3Param color,
+               const float param, const int durationMillis, const bool depthEnabled)
+{
+    ShapeQueues & shapes = ctx.shapes[type];
+    ShapeInstance * shape = pushEntry(ctx, shapes.queue, shapes.timed, ctx.shapesUsage, durationMillis, depthEnabled);
+    if (shape == DD_NULL)
+    {
+        reportDropped(ctx.shapesUsage, "DEBUG_DRAW_MAX_SHAPES limit reached! Dropping further debug shape draws.");
+        return;
+    }
 
-    v1.line.x = line.posTo[X];
-    v1.line.y = line.posTo[Y];
-    v1.line.z = line.posTo[Z];
-    v1.line.r = line.color[X];
-    v1.line.g = line.color[Y];
-    v1.line.b = line.color[Z];
+    std::memcpy(shape->transform, transform, sizeof(shape->transform));
+    shape->color[0] = color[X];
+    shape->color[1] = color[Y];
+    shape->color[2] = color[Z];
+    shape->param    = param;
 }
 
-void pushGlyphVerts(const DrawVertex verts[4])
+//
+// Shape wireframes, written once for every use: each generator hands its
+// lines to 'emit', which either queues them with dd::line(), writes them
+// into lines taken with reserveLines() or, from shapeMesh(), records the
+// unit mesh a renderer instances.
+//
+struct LineEmitter
 {
-    static const int indexes[6] = { 0, 1, 2, 2, 1, 3 };
+    ddVec3 color;
+    int durationMillis;
+    bool depthEnabled;
 
-    // Make room for one more glyph (2 tris):
-    if ((g_vertexBufferUsed + 6) >= DEBUG_DRAW_VERTEX_BUFFER_SIZE)
+    LineEmitter(ddVec3Param c, const int duration, const bool depth)
+        : durationMillis(duration), depthEnabled(depth)
     {
-        flushDebugVerts(DrawModeText, false);
+        vecCopy(color, c);
     }
 
-    for (int i = 0; i < 6; ++i)
+    void operator()(ddVec3Param from, ddVec3Param to)
     {
-        g_vertexBuffer[g_vertexBufferUsed++].glyph = verts[indexes[i]].glyph;
+        line(from, to, color, durationMillis, depthEnabled);
     }
-}
+};
 
-void pushStringGlyphs(float x, float y, const char * text, ddVec3Param color, const float scaling)
+// Writes the lines into storage from reserveLines().
+struct StreamEmitter
 {
-    // Invariants for all characters:
-    const float initialX    = x;
-    const float scaleU      = static_cast<float>(getFontCharSet().bitmapWidth);
-    const float scaleV      = static_cast<float>(getFontCharSet().bitmapHeight);
-    const float fixedWidth  = static_cast<float>(getFontCharSet().charWidth);
-    const float fixedHeight = static_cast<float>(getFontCharSet().charHeight);
-    const float tabW        = fixedWidth  * 4.0f * scaling; // TAB = 4 spaces.
-    const float chrW        = fixedWidth  * scaling;
-    const float chrH        = fixedHeight * scaling;
-
-    for (; *text != '\0'; ++text)
-    {
-        const int charVal = *text;
-        if (charVal >= FontCharSet::MaxChars)
-        {
-            continue;
-        }
-        if (charVal == ' ')
-        {
-            x += chrW;
-            continue;
-        }
-        if (charVal == '\t')
-        {
-            x += tabW;
-            continue;
-        }
-        if (charVal == '\n')
-        {
-            y += chrH;
-            x  = initialX;
-            continue;
-        }
+    DrawVertex * verts;
+    VertColor color;
 
-        const FontChar fontChar = getFontCharSet().chars[charVal];
-        const float u0 = (fontChar.x + 0.5f) / scaleU;
-        const float v0 = (fontChar.y + 0.5f) / scaleV;
-        const float u1 = u0 + (fixedWidth  / scaleU);
-        const float v1 = v0 + (fixedHeight / scaleV);
+    StreamEmitter(DrawVertex * out, ddVec3Param c)
+        : verts(out), color(vertColor(c, 255.0f))
+    { }
 
-        DrawVertex verts[4];
-        verts[0].glyph.x = x;
-        verts[0].glyph.y = y;
-        verts[0].glyph.u = u0;
-        verts[0].glyph.v = v0;
-        verts[0].glyph.r = color[X];
-        verts[0].glyph.g = color[Y];
-        verts[0].glyph.b = color[Z];
-        verts[1].glyph.x = x;
-        verts[1].glyph.y = y + chrH;
-        verts[1].glyph.u = u0;
-        verts[1].glyph.v = v1;
-        verts[1].glyph.r = color[X];
-        verts[1].glyph.g = color[Y];
-        verts[1].glyph.b = color[Z];
-        verts[2].glyph.x = x + chrW;
-        verts[2].glyph.y = y;
-        verts[2].glyph.u = u1;
-        verts[2].glyph.v = v0;
-        verts[2].glyph.r = color[X];
-        verts[2].glyph.g = color[Y];
-        verts[2].glyph.b = color[Z];
-        verts[3].glyph.x = x + chrW;
-        verts[3].glyph.y = y + chrH;
-        verts[3].glyph.u = u1;
-        verts[3].glyph.v = v1;
-        verts[3].glyph.r = color[X];
-        verts[3].glyph.g = color[Y];
-        verts[3].glyph.b = color[Z];
-
-        pushGlyphVerts(verts);
-        x += chrW;
+    void operator()(ddVec3Param from, ddVec3Param to)
+    {
+        setLineVert(verts[0], from, color);
+        setLineVert(verts[1], to, color);
+        verts += 2;
     }
-}
+};
 
-float calcTextWidth(const char * text, const float scaling)
+struct MeshEmitter
 {
-    const float fixedWidth = static_cast<float>(getFontCharSet().charWidth);
-    const float tabW = fixedWidth * 4.0f * scaling; // TAB = 4 spaces.
-    const float chrW = fixedWidth * scaling;
+    float * xyz; // Null to count only
+    int vertCount;
 
-    float x = 0.0f;
-    for (; *text != '\0'; ++text)
+    explicit MeshEmitter(float * out) : xyz(out), vertCount(0) { }
+
+    void operator()(ddVec3Param from, ddVec3Param to)
     {
-        // Tabs are handled differently (4 spaces)
-        if (*text == '\t')
+        if (xyz != DD_NULL)
         {
-            x += tabW;
-        }
-        else // Non-tab char (including whitespace)
-        {
-            x += chrW;
+            float * v = xyz + vertCount * 3;
+            v[0] = from[X]; v[1] = from[Y]; v[2] = from[Z];
+            v[3] = to[X];   v[4] = to[Y];   v[5] = to[Z];
         }
+        vertCount += 2;
     }
+};
 
-    return x;
-}
+//
+// Sine and cosine of each step of the fixed-step shapes, from 0 to 360
+// degrees inclusive (entry i is i * step degrees). Spheres use 15 degree
+// steps, cones 20 and arrowheads 30. Multiples of 90 degrees are exact.
+//
+const float sin15[25] = {
+     0.0f,         0.25881904f,  0.5f,         0.70710677f,  0.8660254f,   0.9659258f,
+     1.0f,         0.9659258f,   0.8660254f,   0.70710677f,  0.5f,         0.25881904f,
+     0.0f,        -0.25881904f, -0.5f,        -0.70710677f, -0.8660254f,  -0.9659258f,
+    -1.0f,        -0.9659258f,  -0.8660254f,  -0.70710677f, -0.5f,        -0.25881904f,
+     0.0f
+};
+const float cos15[25] = {
+     1.0f,         0.9659258f,   0.8660254f,   0.70710677f,  0.5f,         0.25881904f,
+     0.0f,        -0.25881904f, -0.5f,        -0.70710677f, -0.8660254f,  -0.9659258f,
+    -1.0f,        -0.9659258f,  -0.8660254f,  -0.70710677f, -0.5f,        -0.25881904f,
+     0.0f,         0.25881904f,  0.5f,         0.70710677f,  0.8660254f,   0.9659258f,
+     1.0f
+};
+const float sin20[19] = {
+     0.0f,         0.34202015f,  0.64278764f,  0.8660254f,   0.9848077f,   0.9848077f,
+     0.8660254f,   0.64278764f,  0.34202015f,  0.0f,        -0.34202015f, -0.64278764f,
+    -0.8660254f,  -0.9848077f,  -0.9848077f,  -0.8660254f,  -0.64278764f, -0.34202015f,
+     0.0f
+};
+const float cos20[19] = {
+     1.0f,         0.9396926f,   0.76604444f,  0.5f,         0.17364818f, -0.17364818f,
+    -0.5f,        -0.76604444f, -0.9396926f,  -1.0f,        -0.9396926f,  -0.76604444f,
+    -0.5f,        -0.17364818f,  0.17364818f,  0.5f,         0.76604444f,  0.9396926f,
+     1.0f
+};
+const float sin30[13] = {
+     0.0f,  0.5f,  0.8660254f,  1.0f,  0.8660254f,  0.5f,
+     0.0f, -0.5f, -0.8660254f, -1.0f, -0.8660254f, -0.5f,
+     0.0f
+};
+const float cos30[13] = {
+     1.0f,  0.8660254f,  0.5f,  0.0f, -0.5f, -0.8660254f,
+    -1.0f, -0.8660254f, -0.5f,  0.0f,  0.5f,  0.8660254f,
+     1.0f
+};
 
-void drawDebugStrings()
+// Lines each CPU-expanded shape writes, for reserveLines().
+enum
 {
-    if (g_debugStringsCount == 0)
+    SphereLineCount     = 2 * (360 / 15) * (360 / 15),
+    ConeLineCount       = 2 * (360 / 20), // Pointed
+    OpenConeLineCount   = 3 * (360 / 20),
+    ArrowLineCount      = 1 + 2 * (360 / 30),
+    BoxLineCount        = 12,
+    RingMaxPoints       = 360 / 15
+};
+
+// Points of a ring as separate x, y and z arrays.
+struct RingPoints
+{
+    float x[RingMaxPoints];
+    float y[RingMaxPoints];
+    float z[RingMaxPoints];
+
+    void get(ddVec3 point, const int i) const
     {
-        return;
+        point[X] = x[i];
+        point[Y] = y[i];
+        point[Z] = z[i];
     }
+};
+
+// ring[i] = center + (axis0 * sinTable[i]) + (axis1 * cosTable[i]), for i in [0, count).
+void ringPoints(RingPoints & ring, const float * sinTable, const float * cosTable, const int count,
+                ddVec3Param center, ddVec3Param axis0, ddVec3Param axis1)
+{
+    int i = 0;
 
-    for (int i = 0; i < g_debugStringsCount; ++i)
+    #if defined(DD_SIMD_SSE)
+    for (; (i + 4) <= count; i += 4)
     {
-        const DebugString & dstr = g_debugStrings[i];
-        if (dstr.centered)
-        {
-            // 3D Labels are centered at the point of origin, e.g. center-aligned.
-            const float offset = calcTextWidth(dstr.text.c_str(), dstr.scaling) * 0.5f;
-            pushStringGlyphs(dstr.posX - offset, dstr.posY, dstr.text.c_str(), dstr.color, dstr.scaling);
-        }
-        else
-        {
-            // Left-aligned
-            pushStringGlyphs(dstr.posX, dstr.posY, dstr.text.c_str(), dstr.color, dstr.scaling);
-        }
+        const __m128 s = _mm_loadu_ps(sinTable + i);
+        const __m128 c = _mm_loadu_ps(cosTable + i);
+        _mm_storeu_ps(ring.x + i, _mm_add_ps(_mm_set1_ps(center[X]),
+                      _mm_add_ps(_mm_mul_ps(s, _mm_set1_ps(axis0[X])), _mm_mul_ps(c, _mm_set1_ps(axis1[X])))));
+        _mm_storeu_ps(ring.y + i, _mm_add_ps(_mm_set1_ps(center[Y]),
+                      _mm_add_ps(_mm_mul_ps(s, _mm_set1_ps(axis0[Y])), _mm_mul_ps(c, _mm_set1_ps(axis1[Y])))));
+        _mm_storeu_ps(ring.z + i, _mm_add_ps(_mm_set1_ps(center[Z]),
+                      _mm_add_ps(_mm_mul_ps(s, _mm_set1_ps(axis0[Z])), _mm_mul_ps(c, _mm_set1_ps(axis1[Z])))));
+    }
+    #elif defined(DD_SIMD_NEON)
+    for (; (i + 4) <= count; i += 4)
+    {
+        const float32x4_t s = vld1q_f32(sinTable + i);
+        const float32x4_t c = vld1q_f32(cosTable + i);
+        vst1q_f32(ring.x + i, vaddq_f32(vdupq_n_f32(center[X]), vaddq_f32(vmulq_n_f32(s, axis0[X]), vmulq_n_f32(c, axis1[X]))));
+        vst1q_f32(ring.y + i, vaddq_f32(vdupq_n_f32(center[Y]), vaddq_f32(vmulq_n_f32(s, axis0[Y]), vmulq_n_f32(c, axis1[Y]))));
+        vst1q_f32(ring.z + i, vaddq_f32(vdupq_n_f32(center[Z]), vaddq_f32(vmulq_n_f32(s, axis0[Z]), vmulq_n_f32(c, axis1[Z]))));
     }
+    #endif // DD_SIMD_SSE / DD_SIMD_NEON
 
-    flushDebugVerts(DrawModeText, false);
+    // What's left over, or all of it without SIMD. Same operation order as above.
+    for (; i < count; ++i)
+    {
+        ring.x[i] = center[X] + ((sinTable[i] * axis0[X]) + (cosTable[i] * axis1[X]));
+        ring.y[i] = center[Y] + ((sinTable[i] * axis0[Y]) + (cosTable[i] * axis1[Y]));
+        ring.z[i] = center[Z] + ((sinTable[i] * axis0[Z]) + (cosTable[i] * axis1[Z]));
+    }
 }
 
-void drawDebugPoints()
+template<typename Emit>
+void circleLines(ddVec3Param center, ddVec3Param left, ddVec3Param up, const float numSteps, Emit & emit)
 {
-    if (g_debugPointsCount == 0)
+    ddVec3 point, lastPoint;
+    vecAdd(lastPoint, center, up);
+
+    for (int i = 1; i <= numSteps; ++i)
     {
-        return;
+        const float radians = DD_TAU * i / numSteps;
+
+        ddVec3 vs, vc;
+        vecScale(vs, left, DD_FSIN(radians));
+        vecScale(vc, up,   DD_FCOS(radians));
+
+        vecAdd(point, center, vs);
+        vecAdd(point, point,  vc);
+
+        emit(lastPoint, point);
+        vecCopy(lastPoint, point);
     }
+}
 
-    //
-    // First pass, points with depth test ENABLED:
-    //
-    int numDepthlessPoints = 0;
-    for (int i = 0; i < g_debugPointsCount; ++i)
+template<typename Emit>
+void sphereLines(ddVec3Param center, const float radius, Emit & emit)
+{
+    static const int stepCount = 360 / 15;
+    ddVec3 cache[stepCount];
+    ddVec3 radiusVec;
+
+    vecSet(radiusVec, 0.0f, 0.0f, radius);
+    vecAdd(cache[0], center, radiusVec);
+
+    for (int n = 1; n < DD_ARRAY_LEN(cache); ++n)
     {
-        const DebugPoint & point = g_debugPoints[i];
-        if (point.depthEnabled)
-        {
-            pushPointVert(point);
-        }
-        numDepthlessPoints += !point.depthEnabled;
+        vecCopy(cache[n], cache[0]);
     }
-    flushDebugVerts(DrawModePoints, true);
 
-    //
-    // Second pass draws points with depth DISABLED:
-    //
-    if (numDepthlessPoints > 0)
+    RingPoints ring;
+    ddVec3 lastPoint, temp, ringCenter, axis0, axis1;
+    for (int i = 1; i <= stepCount; ++i)
     {
-        for (int i = 0; i < g_debugPointsCount; ++i)
+        const float rs = radius * sin15[i];
+
+        lastPoint[X] = center[X];
+        lastPoint[Y] = center[Y] + rs;
+        lastPoint[Z] = center[Z] + radius * cos15[i];
+
+        // The ring of latitude i, starting one step around.
+        vecSet(ringCenter, center[X], center[Y], lastPoint[Z]);
+        vecSet(axis0, rs, 0.0f, 0.0f);
+        vecSet(axis1, 0.0f, rs, 0.0f);
+        ringPoints(ring, sin15 + 1, cos15 + 1, stepCount, ringCenter, axis0, axis1);
+
+        for (int n = 0; n < stepCount; ++n)
         {
-            const DebugPoint & point = g_debugPoints[i];
-            if (!point.depthEnabled)
-            {
-                pushPointVert(point);
-            }
+            ring.get(temp, n);
+
+            emit(lastPoint, temp);
+            emit(lastPoint, cache[n]);
+
+            vecCopy(cache[n], lastPoint);
+            vecCopy(lastPoint, temp);
         }
-        flushDebugVerts(DrawModePoints, false);
     }
 }
 
-void drawDebugLines()
+// 'axis0' and 'axis1' span the rings, 'top' is the base center.
+template<typename Emit>
+void coneLines(ddVec3Param apex, ddVec3Param top, ddVec3Param axis0, ddVec3Param axis1,
+               const float baseRadius, const float apexRadius, Emit & emit)
 {
-    if (g_debugLinesCount == 0)
-    {
-        return;
-    }
+    static const int stepCount = 360 / 20;
+    RingPoints base;
+    ddVec3 temp0, temp1, p1, p2, lastP1, lastP2;
 
-    //
-    // First pass, lines with depth test ENABLED:
-    //
-    int numDepthlessLines = 0;
-    for (int i = 0; i < g_debugLinesCount; ++i)
+    // Both rings start one step around.
+    vecScale(temp0, axis0, baseRadius);
+    vecScale(temp1, axis1, baseRadius);
+    vecAdd(lastP2, top, temp1);
+    ringPoints(base, sin20 + 1, cos20 + 1, stepCount, top, temp0, temp1);
+
+    if (apexRadius == 0.0f)
     {
-        const DebugLine & line = g_debugLines[i];
-        if (line.depthEnabled)
+        for (int i = 0; i < stepCount; ++i)
         {
-            pushLineVert(line);
+            base.get(p2, i);
+
+            emit(lastP2, p2);
+            emit(p2, apex);
+
+            vecCopy(lastP2, p2);
         }
-        numDepthlessLines += !line.depthEnabled;
     }
-    flushDebugVerts(DrawModeLines, true);
-
-    //
-    // Second pass draws lines with depth DISABLED:
-    //
-    if (numDepthlessLines > 0)
+    else // A degenerate cone with open apex:
     {
-        for (int i = 0; i < g_debugLinesCount; ++i)
+        RingPoints tip;
+        vecScale(temp0, axis0, apexRadius);
+        vecScale(temp1, axis1, apexRadius);
+        vecAdd(lastP1, apex, temp1);
+        ringPoints(tip, sin20 + 1, cos20 + 1, stepCount, apex, temp0, temp1);
+
+        for (int i = 0; i < stepCount; ++i)
         {
-            const DebugLine & line = g_debugLines[i];
-            if (!line.depthEnabled)
-            {
-                pushLineVert(line);
-            }
+            tip.get(p1, i);
+            base.get(p2, i);
+
+            emit(lastP1, p1);
+            emit(lastP2, p2);
+            emit(p1, p2);
+
+            vecCopy(lastP1, p1);
+            vecCopy(lastP2, p2);
         }
-        flushDebugVerts(DrawModeLines, false);
     }
 }
 
-template<typename T>
-void clearDebugQueue(T * queue, int & queueCount)
+template<typename Emit>
+void boxLines(const ddVec3 points[8], Emit & emit)
 {
-    if (g_currentTimeMillis == 0)
+    // Build the lines from points using clever indexing tricks:
+    // (& 3 is a fancy way of doing % 4, but avoids the expensive modulo operation)
+    for (int i = 0; i < 4; ++i)
     {
-        queueCount = 0;
-        return;
+        emit(points[i], points[(i + 1) & 3]);
+        emit(points[4 + i], points[4 + ((i + 1) & 3)]);
+        emit(points[i], points[4 + i]);
     }
+}
 
-    int index = 0;
-    T * pElem = queue;
+// The corners of a box of half extents (w, h, d), in the order boxLines() takes.
+void boxPoints(ddVec3 points[8], ddVec3Param center, const float w, const float h, const float d)
+{
+    const float cx = center[X];
+    const float cy = center[Y];
+    const float cz = center[Z];
 
-    // Concatenate elements that still need to be draw on future frames:
-    for (int i = 0; i < queueCount; ++i, ++pElem)
-    {
-        if (pElem->expiryDateMillis > g_currentTimeMillis)
-        {
-            if (index != i)
-            {
-                queue[index] = *pElem;
-            }
-            ++index;
-        }
-    }
+    #define DD_BOX_V(v, op1, op2, op3) \
+    v[X] = cx op1 w; \
+    v[Y] = cy op2 h; \
+    v[Z] = cz op3 d
+    DD_BOX_V(points[0], -, +, +);
+    DD_BOX_V(points[1], -, +, -);
+    DD_BOX_V(points[2], +, +, -);
+    DD_BOX_V(points[3], +, +, +);
+    DD_BOX_V(points[4], -, -, +);
+    DD_BOX_V(points[5], -, -, -);
+    DD_BOX_V(points[6], +, -, -);
+    DD_BOX_V(points[7], +, -, +);
+    #undef DD_BOX_V
+}
 
-    queueCount = index;
+// Instance of the unit box (-0.5 to 0.5 on each axis) scaled by 'size' around 'center'.
+void pushBoxShape(ContextImpl & ctx, ddVec3Param center, ddVec3Param size, ddVec3Param color,
+                  const int durationMillis, const bool depthEnabled)
+{
+    const float transform[12] = {
+        size[X], 0.0f,    0.0f,    center[X],
+        0.0f,    size[Y], 0.0f,    center[Y],
+        0.0f,    0.0f,    size[Z], center[Z]
+    };
+    pushShape(ctx, ShapeBox, transform, color, 1.0f, durationMillis, depthEnabled);
 }
 
-void setupGlyphTexture()
+#ifdef DEBUG_DRAW_STR_DEALLOC_FUNC
+void deallocStrings(ContextImpl & ctx)
 {
-    if (g_renderInterface == DD_NULL)
+    for (int i = 0; i < ctx.debugStringsCapacity; ++i)
     {
-        return;
+        DEBUG_DRAW_STR_DEALLOC_FUNC(ctx.debugStrings[i].text);
     }
-
-    if (g_glyphTex != DD_NULL)
+    for (int i = 0; i < ctx.timedStrings.runs[0].capacity; ++i)
     {
-        g_renderInterface->destroyGlyphTexture(g_glyphTex);
-        g_glyphTex = DD_NULL;
+        DEBUG_DRAW_STR_DEALLOC_FUNC(ctx.timedStrings.runs[0].items[i].text);
     }
-
-    UByte * decompressedBitmap = decompressFontBitmap();
-    if (decompressedBitmap == DD_NULL)
+    for (int i = 0; i < ctx.glyphRunCapacity; ++i)
     {
-        return; // Failed to decompressed. No font rendering available.
+        DEBUG_DRAW_STR_DEALLOC_FUNC(ctx.glyphRuns[i].text);
     }
-
-    g_glyphTex = g_renderInterface->createGlyphTexture(
-                         getFontCharSet().bitmapWidth,
-                         getFontCharSet().bitmapHeight,
-                         decompressedBitmap);
-
-    // No longer needed.
-    DD_MFREE(decompressedBitmap);
+    ctx.glyphRunCount = 0;
 }
+#endif // DEBUG_DRAW_STR_DEALLOC_FUNC
 
 } // namespace unnamed {}
 
@@ -2182,29 +4378,46 @@ void setupGlyphTexture()
 // Public Debug Draw interface:
 // ========================================================
 
-void initialize(RenderInterface * renderer)
+ContextHandle createContext(RenderInterface * renderer)
 {
-    if (g_renderInterface != DD_NULL) // Reinitializing?
+    if (renderer == DD_NULL)
     {
-        shutdown(); // Shutdown first.
+        return DD_NULL;
     }
 
-    g_renderInterface = renderer;
-    g_currentTimeMillis = 0;
-    g_vertexBufferUsed  = 0;
-    g_debugStringsCount = 0;
-    g_debugPointsCount  = 0;
-    g_debugLinesCount   = 0;
+    ContextImpl * ctx = new ContextImpl(renderer);
+
+    #if DEBUG_DRAW_THREAD_QUEUES
+    ctx->ownerThread = currentThread();
+    ctx->serial      = g_contextSerial.fetch_add(1) + 1;
+    ctx->threadQueueCount.store(0);
+    for (int i = 0; i < DEBUG_DRAW_MAX_THREADS; ++i)
+    {
+        ctx->threadQueues[i].store(DD_NULL);
+    }
+    #endif // DEBUG_DRAW_THREAD_QUEUES
 
-    setupGlyphTexture();
+    ctx->shapeInstances = renderer->supportsShapeInstances();
+    return reinterpret_cast<ContextHandle>(ctx);
 }
 
-void shutdown()
+void destroyContext(ContextHandle handle)
 {
+    if (handle == DD_NULL)
+    {
+        return;
+    }
+
+    ContextImpl * ctx = reinterpret_cast<ContextImpl *>(handle);
+    if (t_currentContext == ctx)
+    {
+        t_currentContext = DD_NULL;
+    }
+
     //
     // If this macro is defined, the user-provided ddStr type
     // needs some extra cleanup before shutdown, so we run for
-    // all entries in the g_debugStrings[] array.
+    // all entries in the ctx.debugStrings[] array.
     //
     // We could call std::string::clear() here, but clear()
     // doesn't deallocate memory in std string, so we might
@@ -2212,133 +4425,286 @@ void shutdown()
     // when using the default (AKA std::string) ddStr.
     //
     #ifdef DEBUG_DRAW_STR_DEALLOC_FUNC
-    for (int i = 0; i < DD_ARRAY_LEN(g_debugStrings); ++i)
+    deallocStrings(*ctx);
+    #endif // DEBUG_DRAW_STR_DEALLOC_FUNC
+
+    if (ctx->glyphTex != DD_NULL)
     {
-        DEBUG_DRAW_STR_DEALLOC_FUNC(g_debugStrings[i].text);
+        ctx->renderInterface->destroyGlyphTexture(ctx->glyphTex);
+        ctx->glyphTex = DD_NULL;
     }
-    #endif // DEBUG_DRAW_STR_DEALLOC_FUNC
 
-    if (g_renderInterface != DD_NULL && g_glyphTex != DD_NULL)
+    #if DEBUG_DRAW_THREAD_QUEUES
+    destroyThreadQueues(*ctx);
+    #endif // DEBUG_DRAW_THREAD_QUEUES
+
+    delete ctx;
+}
+
+void makeCurrent(ContextHandle handle)
+{
+    t_currentContext = reinterpret_cast<ContextImpl *>(handle);
+}
+
+ContextHandle currentContext()
+{
+    return reinterpret_cast<ContextHandle>(t_currentContext);
+}
+
+void initialize(RenderInterface * renderer)
+{
+    if (t_currentContext != DD_NULL) // Reinitializing?
     {
-        g_renderInterface->destroyGlyphTexture(g_glyphTex);
-        g_glyphTex = DD_NULL;
+        shutdown(); // Shutdown first.
     }
 
-    g_renderInterface = DD_NULL;
+    makeCurrent(createContext(renderer));
+}
+
+void shutdown()
+{
+    destroyContext(currentContext());
 }
 
 bool hasPendingDraws()
 {
-    return (g_debugStringsCount + g_debugPointsCount + g_debugLinesCount) > 0;
+    const ContextImpl * ctx = t_currentContext;
+    if (ctx == DD_NULL)
+    {
+        return false;
+    }
+    return (ctx->debugStringsCount + ctx->debugPoints.count() + ctx->debugLines.count() +
+            ctx->timedStrings.count() + ctx->timedPoints.count() + ctx->timedLines.count() +
+            ctx->shapesCount()) > 0;
 }
 
 void flush(const ddI64 currTimeMillis, const int flags)
 {
     DD_CHECK_INIT;
-
-    if (!hasPendingDraws())
+    ContextImpl & ctx = *t_currentContext;
+
+    #if DEBUG_DRAW_THREAD_QUEUES
+    mergeThreadQueues(ctx);
+    #endif // DEBUG_DRAW_THREAD_QUEUES
+
+    // This frame's high-water marks:
+    const int stringsQueued = ctx.debugStringsCount + ctx.timedStrings.count();
+    const int pointsQueued  = ctx.debugPoints.count() + ctx.timedPoints.count();
+    const int linesQueued   = ctx.debugLines.count() + ctx.timedLines.count();
+    const int shapesQueued  = ctx.shapesCount();
+    ctx.debugStringsShrink.note(ctx.debugStringsCount);
+    ctx.debugPoints.shrink.note(ctx.debugPoints.count());
+    ctx.debugLines.shrink.note(ctx.debugLines.count());
+    ctx.timedStrings.noteQueued();
+    ctx.timedPoints.noteQueued();
+    ctx.timedLines.noteQueued();
+    for (int type = 0; type < ShapeTypeCount; ++type)
     {
-        return;
+        ctx.shapes[type].queue.shrink.note(ctx.shapes[type].queue.count());
+        ctx.shapes[type].timed.noteQueued();
     }
 
-    // Save the last know time value for next dd::line/dd::point calls.
-    g_currentTimeMillis = currTimeMillis;
-
-    // Let the user set common render states...
-    g_renderInterface->beginDraw();
-
-    // Issue the render calls:
-    if (flags & FlushLines)  { drawDebugLines();   }
-    if (flags & FlushPoints) { drawDebugPoints();  }
-    if (flags & FlushText)   { drawDebugStrings(); }
+    if (hasPendingDraws())
+    {
+        // Save the last know time value for next dd::line/dd::point calls.
+        ctx.currentTimeMillis = currTimeMillis;
+
+        // Let the user set common render states...
+        ctx.renderInterface->beginDraw();
+
+        // Issue the render calls:
+        if (flags & FlushLines)  { drawDebugLines(ctx); drawDebugShapes(ctx); }
+        if (flags & FlushPoints) { drawDebugPoints(ctx);  }
+        if (flags & FlushText)   { drawDebugStrings(ctx); }
+
+        // And cleanup if needed...
+        ctx.renderInterface->endDraw();
+
+        // Remove all expired objects, regardless of draw flags. One-frame
+        // ones all go; timed ones only get looked at on their expiry tick.
+        ctx.debugStringsCount = 0;
+        ctx.debugPoints.clear();
+        ctx.debugLines.clear();
+        for (int type = 0; type < ShapeTypeCount; ++type)
+        {
+            ctx.shapes[type].queue.clear();
+        }
+        if (ctx.currentTimeMillis == 0)
+        {
+            ctx.timedStrings.clear();
+            ctx.timedPoints.clear();
+            ctx.timedLines.clear();
+            for (int type = 0; type < ShapeTypeCount; ++type)
+            {
+                ctx.shapes[type].timed.clear();
+            }
+        }
+        else
+        {
+            ctx.timedStrings.advance(ctx.currentTimeMillis);
+            ctx.timedPoints.advance(ctx.currentTimeMillis);
+            ctx.timedLines.advance(ctx.currentTimeMillis);
+            for (int type = 0; type < ShapeTypeCount; ++type)
+            {
+                ctx.shapes[type].timed.advance(ctx.currentTimeMillis);
+            }
+        }
+    }
 
-    // And cleanup if needed...
-    g_renderInterface->endDraw();
+    trimQueues(ctx);
+    recordFrameStats(ctx.stringsUsage, stringsQueued, ctx.debugStringsCapacity + ctx.timedStrings.capacity(), DEBUG_DRAW_MAX_STRINGS);
+    recordFrameStats(ctx.pointsUsage, pointsQueued, ctx.debugPoints.capacity + ctx.timedPoints.capacity(), DEBUG_DRAW_MAX_POINTS);
+    recordFrameStats(ctx.linesUsage, linesQueued, ctx.debugLines.capacity + ctx.timedLines.capacity(), DEBUG_DRAW_MAX_LINES);
 
-    // Remove all expired objects, regardless of draw flags:
-    clearDebugQueue(g_debugStrings, g_debugStringsCount);
-    clearDebugQueue(g_debugPoints,  g_debugPointsCount);
-    clearDebugQueue(g_debugLines,   g_debugLinesCount);
+    int shapesCapacity = 0;
+    for (int type = 0; type < ShapeTypeCount; ++type)
+    {
+        shapesCapacity += ctx.shapes[type].queue.capacity + ctx.shapes[type].timed.capacity();
+    }
+    recordFrameStats(ctx.shapesUsage, shapesQueued, shapesCapacity, DEBUG_DRAW_MAX_SHAPES);
 }
 
 void clear()
 {
     DD_CHECK_INIT;
+    ContextImpl & ctx = *t_currentContext;
+
+    #if DEBUG_DRAW_THREAD_QUEUES
+    mergeThreadQueues(ctx); // Drained here, then dropped below.
+    #endif // DEBUG_DRAW_THREAD_QUEUES
 
     // Let the user cleanup the debug strings:
     #ifdef DEBUG_DRAW_STR_DEALLOC_FUNC
-    for (int i = 0; i < DD_ARRAY_LEN(g_debugStrings); ++i)
+    deallocStrings(ctx);
+    #endif // DEBUG_DRAW_STR_DEALLOC_FUNC
+
+    ctx.vertexBufferUsed  = 0;
+    ctx.debugStringsCount = 0;
+    ctx.debugPoints.clear();
+    ctx.debugLines.clear();
+    ctx.timedStrings.clear();
+    ctx.timedPoints.clear();
+    ctx.timedLines.clear();
+    for (int type = 0; type < ShapeTypeCount; ++type)
     {
-        DEBUG_DRAW_STR_DEALLOC_FUNC(g_debugStrings[i].text);
+        ctx.shapes[type].queue.clear();
+        ctx.shapes[type].timed.clear();
     }
-    #endif // DEBUG_DRAW_STR_DEALLOC_FUNC
+}
+
+bool getFrameStats(FrameStats & stats)
+{
+    const ContextImpl * ctx = t_currentContext;
+    if (ctx == DD_NULL)
+    {
+        return false;
+    }
+    stats.points  = ctx->pointsUsage.last;
+    stats.lines   = ctx->linesUsage.last;
+    stats.strings = ctx->stringsUsage.last;
+    stats.shapes  = ctx->shapesUsage.last;
+    return true;
+}
+
+void setCullFrustum(ddMat4x4Param vpMatrix)
+{
+    DD_CHECK_INIT;
+    ContextImpl & ctx = *t_currentContext;
+
+    // Clip space is -w <= x, y, z <= w: each plane is the W row of the
+    // (column-major) matrix plus or minus the X, Y or Z one. In doubles, as
+    // the far plane's W - Z cancels most of its bits in a perspective matrix.
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        for (int side = 0; side < 2; ++side)
+        {
+            const double sign = (side == 0) ? 1.0 : -1.0;
+            double row[4];
+            for (int col = 0; col < 4; ++col)
+            {
+                row[col] = static_cast<double>(vpMatrix[(col * 4) + 3]) + (sign * vpMatrix[(col * 4) + axis]);
+            }
+
+            float * plane = ctx.cullPlanes[(axis * 2) + side];
+            const double lenSqr = (row[0] * row[0]) + (row[1] * row[1]) + (row[2] * row[2]);
+            if (lenSqr > 0.0)
+            {
+                const double invLen = DD_INV_FSQRT(static_cast<float>(lenSqr));
+                for (int col = 0; col < 4; ++col)
+                {
+                    plane[col] = static_cast<float>(row[col] * invLen);
+                }
+            }
+            else
+            {
+                // Degenerate matrix; a plane everything is inside.
+                plane[0] = plane[1] = plane[2] = 0.0f;
+                plane[3] = 1.0f;
+            }
+        }
+    }
+    ctx.cullEnabled = true;
+}
 
-    g_vertexBufferUsed  = 0;
-    g_debugStringsCount = 0;
-    g_debugPointsCount  = 0;
-    g_debugLinesCount   = 0;
+void clearCullFrustum()
+{
+    DD_CHECK_INIT;
+    t_currentContext->cullEnabled = false;
 }
 
 void point(ddVec3Param pos, ddVec3Param color, const float size, const int durationMillis, const bool depthEnabled)
 {
     DD_CHECK_INIT;
+    ContextImpl & ctx = *t_currentContext;
 
-    if (g_debugPointsCount == DEBUG_DRAW_MAX_POINTS)
+    DrawVertex * v = beginVerts(ctx, 1, durationMillis, depthEnabled);
+    if (v == DD_NULL)
     {
-        DEBUG_DRAW_OVERFLOWED("DEBUG_DRAW_MAX_POINTS limit reached! Dropping further debug point draws.");
         return;
     }
 
-    DebugPoint & point     = g_debugPoints[g_debugPointsCount++];
-    point.expiryDateMillis = g_currentTimeMillis + durationMillis;
-    point.depthEnabled     = depthEnabled;
-    point.size             = size;
+    setPointVert(*v, pos, vertColor(color, size));
 
-    vecCopy(point.position, pos);
-    vecCopy(point.color, color);
+    commitVerts(ctx);
 }
 
 void line(ddVec3Param from, ddVec3Param to, ddVec3Param color, const int durationMillis, const bool depthEnabled)
 {
     DD_CHECK_INIT;
+    ContextImpl & ctx = *t_currentContext;
 
-    if (g_debugLinesCount == DEBUG_DRAW_MAX_LINES)
+    DrawVertex * v = beginVerts(ctx, 2, durationMillis, depthEnabled);
+    if (v == DD_NULL)
     {
-        DEBUG_DRAW_OVERFLOWED("DEBUG_DRAW_MAX_LINES limit reached! Dropping further debug line draws.");
         return;
     }
 
-    DebugLine & line      = g_debugLines[g_debugLinesCount++];
-    line.expiryDateMillis = g_currentTimeMillis + durationMillis;
-    line.depthEnabled     = depthEnabled;
+    const VertColor c = vertColor(color, 255.0f);
+    setLineVert(v[0], from, c);
+    setLineVert(v[1], to, c);
 
-    vecCopy(line.posFrom, from);
-    vecCopy(line.posTo, to);
-    vecCopy(line.color, color);
+    commitVerts(ctx);
 }
 
 void screenText(ddStrParam str, ddVec3Param pos, ddVec3Param color, const float scaling, const int durationMillis)
 {
     DD_CHECK_INIT;
-    if (g_glyphTex == DD_NULL)
-    {
-        return;
-    }
+    ContextImpl & ctx = *t_currentContext;
 
-    if (g_debugStringsCount == DEBUG_DRAW_MAX_STRINGS)
+    DebugString * dstr = beginString(ctx, durationMillis);
+    if (dstr == DD_NULL)
     {
-        DEBUG_DRAW_OVERFLOWED("DEBUG_DRAW_MAX_STRINGS limit reached! Dropping further debug string draws.");
         return;
     }
 
-    DebugString & dstr    = g_debugStrings[g_debugStringsCount++];
-    dstr.expiryDateMillis = g_currentTimeMillis + durationMillis;
-    dstr.posX             = pos[X];
-    dstr.posY             = pos[Y];
-    dstr.scaling          = scaling;
-    dstr.text             = DD_MOVE(str);
-    dstr.centered         = false;
-    vecCopy(dstr.color, color);
+    dstr->posX     = pos[X];
+    dstr->posY     = pos[Y];
+    dstr->scaling  = scaling;
+    dstr->text     = DD_MOVE(str);
+    dstr->centered = false;
+    vecCopy(dstr->color, color);
+
+    commitString(ctx);
 }
 
 void projectedText(ddStrParam str, ddVec3Param pos, ddVec3Param color, ddMat4x4Param vpMatrix,
@@ -2346,14 +4712,11 @@ void projectedText(ddStrParam str, ddVec3Param pos, ddVec3Param color, ddMat4x4P
                    const int durationMillis)
 {
     DD_CHECK_INIT;
-    if (g_glyphTex == DD_NULL)
-    {
-        return;
-    }
+    ContextImpl & ctx = *t_currentContext;
 
-    if (g_debugStringsCount == DEBUG_DRAW_MAX_STRINGS)
+    // Before the projection; the label is kept or dropped whole by its anchor.
+    if (cullSubmission(ctx, ctx.stringsUsage, pos, 0.0f, durationMillis))
     {
-        DEBUG_DRAW_OVERFLOWED("DEBUG_DRAW_MAX_STRINGS limit reached! Dropping further debug string draws.");
         return;
     }
 
@@ -2378,14 +4741,20 @@ void projectedText(ddStrParam str, ddVec3Param pos, ddVec3Param color, ddMat4x4P
     // NOTE: This is not renderer agnostic, I think... Should add a #define or something!
     scrY = static_cast<float>(sh) - scrY;
 
-    DebugString & dstr    = g_debugStrings[g_debugStringsCount++];
-    dstr.expiryDateMillis = g_currentTimeMillis + durationMillis;
-    dstr.posX             = scrX;
-    dstr.posY             = scrY;
-    dstr.scaling          = scaling;
-    dstr.text             = DD_MOVE(str);
-    dstr.centered         = true;
-    vecCopy(dstr.color, color);
+    DebugString * dstr = beginString(ctx, durationMillis);
+    if (dstr == DD_NULL)
+    {
+        return;
+    }
+
+    dstr->posX     = scrX;
+    dstr->posY     = scrY;
+    dstr->scaling  = scaling;
+    dstr->text     = DD_MOVE(str);
+    dstr->centered = true;
+    vecCopy(dstr->color, color);
+
+    commitString(ctx);
 }
 
 void axisTriad(ddMat4x4Param transform, const float size, const float length,
@@ -2416,34 +4785,11 @@ void axisTriad(ddMat4x4Param transform, const float size, const float length,
     arrow(p0, p3, cB, size, durationMillis, depthEnabled); // Z: blue axis
 }
 
-void arrow(ddVec3Param from, ddVec3Param to, ddVec3Param color, const float size,
-           const int durationMillis, const bool depthEnabled)
+template<typename Emit>
+void arrowLines(ddVec3Param from, ddVec3Param to, const float size, Emit & emit)
 {
-    DD_CHECK_INIT;
-
-    static const float arrowStep = 30.0f; // In degrees
-    static bool sinCosTablesComputed = false;
-    static float arrowSin[45];
-    static float arrowCos[45];
-
-    // Calculate sine and cosine tables only once:
-    if (!sinCosTablesComputed)
-    {
-        int i = 0;
-        float degrees = 0.0f;
-        for (; degrees < 360.0f; degrees += arrowStep, ++i)
-        {
-            arrowSin[i] = DD_FSIN(DD_DEG2RAD(degrees));
-            arrowCos[i] = DD_FCOS(DD_DEG2RAD(degrees));
-        }
-
-        arrowSin[i] = arrowSin[0];
-        arrowCos[i] = arrowCos[0];
-        sinCosTablesComputed = true;
-    }
-
     // Body line:
-    line(from, to, color, durationMillis, depthEnabled);
+    emit(from, to);
 
     // Aux vectors to compute the arrowhead:
     ddVec3 up, right, forward;
@@ -2453,33 +4799,60 @@ void arrow(ddVec3Param from, ddVec3Param to, ddVec3Param color, const float size
     vecScale(forward, forward, size);
 
     // Arrowhead is a cone (sin/cos tables used here):
-    float degrees = 0.0f;
-    for (int i = 0; degrees < 360.0f; degrees += arrowStep, ++i)
+    for (int i = 0; i < (360 / 30); ++i)
     {
         float scale;
         ddVec3 v1, v2, temp;
 
-        scale = 0.5f * size * arrowCos[i];
+        scale = 0.5f * size * cos30[i];
         vecScale(temp, right, scale);
         vecSub(v1, to, forward);
         vecAdd(v1, v1, temp);
 
-        scale = 0.5f * size * arrowSin[i];
+        scale = 0.5f * size * sin30[i];
         vecScale(temp, up, scale);
         vecAdd(v1, v1, temp);
 
-        scale = 0.5f * size * arrowCos[i + 1];
+        scale = 0.5f * size * cos30[i + 1];
         vecScale(temp, right, scale);
         vecSub(v2, to, forward);
         vecAdd(v2, v2, temp);
 
-        scale = 0.5f * size * arrowSin[i + 1];
+        scale = 0.5f * size * sin30[i + 1];
         vecScale(temp, up, scale);
         vecAdd(v2, v2, temp);
 
-        line(v1, to, color, durationMillis, depthEnabled);
-        line(v1, v2, color, durationMillis, depthEnabled);
+        emit(v1, to);
+        emit(v1, v2);
+    }
+}
+
+void arrow(ddVec3Param from, ddVec3Param to, ddVec3Param color, const float size,
+           const int durationMillis, const bool depthEnabled)
+{
+    DD_CHECK_INIT;
+    ContextImpl & ctx = *t_currentContext;
+
+    // The head is 'size' long with a radius of size / 2, at the 'to' end.
+    ddVec3 center, shaft;
+    vecAdd(center, from, to);
+    vecScale(center, center, 0.5f);
+    vecSub(shaft, to, from);
+    if (cullSubmission(ctx, ctx.linesUsage, center, (0.5f * vecLength(shaft)) + size, durationMillis))
+    {
+        return;
+    }
+
+    DrawVertex * verts = reserveLines(ctx, ArrowLineCount, durationMillis, depthEnabled);
+    if (verts != DD_NULL)
+    {
+        StreamEmitter emit(verts, color);
+        arrowLines(from, to, size, emit);
+        return;
     }
+
+    LineEmitter emit(color, durationMillis, depthEnabled);
+    arrowLines(from, to, size, emit);
 }
 
 void cross(ddVec3Param center, const float length, const int durationMillis, const bool depthEnabled)
@@ -2518,30 +4891,45 @@ void circle(ddVec3Param center, ddVec3Param planeNormal, ddVec3Param color, cons
             const float numSteps, const int durationMillis, const bool depthEnabled)
 {
     DD_CHECK_INIT;
+    ContextImpl & ctx = *t_currentContext;
 
-    ddVec3 left, up;
-    ddVec3 point, lastPoint;
+    if (cullSubmission(ctx, ctx.shapesUsage, center, DD_FABS(radius), durationMillis))
+    {
+        return;
+    }
 
+    ddVec3 left, up;
     vecOrthogonalBasis(left, up, planeNormal);
 
     vecScale(up, up, radius);
     vecScale(left, left, radius);
-    vecAdd(lastPoint, center, up);
 
-    for (int i = 1; i <= numSteps; ++i)
+    // The circle mesh only has rings of whole step counts.
+    const int steps = static_cast<int>(numSteps);
+    if (shapeInstancing(ctx) && static_cast<float>(steps) == numSteps &&
+        steps >= 3 && steps <= ShapeCircleMaxSteps)
     {
-        const float radians = DD_TAU * i / numSteps;
-
-        ddVec3 vs, vc;
-        vecScale(vs, left, DD_FSIN(radians));
-        vecScale(vc, up,   DD_FCOS(radians));
-
-        vecAdd(point, center, vs);
-        vecAdd(point, point,  vc);
+        // The unit rings sit at z = 1; a zero z column drops that.
+        const float transform[12] = {
+            left[X], up[X], 0.0f, center[X],
+            left[Y], up[Y], 0.0f, center[Y],
+            left[Z], up[Z], 0.0f, center[Z]
+        };
+        pushShape(ctx, ShapeCircle, transform, color, numSteps, durationMillis, depthEnabled);
+        return;
+    }
 
-        line(lastPoint, point, color, durationMillis, depthEnabled);
-        vecCopy(lastPoint, point);
+    // circleLines() draws one line per whole step.
+    DrawVertex * verts = (numSteps >= 1.0f) ? reserveLines(ctx, steps, durationMillis, depthEnabled) : DD_NULL;
+    if (verts != DD_NULL)
+    {
+        StreamEmitter emit(verts, color);
+        circleLines(center, left, up, numSteps, emit);
+        return;
     }
+
+    LineEmitter emit(color, durationMillis, depthEnabled);
+    circleLines(center, left, up, numSteps, emit);
 }
 
 void plane(ddVec3Param center, ddVec3Param planeNormal, ddVec3Param planeColor, ddVec3Param normalVecColor,
@@ -2584,54 +4972,54 @@ void plane(ddVec3Param center, ddVec3Param planeNormal, ddVec3Param planeColor,
 void sphere(ddVec3Param center, ddVec3Param color, const float radius, const int durationMillis, const bool depthEnabled)
 {
     DD_CHECK_INIT;
+    ContextImpl & ctx = *t_currentContext;
 
-    static const int stepSize = 15;
-    ddVec3 cache[360 / stepSize];
-    ddVec3 radiusVec;
-
-    vecSet(radiusVec, 0.0f, 0.0f, radius);
-    vecAdd(cache[0], center, radiusVec);
-
-    for (int n = 1; n < DD_ARRAY_LEN(cache); ++n)
+    if (cullSubmission(ctx, ctx.shapesUsage, center, DD_FABS(radius), durationMillis))
     {
-        vecCopy(cache[n], cache[0]);
+        return;
     }
 
-    ddVec3 lastPoint, temp;
-    for (int i = stepSize; i <= 360; i += stepSize)
+    if (shapeInstancing(ctx))
     {
-        const float s = DD_FSIN(DD_DEG2RAD(i));
-        const float c = DD_FCOS(DD_DEG2RAD(i));
-
-        lastPoint[X] = center[X];
-        lastPoint[Y] = center[Y] + radius * s;
-        lastPoint[Z] = center[Z] + radius * c;
-
-        for (int n = 0, j = stepSize; j <= 360; j += stepSize, ++n)
-        {
-            temp[X] = center[X] + DD_FSIN(DD_DEG2RAD(j)) * radius * s;
-            temp[Y] = center[Y] + DD_FCOS(DD_DEG2RAD(j)) * radius * s;
-            temp[Z] = lastPoint[Z];
-
-            line(lastPoint, temp, color, durationMillis, depthEnabled);
-            line(lastPoint, cache[n], color, durationMillis, depthEnabled);
+        const float transform[12] = {
+            radius, 0.0f,   0.0f,   center[X],
+            0.0f,   radius, 0.0f,   center[Y],
+            0.0f,   0.0f,   radius, center[Z]
+        };
+        pushShape(ctx, ShapeSphere, transform, color, 1.0f, durationMillis, depthEnabled);
+        return;
+    }
 
-            vecCopy(cache[n], lastPoint);
-            vecCopy(lastPoint, temp);
-        }
+    DrawVertex * verts = reserveLines(ctx, SphereLineCount, durationMillis, depthEnabled);
+    if (verts != DD_NULL)
+    {
+        StreamEmitter emit(verts, color);
+        sphereLines(center, radius, emit);
+        return;
     }
+
+    LineEmitter emit(color, durationMillis, depthEnabled);
+    sphereLines(center, radius, emit);
 }
 
 void cone(ddVec3Param apex, ddVec3Param dir, ddVec3Param color, const float baseRadius,
           const float apexRadius, const int durationMillis, const bool depthEnabled)
 {
     DD_CHECK_INIT;
+    ContextImpl & ctx = *t_currentContext;
+
+    // Around the middle of the axis, reaching the rim of the wider ring.
+    ddVec3 middle;
+    vecScale(middle, dir, 0.5f);
+    vecAdd(middle, middle, apex);
+    const float halfLength = 0.5f * vecLength(dir);
+    const float ringRadius = (DD_FABS(baseRadius) > DD_FABS(apexRadius)) ? DD_FABS(baseRadius) : DD_FABS(apexRadius);
+    if (cullSubmission(ctx, ctx.shapesUsage, middle, halfLength + ringRadius, durationMillis))
+    {
+        return;
+    }
 
-    static const int stepSize = 20;
     ddVec3 axis[3];
-    ddVec3 top, temp0, temp1, temp2;
-    ddVec3 p1, p2, lastP1, lastP2;
-
     vecCopy(axis[2], dir);
     vecNormalize(axis[2], axis[2]);
     vecOrthogonalBasis(axis[0], axis[1], axis[2]);
@@ -2640,93 +5028,97 @@ void cone(ddVec3Param apex, ddVec3Param dir, ddVec3Param color, const float base
     axis[1][Y] = -axis[1][Y];
     axis[1][Z] = -axis[1][Z];
 
+    // Pointed cones draw spokes to the apex, which the unit mesh doesn't have.
+    if (shapeInstancing(ctx) && apexRadius != 0.0f && baseRadius != 0.0f)
+    {
+        const float transform[12] = {
+            axis[0][X] * baseRadius, axis[1][X] * baseRadius, dir[X], apex[X],
+            axis[0][Y] * baseRadius, axis[1][Y] * baseRadius, dir[Y], apex[Y],
+            axis[0][Z] * baseRadius, axis[1][Z] * baseRadius, dir[Z], apex[Z]
+        };
+        pushShape(ctx, ShapeCone, transform, color, apexRadius / baseRadius, durationMillis, depthEnabled);
+        return;
+    }
+
+    ddVec3 top;
     vecAdd(top, apex, dir);
-    vecScale(temp1, axis[1], baseRadius);
-    vecAdd(lastP2, top, temp1);
 
-    if (apexRadius == 0.0f)
+    const int lineCount = (apexRadius == 0.0f) ? ConeLineCount : OpenConeLineCount;
+    DrawVertex * verts = reserveLines(ctx, lineCount, durationMillis, depthEnabled);
+    if (verts != DD_NULL)
     {
-        for (int i = stepSize; i <= 360; i += stepSize)
-        {
-            vecScale(temp1, axis[0], DD_FSIN(DD_DEG2RAD(i)));
-            vecScale(temp2, axis[1], DD_FCOS(DD_DEG2RAD(i)));
-            vecAdd(temp0, temp1, temp2);
+        StreamEmitter emit(verts, color);
+        coneLines(apex, top, axis[0], axis[1], baseRadius, apexRadius, emit);
+        return;
+    }
 
-            vecScale(temp0, temp0, baseRadius);
-            vecAdd(p2, top, temp0);
+    LineEmitter emit(color, durationMillis, depthEnabled);
+    coneLines(apex, top, axis[0], axis[1], baseRadius, apexRadius, emit);
+}
 
-            line(lastP2, p2, color, durationMillis, depthEnabled);
-            line(p2, apex, color, durationMillis, depthEnabled);
+void box(const ddVec3 points[8], ddVec3Param color, const int durationMillis, const bool depthEnabled)
+{
+    DD_CHECK_INIT;
+    ContextImpl & ctx = *t_currentContext;
 
-            vecCopy(lastP2, p2);
-        }
-    }
-    else // A degenerate cone with open apex:
+    if (cullsSubmissions(ctx, durationMillis))
     {
-        vecScale(temp1, axis[1], apexRadius);
-        vecAdd(lastP1, apex, temp1);
-
-        for (int i = stepSize; i <= 360; i += stepSize)
+        ddVec3 center, offset;
+        vecSet(center, 0.0f, 0.0f, 0.0f);
+        for (int i = 0; i < 8; ++i)
         {
-            vecScale(temp1, axis[0], DD_FSIN(DD_DEG2RAD(i)));
-            vecScale(temp2, axis[1], DD_FCOS(DD_DEG2RAD(i)));
-            vecAdd(temp0, temp1, temp2);
-
-            vecScale(temp1, temp0, apexRadius);
-            vecScale(temp2, temp0, baseRadius);
-
-            vecAdd(p1, apex, temp1);
-            vecAdd(p2, top,  temp2);
-
-            line(lastP1, p1, color, durationMillis, depthEnabled);
-            line(lastP2, p2, color, durationMillis, depthEnabled);
-            line(p1, p2, color, durationMillis, depthEnabled);
+            vecAdd(center, center, points[i]);
+        }
+        vecScale(center, center, 0.125f);
 
-            vecCopy(lastP1, p1);
-            vecCopy(lastP2, p2);
+        float radius = 0.0f;
+        for (int i = 0; i < 8; ++i)
+        {
+            vecSub(offset, points[i], center);
+            const float distance = vecLength(offset);
+            radius = (distance > radius) ? distance : radius;
+        }
+        if (cullSubmission(ctx, ctx.shapesUsage, center, radius, durationMillis))
+        {
+            return;
         }
     }
-}
 
-void box(const ddVec3 points[8], ddVec3Param color, const int durationMillis, const bool depthEnabled)
-{
-    // Build the lines from points using clever indexing tricks:
-    // (& 3 is a fancy way of doing % 4, but avoids the expensive modulo operation)
-    for (int i = 0; i < 4; ++i)
+    // Any eight points, so always lines.
+    DrawVertex * verts = reserveLines(ctx, BoxLineCount, durationMillis, depthEnabled);
+    if (verts != DD_NULL)
     {
-        line(points[i], points[(i + 1) & 3], color, durationMillis, depthEnabled);
-        line(points[4 + i], points[4 + ((i + 1) & 3)], color, durationMillis, depthEnabled);
-        line(points[i], points[4 + i], color, durationMillis, depthEnabled);
+        StreamEmitter emit(verts, color);
+        boxLines(points, emit);
+        return;
     }
+
+    LineEmitter emit(color, durationMillis, depthEnabled);
+    boxLines(points, emit);
 }
 
 void box(ddVec3Param center, ddVec3Param color, const float width, const float height,
          const float depth, const int durationMillis, const bool depthEnabled)
 {
     DD_CHECK_INIT;
+    ContextImpl & ctx = *t_currentContext;
 
-    const float cx = center[X];
-    const float cy = center[Y];
-    const float cz = center[Z];
-    const float w  = width  * 0.5f;
-    const float h  = height * 0.5f;
-    const float d  = depth  * 0.5f;
+    ddVec3 size;
+    vecSet(size, width, height, depth);
+    if (cullSubmission(ctx, ctx.shapesUsage, center, 0.5f * vecLength(size), durationMillis))
+    {
+        return;
+    }
+
+    if (shapeInstancing(ctx))
+    {
+        pushBoxShape(ctx, center, size, color, durationMillis, depthEnabled);
+        return;
+    }
 
     // Create all the 8 points:
     ddVec3 points[8];
-    #define DD_BOX_V(v, op1, op2, op3) \
-    v[X] = cx op1 w; \
-    v[Y] = cy op2 h; \
-    v[Z] = cz op3 d
-    DD_BOX_V(points[0], -, +, +);
-    DD_BOX_V(points[1], -, +, -);
-    DD_BOX_V(points[2], +, +, -);
-    DD_BOX_V(points[3], +, +, +);
-    DD_BOX_V(points[4], -, -, +);
-    DD_BOX_V(points[5], -, -, -);
-    DD_BOX_V(points[6], +, -, -);
-    DD_BOX_V(points[7], +, -, +);
-    #undef DD_BOX_V
+    boxPoints(points, center, width * 0.5f, height * 0.5f, depth * 0.5f);
 
     box(points, color, durationMillis, depthEnabled);
 }
@@ -2734,6 +5126,22 @@ void box(ddVec3Param center, ddVec3Param color, const float width, const float h
 void aabb(ddVec3Param mins, ddVec3Param maxs, ddVec3Param color, const int durationMillis, const bool depthEnabled)
 {
     DD_CHECK_INIT;
+    ContextImpl & ctx = *t_currentContext;
+
+    ddVec3 center, size;
+    vecAdd(center, mins, maxs);
+    vecScale(center, center, 0.5f);
+    vecSub(size, maxs, mins);
+    if (cullSubmission(ctx, ctx.shapesUsage, center, 0.5f * vecLength(size), durationMillis))
+    {
+        return;
+    }
+
+    if (shapeInstancing(ctx))
+    {
+        pushBoxShape(ctx, center, size, color, durationMillis, depthEnabled);
+        return;
+    }
 
     ddVec3 bb[2];
     ddVec3 points[8];
@@ -2860,6 +5268,43 @@ void xzSquareGrid(const float mins, const float maxs, const float y, const float
     }
 }
 
+int shapeMesh(const ShapeType type, float * xyz)
+{
+    ddVec3 origin, unitX, unitY, unitZ;
+    vecSet(origin, 0.0f, 0.0f, 0.0f);
+    vecSet(unitX,  1.0f, 0.0f, 0.0f);
+    vecSet(unitY,  0.0f, 1.0f, 0.0f);
+    vecSet(unitZ,  0.0f, 0.0f, 1.0f);
+
+    MeshEmitter emit(xyz);
+    switch (type)
+    {
+    case ShapeSphere :
+        sphereLines(origin, 1.0f, emit);
+        break;
+    case ShapeCone :
+        // Apex ring at z = 0, scaled by the instance's param; base ring at z = 1.
+        coneLines(origin, unitZ, unitX, unitY, 1.0f, 1.0f, emit);
+        break;
+    case ShapeBox :
+        {
+            ddVec3 points[8];
+            boxPoints(points, origin, 0.5f, 0.5f, 0.5f);
+            boxLines(points, emit);
+        }
+        break;
+    case ShapeCircle :
+        for (int steps = 3; steps <= ShapeCircleMaxSteps; ++steps)
+        {
+            circleLines(unitZ, unitX, unitY, static_cast<float>(steps), emit);
+        }
+        break;
+    default :
+        break;
+    }
+    return emit.vertCount;
+}
+
 // ========================================================
 // RenderInterface stubs:
 // ========================================================
@@ -2870,6 +5315,8 @@ void RenderInterface::endDraw() { }
 void RenderInterface::drawPointList(const DrawVertex *, int, bool) { }
 void RenderInterface::drawLineList(const DrawVertex *, int, bool) { }
 void RenderInterface::drawGlyphList(const DrawVertex *, int, GlyphTextureHandle) { }
+bool RenderInterface::supportsShapeInstances() { return false; }
+void RenderInterface::drawShapeList(ShapeType, const ShapeInstance *, int, bool) { }
 void RenderInterface::destroyGlyphTexture(GlyphTextureHandle) { }
 GlyphTextureHandle RenderInterface::createGlyphTexture(int, int, const void *) { return DD_NULL; }
 
@@ -2880,6 +5327,9 @@ GlyphTextureHandle RenderInterface::createGlyphTexture(int, int, const void *) {
 #undef DD_MOVE
 #undef DD_FSIN
 #undef DD_FCOS
+#undef DD_SIMD_SSE
+#undef DD_SIMD_SSE2
+#undef DD_SIMD_NEON
 #undef DD_FABS
 #undef DD_INV_FSQRT
 #undef DD_PI
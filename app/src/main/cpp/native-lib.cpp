@@ -9,6 +9,7 @@
 #include <android/asset_manager.h>
 #include <android/asset_manager_jni.h>
 #include "Renderer.h"
+#include "ProgramBinaryCache.h"
 
 #include <errno.h>
 #include "stb_image.h"
@@ -60,6 +61,26 @@ Java_com_example_eglrenderer_MainActivity_nativeOnStop(JNIEnv* jenv, jobject obj
 }
 
 
+extern "C" JNIEXPORT void JNICALL
+Java_com_example_eglrenderer_MainActivity_nativeSetCacheDir(JNIEnv* jenv, jobject obj, jstring cacheDir)
+{
+    const char *path = jenv->GetStringUTFChars(cacheDir, 0);
+    LOG_INFO("Program cache directory %s", path);
+    ProgramBinaryCache::setDirectory(path);
+    jenv->ReleaseStringUTFChars(cacheDir, path);
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_example_eglrenderer_MainActivity_nativeCaptureFrames(JNIEnv* jenv, jobject obj, jstring fileName, jint frameCount)
+{
+    if (renderer == 0) {
+        return;
+    }
+    const char *path = jenv->GetStringUTFChars(fileName, 0);
+    LOG_INFO("Capturing %d frames to %s", (int)frameCount, path);
+    renderer->requestCapture(path, frameCount);
+    jenv->ReleaseStringUTFChars(fileName, path);
+}
 
 extern "C" JNIEXPORT void JNICALL
 Java_com_example_eglrenderer_MainActivity_nativeSetSurface(JNIEnv* jenv, jobject obj, jobject surface)
@@ -11,11 +11,13 @@ import android.view.SurfaceHolder;
 import android.widget.TextView;
 import android.view.View;
 import android.view.View.OnClickListener;
+import android.view.View.OnLongClickListener;
 import android.widget.Toast;
 
 public class MainActivity extends AppCompatActivity implements SurfaceHolder.Callback
 {
     private static String TAG = "EglSample";
+    private static final int CAPTURE_FRAME_COUNT = 60;
 
     // Used to load the 'native-lib' library on application startup.
     static {
@@ -32,6 +34,8 @@ public class MainActivity extends AppCompatActivity implements SurfaceHolder.Cal
 
         Log.i(TAG, "onCreate()");
 
+        nativeSetCacheDir(getCacheDir().getAbsolutePath());
+
         setContentView(R.layout.activity_main);
         SurfaceView surfaceView = (SurfaceView)findViewById(R.id.surfaceview);
         surfaceView.getHolder().addCallback(this);
@@ -42,6 +46,15 @@ public class MainActivity extends AppCompatActivity implements SurfaceHolder.Cal
                         Toast.LENGTH_LONG);
                 toast.show();
             }});
+        surfaceView.setOnLongClickListener(new OnLongClickListener() {
+            public boolean onLongClick(View view) {
+                String path = getCacheDir().getAbsolutePath() + "/capture.glcs";
+                nativeCaptureFrames(path, CAPTURE_FRAME_COUNT);
+                Toast.makeText(MainActivity.this,
+                        "Capturing " + CAPTURE_FRAME_COUNT + " frames to " + path,
+                        Toast.LENGTH_SHORT).show();
+                return true;
+            }});
     }
 
     @Override
@@ -94,6 +107,8 @@ public class MainActivity extends AppCompatActivity implements SurfaceHolder.Cal
     public native void nativeOnPause();
     public native void nativeOnStop();
     public native void nativeSetSurface(Surface surface);
+    public native void nativeSetCacheDir(String cacheDir);
+    public native void nativeCaptureFrames(String fileName, int frameCount);
     public static native void init_asset_manager(AssetManager assetManager);
 
     public void surfaceChanged(SurfaceHolder holder, int format, int w, int h) {
@@ -0,0 +1,66 @@
+//
+//  OffscreenGLES.cpp
+//
+
+#include "OffscreenGLES.h"
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <string.h>
+
+bool createOffscreenContext(bool debug, int width, int height)
+{
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+
+    EGLDisplay display = EGL_NO_DISPLAY;
+    if (getPlatformDisplay)
+    {
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    }
+    if (display == EGL_NO_DISPLAY)
+    {
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, 0, 0))
+    {
+        fprintf(stderr, "no EGL display (error 0x%x)\n", eglGetError());
+        return false;
+    }
+
+    const EGLint configAttribs[] = {
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+            EGL_RED_SIZE, 8,
+            EGL_GREEN_SIZE, 8,
+            EGL_BLUE_SIZE, 8,
+            EGL_NONE
+    };
+    EGLConfig config;
+    EGLint numConfigs = 0;
+    if (!eglChooseConfig(display, configAttribs, &config, 1, &numConfigs) || numConfigs == 0)
+    {
+        fprintf(stderr, "eglChooseConfig() returned error 0x%x\n", eglGetError());
+        return false;
+    }
+
+    const EGLint surfaceAttribs[] = { EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE };
+    EGLSurface surface = eglCreatePbufferSurface(display, config, surfaceAttribs);
+
+    eglBindAPI(EGL_OPENGL_ES_API);
+    EGLint contextAttribs[] = { EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE, 0, EGL_NONE };
+    const char *extensions = eglQueryString(display, EGL_EXTENSIONS);
+    if (debug && extensions && strstr(extensions, "EGL_KHR_create_context"))
+    {
+        contextAttribs[2] = EGL_CONTEXT_FLAGS_KHR;
+        contextAttribs[3] = EGL_CONTEXT_OPENGL_DEBUG_BIT_KHR;
+    }
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+    if (context == EGL_NO_CONTEXT ||
+        !eglMakeCurrent(display, surface, surface, context))
+    {
+        fprintf(stderr, "unable to make a GLES2 context current (error 0x%x)\n", eglGetError());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,208 @@
+//
+//  OffscreenGLES.h
+//
+//  Host GLES helpers for the tools: an offscreen Mesa context, and a backend
+//  that replays recorded commands into it. Recorded streams reference GL
+//  objects created outside the recording (programs, textures, buffers,
+//  vertex arrays); StandInGLESBackend maps those names to stand-in objects
+//  (one flat program, empty textures, buffers grown to fit the uploads) so
+//  the state changes, uploads and draws reach the driver as recorded.
+//
+
+#ifndef OffscreenGLES_h
+#define OffscreenGLES_h
+
+#define GL_GLEXT_PROTOTYPES
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+
+#include "GLCommandBuffer.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <map>
+#include <vector>
+
+// Creates a pbuffer GLES2 context and makes it current. 'debug' requests a
+// debug context where EGL_KHR_create_context is available.
+bool createOffscreenContext(bool debug = false, int width = 1080, int height = 1920);
+
+class StandInGLESBackend : public GLCommandBackend {
+public:
+    StandInGLESBackend()
+            : mProgram(0), mIndexBuffer(0), mArrayBuffer(0), mVertexArray(0)
+    {
+    }
+
+    bool initialize()
+    {
+        static const char *vertSource =
+                "attribute vec4 a_Position;\n"
+                "uniform mat4 u_a;\n"
+                "uniform mat4 u_b;\n"
+                "void main() { gl_Position = u_a * u_b * a_Position; gl_PointSize = 1.0; }\n";
+        static const char *fragSource =
+                "precision mediump float;\n"
+                "void main() { gl_FragColor = vec4(1.0); }\n";
+
+        GLuint vert = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(vert, 1, &vertSource, NULL);
+        glCompileShader(vert);
+        GLuint frag = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(frag, 1, &fragSource, NULL);
+        glCompileShader(frag);
+
+        mProgram = glCreateProgram();
+        glAttachShader(mProgram, vert);
+        glAttachShader(mProgram, frag);
+        glLinkProgram(mProgram);
+        glDeleteShader(vert);
+        glDeleteShader(frag);
+
+        GLint status = GL_FALSE;
+        glGetProgramiv(mProgram, GL_LINK_STATUS, &status);
+        if (status != GL_TRUE)
+        {
+            fprintf(stderr, "stand-in program failed to link\n");
+            return false;
+        }
+
+        // Large enough for any GL_UNSIGNED_SHORT draw.
+        std::vector<GLushort> indices(65536, 0);
+        glGenBuffers(1, &mIndexBuffer);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIndexBuffer);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLushort), &indices[0], GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+        GLESCommandBackend::initialize();
+        return true;
+    }
+
+    virtual void execute(const GLCommandBuffer::Command &command, const void *payload)
+    {
+        // Names are remapped on a copy of the payload, so every command still
+        // goes through GLESCommandBackend (and its GLDebug checks).
+        switch (command.opcode)
+        {
+            case GLCommandBuffer::CMD_USE_PROGRAM:
+            {
+                GLCommandBuffer::UseProgram cmd = *(const GLCommandBuffer::UseProgram *)payload;
+                cmd.program = cmd.program ? mProgram : 0;
+                mBackend.execute(command, &cmd);
+                return;
+            }
+            case GLCommandBuffer::CMD_BIND_TEXTURE:
+            {
+                GLCommandBuffer::BindTexture cmd = *(const GLCommandBuffer::BindTexture *)payload;
+                cmd.texture = standIn(mTextures, cmd.texture, TEXTURE);
+                mBackend.execute(command, &cmd);
+                return;
+            }
+            case GLCommandBuffer::CMD_BIND_VERTEX_ARRAY:
+            {
+                GLCommandBuffer::BindVertexArray cmd = *(const GLCommandBuffer::BindVertexArray *)payload;
+                cmd.array = mVertexArray = standIn(mVertexArrays, cmd.array, VERTEX_ARRAY);
+                mBackend.execute(command, &cmd);
+                return;
+            }
+            case GLCommandBuffer::CMD_BIND_FRAMEBUFFER:
+            {
+                // Offscreen targets were created outside the capture; their
+                // passes draw to the surface instead.
+                GLCommandBuffer::BindFramebuffer cmd = *(const GLCommandBuffer::BindFramebuffer *)payload;
+                cmd.framebuffer = 0;
+                mBackend.execute(command, &cmd);
+                return;
+            }
+            case GLCommandBuffer::CMD_DISCARD_FRAMEBUFFER:
+                // Names the offscreen targets' attachments, which the surface
+                // does not have.
+                return;
+            case GLCommandBuffer::CMD_BIND_BUFFER:
+            {
+                GLCommandBuffer::BindBuffer cmd = *(const GLCommandBuffer::BindBuffer *)payload;
+                cmd.buffer = standIn(mBuffers, cmd.buffer, BUFFER);
+                if (cmd.target == GL_ARRAY_BUFFER)
+                {
+                    mArrayBuffer = cmd.buffer;
+                }
+                mBackend.execute(command, &cmd);
+                return;
+            }
+            case GLCommandBuffer::CMD_BUFFER_SUB_DATA:
+            {
+                // Device buffers got their storage outside the capture.
+                const GLCommandBuffer::BufferSubData &cmd = *(const GLCommandBuffer::BufferSubData *)payload;
+                if (cmd.target == GL_ARRAY_BUFFER && mArrayBuffer != 0)
+                {
+                    uint32_t &size = mBufferSizes[mArrayBuffer];
+                    if (size < cmd.offset + cmd.size)
+                    {
+                        size = cmd.offset + cmd.size;
+                        glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_STREAM_DRAW);
+                    }
+                }
+                break;
+            }
+            case GLCommandBuffer::CMD_DRAW_ELEMENTS:
+                if (mVertexArray == 0)
+                {
+                    // Never source indices from client memory.
+                    return;
+                }
+                if (mIndexedArrays.insert(std::make_pair(mVertexArray, true)).second)
+                {
+                    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIndexBuffer);
+                }
+                break;
+            default:
+                break;
+        }
+        mBackend.execute(command, payload);
+    }
+
+private:
+    enum ObjectType { TEXTURE, VERTEX_ARRAY, BUFFER };
+
+    GLuint standIn(std::map<GLuint, GLuint> &names, GLuint name, ObjectType type)
+    {
+        if (name == 0)
+        {
+            return 0;
+        }
+        std::map<GLuint, GLuint>::iterator it = names.find(name);
+        if (it != names.end())
+        {
+            return it->second;
+        }
+
+        GLuint object = 0;
+        switch (type)
+        {
+            case TEXTURE:
+                glGenTextures(1, &object);
+                break;
+            case VERTEX_ARRAY:
+                glGenVertexArraysOES(1, &object);
+                break;
+            case BUFFER:
+                glGenBuffers(1, &object);
+                break;
+        }
+        names[name] = object;
+        return object;
+    }
+
+    GLESCommandBackend mBackend;
+    GLuint mProgram;
+    GLuint mIndexBuffer;
+    GLuint mArrayBuffer;
+    GLuint mVertexArray;
+    std::map<GLuint, GLuint> mTextures;
+    std::map<GLuint, GLuint> mVertexArrays;
+    std::map<GLuint, GLuint> mBuffers;
+    std::map<GLuint, uint32_t> mBufferSizes;
+    std::map<GLuint, bool> mIndexedArrays;
+};
+
+#endif /* OffscreenGLES_h */
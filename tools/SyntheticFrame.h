@@ -0,0 +1,62 @@
+//
+//  SyntheticFrame.h
+//
+//  Records a frame shaped like the app's drawFrame() (viewport, clear, the
+//  textured quad, then full debug-draw line batches) for tools that need one
+//  without a device capture. Object names match a typical device run.
+//
+
+#ifndef SyntheticFrame_h
+#define SyntheticFrame_h
+
+#include "GLCommandBuffer.h"
+
+#include <vector>
+
+inline void recordSyntheticFrame(GLCommandBuffer &commands, int lineBatches)
+{
+    // Same layout as dd::DrawVertex: position, color and point size.
+    static const int vertexCount = 4096;
+    static std::vector<float> vertices;
+    if (vertices.empty())
+    {
+        vertices.resize(vertexCount * 7);
+        for (size_t i = 0; i < vertices.size(); ++i)
+        {
+            vertices[i] = float(i % 97) / 97.0f;
+        }
+    }
+
+    static const GLfloat identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+
+    commands.viewport(0, 0, 1080, 1920);
+    commands.clearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    commands.clear(GL_COLOR_BUFFER_BIT);
+
+    commands.useProgram(3);
+    commands.activeTexture(GL_TEXTURE0);
+    commands.bindTexture(GL_TEXTURE_2D, 1);
+    commands.bindVertexArray(1);
+    commands.drawElements(GL_TRIANGLES, 6, GL_UNSIGNED_BYTE, 0);
+    commands.bindTexture(GL_TEXTURE_2D, 0);
+    commands.bindVertexArray(0);
+    commands.useProgram(0);
+
+    for (int batch = 0; batch < lineBatches; ++batch)
+    {
+        commands.bindVertexArray(2);
+        commands.useProgram(6);
+        commands.uniformMatrix4fv(0, identity);
+        commands.uniformMatrix4fv(1, identity);
+        commands.enable(GL_DEPTH_TEST);
+        commands.bindBuffer(GL_ARRAY_BUFFER, 3);
+        commands.bufferSubData(GL_ARRAY_BUFFER, 0, vertices.size() * sizeof(float), &vertices[0]);
+        commands.drawArrays(GL_LINES, 0, vertexCount);
+        commands.useProgram(0);
+        commands.bindVertexArray(0);
+        commands.bindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    commands.enable(GL_DEPTH_TEST);
+}
+
+#endif /* SyntheticFrame_h */
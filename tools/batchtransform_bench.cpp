@@ -0,0 +1,380 @@
+//
+//  batchtransform_bench.cpp
+//
+//  BatchTransform throughput per instruction set, in elements per
+//  nanosecond, for points, AABBs and spheres through a model matrix and for
+//  points projected to the screen. The first row is the way the renderer
+//  did it before: one glm mat4 * vec4 per point (eight per box) on
+//  array-of-structures data.
+//
+//  Every instruction set's results are checked against the same math in
+//  doubles; exits with 1 if any is off by more than kTolerance.
+//
+//      batchtransform_bench [elements] [passes]
+//
+
+#include "BatchTransform.h"
+#include "Clock.h"
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/gtc/type_ptr.hpp"
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+// Relative to the size of what is measured: the scene for positions and
+// radii, the viewport for screen positions and 1 for depth. Sums of terms
+// that cancel keep the error of the terms, so the result's own size is no
+// measure.
+static const double kTolerance = 1e-5;
+static const double kSceneSize = 100.0;
+
+enum Op { kPoints, kAabbs, kSpheres, kProject, kOpCount };
+static const char *const kOpNames[kOpCount] = { "points", "aabbs", "spheres", "project" };
+
+static uint32_t s_seed = 12345;
+static float nextRange(float low, float high)
+{
+    s_seed = s_seed * 1664525u + 1013904223u;
+    return low + (high - low) * (float(s_seed >> 8) / float(1 << 24));
+}
+
+// The scene in both layouts. Points are spread around the camera, about
+// one in eight behind it.
+struct Scene {
+    explicit Scene(int count)
+    {
+        s_seed = 12345;
+        for (int i = 0; i < count; ++i)
+        {
+            const glm::vec3 p(nextRange(-60.0f, 60.0f), nextRange(-20.0f, 20.0f), nextRange(-90.0f, 30.0f));
+            const glm::vec3 extent(nextRange(0.1f, 2.0f), nextRange(0.1f, 2.0f), nextRange(0.1f, 2.0f));
+            const float radius = nextRange(0.1f, 3.0f);
+            aosPoints.push_back(p);
+            aosMin.push_back(p - extent);
+            aosMax.push_back(p + extent);
+            aosRadius.push_back(radius);
+            for (int c = 0; c < 3; ++c)
+            {
+                x[c].push_back(p[c]);
+                minimum[c].push_back(p[c] - extent[c]);
+                maximum[c].push_back(p[c] + extent[c]);
+            }
+            radii.push_back(radius);
+        }
+
+        model = glm::translate(glm::mat4(1.0f), glm::vec3(3.0f, -1.0f, -12.0f));
+        model = glm::rotate(model, 0.7f, glm::normalize(glm::vec3(0.3f, 1.0f, 0.2f)));
+        model = glm::scale(model, glm::vec3(2.0f, 1.0f, 0.5f));
+        nearZ = 0.5f;
+        viewProjection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, nearZ, 500.0f) *
+                         glm::lookAt(glm::vec3(0.0f, 5.0f, 10.0f), glm::vec3(0.0f, 0.0f, -20.0f),
+                                     glm::vec3(0.0f, 1.0f, 0.0f));
+        viewport.x = 0.0f;
+        viewport.y = 0.0f;
+        viewport.width = 1280.0f;
+        viewport.height = 720.0f;
+    }
+
+    int size() const { return int(radii.size()); }
+
+    std::vector<glm::vec3> aosPoints, aosMin, aosMax;
+    std::vector<float> aosRadius;
+    std::vector<float> x[3], minimum[3], maximum[3], radii;
+    glm::mat4 model, viewProjection;
+    float nearZ;
+    BatchTransform::Viewport viewport;
+};
+
+// Output arrays for the SoA runs.
+struct Outputs {
+    explicit Outputs(int count)
+    {
+        for (int c = 0; c < 7; ++c)
+        {
+            data[c].resize(count);
+        }
+    }
+
+    std::vector<float> data[7];
+};
+
+static BatchTransform::Points points(std::vector<float> *c)
+{
+    const BatchTransform::Points p = { &c[0][0], &c[1][0], &c[2][0] };
+    return p;
+}
+
+static void runBatch(Op op, Scene &scene, Outputs &out)
+{
+    const int count = scene.size();
+    std::vector<float> *o = out.data;
+    switch (op)
+    {
+        case kPoints:
+            BatchTransform::transformPoints(glm::value_ptr(scene.model), points(scene.x), points(o), count);
+            break;
+        case kAabbs:
+        {
+            const BatchTransform::Aabbs in = {
+                &scene.minimum[0][0], &scene.minimum[1][0], &scene.minimum[2][0],
+                &scene.maximum[0][0], &scene.maximum[1][0], &scene.maximum[2][0]
+            };
+            const BatchTransform::Aabbs result = { &o[0][0], &o[1][0], &o[2][0], &o[3][0], &o[4][0], &o[5][0] };
+            BatchTransform::transformAabbs(glm::value_ptr(scene.model), in, result, count);
+            break;
+        }
+        case kSpheres:
+        {
+            const BatchTransform::Spheres in = { &scene.x[0][0], &scene.x[1][0], &scene.x[2][0], &scene.radii[0] };
+            const BatchTransform::Spheres result = { &o[0][0], &o[1][0], &o[2][0], &o[3][0] };
+            BatchTransform::transformSpheres(glm::value_ptr(scene.model), in, result, count);
+            break;
+        }
+        case kProject:
+        {
+            const BatchTransform::ScreenPoints result = { &o[0][0], &o[1][0], &o[2][0] };
+            BatchTransform::projectPoints(glm::value_ptr(scene.viewProjection), points(scene.x), scene.viewport,
+                                          result, count);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+// The per-element glm loops, writing the same SoA outputs so the checks
+// and the sink cover them too.
+static void runAos(Op op, Scene &scene, Outputs &out)
+{
+    const int count = scene.size();
+    std::vector<float> *o = out.data;
+    const glm::mat4 &m = scene.model;
+    switch (op)
+    {
+        case kPoints:
+            for (int i = 0; i < count; ++i)
+            {
+                const glm::vec4 p = m * glm::vec4(scene.aosPoints[i], 1.0f);
+                o[0][i] = p.x;
+                o[1][i] = p.y;
+                o[2][i] = p.z;
+            }
+            break;
+        case kAabbs:
+            for (int i = 0; i < count; ++i)
+            {
+                glm::vec3 low(INFINITY), high(-INFINITY);
+                for (int corner = 0; corner < 8; ++corner)
+                {
+                    const glm::vec3 p((corner & 1) ? scene.aosMax[i].x : scene.aosMin[i].x,
+                                      (corner & 2) ? scene.aosMax[i].y : scene.aosMin[i].y,
+                                      (corner & 4) ? scene.aosMax[i].z : scene.aosMin[i].z);
+                    const glm::vec3 t(m * glm::vec4(p, 1.0f));
+                    low = glm::min(low, t);
+                    high = glm::max(high, t);
+                }
+                for (int c = 0; c < 3; ++c)
+                {
+                    o[c][i] = low[c];
+                    o[3 + c][i] = high[c];
+                }
+            }
+            break;
+        case kSpheres:
+        {
+            const float scale = sqrtf(glm::max(glm::max(glm::dot(glm::vec3(m[0]), glm::vec3(m[0])),
+                                                        glm::dot(glm::vec3(m[1]), glm::vec3(m[1]))),
+                                               glm::dot(glm::vec3(m[2]), glm::vec3(m[2]))));
+            for (int i = 0; i < count; ++i)
+            {
+                const glm::vec4 p = m * glm::vec4(scene.aosPoints[i], 1.0f);
+                o[0][i] = p.x;
+                o[1][i] = p.y;
+                o[2][i] = p.z;
+                o[3][i] = scene.aosRadius[i] * scale;
+            }
+            break;
+        }
+        case kProject:
+        {
+            const BatchTransform::Viewport &v = scene.viewport;
+            for (int i = 0; i < count; ++i)
+            {
+                const glm::vec4 clip = scene.viewProjection * glm::vec4(scene.aosPoints[i], 1.0f);
+                if (clip.w > FLT_EPSILON)
+                {
+                    o[0][i] = v.x + (clip.x / clip.w * 0.5f + 0.5f) * v.width;
+                    o[1][i] = v.y + (0.5f - clip.y / clip.w * 0.5f) * v.height;
+                    o[2][i] = clip.z / clip.w * 0.5f + 0.5f;
+                }
+                else
+                {
+                    o[2][i] = -1.0f;
+                }
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+static double relativeError(double actual, double expected, double size)
+{
+    const double scale = fabs(expected) > size ? fabs(expected) : size;
+    return fabs(actual - expected) / scale;
+}
+
+static void worst(double &current, double error)
+{
+    current = error > current ? error : current;
+}
+
+// Largest error of 'out' after 'op', against doubles.
+static double check(Op op, const Scene &scene, const Outputs &out)
+{
+    const glm::dmat4 m(scene.model);
+    const glm::dmat4 vp(scene.viewProjection);
+    const std::vector<float> *o = out.data;
+    double error = 0.0;
+    for (int i = 0; i < scene.size(); ++i)
+    {
+        const glm::dvec3 p(scene.aosPoints[i]);
+        switch (op)
+        {
+            case kPoints:
+            case kSpheres:
+            {
+                const glm::dvec4 t = m * glm::dvec4(p, 1.0);
+                for (int c = 0; c < 3; ++c)
+                {
+                    worst(error, relativeError(o[c][i], t[c], kSceneSize));
+                }
+                if (op == kSpheres)
+                {
+                    const double scale = sqrt(glm::max(glm::max(glm::dot(glm::dvec3(m[0]), glm::dvec3(m[0])),
+                                                                glm::dot(glm::dvec3(m[1]), glm::dvec3(m[1]))),
+                                                       glm::dot(glm::dvec3(m[2]), glm::dvec3(m[2]))));
+                    worst(error, relativeError(o[3][i], scene.aosRadius[i] * scale, kSceneSize));
+                }
+                break;
+            }
+            case kAabbs:
+            {
+                glm::dvec3 low(INFINITY), high(-INFINITY);
+                for (int corner = 0; corner < 8; ++corner)
+                {
+                    const glm::dvec3 c((corner & 1) ? scene.aosMax[i].x : scene.aosMin[i].x,
+                                       (corner & 2) ? scene.aosMax[i].y : scene.aosMin[i].y,
+                                       (corner & 4) ? scene.aosMax[i].z : scene.aosMin[i].z);
+                    const glm::dvec3 t(m * glm::dvec4(c, 1.0));
+                    low = glm::min(low, t);
+                    high = glm::max(high, t);
+                }
+                for (int c = 0; c < 3; ++c)
+                {
+                    worst(error, relativeError(o[c][i], low[c], kSceneSize));
+                    worst(error, relativeError(o[3 + c][i], high[c], kSceneSize));
+                }
+                break;
+            }
+            case kProject:
+            {
+                const BatchTransform::Viewport &v = scene.viewport;
+                const glm::dvec4 clip = vp * glm::dvec4(p, 1.0);
+                if (clip.w <= FLT_EPSILON)
+                {
+                    worst(error, o[2][i] == -1.0f ? 0.0 : 1.0);
+                    break;
+                }
+                // Between the eye and the near plane w is small and the
+                // divide magnifies float rounding in any implementation;
+                // those points are clipped anyway.
+                if (clip.w < scene.nearZ)
+                {
+                    worst(error, o[2][i] != -1.0f ? 0.0 : 1.0);
+                    break;
+                }
+                const double sx = v.x + (clip.x / clip.w * 0.5 + 0.5) * v.width;
+                const double sy = v.y + (0.5 - clip.y / clip.w * 0.5) * v.height;
+                const double depth = clip.z / clip.w * 0.5 + 0.5;
+                worst(error, relativeError(o[0][i], sx, v.width));
+                worst(error, relativeError(o[1][i], sy, v.height));
+                worst(error, relativeError(o[2][i], depth, 1.0));
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    return error;
+}
+
+struct Row {
+    const char *name;
+    double perNs[kOpCount];
+    double error;
+};
+
+// Fastest pass: other work on the machine only ever adds time.
+static Row measure(const char *name, bool batch, Scene &scene, Outputs &out, int passes, float &sink)
+{
+    Row row;
+    row.name = name;
+    row.error = 0.0;
+    for (int op = 0; op < kOpCount; ++op)
+    {
+        double bestMs = 1e30;
+        for (int pass = 0; pass < passes; ++pass)
+        {
+            const double t0 = nowMillis();
+            batch ? runBatch(Op(op), scene, out) : runAos(Op(op), scene, out);
+            const double ms = nowMillis() - t0;
+            bestMs = ms < bestMs ? ms : bestMs;
+            sink += out.data[0][pass % scene.size()];
+        }
+        row.perNs[op] = scene.size() / (bestMs * 1e6);
+        worst(row.error, check(Op(op), scene, out));
+    }
+    return row;
+}
+
+int main(int argc, char **argv)
+{
+    const int count = argc > 1 ? atoi(argv[1]) : 65536;
+    const int passes = argc > 2 ? atoi(argv[2]) : 200;
+
+    Scene scene(count);
+    Outputs out(count);
+    float sink = 0.0f;
+
+    const BatchTransform::Isa picked = BatchTransform::isa();
+    std::vector<Row> rows;
+    rows.push_back(measure("glm AoS", false, scene, out, passes, sink));
+    for (int isa = 0; isa < BatchTransform::ISA_COUNT; ++isa)
+    {
+        if (BatchTransform::setIsa(BatchTransform::Isa(isa)))
+        {
+            rows.push_back(measure(BatchTransform::isaName(BatchTransform::Isa(isa)), true, scene, out, passes, sink));
+        }
+    }
+    BatchTransform::setIsa(picked);
+
+    printf("%d elements x %d passes, elements/ns, picked %s\n", count, passes, BatchTransform::isaName(picked));
+    printf(" %-10s %10s %10s %10s %10s %12s\n", "", kOpNames[0], kOpNames[1], kOpNames[2], kOpNames[3], "max error");
+    bool accurate = true;
+    for (size_t r = 0; r < rows.size(); ++r)
+    {
+        const bool ok = rows[r].error <= kTolerance;
+        printf(" %-10s %10.3f %10.3f %10.3f %10.3f %12.2e%s\n", rows[r].name, rows[r].perNs[kPoints],
+               rows[r].perNs[kAabbs], rows[r].perNs[kSpheres], rows[r].perNs[kProject], rows[r].error,
+               ok ? "" : "  OVER TOLERANCE");
+        accurate = accurate && ok;
+    }
+    printf(" sink %e\n", sink);
+    return accurate ? 0 : 1;
+}
@@ -0,0 +1,267 @@
+//
+//  ddcull_bench.cpp
+//
+//  dd frustum culling (dd::setCullFrustum()) on a large-world debug view:
+//  lines, points, spheres and projected labels spread over a 2 km cube,
+//  seen by a 60 degree camera in the middle of it, so most of the scene is
+//  off-screen. Reports enqueue + flush time and the vertices handed to the
+//  renderer per frame with culling off and on. The renderer copies each
+//  batch out like WorldDebugDrawer does, so both include the upload copy.
+//
+//  One more frame each way checks that culling kept every line and point
+//  with an end inside the view volume; exits with 1 if it did not.
+//
+//      ddcull_bench [lines] [spheres] [labels] [frames]
+//
+
+#define DEBUG_DRAW_IMPLEMENTATION
+#define DEBUG_DRAW_VERTEX_BUFFER_SIZE 65536
+#define DEBUG_DRAW_MAX_LINES 1048576
+#define DEBUG_DRAW_MAX_POINTS 65536
+#define DEBUG_DRAW_MAX_STRINGS 4096
+#define DEBUG_DRAW_OVERFLOWED(message) fprintf(stderr, "%s\n", message)
+#include "debug_draw.hpp"
+#include "Clock.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+// Column-major, like dd and GL take them.
+static float gViewProjection[16];
+
+// In doubles: in floats, z and w of points near the far plane agree to the
+// last bit and the answer there is noise.
+static bool insideView(const float *p)
+{
+    const float *m = gViewProjection;
+    const double x = double(m[0]) * p[0] + double(m[4]) * p[1] + double(m[8]) * p[2] + m[12];
+    const double y = double(m[1]) * p[0] + double(m[5]) * p[1] + double(m[9]) * p[2] + m[13];
+    const double z = double(m[2]) * p[0] + double(m[6]) * p[1] + double(m[10]) * p[2] + m[14];
+    const double w = double(m[3]) * p[0] + double(m[7]) * p[1] + double(m[11]) * p[2] + m[15];
+    return w > 0.0 && fabs(x) <= w && fabs(y) <= w && fabs(z) <= w;
+}
+
+class CountingRenderer : public dd::RenderInterface {
+public:
+    CountingRenderer() : mScratch(DEBUG_DRAW_VERTEX_BUFFER_SIZE), mCheck(false), mVertices(0), mInside(0) { }
+
+    void drawPointList(const dd::DrawVertex *points, int count, bool /*depthEnabled*/)
+    {
+        memcpy(&mScratch[0], points, count * sizeof(dd::DrawVertex));
+        for (int i = 0; mCheck && i < count; ++i)
+        {
+            mInside += insideView(&points[i].point.x) ? 1 : 0;
+        }
+        mVertices += count;
+    }
+
+    void drawLineList(const dd::DrawVertex *lines, int count, bool /*depthEnabled*/)
+    {
+        memcpy(&mScratch[0], lines, count * sizeof(dd::DrawVertex));
+        for (int i = 0; mCheck && i + 1 < count; i += 2)
+        {
+            mInside += (insideView(&lines[i].line.x) || insideView(&lines[i + 1].line.x)) ? 1 : 0;
+        }
+        mVertices += count;
+    }
+
+    dd::GlyphTextureHandle createGlyphTexture(int, int, const void *)
+    {
+        return reinterpret_cast<dd::GlyphTextureHandle>(this);
+    }
+
+    void drawGlyphList(const dd::DrawVertex * /*glyphs*/, int count, dd::GlyphTextureHandle /*glyphTex*/)
+    {
+        mVertices += count;
+    }
+
+    void reset(bool check)
+    {
+        mCheck = check;
+        mVertices = 0;
+        mInside = 0;
+    }
+
+    unsigned long long vertices() const { return mVertices; }
+    unsigned long long inside() const { return mInside; }
+
+private:
+    std::vector<dd::DrawVertex> mScratch;
+    bool mCheck;
+    unsigned long long mVertices;
+    unsigned long long mInside;
+};
+
+// Camera at the origin looking down -z, turning a little each frame.
+static void setCamera(int frame)
+{
+    const float fovY = 60.0f * float(M_PI) / 180.0f;
+    const float nearZ = 0.5f, farZ = 600.0f;
+    const float f = 1.0f / tanf(fovY * 0.5f);
+    const float yaw = 0.002f * frame;
+    const float c = cosf(yaw), s = sinf(yaw);
+
+    // projection * view, with view a rotation about y.
+    const float proj[16] = {
+        f, 0.0f, 0.0f, 0.0f,
+        0.0f, f, 0.0f, 0.0f,
+        0.0f, 0.0f, (farZ + nearZ) / (nearZ - farZ), -1.0f,
+        0.0f, 0.0f, (2.0f * farZ * nearZ) / (nearZ - farZ), 0.0f
+    };
+    const float view[16] = {
+        c, 0.0f, s, 0.0f,
+        0.0f, 1.0f, 0.0f, 0.0f,
+        -s, 0.0f, c, 0.0f,
+        0.0f, 0.0f, 0.0f, 1.0f
+    };
+    for (int col = 0; col < 4; ++col)
+    {
+        for (int row = 0; row < 4; ++row)
+        {
+            float sum = 0.0f;
+            for (int k = 0; k < 4; ++k)
+            {
+                sum += proj[k * 4 + row] * view[col * 4 + k];
+            }
+            gViewProjection[col * 4 + row] = sum;
+        }
+    }
+}
+
+// Deterministic points in the 2 km cube around the camera.
+static float coord(unsigned int i, unsigned int salt)
+{
+    unsigned int h = (i + 1) * 2654435761u ^ (salt * 40503u);
+    h ^= h >> 13;
+    h *= 0x5bd1e995u;
+    h ^= h >> 15;
+    return (float(h & 0xFFFF) / 65535.0f) * 2000.0f - 1000.0f;
+}
+
+static void queueScene(int lines, int spheres, int labels)
+{
+    const float color[3] = { 0.2f, 0.8f, 0.4f };
+    for (int i = 0; i < lines; ++i)
+    {
+        const float from[3] = { coord(i, 1), coord(i, 2) * 0.1f, coord(i, 3) };
+        const float to[3] = { from[0] + 4.0f, from[1] + 2.0f, from[2] - 3.0f };
+        dd::line(from, to, color);
+        if ((i & 7) == 0)
+        {
+            dd::point(from, color, 4.0f);
+        }
+    }
+    for (int i = 0; i < spheres; ++i)
+    {
+        const float center[3] = { coord(i, 4), coord(i, 5) * 0.1f, coord(i, 6) };
+        dd::sphere(center, color, 3.0f);
+    }
+    for (int i = 0; i < labels; ++i)
+    {
+        const float anchor[3] = { coord(i, 7), coord(i, 8) * 0.1f, coord(i, 9) };
+        dd::projectedText("label", anchor, color, gViewProjection, 0, 0, 1280, 720);
+    }
+}
+
+struct Run {
+    double enqueueMs;
+    double flushMs;
+    unsigned long long vertices;
+    unsigned long long inside;
+    unsigned long long culled;
+    bool statsOk; // dd::getFrameStats() succeeded every frame
+};
+
+static Run run(CountingRenderer &renderer, int lines, int spheres, int labels, int frames, bool cull)
+{
+    Run result = { 0.0, 0.0, 0, 0, 0, true };
+    // The last frame only checks what was kept.
+    for (int frame = 0; frame <= frames; ++frame)
+    {
+        setCamera(frame);
+        renderer.reset(frame == frames);
+
+        const double t0 = nowMillis();
+        if (cull)
+        {
+            dd::setCullFrustum(gViewProjection);
+        }
+        else
+        {
+            dd::clearCullFrustum();
+        }
+        queueScene(lines, spheres, labels);
+        const double t1 = nowMillis();
+        dd::flush(16 * (frame + 1));
+        const double t2 = nowMillis();
+        if (frame == frames)
+        {
+            result.inside = renderer.inside();
+            break;
+        }
+
+        result.enqueueMs += t1 - t0;
+        result.flushMs += t2 - t1;
+        result.vertices += renderer.vertices();
+
+        dd::FrameStats stats = dd::FrameStats();
+        if (!dd::getFrameStats(stats))
+        {
+            result.statsOk = false;
+            break;
+        }
+        result.culled += stats.lines.culled + stats.points.culled + stats.shapes.culled + stats.strings.culled;
+    }
+    return result;
+}
+
+static const char *cullCode()
+{
+#if DEBUG_DRAW_USE_SIMD && defined(__SSE__)
+    return "SSE";
+#elif DEBUG_DRAW_USE_SIMD && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+    return "NEON";
+#else
+    return "scalar";
+#endif
+}
+
+int main(int argc, char **argv)
+{
+    const int lines = argc > 1 ? atoi(argv[1]) : 100000;
+    const int spheres = argc > 2 ? atoi(argv[2]) : 500;
+    const int labels = argc > 3 ? atoi(argv[3]) : 2000;
+    const int frames = argc > 4 ? atoi(argv[4]) : 100;
+
+    CountingRenderer renderer;
+    const dd::ContextHandle context = dd::createContext(&renderer);
+    dd::makeCurrent(context);
+
+    const Run off = run(renderer, lines, spheres, labels, frames, false);
+    const Run on = run(renderer, lines, spheres, labels, frames, true);
+
+    printf("%d lines + %d points + %d spheres + %d labels/frame, %d frames, %s culling\n",
+           lines, lines / 8, spheres, labels, frames, cullCode());
+    printf(" %-12s %12s %12s %14s %14s\n", "", "enqueue ms", "flush ms", "vertices", "culled");
+    printf(" %-12s %12.3f %12.3f %14.0f %14.0f\n", "culling off", off.enqueueMs / frames, off.flushMs / frames,
+           double(off.vertices) / frames, double(off.culled) / frames);
+    printf(" %-12s %12.3f %12.3f %14.0f %14.0f\n", "culling on", on.enqueueMs / frames, on.flushMs / frames,
+           double(on.vertices) / frames, double(on.culled) / frames);
+    printf(" speedup %.2fx, %.1f%% of the vertices\n", (off.enqueueMs + off.flushMs) / (on.enqueueMs + on.flushMs),
+           100.0 * double(on.vertices) / off.vertices);
+
+    // Every line and point with an end in view must have been kept.
+    const bool kept = on.inside == off.inside;
+    printf(" in view      %llu off, %llu on (last frame)%s\n", off.inside, on.inside, kept ? "" : "  MISMATCH");
+    const bool statsOk = off.statsOk && on.statsOk;
+    if (!statsOk)
+    {
+        printf(" frame stats  FAILED\n");
+    }
+
+    dd::destroyContext(context);
+    return kept && statsOk ? 0 : 1;
+}
@@ -0,0 +1,226 @@
+//
+//  ddflush_bench.cpp
+//
+//  CPU cost of dd::flush() for a frame of one-frame debug lines and points
+//  (32k lines and 8k points by default, every fourth one depth-less). The
+//  renderer copies each batch out like WorldDebugDrawer does, so the time
+//  includes touching every vertex once, but no GL.
+//
+//  With 'contexts' > 1, that many independent dd contexts are filled and
+//  flushed concurrently, one thread each.
+//
+//  'burst' extra lines are queued on frame 100 to show the line queue
+//  growing to take them (or dropping what is over DEBUG_DRAW_MAX_LINES) and
+//  shrinking back once the burst is DEBUG_DRAW_SHRINK_FLUSHES frames old.
+//
+//  'timed' keeps that many long-lived lines queued on top: each frame adds
+//  timed / 125 lines lasting kTimedMillis (125 frames), so as many expire.
+//
+//      ddflush_bench [lines] [points] [frames] [contexts] [burst] [timed]
+//
+
+#define DEBUG_DRAW_IMPLEMENTATION
+#define DEBUG_DRAW_VERTEX_BUFFER_SIZE 65536
+#define DEBUG_DRAW_MAX_LINES 262144
+#define DEBUG_DRAW_OVERFLOWED(message) fprintf(stderr, "%s\n", message)
+#include "debug_draw.hpp"
+#include "Clock.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+class CopyingRenderer : public dd::RenderInterface {
+public:
+    CopyingRenderer()
+            : mScratch(DEBUG_DRAW_VERTEX_BUFFER_SIZE), mBatches(0), mVertices(0), mChecksum(0.0)
+    {
+    }
+
+    void drawPointList(const dd::DrawVertex *points, int count, bool depthEnabled)
+    {
+        consume(points, count, depthEnabled);
+    }
+
+    void drawLineList(const dd::DrawVertex *lines, int count, bool depthEnabled)
+    {
+        consume(lines, count, depthEnabled);
+    }
+
+    unsigned int batches() const { return mBatches; }
+    unsigned long long vertices() const { return mVertices; }
+    double checksum() const { return mChecksum; }
+
+private:
+    void consume(const dd::DrawVertex *verts, int count, bool depthEnabled)
+    {
+        memcpy(&mScratch[0], verts, count * sizeof(dd::DrawVertex));
+        // Order-independent, so layouts that batch differently still agree.
+        for (int i = 0; i < count; ++i)
+        {
+            mChecksum += mScratch[i].line.x + mScratch[i].line.g * (depthEnabled ? 1.0 : 2.0);
+        }
+        ++mBatches;
+        mVertices += count;
+    }
+
+    std::vector<dd::DrawVertex> mScratch;
+    unsigned int mBatches;
+    unsigned long long mVertices;
+    double mChecksum;
+};
+
+static void queueFrame(int lines, int points)
+{
+    for (int i = 0; i < lines; ++i)
+    {
+        const float t = float(i) / float(lines);
+        const float from[3] = { t, -1.0f, 0.5f };
+        const float to[3] = { -t, 1.0f, t };
+        const float color[3] = { t, 1.0f - t, 0.5f };
+        dd::line(from, to, color, 0, (i & 3) != 0);
+    }
+    for (int i = 0; i < points; ++i)
+    {
+        const float t = float(i) / float(points);
+        const float pos[3] = { t, t, -t };
+        const float color[3] = { 1.0f, t, 0.0f };
+        dd::point(pos, color, 4.0f, 0, (i & 3) != 0);
+    }
+}
+
+static const int kBurstFrame = 100;
+static const int kFrameMillis = 16;
+static const int kTimedMillis = 125 * kFrameMillis;
+
+static void queueTimed(int count, int frame)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        const float t = float(i) / float(count);
+        const float from[3] = { t, 0.0f, -1.0f };
+        const float to[3] = { t, float(frame & 7), 1.0f };
+        const float color[3] = { 0.0f, t, 1.0f };
+        dd::line(from, to, color, kTimedMillis, (i & 3) != 0);
+    }
+}
+
+struct ContextRun {
+    CopyingRenderer renderer;
+    double queueMs;
+    double flushMs;
+    // Line queue telemetry from dd::getFrameStats().
+    int steadyCapacity;
+    int peakCapacity;
+    int peakHighWater;
+    int finalCapacity;
+    int shrinkFrame;
+    unsigned long long dropped;
+    bool statsOk; // dd::getFrameStats() succeeded every frame
+};
+
+// One renderer with its own dd context, driven entirely by the calling thread.
+static void runContext(ContextRun *run, int lines, int points, int frames, int burst, int timed)
+{
+    const dd::ContextHandle context = dd::createContext(&run->renderer);
+    dd::makeCurrent(context);
+
+    run->queueMs = 0.0;
+    run->flushMs = 0.0;
+    run->steadyCapacity = 0;
+    run->peakCapacity = 0;
+    run->peakHighWater = 0;
+    run->shrinkFrame = -1;
+    run->dropped = 0;
+    run->statsOk = true;
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        double t0 = nowMillis();
+        queueFrame(lines + (frame == kBurstFrame ? burst : 0), points);
+        queueTimed(timed / 125, frame);
+        double t1 = nowMillis();
+        dd::flush(kFrameMillis * (frame + 1));
+        double t2 = nowMillis();
+
+        run->queueMs += t1 - t0;
+        run->flushMs += t2 - t1;
+
+        dd::FrameStats stats = dd::FrameStats();
+        if (!dd::getFrameStats(stats))
+        {
+            run->statsOk = false;
+            break;
+        }
+        if (frame == kBurstFrame - 1)
+        {
+            run->steadyCapacity = stats.lines.capacity;
+        }
+        if (stats.lines.capacity > run->peakCapacity)
+        {
+            run->peakCapacity = stats.lines.capacity;
+        }
+        if (stats.lines.highWater > run->peakHighWater)
+        {
+            run->peakHighWater = stats.lines.highWater;
+        }
+        if (run->shrinkFrame < 0 && frame > kBurstFrame && stats.lines.capacity < run->peakCapacity)
+        {
+            run->shrinkFrame = frame;
+        }
+        run->dropped += stats.lines.dropped + stats.points.dropped;
+        run->finalCapacity = stats.lines.capacity;
+    }
+
+    dd::destroyContext(context);
+}
+
+int main(int argc, char **argv)
+{
+    const int lines = argc > 1 ? atoi(argv[1]) : 32768;
+    const int points = argc > 2 ? atoi(argv[2]) : DEBUG_DRAW_MAX_POINTS;
+    const int frames = argc > 3 ? atoi(argv[3]) : 500;
+    const int contexts = argc > 4 ? atoi(argv[4]) : 1;
+    const int burst = argc > 5 ? atoi(argv[5]) : 100000;
+    const int timed = argc > 6 ? atoi(argv[6]) : 0;
+
+    // Each context on its own thread, all flushing at the same time.
+    std::vector<ContextRun> runs(contexts);
+    std::vector<std::thread> threads;
+    for (int c = 0; c < contexts; ++c)
+    {
+        threads.push_back(std::thread(runContext, &runs[c], lines, points, frames, burst, timed));
+    }
+    for (int c = 0; c < contexts; ++c)
+    {
+        threads[c].join();
+    }
+
+    printf("%d lines + %d points/frame, %d timed lines, %d frames, %d contexts, +%d lines on frame %d\n",
+           lines, points, timed, frames, contexts, burst, kBurstFrame);
+    bool ok = true;
+    for (int c = 0; c < contexts; ++c)
+    {
+        const ContextRun &run = runs[c];
+        printf(" context %d\n", c);
+        printf("  enqueue           %.3f ms/frame\n", run.queueMs / frames);
+        printf("  flush             %.3f ms/frame\n", run.flushMs / frames);
+        printf("  batches/frame     %.1f\n", double(run.renderer.batches()) / frames);
+        printf("  vertices/frame    %.0f\n", double(run.renderer.vertices()) / frames);
+        printf("  checksum          %.6e\n", run.renderer.checksum());
+        printf("  line capacity     %d before burst, %d peak (high water %d), %d at end\n",
+               run.steadyCapacity, run.peakCapacity, run.peakHighWater, run.finalCapacity);
+        if (run.shrinkFrame >= 0)
+        {
+            printf("  shrunk            on frame %d\n", run.shrinkFrame);
+        }
+        printf("  dropped           %llu\n", run.dropped);
+        if (!run.statsOk)
+        {
+            printf("  frame stats       FAILED\n");
+            ok = false;
+        }
+    }
+    return ok ? 0 : 1;
+}
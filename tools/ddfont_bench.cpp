@@ -0,0 +1,130 @@
+//
+//  ddfont_bench.cpp
+//
+//  Cost of the debug font across context re-creation, which Renderer does on
+//  every window set and resume. Compares decoding the LZW-compressed glyph
+//  bitmap on every dd::createContext(), as before, with the process-wide
+//  bitmap that is decoded by the first flush with text and then reused.
+//
+//  The renderer copies the bitmap in createGlyphTexture() to stand in for
+//  the texture upload, so both sides include touching every pixel once.
+//
+//      ddfont_bench [contexts]
+//
+
+#define DEBUG_DRAW_IMPLEMENTATION
+#include "debug_draw.hpp"
+#include "Clock.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+class UploadingRenderer : public dd::RenderInterface {
+public:
+    UploadingRenderer() : mUploads(0), mGlyphs(0) { }
+
+    dd::GlyphTextureHandle createGlyphTexture(int width, int height, const void *pixels)
+    {
+        mTexture.resize(size_t(width) * height);
+        memcpy(&mTexture[0], pixels, mTexture.size());
+        ++mUploads;
+        return reinterpret_cast<dd::GlyphTextureHandle>(&mTexture[0]);
+    }
+
+    void destroyGlyphTexture(dd::GlyphTextureHandle /*glyphTex*/) { }
+
+    void drawGlyphList(const dd::DrawVertex * /*glyphs*/, int count, dd::GlyphTextureHandle /*glyphTex*/)
+    {
+        mGlyphs += count;
+    }
+
+    unsigned int uploads() const { return mUploads; }
+    unsigned long long glyphs() const { return mGlyphs; }
+
+private:
+    std::vector<unsigned char> mTexture;
+    unsigned int mUploads;
+    unsigned long long mGlyphs;
+};
+
+// One create/first-frame/destroy cycle. 'eagerDecode' adds the decode and
+// upload the old createContext() did on its own.
+static void cycle(UploadingRenderer &renderer, bool eagerDecode, bool drawText, double &createMs, double &flushMs)
+{
+    const double t0 = nowMillis();
+    const dd::ContextHandle context = dd::createContext(&renderer);
+    if (eagerDecode)
+    {
+        dd::UByte *bitmap = dd::decompressFontBitmap();
+        renderer.createGlyphTexture(dd::getFontCharSet().bitmapWidth, dd::getFontCharSet().bitmapHeight, bitmap);
+        free(bitmap);
+    }
+    const double t1 = nowMillis();
+
+    dd::makeCurrent(context);
+    if (drawText)
+    {
+        const float pos[3] = { 10.0f, 10.0f, 0.0f };
+        const float color[3] = { 1.0f, 1.0f, 1.0f };
+        dd::screenText("ddfont_bench", pos, color);
+    }
+    dd::flush(16);
+    const double t2 = nowMillis();
+
+    dd::destroyContext(context);
+    createMs += t1 - t0;
+    flushMs += t2 - t1;
+}
+
+int main(int argc, char **argv)
+{
+    const int contexts = argc > 1 ? atoi(argv[1]) : 100;
+    const int bitmapBytes = dd::getFontCharSet().bitmapDecompressSize;
+
+    UploadingRenderer renderer;
+
+    // Before: every context decodes and uploads in createContext(). No text,
+    // so the shared bitmap is still undecoded for the first lazy cycle.
+    double eagerCreate = 0.0, eagerFlush = 0.0;
+    for (int i = 0; i < contexts; ++i)
+    {
+        cycle(renderer, true, false, eagerCreate, eagerFlush);
+    }
+
+    // After, with no text: nothing is decoded or uploaded.
+    const unsigned int uploadsBefore = renderer.uploads();
+    double noTextCreate = 0.0, noTextFlush = 0.0;
+    for (int i = 0; i < contexts; ++i)
+    {
+        cycle(renderer, false, false, noTextCreate, noTextFlush);
+    }
+    const unsigned int noTextUploads = renderer.uploads() - uploadsBefore;
+
+    // After, with text: the first flush decodes once for the process, every
+    // flush after that only uploads.
+    double firstCreate = 0.0, firstFlush = 0.0;
+    cycle(renderer, false, true, firstCreate, firstFlush);
+    double lazyCreate = 0.0, lazyFlush = 0.0;
+    for (int i = 1; i < contexts; ++i)
+    {
+        cycle(renderer, false, true, lazyCreate, lazyFlush);
+    }
+
+    printf("%d context cycles, %d KB font bitmap (%d x %d)\n", contexts, bitmapBytes / 1024,
+           dd::getFontCharSet().bitmapWidth, dd::getFontCharSet().bitmapHeight);
+    printf("  decode per context    create %.3f ms\n", eagerCreate / contexts);
+    printf("  lazy, no text         create %.3f ms, first flush %.3f ms, %u uploads\n",
+           noTextCreate / contexts, noTextFlush / contexts, noTextUploads);
+    printf("  lazy, first context   create %.3f ms, first flush %.3f ms (decode)\n", firstCreate, firstFlush);
+    if (contexts > 1)
+    {
+        printf("  lazy, later contexts  create %.3f ms, first flush %.3f ms\n",
+               lazyCreate / (contexts - 1), lazyFlush / (contexts - 1));
+    }
+    printf("  bitmap memory         %d KB resident once, was %d KB allocated per context\n",
+           bitmapBytes / 1024, bitmapBytes / 1024);
+    printf("  glyph vertices        %llu\n", renderer.glyphs());
+    return 0;
+}
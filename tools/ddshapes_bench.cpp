@@ -0,0 +1,365 @@
+//
+//  ddshapes_bench.cpp
+//
+//  Throughput of the shapes dd expands to lines on the CPU (renderers
+//  without shape instancing, or draws from other threads), in shapes per
+//  millisecond of enqueue plus flush, against a copy of the generators as
+//  they were before the trig tables and SIMD rings: one sinf/cosf per step
+//  and one dd::line() per line.
+//
+//  Also checks the new output against that copy, vertex by vertex, and
+//  exits with 1 if any coordinate is off by more than kTolerance times the
+//  shape's size. The reference always uses libm, so the _fastmath build
+//  (DEBUG_DRAW_USE_STD_MATH=0) checks dd's FastMath path against it.
+//
+//      ddshapes_bench [shapes per frame] [frames]
+//
+
+#define DEBUG_DRAW_IMPLEMENTATION
+#define DEBUG_DRAW_VERTEX_BUFFER_SIZE 65536
+#define DEBUG_DRAW_MAX_LINES 1048576
+#define DEBUG_DRAW_OVERFLOWED(message) fprintf(stderr, "%s\n", message)
+#include "debug_draw.hpp"
+#include "Clock.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+static const float kTolerance = 1e-5f;
+
+class CapturingRenderer : public dd::RenderInterface {
+public:
+    CapturingRenderer() : mCapture(false), mVertices(0) { }
+
+    void drawLineList(const dd::DrawVertex *lines, int count, bool /*depthEnabled*/)
+    {
+        if (mCapture)
+        {
+            mCaptured.insert(mCaptured.end(), lines, lines + count);
+        }
+        mVertices += count;
+    }
+
+    void capture(bool enabled)
+    {
+        mCapture = enabled;
+        mCaptured.clear();
+    }
+
+    const std::vector<dd::DrawVertex> &captured() const { return mCaptured; }
+    unsigned long long vertices() const { return mVertices; }
+
+private:
+    bool mCapture;
+    std::vector<dd::DrawVertex> mCaptured;
+    unsigned long long mVertices;
+};
+
+//
+// The generators before the tables, kept as they were.
+//
+namespace reference {
+
+static float deg2rad(int degrees)
+{
+    return static_cast<float>(degrees) * M_PI / 180.0f;
+}
+
+static void sphere(const float center[3], const float color[3], float radius)
+{
+    static const int stepSize = 15;
+    float cache[360 / stepSize][3];
+    for (int n = 0; n < 360 / stepSize; ++n)
+    {
+        cache[n][0] = center[0];
+        cache[n][1] = center[1];
+        cache[n][2] = center[2] + radius;
+    }
+
+    float lastPoint[3], temp[3];
+    for (int i = stepSize; i <= 360; i += stepSize)
+    {
+        const float s = sinf(deg2rad(i));
+        const float c = cosf(deg2rad(i));
+
+        lastPoint[0] = center[0];
+        lastPoint[1] = center[1] + radius * s;
+        lastPoint[2] = center[2] + radius * c;
+
+        for (int n = 0, j = stepSize; j <= 360; j += stepSize, ++n)
+        {
+            temp[0] = center[0] + sinf(deg2rad(j)) * radius * s;
+            temp[1] = center[1] + cosf(deg2rad(j)) * radius * s;
+            temp[2] = lastPoint[2];
+
+            dd::line(lastPoint, temp, color);
+            dd::line(lastPoint, cache[n], color);
+
+            dd::vecCopy(cache[n], lastPoint);
+            dd::vecCopy(lastPoint, temp);
+        }
+    }
+}
+
+static void cone(const float apex[3], const float dir[3], const float color[3], float baseRadius, float apexRadius)
+{
+    static const int stepSize = 20;
+    ddVec3 axis[3];
+    ddVec3 top, temp0, temp1, temp2;
+    ddVec3 p1, p2, lastP1, lastP2;
+
+    dd::vecCopy(axis[2], dir);
+    dd::vecNormalize(axis[2], axis[2]);
+    dd::vecOrthogonalBasis(axis[0], axis[1], axis[2]);
+    axis[1][0] = -axis[1][0];
+    axis[1][1] = -axis[1][1];
+    axis[1][2] = -axis[1][2];
+
+    dd::vecAdd(top, apex, dir);
+    dd::vecScale(temp1, axis[1], baseRadius);
+    dd::vecAdd(lastP2, top, temp1);
+
+    if (apexRadius == 0.0f)
+    {
+        for (int i = stepSize; i <= 360; i += stepSize)
+        {
+            dd::vecScale(temp1, axis[0], sinf(deg2rad(i)));
+            dd::vecScale(temp2, axis[1], cosf(deg2rad(i)));
+            dd::vecAdd(temp0, temp1, temp2);
+            dd::vecScale(temp0, temp0, baseRadius);
+            dd::vecAdd(p2, top, temp0);
+
+            dd::line(lastP2, p2, color);
+            dd::line(p2, apex, color);
+            dd::vecCopy(lastP2, p2);
+        }
+    }
+    else
+    {
+        dd::vecScale(temp1, axis[1], apexRadius);
+        dd::vecAdd(lastP1, apex, temp1);
+
+        for (int i = stepSize; i <= 360; i += stepSize)
+        {
+            dd::vecScale(temp1, axis[0], sinf(deg2rad(i)));
+            dd::vecScale(temp2, axis[1], cosf(deg2rad(i)));
+            dd::vecAdd(temp0, temp1, temp2);
+            dd::vecScale(temp1, temp0, apexRadius);
+            dd::vecScale(temp2, temp0, baseRadius);
+            dd::vecAdd(p1, apex, temp1);
+            dd::vecAdd(p2, top, temp2);
+
+            dd::line(lastP1, p1, color);
+            dd::line(lastP2, p2, color);
+            dd::line(p1, p2, color);
+            dd::vecCopy(lastP1, p1);
+            dd::vecCopy(lastP2, p2);
+        }
+    }
+}
+
+static void arrow(const float from[3], const float to[3], const float color[3], float size)
+{
+    float arrowSin[13];
+    float arrowCos[13];
+    for (int i = 0; i < 12; ++i)
+    {
+        arrowSin[i] = sinf(deg2rad(i * 30));
+        arrowCos[i] = cosf(deg2rad(i * 30));
+    }
+    arrowSin[12] = arrowSin[0];
+    arrowCos[12] = arrowCos[0];
+
+    dd::line(from, to, color);
+
+    ddVec3 up, right, forward;
+    dd::vecSub(forward, to, from);
+    dd::vecNormalize(forward, forward);
+    dd::vecOrthogonalBasis(right, up, forward);
+    dd::vecScale(forward, forward, size);
+
+    for (int i = 0; i < 12; ++i)
+    {
+        ddVec3 v1, v2, temp;
+        dd::vecScale(temp, right, 0.5f * size * arrowCos[i]);
+        dd::vecSub(v1, to, forward);
+        dd::vecAdd(v1, v1, temp);
+        dd::vecScale(temp, up, 0.5f * size * arrowSin[i]);
+        dd::vecAdd(v1, v1, temp);
+
+        dd::vecScale(temp, right, 0.5f * size * arrowCos[i + 1]);
+        dd::vecSub(v2, to, forward);
+        dd::vecAdd(v2, v2, temp);
+        dd::vecScale(temp, up, 0.5f * size * arrowSin[i + 1]);
+        dd::vecAdd(v2, v2, temp);
+
+        dd::line(v1, to, color);
+        dd::line(v1, v2, color);
+    }
+}
+
+} // namespace reference
+
+enum Shape { kSphere, kCone, kOpenCone, kArrow, kShapeCount };
+static const char *const kShapeNames[kShapeCount] = { "sphere", "cone", "open cone", "arrow" };
+
+// Shape 'index' of a frame; 'useReference' picks the old generators.
+static void queueShape(Shape shape, int index, bool useReference)
+{
+    const float t = float(index % 97) / 97.0f;
+    const float pos[3] = { 20.0f * t - 10.0f, 5.0f - 10.0f * t, float(index % 13) - 6.0f };
+    const float color[3] = { t, 1.0f - t, 0.5f };
+    const float size = 0.5f + 4.0f * t;
+
+    switch (shape)
+    {
+        case kSphere:
+            useReference ? reference::sphere(pos, color, size) : dd::sphere(pos, color, size);
+            break;
+        case kCone:
+        case kOpenCone:
+        {
+            const float dir[3] = { t - 0.5f, size, 0.25f };
+            const float apexRadius = shape == kOpenCone ? 0.25f * size : 0.0f;
+            useReference ? reference::cone(pos, dir, color, size, apexRadius)
+                         : dd::cone(pos, dir, color, size, apexRadius);
+            break;
+        }
+        case kArrow:
+        {
+            const float to[3] = { pos[0] + size, pos[1] - t, pos[2] + 2.0f };
+            useReference ? reference::arrow(pos, to, color, size) : dd::arrow(pos, to, color, size);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+static void flushFrame()
+{
+    static ddI64 nowMillis = 0;
+    nowMillis += 16;
+    dd::flush(nowMillis);
+}
+
+static void queueFrame(Shape shape, int count, bool useReference)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        queueShape(shape, i, useReference);
+    }
+}
+
+// Largest coordinate difference relative to the shape size, or a negative
+// value if the vertex counts differ.
+static float compare(const std::vector<dd::DrawVertex> &expected, const std::vector<dd::DrawVertex> &actual)
+{
+    if (expected.size() != actual.size())
+    {
+        return -1.0f;
+    }
+    float maxError = 0.0f;
+    for (size_t i = 0; i < expected.size(); ++i)
+    {
+        const float dx = fabsf(expected[i].line.x - actual[i].line.x);
+        const float dy = fabsf(expected[i].line.y - actual[i].line.y);
+        const float dz = fabsf(expected[i].line.z - actual[i].line.z);
+        const float d = dx > dy ? (dx > dz ? dx : dz) : (dy > dz ? dy : dz);
+        if (d > maxError)
+        {
+            maxError = d;
+        }
+    }
+    return maxError / 4.5f; // Largest size queueShape() uses
+}
+
+static double timeFrames(Shape shape, int count, int frames, bool useReference)
+{
+    double total = 0.0;
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        const double t0 = nowMillis();
+        queueFrame(shape, count, useReference);
+        flushFrame();
+        total += nowMillis() - t0;
+    }
+    return total;
+}
+
+static const char *mathCode()
+{
+#if DEBUG_DRAW_USE_STD_MATH
+    return "libm";
+#else
+    return "FastMath";
+#endif
+}
+
+static const char *ringCode()
+{
+#if DEBUG_DRAW_USE_SIMD && defined(__SSE__)
+    return "SSE";
+#elif DEBUG_DRAW_USE_SIMD && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+    return "NEON";
+#else
+    return "scalar";
+#endif
+}
+
+int main(int argc, char **argv)
+{
+    const int count = argc > 1 ? atoi(argv[1]) : 200;
+    const int frames = argc > 2 ? atoi(argv[2]) : 200;
+
+    CapturingRenderer renderer;
+    const dd::ContextHandle context = dd::createContext(&renderer);
+    dd::makeCurrent(context);
+
+    printf("%d shapes/frame, %d frames, %s rings, %s\n", count, frames, ringCode(), mathCode());
+    printf(" %-10s %12s %12s %8s %12s\n", "shape", "old/ms", "new/ms", "speedup", "max error");
+
+    bool accurate = true;
+    for (int s = 0; s < kShapeCount; ++s)
+    {
+        const Shape shape = Shape(s);
+
+        renderer.capture(true);
+        queueFrame(shape, count, true);
+        flushFrame();
+        const std::vector<dd::DrawVertex> expected = renderer.captured();
+
+        renderer.capture(true);
+        queueFrame(shape, count, false);
+        flushFrame();
+        const float error = compare(expected, renderer.captured());
+        renderer.capture(false);
+
+        const double oldMs = timeFrames(shape, count, frames, true);
+        const double newMs = timeFrames(shape, count, frames, false);
+        const double shapes = double(count) * frames;
+
+        printf(" %-10s %12.1f %12.1f %7.2fx ", kShapeNames[s], shapes / oldMs, shapes / newMs, oldMs / newMs);
+        if (error < 0.0f)
+        {
+            printf("%12s\n", "count differs");
+        }
+        else
+        {
+            printf("%12.2e\n", error);
+        }
+        if (error < 0.0f || error > kTolerance)
+        {
+            accurate = false;
+        }
+    }
+
+    dd::FrameStats stats;
+    dd::getFrameStats(stats);
+    printf(" dropped           %d\n", stats.lines.dropped);
+
+    dd::destroyContext(context);
+    return accurate ? 0 : 1;
+}
@@ -0,0 +1,293 @@
+//
+//  ddthreads_bench.cpp
+//
+//  Contention benchmark for debug-draw submission from worker threads. Each
+//  frame, 'threads' producers add lines/threads lines at the same time and
+//  the main thread then flushes. Compares dd::line() through the per-thread
+//  rings (DEBUG_DRAW_THREAD_QUEUES) with the same producers appending to one
+//  shared queue under a std::mutex, and with the render thread adding all
+//  lines itself. Then checks that short-lived threads, many more than
+//  DEBUG_DRAW_MAX_THREADS over time, keep getting rings as earlier ones
+//  exit; exits with 1 if any of their lines are dropped.
+//
+//      ddthreads_bench [threads] [lines] [frames]
+//
+
+#define DEBUG_DRAW_IMPLEMENTATION
+#define DEBUG_DRAW_VERTEX_BUFFER_SIZE 65536
+#define DEBUG_DRAW_THREAD_QUEUES 1
+#define DEBUG_DRAW_MAX_THREADS 64
+
+#include <atomic>
+
+static std::atomic<unsigned int> s_overflows(0);
+#define DEBUG_DRAW_OVERFLOWED(message) s_overflows.fetch_add(1, std::memory_order_relaxed)
+
+#include "debug_draw.hpp"
+#include "Clock.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+class CountingRenderer : public dd::RenderInterface {
+public:
+    CountingRenderer() : mVertices(0) { }
+
+    void drawLineList(const dd::DrawVertex *, int count, bool)
+    {
+        mVertices += count;
+    }
+
+    unsigned long long vertices() const { return mVertices; }
+
+private:
+    unsigned long long mVertices;
+};
+
+// Releases the producers for one frame and waits for all of them.
+class FrameGate {
+public:
+    explicit FrameGate(int producers) : mProducers(producers), mFrame(0), mDone(0) { }
+
+    void release()
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mDone = 0;
+        ++mFrame;
+        mCondition.notify_all();
+        mCondition.wait(lock, [this] { return mDone == mProducers; });
+    }
+
+    int waitForFrame(int lastFrame)
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mCondition.wait(lock, [this, lastFrame] { return mFrame != lastFrame; });
+        return mFrame;
+    }
+
+    void finished()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (++mDone == mProducers)
+        {
+            mCondition.notify_all();
+        }
+    }
+
+private:
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    int mProducers;
+    int mFrame;
+    int mDone;
+};
+
+// The alternative: one queue shared by every thread behind a lock.
+struct LockedQueue {
+    std::mutex mutex;
+    std::vector<dd::DrawVertex> verts;
+    std::vector<long long> expiry;
+    int count;
+};
+
+enum Mode { MODE_THREAD_QUEUES, MODE_MUTEX };
+
+static void submitLines(Mode mode, LockedQueue &locked, int thread, int count)
+{
+    const float color[3] = { 1.0f, 0.5f, 0.25f };
+    for (int i = 0; i < count; ++i)
+    {
+        const float t = float(i) / float(count);
+        const float from[3] = { t, float(thread), 0.0f };
+        const float to[3] = { -t, float(thread), 1.0f };
+        if (mode == MODE_THREAD_QUEUES)
+        {
+            dd::line(from, to, color, 0, (i & 3) != 0);
+            continue;
+        }
+
+        std::lock_guard<std::mutex> lock(locked.mutex);
+        if (locked.count == DEBUG_DRAW_MAX_LINES)
+        {
+            continue;
+        }
+        dd::DrawVertex *v = &locked.verts[locked.count * 2];
+        locked.expiry[locked.count++] = 0;
+        v[0].line.x = from[0]; v[0].line.y = from[1]; v[0].line.z = from[2];
+        v[0].line.r = color[0]; v[0].line.g = color[1]; v[0].line.b = color[2];
+        v[1].line.x = to[0]; v[1].line.y = to[1]; v[1].line.z = to[2];
+        v[1].line.r = color[0]; v[1].line.g = color[1]; v[1].line.b = color[2];
+    }
+}
+
+struct Result {
+    double submitMs;  // Slowest producer, averaged over frames
+    double flushMs;
+    double linesPerFrame;
+};
+
+static Result run(Mode mode, int threads, int lines, int frames)
+{
+    CountingRenderer renderer;
+    dd::initialize(&renderer);
+
+    LockedQueue locked;
+    locked.verts.resize(DEBUG_DRAW_MAX_LINES * 2);
+    locked.expiry.resize(DEBUG_DRAW_MAX_LINES);
+    locked.count = 0;
+
+    FrameGate gate(threads);
+    std::vector<double> slowest(frames, 0.0);
+    std::mutex slowestMutex;
+    const int perThread = lines / threads;
+
+    const dd::ContextHandle context = dd::currentContext();
+    std::vector<std::thread> producers;
+    for (int p = 0; p < threads; ++p)
+    {
+        producers.push_back(std::thread([&, p] {
+            dd::makeCurrent(context);
+            int frame = 0;
+            for (int f = 0; f < frames; ++f)
+            {
+                frame = gate.waitForFrame(frame);
+                const double start = nowMillis();
+                submitLines(mode, locked, p, perThread);
+                const double elapsed = nowMillis() - start;
+                {
+                    std::lock_guard<std::mutex> lock(slowestMutex);
+                    if (elapsed > slowest[f])
+                    {
+                        slowest[f] = elapsed;
+                    }
+                }
+                gate.finished();
+            }
+        }));
+    }
+
+    double flushMs = 0.0;
+    for (int f = 0; f < frames; ++f)
+    {
+        gate.release();
+
+        const double start = nowMillis();
+        if (mode == MODE_THREAD_QUEUES)
+        {
+            dd::flush(16 * (f + 1));
+        }
+        else
+        {
+            std::lock_guard<std::mutex> lock(locked.mutex);
+            renderer.drawLineList(&locked.verts[0], locked.count * 2, true);
+            locked.count = 0;
+        }
+        flushMs += nowMillis() - start;
+    }
+
+    for (size_t p = 0; p < producers.size(); ++p)
+    {
+        producers[p].join();
+    }
+
+    Result result;
+    result.submitMs = 0.0;
+    for (int f = 0; f < frames; ++f)
+    {
+        result.submitMs += slowest[f];
+    }
+    result.submitMs /= frames;
+    result.flushMs = flushMs / frames;
+    result.linesPerFrame = double(renderer.vertices()) / 2.0 / frames;
+
+    dd::shutdown();
+    return result;
+}
+
+static double runSingleThread(int lines, int frames)
+{
+    CountingRenderer renderer;
+    dd::initialize(&renderer);
+    LockedQueue unused;
+
+    double submitMs = 0.0;
+    for (int f = 0; f < frames; ++f)
+    {
+        const double start = nowMillis();
+        submitLines(MODE_THREAD_QUEUES, unused, 0, lines);
+        submitMs += nowMillis() - start;
+        dd::flush(16 * (f + 1));
+    }
+
+    dd::shutdown();
+    return submitMs / frames;
+}
+
+// Rounds of short-lived producers, each submitting one line and exiting,
+// with a flush after each round. Returns the lines drawn.
+static unsigned long long runThreadChurn(int rounds, int threadsPerRound)
+{
+    CountingRenderer renderer;
+    dd::initialize(&renderer);
+    const dd::ContextHandle context = dd::currentContext();
+
+    const float from[3] = { 0.0f, 0.0f, 0.0f };
+    const float to[3] = { 1.0f, 1.0f, 1.0f };
+    const float color[3] = { 1.0f, 1.0f, 1.0f };
+    for (int r = 0; r < rounds; ++r)
+    {
+        std::vector<std::thread> producers;
+        for (int p = 0; p < threadsPerRound; ++p)
+        {
+            producers.push_back(std::thread([&] {
+                dd::makeCurrent(context);
+                dd::line(from, to, color);
+            }));
+        }
+        for (size_t p = 0; p < producers.size(); ++p)
+        {
+            producers[p].join();
+        }
+        dd::flush(16 * (r + 1));
+    }
+
+    dd::shutdown();
+    return renderer.vertices() / 2;
+}
+
+int main(int argc, char **argv)
+{
+    const int threads = argc > 1 ? atoi(argv[1]) : 8;
+    const int lines = argc > 2 ? atoi(argv[2]) : DEBUG_DRAW_MAX_LINES;
+    const int frames = argc > 3 ? atoi(argv[3]) : 200;
+
+    printf("%d producers x %d lines, %d frames, %u hardware threads\n",
+           threads, lines / threads, frames, std::thread::hardware_concurrency());
+
+    const double single = runSingleThread(lines, frames);
+    printf("  render thread only   submit %.3f ms\n", single);
+
+    const char *names[2] = { "per-thread rings", "shared mutex    " };
+    const Mode modes[2] = { MODE_THREAD_QUEUES, MODE_MUTEX };
+    for (int m = 0; m < 2; ++m)
+    {
+        s_overflows = 0;
+        Result result = run(modes[m], threads, lines, frames);
+        printf("  %s     submit %.3f ms  flush %.3f ms  %.0f lines/frame drawn, %u dropped\n",
+               names[m], result.submitMs, result.flushMs, result.linesPerFrame, s_overflows.load());
+    }
+
+    // Half the slots per round, so every round needs rings exited threads left.
+    const int rounds = 16;
+    const int perRound = DEBUG_DRAW_MAX_THREADS / 2;
+    s_overflows = 0;
+    const unsigned long long drawn = runThreadChurn(rounds, perRound);
+    const bool churnOk = drawn == (unsigned long long)(rounds * perRound) && s_overflows.load() == 0;
+    printf("  thread churn         %d threads in rounds of %d, %llu lines drawn, %u dropped  %s\n",
+           rounds * perRound, perRound, drawn, s_overflows.load(), churnOk ? "ok" : "FAILED");
+    return churnOk ? 0 : 1;
+}
@@ -0,0 +1,202 @@
+//
+//  debugdraw_bench.cpp
+//
+//  Debug-draw stress scene: every frame queues 'lines' one-frame dd lines
+//  (32k by default), draws them through WorldDebugDrawer and replays the
+//  commands into an offscreen Mesa context with the drawer's real program,
+//  VAO and stream buffer. The surface is tiny so the software rasterizer
+//  does not drown out the upload and draw-call cost being measured.
+//
+//  'spheres' more one-frame dd::sphere() calls are queued on top. With
+//  'instancing' 1 (the default) each is one 64-byte instance of the unit
+//  sphere mesh; 0 expands them to 1152 lines each, as dd always used to.
+//
+//  'text' rows of dd::screenText() make up a stats overlay on top. All but
+//  the first row stay the same; that one changes every 30 frames, like an
+//  FPS readout.
+//
+//  'grid' lines of dd::xzSquareGrid() are a persistent overlay. With
+//  'retained' 0 they are queued every frame like everything else; 1 records
+//  them once with WorldDebugDrawer::beginStaticGeometry().
+//
+//      debugdraw_bench [lines] [frames] [spheres] [instancing] [text] [grid] [retained]
+//
+//  e.g. 1k spheres alone: debugdraw_bench 0 60 1000 1 (or 0)
+//       a 40 row overlay: debugdraw_bench 0 600 0 1 40
+//       a 40k line grid:  debugdraw_bench 0 60 0 1 0 40000 1 (or 0)
+//
+
+#include "WorldDebugDrawer.h"
+#include "ShaderBatch.h"
+#include "GLDebug.h"
+#include "Clock.h"
+#include "OffscreenGLES.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+static void queueLines(int count, int frame)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        const float t = float(i) / float(count);
+        const float from[3] = { t * 2.0f - 1.0f, -1.0f, 0.5f };
+        const float to[3] = { 1.0f - t * 2.0f, 1.0f, float((i + frame) % 7) / 7.0f };
+        const float color[3] = { t, 1.0f - t, 0.5f };
+        dd::line(from, to, color, 0, (i & 1) == 0);
+    }
+}
+
+static void queueSpheres(int count, int frame)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        const float t = float(i) / float(count);
+        const float center[3] = { t * 2.0f - 1.0f, float((i * 7 + frame) % 13) / 13.0f - 0.5f, 0.5f };
+        const float color[3] = { 1.0f - t, t, 1.0f };
+        dd::sphere(center, color, 0.05f + 0.1f * t, 0, (i & 1) == 0);
+    }
+}
+
+// About 'lines' lines, two per grid step.
+static void queueGrid(int lines)
+{
+    const float color[3] = { 0.4f, 0.4f, 0.4f };
+    if (lines >= 2)
+    {
+        dd::xzSquareGrid(0.0f, float(lines / 2 - 1), 0.5f, 1.0f, color);
+    }
+}
+
+static void queueText(int rows, int frame)
+{
+    const float white[3] = { 1.0f, 1.0f, 1.0f };
+    char text[64];
+    for (int i = 0; i < rows; ++i)
+    {
+        if (i == 0)
+        {
+            snprintf(text, sizeof(text), "frame %6d   %5.2f ms", frame / 30 * 30, 16.0f + float(frame / 30 % 7));
+        }
+        else
+        {
+            snprintf(text, sizeof(text), "counter %02d     %8d", i, i * 1234);
+        }
+        const float pos[3] = { 4.0f, 4.0f + 20.0f * i, 0.0f };
+        dd::screenText(std::string(text), pos, white, 0.5f);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const int lines = argc > 1 ? atoi(argv[1]) : 32768;
+    const int frames = argc > 2 ? atoi(argv[2]) : 60;
+    const int spheres = argc > 3 ? atoi(argv[3]) : 0;
+    const bool instancing = argc > 4 ? atoi(argv[4]) != 0 : true;
+    const int textRows = argc > 5 ? atoi(argv[5]) : 0;
+    const int gridLines = argc > 6 ? atoi(argv[6]) : 0;
+    const bool retained = argc > 7 ? atoi(argv[7]) != 0 : false;
+
+    if (!createOffscreenContext(false, 64, 64))
+    {
+        return 1;
+    }
+    GLDebug::initialize();
+    GLESCommandBackend::initialize();
+
+    ShaderBatch shaderBatch;
+    shaderBatch.initialize();
+
+    WorldDebugDrawer drawer;
+    drawer.setShapeInstancing(instancing);
+    drawer.init(shaderBatch);
+    shaderBatch.submit();
+    while (!shaderBatch.poll())
+    {
+    }
+
+    GLCommandBuffer commands;
+    GLESCommandBackend backend;
+
+    int grid = -1;
+    if (retained)
+    {
+        grid = drawer.beginStaticGeometry();
+        queueGrid(gridLines);
+        drawer.endStaticGeometry();
+    }
+
+    double enqueueMs = 0.0;
+    double recordMs = 0.0;
+    double replayMs = 0.0;
+    unsigned int drawCalls = 0;
+    unsigned int orphans = 0;
+    double queuedBytes = 0.0;
+    unsigned long long dropped = 0;
+    double commandBytes = 0.0;
+    unsigned int glyphUploads = 0;
+    unsigned int glyphReuses = 0;
+
+    const double start = nowMillis();
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        double t0 = nowMillis();
+        queueLines(lines, frame);
+        queueSpheres(spheres, frame);
+        queueText(textRows, frame);
+        if (!retained)
+        {
+            queueGrid(gridLines);
+        }
+
+        double t1 = nowMillis();
+        drawer.setViewport(64, 64);
+        drawer.draw(commands);
+        double t2 = nowMillis();
+        commands.replay(backend);
+        glFlush();
+        double t3 = nowMillis();
+
+        enqueueMs += t1 - t0;
+        recordMs += t2 - t1;
+        replayMs += t3 - t2;
+        drawCalls += drawer.drawCallCount();
+        orphans += drawer.streamOrphanCount();
+        glyphUploads += drawer.glyphUploadCount();
+        glyphReuses += drawer.glyphReuseCount();
+        commandBytes += commands.byteSize();
+
+        dd::FrameStats stats;
+        if (drawer.frameStats(stats))
+        {
+            queuedBytes += stats.lines.highWater * 2.0 * sizeof(dd::DrawVertex) +
+                           stats.shapes.highWater * double(sizeof(dd::ShapeInstance));
+            dropped += stats.lines.dropped + stats.shapes.dropped;
+        }
+        commands.reset();
+    }
+    glFinish();
+    const double totalMs = nowMillis() - start;
+
+    printf("%d lines + %d spheres/frame (%s) + %d text rows + %d grid lines (%s), batch %d vertices, "
+           "%d stream segments, %d frames\n",
+           lines, spheres, !instancing ? "as lines" : GLESCommandBackend::hasInstancing() ? "instanced" : "one draw each",
+           textRows, gridLines, retained ? "retained" : "queued", DEBUG_DRAW_VERTEX_BUFFER_SIZE,
+           DEBUG_DRAW_STREAM_SEGMENTS, frames);
+    printf("  draw calls/frame  %.1f\n", double(drawCalls) / frames);
+    printf("  orphans/frame     %.1f\n", double(orphans) / frames);
+    printf("  glyph batches     %u uploaded, %u reused\n", glyphUploads, glyphReuses);
+    printf("  dd queue KB/frame %.1f\n", queuedBytes / 1024.0 / frames);
+    printf("  commands KB/frame %.1f\n", commandBytes / 1024.0 / frames);
+    printf("  dropped/frame     %.0f\n", double(dropped) / frames);
+    printf("  enqueue           %.3f ms/frame\n", enqueueMs / frames);
+    printf("  record            %.3f ms/frame\n", recordMs / frames);
+    printf("  replay + flush    %.3f ms/frame\n", replayMs / frames);
+    printf("  total incl. GPU   %.3f ms/frame\n", totalMs / frames);
+    printf("  GL errors         %u\n", GLDebug::errorCount());
+
+    drawer.releaseStaticGeometry(grid);
+    drawer.unInit();
+    return 0;
+}
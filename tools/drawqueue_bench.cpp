@@ -0,0 +1,163 @@
+//
+//  drawqueue_bench.cpp
+//
+//  Times DrawQueue::sort() against std::stable_sort on 100k keys and counts
+//  the state changes a synthetic scene needs in call order versus key order.
+//
+//      drawqueue_bench [draws] [iterations]
+//
+
+#include "DrawQueue.h"
+#include "Clock.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+struct KeyedDraw {
+    uint64_t key;
+    DrawQueue::Draw draw;
+};
+
+static bool keyLess(const KeyedDraw &a, const KeyedDraw &b)
+{
+    return a.key < b.key;
+}
+
+// Deterministic, so runs are comparable.
+static uint32_t s_seed = 12345;
+static uint32_t nextRandom()
+{
+    s_seed = s_seed * 1664525u + 1013904223u;
+    return s_seed >> 8;
+}
+
+static float randomFloat(float maxValue)
+{
+    return maxValue * float(nextRandom() & 0xffff) / 65535.0f;
+}
+
+// A scene in typical submission order (object by object): 3 layers, 32
+// programs, 512 textures spread over the programs, one mesh per texture,
+// 10% of the scene layer translucent.
+static std::vector<KeyedDraw> makeScene(int count)
+{
+    std::vector<KeyedDraw> scene(count);
+    for (int i = 0; i < count; ++i)
+    {
+        KeyedDraw &item = scene[i];
+        const unsigned int layer = (i % 50 == 0) ? 0 : ((i % 20 == 0) ? 2 : 1);
+        const bool translucent = (layer == 1) && (nextRandom() % 10 == 0);
+        const GLuint program = 1 + nextRandom() % 32;
+        const GLuint texture = 1 + (program - 1) * 16 + nextRandom() % 16;
+
+        item.draw.program = program;
+        item.draw.texture = texture;
+        item.draw.vertexArray = texture;
+        item.draw.mode = GL_TRIANGLES;
+        item.draw.count = 36;
+        item.draw.indexType = GL_UNSIGNED_SHORT;
+        item.draw.first = 0;
+        item.key = DrawQueue::makeKey(layer, translucent, program, texture, randomFloat(100.0f));
+    }
+    return scene;
+}
+
+// Records opcode and first payload word of every command.
+class TraceBackend : public GLCommandBackend {
+public:
+    virtual void execute(const GLCommandBuffer::Command &command, const void *payload)
+    {
+        mTrace.push_back(((uint64_t)command.opcode << 32) | *(const uint32_t *)payload);
+    }
+
+    std::vector<uint64_t> mTrace;
+};
+
+static void fill(DrawQueue &queue, const std::vector<KeyedDraw> &scene)
+{
+    queue.clear();
+    for (size_t i = 0; i < scene.size(); ++i)
+    {
+        queue.add(scene[i].key, scene[i].draw);
+    }
+}
+
+static void printStats(const char *label, const DrawQueue::Stats &stats)
+{
+    printf("  %-10s draws %u, program %u, texture %u, vertex array %u\n", label,
+           stats.draws, stats.programChanges, stats.textureChanges, stats.vertexArrayChanges);
+}
+
+int main(int argc, char **argv)
+{
+    const int count = argc > 1 ? atoi(argv[1]) : 100000;
+    const int iterations = argc > 2 ? atoi(argv[2]) : 50;
+
+    const std::vector<KeyedDraw> scene = makeScene(count);
+
+    DrawQueue queue;
+    GLCommandBuffer commands;
+
+    // Sort cost.
+    double radixMs = 0.0;
+    double stdMs = 0.0;
+    for (int i = 0; i < iterations; ++i)
+    {
+        fill(queue, scene);
+        double start = nowMillis();
+        queue.sort();
+        radixMs += nowMillis() - start;
+
+        std::vector<KeyedDraw> copy = scene;
+        start = nowMillis();
+        std::stable_sort(copy.begin(), copy.end(), keyLess);
+        stdMs += nowMillis() - start;
+    }
+    printf("sort %d keys (avg of %d):\n", count, iterations);
+    printf("  radix       %.3f ms (%.2f ns/key)\n", radixMs / iterations, radixMs * 1e6 / iterations / count);
+    printf("  stable_sort %.3f ms (%.2f ns/key)\n", stdMs / iterations, stdMs * 1e6 / iterations / count);
+
+    // The radix order has to match std::stable_sort exactly.
+    fill(queue, scene);
+    queue.sort();
+    queue.submit(commands);
+    TraceBackend radixTrace;
+    commands.replay(radixTrace);
+    commands.reset();
+
+    std::vector<KeyedDraw> expected = scene;
+    std::stable_sort(expected.begin(), expected.end(), keyLess);
+    fill(queue, expected);
+    queue.submit(commands);
+    TraceBackend stdTrace;
+    commands.replay(stdTrace);
+    commands.reset();
+
+    if (radixTrace.mTrace != stdTrace.mTrace)
+    {
+        printf("  ERROR: radix order differs from std::stable_sort\n");
+        return 1;
+    }
+
+    // State changes, call order versus sorted.
+    printf("state changes, %d draws:\n", count);
+    fill(queue, scene);
+    queue.submit(commands);
+    const DrawQueue::Stats unsorted = queue.stats();
+    printStats("call order", unsorted);
+    commands.reset();
+
+    queue.sort();
+    queue.submit(commands);
+    const DrawQueue::Stats sorted = queue.stats();
+    printStats("sorted", sorted);
+    printf("  commands recorded: %u\n", commands.commandCount());
+
+    const uint32_t before = unsorted.programChanges + unsorted.textureChanges + unsorted.vertexArrayChanges;
+    const uint32_t after = sorted.programChanges + sorted.textureChanges + sorted.vertexArrayChanges;
+    printf("  binds %u -> %u (%.1fx fewer)\n", before, after, double(before) / double(after));
+
+    return 0;
+}
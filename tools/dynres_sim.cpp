@@ -0,0 +1,218 @@
+//
+//  dynres_sim.cpp
+//
+//  Drives DynamicResolution with simulated frame times and checks that it
+//  converges. Each frame costs a fixed part plus a scene part that follows
+//  the pixel count (scale squared), with deterministic noise:
+//
+//    light     fits the budget at full resolution; must never change.
+//    heavy     26 ms at full resolution; must settle inside the band.
+//    fixed     most of the cost does not scale, so the model overshoots
+//              and takes several steps; must still settle.
+//    spike     light, then heavy for 300 frames, then light again; must
+//              come down during the spike and get back to full resolution.
+//    noisy     heavy with +-30% noise per frame; must not keep changing.
+//    overload  too heavy even at the minimum scale; must sit at it.
+//
+//  The vsync- variants are measured without a GPU timer: the controller
+//  gets frame intervals, which vsync rounds up to whole budgets, under
+//  frameIntervalConfig(). They must come down until frames fit. Only
+//  probes raise them, and a failed probe costs a missed frame, so after
+//  settling they may miss vsync on at most 1% of frames. vsync-spike must
+//  get back to full resolution.
+//
+//  Prints frames to settle, changes, frames over budget and the final
+//  scale per scenario. Exits with 1 if any check fails.
+//
+//      dynres_sim                 every scenario
+//      dynres_sim <scenario>      one scenario's frames as CSV
+//
+
+#include "DynamicResolution.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct Scenario {
+    const char *name;
+    double fixedMs;
+    double sceneMs; // At full resolution.
+    double noise; // Fraction, uniform.
+    // Frames [spikeBegin, spikeEnd) cost spikeSceneMs instead.
+    int spikeBegin;
+    int spikeEnd;
+    double spikeSceneMs;
+    bool vsync; // Frame intervals instead of GPU times.
+};
+
+static const int kFrames = 1200;
+
+static const Scenario kScenarios[] = {
+    { "light", 2.0, 8.0, 0.05, 0, 0, 0.0, false },
+    { "heavy", 2.0, 24.0, 0.05, 0, 0, 0.0, false },
+    { "fixed", 11.0, 8.0, 0.05, 0, 0, 0.0, false },
+    { "spike", 2.0, 8.0, 0.05, 300, 600, 24.0, false },
+    { "noisy", 2.0, 24.0, 0.30, 0, 0, 0.0, false },
+    { "overload", 2.0, 80.0, 0.05, 0, 0, 0.0, false },
+    { "vsync-light", 2.0, 8.0, 0.05, 0, 0, 0.0, true },
+    { "vsync-heavy", 2.0, 24.0, 0.05, 0, 0, 0.0, true },
+    { "vsync-spike", 2.0, 8.0, 0.05, 300, 600, 24.0, true },
+    { "vsync-noisy", 2.0, 24.0, 0.30, 0, 0, 0.0, true },
+};
+static const int kScenarioCount = int(sizeof(kScenarios) / sizeof(kScenarios[0]));
+
+static double sceneMs(const Scenario &s, int frame)
+{
+    return frame >= s.spikeBegin && frame < s.spikeEnd ? s.spikeSceneMs : s.sceneMs;
+}
+
+// Noise-free cost of a frame at 'scale'.
+static double frameMs(const Scenario &s, int frame, float scale)
+{
+    return s.fixedMs + sceneMs(s, frame) * scale * scale;
+}
+
+struct Result {
+    int lastChange; // Frame of the last change, -1 if none.
+    unsigned int changes;
+    unsigned int changesAfterSettle; // In the last third.
+    int overBudget;
+    int overBudgetAfterSettle; // In the last third.
+    float finalScale;
+    float minScale;
+    double finalMs; // Noise-free.
+};
+
+static Result run(const Scenario &s, FILE *trace)
+{
+    DynamicResolution controller(s.vsync ? DynamicResolution::frameIntervalConfig()
+                                         : DynamicResolution::defaultConfig());
+    const DynamicResolution::Config &config = controller.config();
+    uint32_t seed = 12345;
+
+    Result r = { -1, 0, 0, 0, 0, config.maxScale, config.maxScale, 0.0 };
+    if (trace)
+    {
+        fprintf(trace, "frame,ms,estimate,scale\n");
+    }
+    for (int frame = 0; frame < kFrames; ++frame)
+    {
+        const float scale = controller.scale();
+        seed = seed * 1664525u + 1013904223u;
+        const double jitter = (double(seed >> 8) / double(1 << 24) * 2.0 - 1.0) * s.noise;
+        const double ms = frameMs(s, frame, scale) * (1.0 + jitter);
+        if (ms > config.budgetMs)
+        {
+            ++r.overBudget;
+            if (frame >= kFrames * 2 / 3)
+            {
+                ++r.overBudgetAfterSettle;
+            }
+        }
+
+        if (s.vsync)
+        {
+            // The frame is shown at the next vsync after it finishes.
+            controller.addFrame(ceil(ms / config.budgetMs) * config.budgetMs, -1.0);
+        }
+        else
+        {
+            // The GPU is timed; the CPU time is not used.
+            controller.addFrame(0.0, ms);
+        }
+
+        if (controller.scale() != scale)
+        {
+            r.lastChange = frame;
+            ++r.changes;
+            if (frame >= kFrames * 2 / 3)
+            {
+                ++r.changesAfterSettle;
+            }
+        }
+        r.minScale = controller.scale() < r.minScale ? controller.scale() : r.minScale;
+        if (trace)
+        {
+            fprintf(trace, "%d,%.3f,%.3f,%.4f\n", frame, ms, controller.estimateMs(), controller.scale());
+        }
+    }
+    r.finalScale = controller.scale();
+    r.finalMs = frameMs(s, kFrames - 1, r.finalScale);
+    return r;
+}
+
+// The scenario's own expectations, and for all: settled (no changes in the
+// last third) inside the band unless pinned at a scale limit, or for vsync,
+// fitting it.
+static bool check(const Scenario &s, const Result &r)
+{
+    const DynamicResolution::Config config = s.vsync ? DynamicResolution::frameIntervalConfig()
+                                                     : DynamicResolution::defaultConfig();
+    const double low = config.budgetMs * config.raiseBelow;
+    const double high = config.budgetMs * config.lowerAbove;
+    bool ok = true;
+    if (s.vsync)
+    {
+        // Fits vsync, with the noise, and probes rarely miss it.
+        ok = r.finalMs * (1.0 + s.noise) <= config.budgetMs && r.overBudgetAfterSettle * 100 <= kFrames / 3;
+    }
+    else
+    {
+        ok = r.changesAfterSettle == 0;
+        ok = ok && (r.finalMs <= high || r.finalScale == config.minScale);
+        // Below the band is fine only if one more step up would leave it.
+        const float up = r.finalScale + config.step;
+        ok = ok && (r.finalMs >= low || r.finalScale == config.maxScale ||
+                    frameMs(s, kFrames - 1, up) > high);
+    }
+
+    if (strcmp(s.name, "light") == 0 || strcmp(s.name, "vsync-light") == 0)
+    {
+        ok = ok && r.changes == 0;
+    }
+    else if (strcmp(s.name, "spike") == 0 || strcmp(s.name, "vsync-spike") == 0)
+    {
+        ok = ok && r.minScale < config.maxScale && r.finalScale == config.maxScale;
+    }
+    else if (strcmp(s.name, "overload") == 0)
+    {
+        ok = ok && r.finalScale == config.minScale;
+    }
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+    {
+        for (int i = 0; i < kScenarioCount; ++i)
+        {
+            if (strcmp(argv[1], kScenarios[i].name) == 0)
+            {
+                run(kScenarios[i], stdout);
+                return 0;
+            }
+        }
+        fprintf(stderr, "unknown scenario %s\n", argv[1]);
+        return 2;
+    }
+
+    const DynamicResolution::Config config = DynamicResolution::defaultConfig();
+    printf("%d frames, budget %.2f ms, band %.2f - %.2f ms, scale %.3f - %.3f step %.4f\n", kFrames,
+           config.budgetMs, config.budgetMs * config.raiseBelow, config.budgetMs * config.lowerAbove,
+           config.minScale, config.maxScale, config.step);
+    printf(" %-12s %8s %8s %8s %8s %8s %9s\n", "", "settled", "changes", "over", "scale", "min", "final ms");
+    bool ok = true;
+    for (int i = 0; i < kScenarioCount; ++i)
+    {
+        const Result r = run(kScenarios[i], NULL);
+        const bool passed = check(kScenarios[i], r);
+        printf(" %-12s %8d %8u %7.1f%% %8.4f %8.4f %9.2f%s\n", kScenarios[i].name, r.lastChange, r.changes,
+               100.0 * r.overBudget / kFrames, r.finalScale, r.minScale, r.finalMs, passed ? "" : "  FAILED");
+        ok = ok && passed;
+    }
+    return ok ? 0 : 1;
+}
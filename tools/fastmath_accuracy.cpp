@@ -0,0 +1,302 @@
+//
+//  fastmath_accuracy.cpp
+//
+//  Sweeps FastMath's functions over the float range in every form this
+//  build has (scalar, SSE2 or NEON, and AVX2 in fastmath_accuracy_avx2) and
+//  checks them against the bounds stated in FastMath.h, with the reference
+//  computed in doubles. Outside a function's stated domain only the stated
+//  behavior is checked (exp's +inf and 0, atan2(0, 0) == 0). Exits with 1
+//  if anything is over.
+//
+//  The sweep takes every 'stride'-th float bit pattern, 1 being exhaustive;
+//  atan2 pairs each of them as y with a scrambled pattern as x.
+//
+//      fastmath_accuracy [stride]
+//
+
+#include "FastMath.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+enum Function { kRsqrt, kSin, kCos, kAtan2, kExp, kFunctionCount };
+static const char *const kFunctionNames[kFunctionCount] = { "rsqrt", "sin", "cos", "atan2", "exp" };
+
+// Loads and stores per form; the FastMath overloads do the rest.
+struct ScalarLanes {
+    typedef float V;
+    static const int WIDTH = 1;
+    static inline V load(const float *p) { return *p; }
+    static inline void store(float *p, V v) { *p = v; }
+};
+
+#if FASTMATH_SSE2
+struct Sse2Lanes {
+    typedef __m128 V;
+    static const int WIDTH = 4;
+    static inline V load(const float *p) { return _mm_loadu_ps(p); }
+    static inline void store(float *p, V v) { _mm_storeu_ps(p, v); }
+};
+#endif
+
+#if FASTMATH_AVX2
+struct Avx2Lanes {
+    typedef __m256 V;
+    static const int WIDTH = 8;
+    static inline V load(const float *p) { return _mm256_loadu_ps(p); }
+    static inline void store(float *p, V v) { _mm256_storeu_ps(p, v); }
+};
+#endif
+
+#if FASTMATH_NEON
+struct NeonLanes {
+    typedef float32x4_t V;
+    static const int WIDTH = 4;
+    static inline V load(const float *p) { return vld1q_f32(p); }
+    static inline void store(float *p, V v) { vst1q_f32(p, v); }
+};
+#endif
+
+// f(a) or, for atan2, f(a, b) over 'count' elements, a multiple of 8.
+typedef void (*Kernel)(const float *a, const float *b, float *out, int count);
+
+template<class L>
+static void runForm(Function function, const float *a, const float *b, float *out, int count)
+{
+    for (int i = 0; i < count; i += L::WIDTH)
+    {
+        const typename L::V x = L::load(a + i);
+        switch (function)
+        {
+            case kRsqrt:
+                L::store(out + i, FastMath::rsqrt(x));
+                break;
+            case kSin:
+                L::store(out + i, FastMath::sin(x));
+                break;
+            case kCos:
+                L::store(out + i, FastMath::cos(x));
+                break;
+            case kAtan2:
+                L::store(out + i, FastMath::atan2(x, L::load(b + i)));
+                break;
+            case kExp:
+                L::store(out + i, FastMath::exp(x));
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+template<class L, Function F>
+static void kernel(const float *a, const float *b, float *out, int count)
+{
+    runForm<L>(F, a, b, out, count);
+}
+
+struct Form {
+    const char *name;
+    Kernel kernels[kFunctionCount];
+    float rsqrtBound;
+    // ARMv7 NEON: atan2 only for max(|y|, |x|) in [FLT_MIN, 2^126].
+    bool narrowAtan2;
+};
+
+template<class L>
+static Form makeForm(const char *name, float rsqrtBound, bool narrowAtan2 = false)
+{
+    const Form form = {
+        name,
+        { kernel<L, kRsqrt>, kernel<L, kSin>, kernel<L, kCos>, kernel<L, kAtan2>, kernel<L, kExp> },
+        rsqrtBound,
+        narrowAtan2
+    };
+    return form;
+}
+
+// Error of 'got' for f(a, b), relative or absolute as FastMath.h states it;
+// -1 where the function promises nothing, HUGE_VAL where it broke a
+// promise outside its domain.
+static double error(const Form &form, Function function, float a, float b, float got)
+{
+    switch (function)
+    {
+        case kRsqrt:
+        {
+            if (!(a >= FLT_MIN && a <= FLT_MAX))
+            {
+                return -1.0;
+            }
+            const double expected = 1.0 / sqrt(double(a));
+            return fabs(got - expected) / expected;
+        }
+        case kSin:
+        case kCos:
+        {
+            if (!(fabsf(a) <= FastMath::SIN_COS_MAX_ARGUMENT))
+            {
+                return -1.0;
+            }
+            return fabs(got - (function == kSin ? sin(double(a)) : cos(double(a))));
+        }
+        case kAtan2:
+        {
+            if (!isfinite(a) || !isfinite(b))
+            {
+                return -1.0;
+            }
+            const float larger = fabsf(a) > fabsf(b) ? fabsf(a) : fabsf(b);
+            if (form.narrowAtan2 && (larger < FLT_MIN || larger > 8.5070592e37f))
+            {
+                return -1.0;
+            }
+            if (a == 0.0f && b == 0.0f)
+            {
+                return got == 0.0f ? 0.0 : HUGE_VAL;
+            }
+            // Signed zeros are not told apart.
+            return fabs(got - atan2(a == 0.0f ? 0.0 : double(a), b == 0.0f ? 0.0 : double(b)));
+        }
+        case kExp:
+        {
+            if (isnan(a))
+            {
+                return -1.0;
+            }
+            if (a > FastMath::EXP_MAX_ARGUMENT)
+            {
+                return got == HUGE_VALF ? 0.0 : HUGE_VAL;
+            }
+            if (a < FastMath::EXP_MIN_ARGUMENT)
+            {
+                return got == 0.0f ? 0.0 : HUGE_VAL;
+            }
+            const double expected = exp(double(a));
+            return fabs(got - expected) / expected;
+        }
+        default:
+            return -1.0;
+    }
+}
+
+struct Worst {
+    double error;
+    float a, b;
+    long samples;
+
+    Worst() : error(0.0), a(0.0f), b(0.0f), samples(0) { }
+};
+
+static float fromBits(uint32_t bits)
+{
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+static const int kBlock = 4096;
+
+int main(int argc, char **argv)
+{
+    const long stride = argc > 1 ? atol(argv[1]) : 97;
+    if (stride < 1)
+    {
+        fprintf(stderr, "usage: %s [stride >= 1]\n", argv[0]);
+        return 2;
+    }
+
+    std::vector<Form> forms;
+    forms.push_back(makeForm<ScalarLanes>("scalar", FastMath::RSQRT_MAX_RELATIVE_ERROR));
+#if FASTMATH_SSE2
+    forms.push_back(makeForm<Sse2Lanes>("SSE2", FastMath::RSQRT_SIMD_MAX_RELATIVE_ERROR));
+#endif
+#if FASTMATH_AVX2
+    forms.push_back(makeForm<Avx2Lanes>("AVX2", FastMath::RSQRT_SIMD_MAX_RELATIVE_ERROR));
+#endif
+#if FASTMATH_NEON
+#if defined(__aarch64__)
+    forms.push_back(makeForm<NeonLanes>("NEON", FastMath::RSQRT_SIMD_MAX_RELATIVE_ERROR));
+#else
+    forms.push_back(makeForm<NeonLanes>("NEON", FastMath::RSQRT_SIMD_MAX_RELATIVE_ERROR, true));
+#endif
+#endif
+
+    std::vector<Worst> worst(forms.size() * kFunctionCount);
+    std::vector<float> a(kBlock), b(kBlock), out(kBlock);
+    const uint64_t end = uint64_t(1) << 32;
+    for (uint64_t first = 0; first < end; first += uint64_t(stride) * kBlock)
+    {
+        int count = 0;
+        for (uint64_t bits = first; bits < end && count < kBlock; bits += stride, ++count)
+        {
+            a[count] = fromBits(uint32_t(bits));
+            b[count] = fromBits(uint32_t(bits) * 2654435761u + 0x9E3779B9u);
+        }
+        // The last block is padded to a whole number of vectors.
+        const int padded = (count + 7) & ~7;
+        for (int i = count; i < padded; ++i)
+        {
+            a[i] = 1.0f;
+            b[i] = 1.0f;
+        }
+
+        for (size_t f = 0; f < forms.size(); ++f)
+        {
+            for (int function = 0; function < kFunctionCount; ++function)
+            {
+                forms[f].kernels[function](&a[0], &b[0], &out[0], padded);
+                Worst &w = worst[f * kFunctionCount + function];
+                for (int i = 0; i < count; ++i)
+                {
+                    const double e = error(forms[f], Function(function), a[i], b[i], out[i]);
+                    if (e < 0.0)
+                    {
+                        continue;
+                    }
+                    ++w.samples;
+                    if (e > w.error)
+                    {
+                        w.error = e;
+                        w.a = a[i];
+                        w.b = b[i];
+                    }
+                }
+            }
+        }
+    }
+
+    const float bounds[kFunctionCount] = {
+        0.0f, FastMath::SIN_COS_MAX_ABSOLUTE_ERROR, FastMath::SIN_COS_MAX_ABSOLUTE_ERROR,
+        FastMath::ATAN2_MAX_ABSOLUTE_ERROR, FastMath::EXP_MAX_RELATIVE_ERROR
+    };
+    printf("every %ld-th float, errors against doubles\n", stride);
+    printf(" %-6s %-7s %12s %12s %12s  %s\n", "", "", "samples", "max error", "bound", "at");
+    bool accurate = true;
+    for (size_t f = 0; f < forms.size(); ++f)
+    {
+        for (int function = 0; function < kFunctionCount; ++function)
+        {
+            const Worst &w = worst[f * kFunctionCount + function];
+            const double bound = function == kRsqrt ? forms[f].rsqrtBound : bounds[function];
+            const bool ok = w.error <= bound;
+            printf(" %-6s %-7s %12ld %12.3e %12.3e  ", kFunctionNames[function], forms[f].name, w.samples, w.error,
+                   bound);
+            if (function == kAtan2)
+            {
+                printf("(%.9g, %.9g)", w.a, w.b);
+            }
+            else
+            {
+                printf("%.9g", w.a);
+            }
+            printf("%s\n", ok ? "" : "  OVER BOUND");
+            accurate = accurate && ok;
+        }
+    }
+    return accurate ? 0 : 1;
+}
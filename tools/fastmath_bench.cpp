@@ -0,0 +1,370 @@
+//
+//  fastmath_bench.cpp
+//
+//  FastMath's functions in nanoseconds per element, in every form this
+//  build has (scalar, SSE2 or NEON, and AVX2 in fastmath_bench_avx2),
+//  against libm and against a copy of the approximations debug_draw.hpp
+//  had before it used FastMath: a Quake-style rsqrt with one Newton step
+//  and sin/cos polynomials after a branchy range reduction.
+//
+//  Also prints each row's largest error over the same inputs, against
+//  doubles: relative for rsqrt and exp, absolute for the rest. Accuracy
+//  over the whole float range is fastmath_accuracy's job.
+//
+//      fastmath_bench [elements] [passes]
+//
+
+#include "FastMath.h"
+#include "Clock.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+enum Function { kRsqrt, kSin, kCos, kAtan2, kExp, kFunctionCount };
+static const char *const kFunctionNames[kFunctionCount] = { "rsqrt", "sin", "cos", "atan2", "exp" };
+
+//
+// debug_draw.hpp's approximations before FastMath, kept as they were.
+//
+namespace reference {
+
+static const float PI = 3.1415926535897931f;
+static const float TAU = PI * 2.0f;
+
+static float roundFloat(float x)
+{
+    const int i = static_cast<int>(x);
+    return (x >= 0.0f) ? static_cast<float>(i) : static_cast<float>(i - 1);
+}
+
+static float fastInvSqrt(float x)
+{
+    uint32_t i;
+    float y, r;
+    y = x * 0.5f;
+    memcpy(&i, &x, sizeof(i));
+    i = 0x5F3759DF - (i >> 1);
+    memcpy(&r, &i, sizeof(r));
+    r = r * (1.5f - (r * r * y));
+    return r;
+}
+
+static float fastSin(float radians)
+{
+    static const float A = -2.39e-08;
+    static const float B =  2.7526e-06;
+    static const float C =  1.98409e-04;
+    static const float D =  8.3333315e-03;
+    static const float E =  1.666666664e-01;
+    static const float HALFPI = PI * 0.5f;
+
+    if (radians < 0.0f || radians >= TAU)
+    {
+        radians -= roundFloat(radians / TAU) * TAU;
+    }
+
+    if (radians < PI)
+    {
+        if (radians > HALFPI)
+        {
+            radians = PI - radians;
+        }
+    }
+    else
+    {
+        radians = (radians > (PI + HALFPI)) ? (radians - TAU) : (PI - radians);
+    }
+
+    const float s = radians * radians;
+    return radians * (((((A * s + B) * s - C) * s + D) * s - E) * s + 1.0f);
+}
+
+static float fastCos(float radians)
+{
+    static const float A = -2.605e-07;
+    static const float B =  2.47609e-05;
+    static const float C =  1.3888397e-03;
+    static const float D =  4.16666418e-02;
+    static const float E =  4.999999963e-01;
+    static const float HALFPI = PI * 0.5f;
+
+    if (radians < 0.0f || radians >= TAU)
+    {
+        radians -= roundFloat(radians / TAU) * TAU;
+    }
+
+    float d;
+    if (radians < PI)
+    {
+        if (radians > HALFPI)
+        {
+            radians = PI - radians;
+            d = -1.0f;
+        }
+        else
+        {
+            d = 1.0f;
+        }
+    }
+    else
+    {
+        if (radians > (PI + HALFPI))
+        {
+            radians = radians - TAU;
+            d = 1.0f;
+        }
+        else
+        {
+            radians = PI - radians;
+            d = -1.0f;
+        }
+    }
+
+    const float s = radians * radians;
+    return d * (((((A * s + B) * s - C) * s + D) * s - E) * s + 1.0f);
+}
+
+} // namespace reference
+
+// f(a) or, for atan2, f(a, b) over 'count' elements, a multiple of 8.
+typedef void (*Kernel)(const float *a, const float *b, float *out, int count);
+
+template<Function F>
+static void libmKernel(const float *a, const float *b, float *out, int count)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        switch (F)
+        {
+            case kRsqrt: out[i] = 1.0f / sqrtf(a[i]); break;
+            case kSin: out[i] = sinf(a[i]); break;
+            case kCos: out[i] = cosf(a[i]); break;
+            case kAtan2: out[i] = atan2f(a[i], b[i]); break;
+            case kExp: out[i] = expf(a[i]); break;
+            default: break;
+        }
+    }
+}
+
+template<Function F>
+static void referenceKernel(const float *a, const float *, float *out, int count)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        out[i] = F == kRsqrt ? reference::fastInvSqrt(a[i])
+                             : (F == kSin ? reference::fastSin(a[i]) : reference::fastCos(a[i]));
+    }
+}
+
+// Loads and stores per form; the FastMath overloads do the rest.
+struct ScalarLanes {
+    typedef float V;
+    static const int WIDTH = 1;
+    static inline V load(const float *p) { return *p; }
+    static inline void store(float *p, V v) { *p = v; }
+};
+
+#if FASTMATH_SSE2
+struct Sse2Lanes {
+    typedef __m128 V;
+    static const int WIDTH = 4;
+    static inline V load(const float *p) { return _mm_loadu_ps(p); }
+    static inline void store(float *p, V v) { _mm_storeu_ps(p, v); }
+};
+#endif
+
+#if FASTMATH_AVX2
+struct Avx2Lanes {
+    typedef __m256 V;
+    static const int WIDTH = 8;
+    static inline V load(const float *p) { return _mm256_loadu_ps(p); }
+    static inline void store(float *p, V v) { _mm256_storeu_ps(p, v); }
+};
+#endif
+
+#if FASTMATH_NEON
+struct NeonLanes {
+    typedef float32x4_t V;
+    static const int WIDTH = 4;
+    static inline V load(const float *p) { return vld1q_f32(p); }
+    static inline void store(float *p, V v) { vst1q_f32(p, v); }
+};
+#endif
+
+template<class L, Function F>
+static void fastMathKernel(const float *a, const float *b, float *out, int count)
+{
+    for (int i = 0; i < count; i += L::WIDTH)
+    {
+        const typename L::V x = L::load(a + i);
+        switch (F)
+        {
+            case kRsqrt: L::store(out + i, FastMath::rsqrt(x)); break;
+            case kSin: L::store(out + i, FastMath::sin(x)); break;
+            case kCos: L::store(out + i, FastMath::cos(x)); break;
+            case kAtan2: L::store(out + i, FastMath::atan2(x, L::load(b + i))); break;
+            case kExp: L::store(out + i, FastMath::exp(x)); break;
+            default: break;
+        }
+    }
+}
+
+struct Row {
+    const char *name;
+    Kernel kernels[kFunctionCount];
+    double nsPerElement[kFunctionCount];
+    double error[kFunctionCount];
+};
+
+template<class L>
+static Row fastMathRow(const char *name)
+{
+    const Row row = {
+        name,
+        { fastMathKernel<L, kRsqrt>, fastMathKernel<L, kSin>, fastMathKernel<L, kCos>, fastMathKernel<L, kAtan2>,
+          fastMathKernel<L, kExp> },
+        { 0.0 }, { 0.0 }
+    };
+    return row;
+}
+
+static uint32_t s_seed = 12345;
+static float nextRange(float low, float high)
+{
+    s_seed = s_seed * 1664525u + 1013904223u;
+    return low + (high - low) * (float(s_seed >> 8) / float(1 << 24));
+}
+
+// Inputs in the ranges the renderer uses each function over.
+struct Inputs {
+    explicit Inputs(int count)
+    {
+        for (int f = 0; f < kFunctionCount; ++f)
+        {
+            a[f].resize(count);
+            b[f].resize(count);
+        }
+        for (int i = 0; i < count; ++i)
+        {
+            a[kRsqrt][i] = powf(10.0f, nextRange(-4.0f, 4.0f));
+            a[kSin][i] = nextRange(-100.0f, 100.0f);
+            a[kCos][i] = nextRange(-100.0f, 100.0f);
+            a[kAtan2][i] = nextRange(-100.0f, 100.0f);
+            b[kAtan2][i] = nextRange(-100.0f, 100.0f);
+            a[kExp][i] = nextRange(-80.0f, 80.0f);
+        }
+    }
+
+    std::vector<float> a[kFunctionCount], b[kFunctionCount];
+};
+
+static double maxError(Function function, const Inputs &in, const std::vector<float> &out)
+{
+    double worst = 0.0;
+    for (size_t i = 0; i < out.size(); ++i)
+    {
+        const double a = in.a[function][i];
+        double e = 0.0;
+        switch (function)
+        {
+            case kRsqrt: e = fabs(out[i] * sqrt(a) - 1.0); break;
+            case kSin: e = fabs(out[i] - sin(a)); break;
+            case kCos: e = fabs(out[i] - cos(a)); break;
+            case kAtan2: e = fabs(out[i] - atan2(a, double(in.b[function][i]))); break;
+            case kExp: e = fabs(out[i] / exp(a) - 1.0); break;
+            default: break;
+        }
+        worst = e > worst ? e : worst;
+    }
+    return worst;
+}
+
+// Fastest pass: other work on the machine only ever adds time.
+static void measure(Row &row, const Inputs &in, std::vector<float> &out, int passes, float &sink)
+{
+    const int count = int(out.size());
+    for (int f = 0; f < kFunctionCount; ++f)
+    {
+        if (!row.kernels[f])
+        {
+            continue;
+        }
+        double bestMs = 1e30;
+        for (int pass = 0; pass < passes; ++pass)
+        {
+            const double t0 = nowMillis();
+            row.kernels[f](&in.a[f][0], &in.b[f][0], &out[0], count);
+            const double ms = nowMillis() - t0;
+            bestMs = ms < bestMs ? ms : bestMs;
+            sink += out[pass % count];
+        }
+        row.nsPerElement[f] = bestMs * 1e6 / count;
+        row.error[f] = maxError(Function(f), in, out);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const int count = (argc > 1 ? atoi(argv[1]) : 4096 + 7) & ~7;
+    const int passes = argc > 2 ? atoi(argv[2]) : 200;
+
+    std::vector<Row> rows;
+    const Row libm = {
+        "libm",
+        { libmKernel<kRsqrt>, libmKernel<kSin>, libmKernel<kCos>, libmKernel<kAtan2>, libmKernel<kExp> },
+        { 0.0 }, { 0.0 }
+    };
+    const Row old = {
+        "dd before",
+        { referenceKernel<kRsqrt>, referenceKernel<kSin>, referenceKernel<kCos>, NULL, NULL },
+        { 0.0 }, { 0.0 }
+    };
+    rows.push_back(libm);
+    rows.push_back(old);
+    rows.push_back(fastMathRow<ScalarLanes>("scalar"));
+#if FASTMATH_SSE2
+    rows.push_back(fastMathRow<Sse2Lanes>("SSE2"));
+#endif
+#if FASTMATH_AVX2
+    rows.push_back(fastMathRow<Avx2Lanes>("AVX2"));
+#endif
+#if FASTMATH_NEON
+    rows.push_back(fastMathRow<NeonLanes>("NEON"));
+#endif
+
+    Inputs in(count);
+    std::vector<float> out(count);
+    float sink = 0.0f;
+    for (size_t r = 0; r < rows.size(); ++r)
+    {
+        measure(rows[r], in, out, passes, sink);
+    }
+
+    printf("%d elements x %d passes, ns/element\n", count, passes);
+    printf(" %-10s", "");
+    for (int f = 0; f < kFunctionCount; ++f)
+    {
+        printf(" %9s", kFunctionNames[f]);
+    }
+    printf("   max error\n");
+    for (size_t r = 0; r < rows.size(); ++r)
+    {
+        printf(" %-10s", rows[r].name);
+        for (int f = 0; f < kFunctionCount; ++f)
+        {
+            rows[r].kernels[f] ? printf(" %9.3f", rows[r].nsPerElement[f]) : printf(" %9s", "-");
+        }
+        printf("  ");
+        for (int f = 0; f < kFunctionCount; ++f)
+        {
+            rows[r].kernels[f] ? printf(" %8.1e", rows[r].error[f]) : printf(" %8s", "-");
+        }
+        printf("\n");
+    }
+    printf(" sink %e\n", sink);
+    return 0;
+}
@@ -0,0 +1,101 @@
+//
+//  gldebug_bench.cpp
+//
+//  drawFrame() microbenchmark for the GLDebug modes: records the synthetic
+//  app frame, replays it into an offscreen Mesa context and ends the frame,
+//  as Renderer::drawFrame()/submitFrame() do. Built once per GLDEBUG_MODE.
+//  The surface is tiny so rasterization in llvmpipe doesn't drown the
+//  CPU-side cost being compared.
+//
+//      gldebug_bench_<mode> [--no-callback] [frames] [lineBatches]
+//
+//  --no-callback forces the per-call fallback of the full mode.
+//
+
+#include "GLDebug.h"
+#include "Clock.h"
+#include "OffscreenGLES.h"
+#include "SyntheticFrame.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *modeName()
+{
+    switch (GLDEBUG_MODE)
+    {
+        case GLDEBUG_OFF:
+            return "off";
+        case GLDEBUG_SAMPLED:
+            return "sampled";
+        default:
+            return "full";
+    }
+}
+
+int main(int argc, char **argv)
+{
+    bool useCallback = true;
+    int frames = 2000;
+    int batches = 2;
+
+    int positional = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--no-callback") == 0)
+        {
+            useCallback = false;
+        }
+        else if (positional++ == 0)
+        {
+            frames = atoi(argv[i]);
+        }
+        else
+        {
+            batches = atoi(argv[i]);
+        }
+    }
+
+    StandInGLESBackend backend;
+    if (!createOffscreenContext(GLDEBUG_MODE == GLDEBUG_FULL, 16, 16) || !backend.initialize())
+    {
+        return 1;
+    }
+    GLDebug::initialize(useCallback);
+
+    GLCommandBuffer commands;
+
+    // Warm up: stand-in objects, buffer storage, driver state.
+    for (int i = 0; i < 10; ++i)
+    {
+        recordSyntheticFrame(commands, batches);
+        commands.replay(backend);
+        commands.reset();
+    }
+    glFinish();
+
+    const uint32_t commandsPerFrame = [&]() {
+        recordSyntheticFrame(commands, batches);
+        const uint32_t count = commands.commandCount();
+        commands.reset();
+        return count;
+    }();
+
+    const double start = nowMillis();
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        recordSyntheticFrame(commands, batches);
+        commands.replay(backend);
+        GLDebug::endFrame();
+        commands.reset();
+    }
+    glFinish();
+    const double elapsed = nowMillis() - start;
+
+    printf("mode %-7s %-16s %u commands/frame: %.2f us/frame (%d frames), %u GL errors\n",
+           modeName(),
+           GLDEBUG_MODE != GLDEBUG_FULL ? "" : (GLDebug::perCallChecks() ? "(per-call)" : "(KHR_debug)"),
+           commandsPerFrame, elapsed * 1000.0 / frames, frames, GLDebug::errorCount());
+    return 0;
+}
@@ -0,0 +1,569 @@
+//
+//  glm_bench.cpp
+//
+//  Batch throughput of the glm operations the renderer's transforms are made
+//  of: mat4 * mat4, mat4 * vec4 with one matrix and with one matrix per
+//  instance, inverse, and the quaternion product, rotation and mat4_cast.
+//  Every operation runs on glm's default packed types and on its aligned
+//  types, whose storage is an __m128 and which are the only ones glm's SSE
+//  code is written for.
+//
+//  Which instruction set glm uses is fixed at compile time, so the build
+//  makes one executable per setting (see tools/CMakeLists.txt):
+//
+//      glm_bench_pure    GLM_FORCE_PURE, the plain C++ paths
+//      glm_bench_sse2    compiler default, SSE2 on x86-64 hosts
+//      glm_bench_sse42   -msse4.2, the Android x86_64 baseline
+//      glm_bench_avx     -mavx, on compilers and machines that have it
+//      glm_bench         the compiler default on non-x86 hosts
+//
+//  Times are the fastest of the passes. Every result is also checked against
+//  the same math in doubles; exits with 1 if any operation is off by more
+//  than its tolerance.
+//
+//      glm_bench_<setting> [elements] [passes]
+//
+
+#include "glm/glm.hpp"
+#include "glm/gtc/quaternion.hpp"
+#include "Clock.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Relative to max(1, |expected|). Products of TRS matrices keep a few ulps;
+// inverse gets 1e-4 because the SSE kernel reciprocates the determinant in
+// single precision after a long chain of products.
+static const double kProductTolerance = 1e-5;
+static const double kInverseTolerance = 1e-4;
+
+// Deterministic, so runs and builds are comparable.
+static uint32_t s_seed = 12345;
+static float nextUnit()
+{
+    s_seed = s_seed * 1664525u + 1013904223u;
+    return float(s_seed >> 8) / float(1 << 24);
+}
+
+static float nextRange(float low, float high)
+{
+    return low + (high - low) * nextUnit();
+}
+
+// 64-byte aligned, zeroed array that does not depend on operator new
+// honouring alignof(T).
+template<typename T>
+class AlignedArray {
+public:
+    explicit AlignedArray(int count) : mData(NULL), mCount(count)
+    {
+        void *memory = NULL;
+        if (posix_memalign(&memory, 64, sizeof(T) * count) != 0)
+        {
+            fprintf(stderr, "glm_bench: out of memory\n");
+            exit(2);
+        }
+        memset(memory, 0, sizeof(T) * count);
+        mData = static_cast<T *>(memory);
+    }
+
+    ~AlignedArray() { free(mData); }
+
+    T &operator[](int i) { return mData[i]; }
+    const T &operator[](int i) const { return mData[i]; }
+    int size() const { return mCount; }
+
+private:
+    AlignedArray(const AlignedArray &);
+    AlignedArray &operator=(const AlignedArray &);
+
+    T *mData;
+    int mCount;
+};
+
+//
+// Reference math in doubles, column-major like glm.
+//
+struct DMat4 { double m[16]; };
+struct DVec4 { double v[4]; };
+struct DQuat { double w, x, y, z; };
+
+template<typename Mat>
+static DMat4 toDouble(const Mat &a)
+{
+    DMat4 r;
+    for (int c = 0; c < 4; ++c)
+    {
+        for (int row = 0; row < 4; ++row)
+        {
+            r.m[c * 4 + row] = a[c][row];
+        }
+    }
+    return r;
+}
+
+static DMat4 refMul(const DMat4 &a, const DMat4 &b)
+{
+    DMat4 r;
+    for (int c = 0; c < 4; ++c)
+    {
+        for (int row = 0; row < 4; ++row)
+        {
+            double sum = 0.0;
+            for (int k = 0; k < 4; ++k)
+            {
+                sum += a.m[k * 4 + row] * b.m[c * 4 + k];
+            }
+            r.m[c * 4 + row] = sum;
+        }
+    }
+    return r;
+}
+
+static DVec4 refMul(const DMat4 &a, const double v[4])
+{
+    DVec4 r;
+    for (int row = 0; row < 4; ++row)
+    {
+        r.v[row] = a.m[row] * v[0] + a.m[4 + row] * v[1] + a.m[8 + row] * v[2] + a.m[12 + row] * v[3];
+    }
+    return r;
+}
+
+// Gauss-Jordan with partial pivoting.
+static DMat4 refInverse(const DMat4 &a)
+{
+    double work[4][8];
+    for (int row = 0; row < 4; ++row)
+    {
+        for (int c = 0; c < 4; ++c)
+        {
+            work[row][c] = a.m[c * 4 + row];
+            work[row][4 + c] = row == c ? 1.0 : 0.0;
+        }
+    }
+    for (int col = 0; col < 4; ++col)
+    {
+        int pivot = col;
+        for (int row = col + 1; row < 4; ++row)
+        {
+            if (fabs(work[row][col]) > fabs(work[pivot][col]))
+            {
+                pivot = row;
+            }
+        }
+        for (int c = 0; c < 8; ++c)
+        {
+            const double t = work[col][c];
+            work[col][c] = work[pivot][c];
+            work[pivot][c] = t;
+        }
+        const double scale = 1.0 / work[col][col];
+        for (int c = 0; c < 8; ++c)
+        {
+            work[col][c] *= scale;
+        }
+        for (int row = 0; row < 4; ++row)
+        {
+            if (row != col)
+            {
+                const double f = work[row][col];
+                for (int c = 0; c < 8; ++c)
+                {
+                    work[row][c] -= f * work[col][c];
+                }
+            }
+        }
+    }
+    DMat4 r;
+    for (int row = 0; row < 4; ++row)
+    {
+        for (int c = 0; c < 4; ++c)
+        {
+            r.m[c * 4 + row] = work[row][4 + c];
+        }
+    }
+    return r;
+}
+
+static DQuat refMul(const DQuat &p, const DQuat &q)
+{
+    DQuat r;
+    r.w = p.w * q.w - p.x * q.x - p.y * q.y - p.z * q.z;
+    r.x = p.w * q.x + p.x * q.w + p.y * q.z - p.z * q.y;
+    r.y = p.w * q.y + p.y * q.w + p.z * q.x - p.x * q.z;
+    r.z = p.w * q.z + p.z * q.w + p.x * q.y - p.y * q.x;
+    return r;
+}
+
+static DVec4 refRotate(const DQuat &q, const double v[3])
+{
+    const DQuat p = { 0.0, v[0], v[1], v[2] };
+    const DQuat conjugate = { q.w, -q.x, -q.y, -q.z };
+    const DQuat r = refMul(refMul(q, p), conjugate);
+    const DVec4 result = { { r.x, r.y, r.z, 0.0 } };
+    return result;
+}
+
+static DMat4 refMat4Cast(const DQuat &q)
+{
+    const double xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+    const double xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+    const double wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+    const DMat4 r = { {
+        1.0 - 2.0 * (yy + zz), 2.0 * (xy + wz), 2.0 * (xz - wy), 0.0,
+        2.0 * (xy - wz), 1.0 - 2.0 * (xx + zz), 2.0 * (yz + wx), 0.0,
+        2.0 * (xz + wy), 2.0 * (yz - wx), 1.0 - 2.0 * (xx + yy), 0.0,
+        0.0, 0.0, 0.0, 1.0
+    } };
+    return r;
+}
+
+static double relativeError(double actual, double expected)
+{
+    const double scale = fabs(expected) > 1.0 ? fabs(expected) : 1.0;
+    return fabs(actual - expected) / scale;
+}
+
+template<typename Mat>
+static double matrixError(const Mat &actual, const DMat4 &expected)
+{
+    double worst = 0.0;
+    for (int c = 0; c < 4; ++c)
+    {
+        for (int row = 0; row < 4; ++row)
+        {
+            const double e = relativeError(actual[c][row], expected.m[c * 4 + row]);
+            worst = e > worst ? e : worst;
+        }
+    }
+    return worst;
+}
+
+template<typename Vec>
+static double vectorError(const Vec &actual, const DVec4 &expected, int components)
+{
+    double worst = 0.0;
+    for (int i = 0; i < components; ++i)
+    {
+        const double e = relativeError(actual[i], expected.v[i]);
+        worst = e > worst ? e : worst;
+    }
+    return worst;
+}
+
+//
+// The suite, once per glm precision qualifier.
+//
+enum Op {
+    kMatMat,
+    kMatVecShared,
+    kMatVecInstanced,
+    kInverse,
+    kQuatMul,
+    kQuatRotate,
+    kMat4Cast,
+    kOpCount
+};
+
+static const char *const kOpNames[kOpCount] = {
+    "mat4 * mat4",
+    "mat4 * vec4 (one)",
+    "mat4 * vec4 (each)",
+    "inverse(mat4)",
+    "quat * quat",
+    "quat * vec3",
+    "mat4_cast(quat)"
+};
+
+struct Result {
+    double nsPerOp[kOpCount];
+    double error[kOpCount];
+    float checksum;
+};
+
+template<glm::precision P>
+class Suite {
+public:
+    typedef glm::mat<4, 4, float, P> Mat4;
+    typedef glm::vec<4, float, P> Vec4;
+    typedef glm::vec<3, float, P> Vec3;
+    typedef glm::tquat<float, P> Quat;
+
+    explicit Suite(int count)
+        : mCount(count), mA(count), mB(count), mMatOut(count), mV(count), mVecOut(count), mV3(count),
+          mVec3Out(count), mQ(count), mR(count), mQuatOut(count)
+    {
+        // Model matrices: rotation, scale in [0.5, 2] and translation, so
+        // every inverse is well conditioned.
+        s_seed = 12345;
+        for (int i = 0; i < count; ++i)
+        {
+            mA[i] = makeTransform();
+            mB[i] = makeTransform();
+            mV[i] = Vec4(nextRange(-10.0f, 10.0f), nextRange(-10.0f, 10.0f), nextRange(-10.0f, 10.0f), 1.0f);
+            mV3[i] = Vec3(nextRange(-10.0f, 10.0f), nextRange(-10.0f, 10.0f), nextRange(-10.0f, 10.0f));
+            mQ[i] = makeRotation();
+            mR[i] = makeRotation();
+        }
+        mShared = makeTransform();
+    }
+
+    void run(int passes, Result &result)
+    {
+        result.checksum = 0.0f;
+        for (int op = 0; op < kOpCount; ++op)
+        {
+            // One pass to warm the caches and to check.
+            runOp(Op(op));
+            result.error[op] = check(Op(op));
+
+            // Fastest pass: other work on the machine only ever adds time.
+            double bestMs = 1e30;
+            for (int pass = 0; pass < passes; ++pass)
+            {
+                const double t0 = nowMillis();
+                runOp(Op(op));
+                const double ms = nowMillis() - t0;
+                bestMs = ms < bestMs ? ms : bestMs;
+                result.checksum += sample(Op(op), pass);
+            }
+            result.nsPerOp[op] = bestMs * 1e6 / mCount;
+        }
+    }
+
+private:
+    Mat4 makeTransform()
+    {
+        const glm::vec3 axis = glm::normalize(glm::vec3(nextRange(-1.0f, 1.0f), nextRange(-1.0f, 1.0f), 1.0f));
+        const float angle = nextRange(0.0f, 6.2831853f);
+        const float c = cosf(angle), s = sinf(angle), t = 1.0f - c;
+        const float scale = nextRange(0.5f, 2.0f);
+
+        Mat4 m(1.0f);
+        m[0] = Vec4(t * axis.x * axis.x + c, t * axis.x * axis.y + s * axis.z, t * axis.x * axis.z - s * axis.y, 0.0f) * scale;
+        m[1] = Vec4(t * axis.x * axis.y - s * axis.z, t * axis.y * axis.y + c, t * axis.y * axis.z + s * axis.x, 0.0f) * scale;
+        m[2] = Vec4(t * axis.x * axis.z + s * axis.y, t * axis.y * axis.z - s * axis.x, t * axis.z * axis.z + c, 0.0f) * scale;
+        m[3] = Vec4(nextRange(-50.0f, 50.0f), nextRange(-50.0f, 50.0f), nextRange(-50.0f, 50.0f), 1.0f);
+        return m;
+    }
+
+    Quat makeRotation()
+    {
+        Quat q(nextRange(-1.0f, 1.0f), nextRange(-1.0f, 1.0f), nextRange(-1.0f, 1.0f), nextRange(-1.0f, 1.0f));
+        return glm::normalize(q);
+    }
+
+    static DQuat toDouble(const Quat &q)
+    {
+        const DQuat r = { q.w, q.x, q.y, q.z };
+        return r;
+    }
+
+    void runOp(Op op)
+    {
+        switch (op)
+        {
+            case kMatMat:
+                for (int i = 0; i < mCount; ++i)
+                {
+                    mMatOut[i] = mA[i] * mB[i];
+                }
+                break;
+            case kMatVecShared:
+            {
+                const Mat4 m = mShared;
+                for (int i = 0; i < mCount; ++i)
+                {
+                    mVecOut[i] = m * mV[i];
+                }
+                break;
+            }
+            case kMatVecInstanced:
+                for (int i = 0; i < mCount; ++i)
+                {
+                    mVecOut[i] = mA[i] * mV[i];
+                }
+                break;
+            case kInverse:
+                for (int i = 0; i < mCount; ++i)
+                {
+                    mMatOut[i] = glm::inverse(mA[i]);
+                }
+                break;
+            case kQuatMul:
+                for (int i = 0; i < mCount; ++i)
+                {
+                    mQuatOut[i] = mQ[i] * mR[i];
+                }
+                break;
+            case kQuatRotate:
+                for (int i = 0; i < mCount; ++i)
+                {
+                    mVec3Out[i] = mQ[i] * mV3[i];
+                }
+                break;
+            case kMat4Cast:
+                for (int i = 0; i < mCount; ++i)
+                {
+                    mMatOut[i] = glm::mat4_cast(mQ[i]);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    // One value from the output, so the passes cannot be optimized away.
+    float sample(Op op, int pass) const
+    {
+        const int i = pass % mCount;
+        switch (op)
+        {
+            case kMatVecShared:
+            case kMatVecInstanced:
+                return mVecOut[i].x;
+            case kQuatMul:
+                return mQuatOut[i].w;
+            case kQuatRotate:
+                return mVec3Out[i].y;
+            default:
+                return mMatOut[i][3][0];
+        }
+    }
+
+    // Largest relative error of the last pass against the double reference.
+    double check(Op op) const
+    {
+        double worst = 0.0;
+        for (int i = 0; i < mCount; ++i)
+        {
+            double e = 0.0;
+            switch (op)
+            {
+                case kMatMat:
+                    e = matrixError(mMatOut[i], refMul(::toDouble(mA[i]), ::toDouble(mB[i])));
+                    break;
+                case kMatVecShared:
+                case kMatVecInstanced:
+                {
+                    const double v[4] = { mV[i].x, mV[i].y, mV[i].z, mV[i].w };
+                    const Mat4 &m = op == kMatVecShared ? mShared : mA[i];
+                    e = vectorError(mVecOut[i], refMul(::toDouble(m), v), 4);
+                    break;
+                }
+                case kInverse:
+                    e = matrixError(mMatOut[i], refInverse(::toDouble(mA[i])));
+                    break;
+                case kQuatMul:
+                {
+                    const DQuat r = refMul(toDouble(mQ[i]), toDouble(mR[i]));
+                    const DVec4 expected = { { r.w, r.x, r.y, r.z } };
+                    const float actual[4] = { mQuatOut[i].w, mQuatOut[i].x, mQuatOut[i].y, mQuatOut[i].z };
+                    e = vectorError(actual, expected, 4);
+                    break;
+                }
+                case kQuatRotate:
+                {
+                    const double v[3] = { mV3[i].x, mV3[i].y, mV3[i].z };
+                    e = vectorError(mVec3Out[i], refRotate(toDouble(mQ[i]), v), 3);
+                    break;
+                }
+                case kMat4Cast:
+                    e = matrixError(mMatOut[i], refMat4Cast(toDouble(mQ[i])));
+                    break;
+                default:
+                    break;
+            }
+            worst = e > worst ? e : worst;
+        }
+        return worst;
+    }
+
+    int mCount;
+    AlignedArray<Mat4> mA, mB, mMatOut;
+    AlignedArray<Vec4> mV, mVecOut;
+    AlignedArray<Vec3> mV3, mVec3Out;
+    AlignedArray<Quat> mQ, mR, mQuatOut;
+    Mat4 mShared;
+};
+
+static const char *archName()
+{
+#if GLM_ARCH == GLM_ARCH_PURE
+    return "pure";
+#elif GLM_ARCH & GLM_ARCH_AVX2_BIT
+    return "AVX2";
+#elif GLM_ARCH & GLM_ARCH_AVX_BIT
+    return "AVX";
+#elif GLM_ARCH & GLM_ARCH_SSE42_BIT
+    return "SSE4.2";
+#elif GLM_ARCH & GLM_ARCH_SSE41_BIT
+    return "SSE4.1";
+#elif GLM_ARCH & GLM_ARCH_SSSE3_BIT
+    return "SSSE3";
+#elif GLM_ARCH & GLM_ARCH_SSE3_BIT
+    return "SSE3";
+#elif GLM_ARCH & GLM_ARCH_SSE2_BIT
+    return "SSE2";
+#elif GLM_ARCH & GLM_ARCH_NEON_BIT
+    return "NEON (no glm kernels)";
+#else
+    return "other";
+#endif
+}
+
+static bool cpuSupported()
+{
+#if (GLM_ARCH & GLM_ARCH_AVX_BIT) && (defined(__GNUC__) || defined(__clang__))
+    return __builtin_cpu_supports("avx");
+#else
+    return true;
+#endif
+}
+
+int main(int argc, char **argv)
+{
+    const int count = argc > 1 ? atoi(argv[1]) : 4096;
+    const int passes = argc > 2 ? atoi(argv[2]) : 500;
+
+    if (!cpuSupported())
+    {
+        printf("glm %s: not supported by this CPU, skipped\n", archName());
+        return 0;
+    }
+
+    Result packed, aligned;
+    {
+        Suite<glm::packed_highp> suite(count);
+        suite.run(passes, packed);
+    }
+    {
+        Suite<glm::aligned_highp> suite(count);
+        suite.run(passes, aligned);
+    }
+
+    printf("glm %d.%d.%d, %s, %d elements x %d passes\n", GLM_VERSION_MAJOR, GLM_VERSION_MINOR, GLM_VERSION_PATCH,
+           archName(), count, passes);
+    printf(" mat4 packed %u bytes align %u, aligned %u bytes align %u\n",
+           unsigned(sizeof(glm::mat<4, 4, float, glm::packed_highp>)),
+           unsigned(alignof(glm::mat<4, 4, float, glm::packed_highp>)),
+           unsigned(sizeof(glm::mat<4, 4, float, glm::aligned_highp>)),
+           unsigned(alignof(glm::mat<4, 4, float, glm::aligned_highp>)));
+    printf(" %-20s %12s %12s %8s %12s %12s\n", "", "packed ns", "aligned ns", "speedup", "packed err", "aligned err");
+
+    bool accurate = true;
+    for (int op = 0; op < kOpCount; ++op)
+    {
+        const double tolerance = op == kInverse ? kInverseTolerance : kProductTolerance;
+        const bool ok = packed.error[op] <= tolerance && aligned.error[op] <= tolerance;
+        printf(" %-20s %12.2f %12.2f %7.2fx %12.2e %12.2e%s\n", kOpNames[op], packed.nsPerOp[op],
+               aligned.nsPerOp[op], packed.nsPerOp[op] / aligned.nsPerOp[op], packed.error[op], aligned.error[op],
+               ok ? "" : "  OVER TOLERANCE");
+        accurate = accurate && ok;
+    }
+    printf(" checksum %e %e\n", packed.checksum, aligned.checksum);
+    return accurate ? 0 : 1;
+}
@@ -0,0 +1,257 @@
+//
+//  glreplay.cpp
+//
+//  Replays frames captured by Renderer::requestCapture() (see GLCommandBuffer)
+//  and reports the submission cost.
+//
+//      glreplay [--backend null|gles] [--loops N] capture.glcs
+//      glreplay --synthesize out.glcs [--frames N] [--batches N]
+//
+//  The null backend only walks the stream, which isolates the cost of the
+//  command buffer itself. The gles backend replays into an offscreen Mesa
+//  context. GL objects created on the device are not part of a capture, so
+//  they are replaced by stand-ins (a flat program, empty textures, buffers
+//  grown to fit the uploads); the output is meaningless, but the state
+//  changes, uploads and draws reach the driver as recorded.
+//  --synthesize writes a capture shaped like the app's frame (textured quad
+//  plus full debug-draw line batches) for use without a device.
+//
+
+#include "GLCommandBuffer.h"
+#include "Clock.h"
+#include "SyntheticFrame.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#if defined(GLREPLAY_HAS_GLES)
+#include "OffscreenGLES.h"
+#endif
+
+class NullCommandBackend : public GLCommandBackend {
+public:
+    NullCommandBackend()
+            : mChecksum(0)
+    {
+        memset(mCounts, 0, sizeof(mCounts));
+    }
+
+    virtual void execute(const GLCommandBuffer::Command &command, const void *payload)
+    {
+        if (command.opcode < GLCommandBuffer::NUM_OPCODES)
+        {
+            ++mCounts[command.opcode];
+        }
+        // Touch the payload, as a real backend would.
+        mChecksum += *(const uint32_t *)payload;
+    }
+
+    uint64_t mCounts[GLCommandBuffer::NUM_OPCODES];
+    uint32_t mChecksum;
+};
+
+static bool synthesize(const char *path, int frames, int batches)
+{
+    FILE *f = fopen(path, "wb");
+    if (!f || !GLCommandBuffer::writeHeader(f))
+    {
+        fprintf(stderr, "glreplay: unable to write %s\n", path);
+        if (f)
+        {
+            fclose(f);
+        }
+        return false;
+    }
+
+    GLCommandBuffer commands;
+    bool ok = true;
+    for (int frame = 0; frame < frames && ok; ++frame)
+    {
+        recordSyntheticFrame(commands, batches);
+        ok = commands.writeFrame(f);
+        commands.reset();
+    }
+
+    ok = (fclose(f) == 0) && ok;
+    if (ok)
+    {
+        printf("wrote %d frames with %d line batches each to %s\n", frames, batches, path);
+    }
+    return ok;
+}
+
+static void usage()
+{
+    fprintf(stderr,
+            "usage: glreplay [--backend null|gles] [--loops N] capture.glcs\n"
+            "       glreplay --synthesize out.glcs [--frames N] [--batches N]\n");
+}
+
+int main(int argc, char **argv)
+{
+    std::string backendName = "null";
+    std::string path;
+    std::string synthesizePath;
+    int loops = 100;
+    int frames = 60;
+    int batches = 8;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const bool hasValue = (i + 1 < argc);
+        if (strcmp(argv[i], "--backend") == 0 && hasValue)
+        {
+            backendName = argv[++i];
+        }
+        else if (strcmp(argv[i], "--loops") == 0 && hasValue)
+        {
+            loops = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--synthesize") == 0 && hasValue)
+        {
+            synthesizePath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--frames") == 0 && hasValue)
+        {
+            frames = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--batches") == 0 && hasValue)
+        {
+            batches = atoi(argv[++i]);
+        }
+        else if (argv[i][0] != '-')
+        {
+            path = argv[i];
+        }
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    if (!synthesizePath.empty())
+    {
+        return synthesize(synthesizePath.c_str(), frames, batches) ? 0 : 1;
+    }
+    if (path.empty() || loops <= 0)
+    {
+        usage();
+        return 1;
+    }
+
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f || !GLCommandBuffer::readHeader(f))
+    {
+        fprintf(stderr, "glreplay: %s is not a capture\n", path.c_str());
+        if (f)
+        {
+            fclose(f);
+        }
+        return 1;
+    }
+
+    // Load every frame up front so file I/O stays out of the timings.
+    std::vector<GLCommandBuffer> captured;
+    for (;;)
+    {
+        captured.push_back(GLCommandBuffer());
+        if (!captured.back().readFrame(f))
+        {
+            captured.pop_back();
+            break;
+        }
+    }
+    if (!feof(f))
+    {
+        fprintf(stderr, "glreplay: frame %d of %s is corrupt, ignoring the rest\n", int(captured.size()),
+                path.c_str());
+    }
+    fclose(f);
+
+    if (captured.empty())
+    {
+        fprintf(stderr, "glreplay: %s holds no frames\n", path.c_str());
+        return 1;
+    }
+
+    uint64_t commandsPerLoop = 0;
+    uint64_t bytesPerLoop = 0;
+    for (size_t i = 0; i < captured.size(); ++i)
+    {
+        commandsPerLoop += captured[i].commandCount();
+        bytesPerLoop += captured[i].byteSize();
+    }
+
+    NullCommandBackend nullBackend;
+    GLCommandBackend *backend = &nullBackend;
+#if defined(GLREPLAY_HAS_GLES)
+    StandInGLESBackend glesBackend;
+#endif
+    if (backendName == "gles")
+    {
+#if defined(GLREPLAY_HAS_GLES)
+        if (!createOffscreenContext() || !glesBackend.initialize())
+        {
+            return 1;
+        }
+        backend = &glesBackend;
+#else
+        fprintf(stderr, "glreplay: built without the gles backend\n");
+        return 1;
+#endif
+    }
+    else if (backendName != "null")
+    {
+        usage();
+        return 1;
+    }
+
+    const int64_t start = nowNanos();
+    for (int loop = 0; loop < loops; ++loop)
+    {
+        for (size_t i = 0; i < captured.size(); ++i)
+        {
+            captured[i].replay(*backend);
+        }
+#if defined(GLREPLAY_HAS_GLES)
+        if (backend == &glesBackend)
+        {
+            glFinish();
+        }
+#endif
+    }
+    const double elapsedNs = double(nowNanos() - start);
+
+    const double totalCommands = double(commandsPerLoop) * loops;
+    const double totalFrames = double(captured.size()) * loops;
+
+    printf("capture:   %s\n", path.c_str());
+    printf("backend:   %s\n", backendName.c_str());
+    printf("frames:    %d (x%d loops)\n", int(captured.size()), loops);
+    printf("commands:  %llu per loop, %.1f per frame\n",
+           (unsigned long long)commandsPerLoop, double(commandsPerLoop) / captured.size());
+    printf("bytes:     %llu per loop, %.1f KiB per frame\n",
+           (unsigned long long)bytesPerLoop, double(bytesPerLoop) / captured.size() / 1024.0);
+    printf("time:      %.2f us per frame, %.1f ns per command\n",
+           elapsedNs / totalFrames / 1e3, elapsedNs / totalCommands);
+
+    if (backend == &nullBackend)
+    {
+        printf("histogram (per loop):\n");
+        for (int op = 0; op < GLCommandBuffer::NUM_OPCODES; ++op)
+        {
+            if (nullBackend.mCounts[op] > 0)
+            {
+                printf("  %-24s %llu\n", GLCommandBuffer::opcodeName(op),
+                       (unsigned long long)(nullBackend.mCounts[op] / loops));
+            }
+        }
+        printf("checksum:  %08x\n", nullBackend.mChecksum);
+    }
+
+    return 0;
+}
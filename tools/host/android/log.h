@@ -0,0 +1,37 @@
+//
+//  android/log.h
+//
+//  Host stand-in for the NDK logging header, so the app's native sources can
+//  be built into the Linux tools unchanged. Messages go to stderr.
+//
+
+#ifndef HOST_ANDROID_LOG_H
+#define HOST_ANDROID_LOG_H
+
+#include <stdarg.h>
+#include <stdio.h>
+
+enum {
+    ANDROID_LOG_UNKNOWN = 0,
+    ANDROID_LOG_DEFAULT,
+    ANDROID_LOG_VERBOSE,
+    ANDROID_LOG_DEBUG,
+    ANDROID_LOG_INFO,
+    ANDROID_LOG_WARN,
+    ANDROID_LOG_ERROR,
+    ANDROID_LOG_FATAL,
+    ANDROID_LOG_SILENT
+};
+
+static inline int __android_log_print(int prio, const char *tag, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    fprintf(stderr, "%s %s: ", prio >= ANDROID_LOG_ERROR ? "E" : "I", tag);
+    int ret = vfprintf(stderr, fmt, args);
+    fputc('\n', stderr);
+    va_end(args);
+    return ret;
+}
+
+#endif /* HOST_ANDROID_LOG_H */
@@ -0,0 +1,42 @@
+//
+//  gl_extensions.cpp
+//
+//  Desktop GLES libraries (libglvnd) only export core entry points, while the
+//  NDK's libGLESv2 also exports the OES ones the app calls directly. Resolve
+//  those through EGL here so the app's sources link unchanged.
+//
+
+#define GL_GLEXT_PROTOTYPES
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#include <EGL/egl.h>
+
+extern "C" void GL_APIENTRY glBindVertexArrayOES(GLuint array)
+{
+    static PFNGLBINDVERTEXARRAYOESPROC bindVertexArray =
+            (PFNGLBINDVERTEXARRAYOESPROC)eglGetProcAddress("glBindVertexArrayOES");
+    if (bindVertexArray)
+    {
+        bindVertexArray(array);
+    }
+}
+
+extern "C" void GL_APIENTRY glGenVertexArraysOES(GLsizei n, GLuint *arrays)
+{
+    static PFNGLGENVERTEXARRAYSOESPROC genVertexArrays =
+            (PFNGLGENVERTEXARRAYSOESPROC)eglGetProcAddress("glGenVertexArraysOES");
+    if (genVertexArrays)
+    {
+        genVertexArrays(n, arrays);
+    }
+}
+
+extern "C" void GL_APIENTRY glDeleteVertexArraysOES(GLsizei n, const GLuint *arrays)
+{
+    static PFNGLDELETEVERTEXARRAYSOESPROC deleteVertexArrays =
+            (PFNGLDELETEVERTEXARRAYSOESPROC)eglGetProcAddress("glDeleteVertexArraysOES");
+    if (deleteVertexArrays)
+    {
+        deleteVertexArrays(n, arrays);
+    }
+}
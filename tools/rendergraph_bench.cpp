@@ -0,0 +1,274 @@
+//
+//  rendergraph_bench.cpp
+//
+//  Compiles sample RenderGraphs and prints what the graph does to them:
+//  passes culled, framebuffer binds in declaration order and reordered,
+//  discards, and attachment memory with every target on its own against
+//  targets sharing pooled memory where their lifetimes allow.
+//
+//    renderer     drawFrame()'s graph: scene, composite, debug overlay.
+//    post         a shadow map, a scene reading it, bloom (a bright pass
+//                 and two rounds of separable blur), tonemap to the window
+//                 and the overlay, plus a debug view and a luminance pass
+//                 nothing reads.
+//    interleaved  two shadow cascades declared alternating between their
+//                 targets, read by one pass to the window.
+//
+//  Then executes each graph in an offscreen context with its passes
+//  clearing their targets, counts the binds and discards recorded, and
+//  checks them and the pool's peak memory against compile()'s numbers.
+//  Last, executes the renderer graph with a scene target the pool cannot
+//  make (0x0, an incomplete framebuffer) and checks that only the overlay
+//  ran. Exits with 1 on a mismatch or a GL error.
+//
+//      rendergraph_bench [width] [height]
+//
+
+#include "RenderGraph.h"
+#include "RenderTargetPool.h"
+#include "ShaderBatch.h"
+#include "GLDebug.h"
+#include "OffscreenGLES.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+typedef RenderTargetPool Pool;
+
+static void clearPass(RenderGraph &, GLCommandBuffer &commands, void *)
+{
+    commands.clearColor(0.5f, 0.5f, 0.5f, 1.0f);
+    commands.clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+static int pass(RenderGraph &graph, const char *name, int write, int read0 = -1, int read1 = -1)
+{
+    const int p = graph.addPass(name, clearPass, NULL);
+    graph.write(p, write);
+    if (read0 >= 0)
+    {
+        graph.read(p, read0);
+    }
+    if (read1 >= 0)
+    {
+        graph.read(p, read1);
+    }
+    return p;
+}
+
+static Pool::Desc desc(GLsizei width, GLsizei height, Pool::ColorFormat color, Pool::DepthFormat depth)
+{
+    const Pool::Desc d = { width, height, color, depth };
+    return d;
+}
+
+static void buildRenderer(RenderGraph &graph, GLsizei width, GLsizei height)
+{
+    const int scene = graph.createTarget("scene", desc(width, height, Pool::COLOR_RGBA8, Pool::DEPTH_NONE));
+    pass(graph, "scene", scene);
+    pass(graph, "composite", RenderGraph::WINDOW, scene);
+    pass(graph, "overlay", RenderGraph::WINDOW);
+}
+
+static void buildPost(RenderGraph &graph, GLsizei width, GLsizei height)
+{
+    const int shadow = graph.createTarget("shadow", desc(512, 512, Pool::COLOR_RGBA8, Pool::DEPTH_16));
+    const int scene = graph.createTarget("scene", desc(width, height, Pool::COLOR_RGBA8, Pool::DEPTH_24_STENCIL_8));
+    const int bright = graph.createTarget("bright", desc(width / 2, height / 2, Pool::COLOR_RGBA8, Pool::DEPTH_NONE));
+    const int blurH = graph.createTarget("blurH", desc(width / 4, height / 4, Pool::COLOR_RGB565, Pool::DEPTH_NONE));
+    const int blurV = graph.createTarget("blurV", desc(width / 4, height / 4, Pool::COLOR_RGB565, Pool::DEPTH_NONE));
+    const int blurH2 = graph.createTarget("blurH2", desc(width / 4, height / 4, Pool::COLOR_RGB565, Pool::DEPTH_NONE));
+    const int blurV2 = graph.createTarget("blurV2", desc(width / 4, height / 4, Pool::COLOR_RGB565, Pool::DEPTH_NONE));
+    const int debugView = graph.createTarget("debug", desc(width / 2, height / 2, Pool::COLOR_RGBA8, Pool::DEPTH_NONE));
+    const int luminance = graph.createTarget("luminance", desc(64, 64, Pool::COLOR_RGBA8, Pool::DEPTH_NONE));
+
+    pass(graph, "shadow", shadow);
+    pass(graph, "scene", scene, shadow);
+    pass(graph, "debug view", debugView, shadow);
+    pass(graph, "luminance", luminance, scene);
+    pass(graph, "bright", bright, scene);
+    pass(graph, "blur h", blurH, bright);
+    pass(graph, "blur v", blurV, blurH);
+    pass(graph, "blur h 2", blurH2, blurV);
+    pass(graph, "blur v 2", blurV2, blurH2);
+    pass(graph, "tonemap", RenderGraph::WINDOW, scene, blurV2);
+    pass(graph, "overlay", RenderGraph::WINDOW);
+}
+
+static void buildInterleaved(RenderGraph &graph, GLsizei, GLsizei)
+{
+    const int near = graph.createTarget("near", desc(1024, 1024, Pool::COLOR_RGBA8, Pool::DEPTH_16));
+    const int far = graph.createTarget("far", desc(1024, 1024, Pool::COLOR_RGBA8, Pool::DEPTH_16));
+    pass(graph, "near opaque", near);
+    pass(graph, "far opaque", far);
+    pass(graph, "near alpha", near);
+    pass(graph, "far alpha", far);
+    pass(graph, "lighting", RenderGraph::WINDOW, near, far);
+}
+
+struct Sample {
+    const char *name;
+    void (*build)(RenderGraph &graph, GLsizei width, GLsizei height);
+};
+
+static const Sample kSamples[] = {
+    { "renderer", buildRenderer },
+    { "post", buildPost },
+    { "interleaved", buildInterleaved },
+};
+static const int kSampleCount = int(sizeof(kSamples) / sizeof(kSamples[0]));
+
+// Forwards to GLESCommandBackend, counting opcodes on the way.
+class CountingBackend : public GLCommandBackend {
+public:
+    CountingBackend()
+    {
+        memset(mCounts, 0, sizeof(mCounts));
+    }
+
+    virtual void execute(const GLCommandBuffer::Command &command, const void *payload)
+    {
+        if (command.opcode < GLCommandBuffer::NUM_OPCODES)
+        {
+            ++mCounts[command.opcode];
+        }
+        mBackend.execute(command, payload);
+    }
+
+    unsigned int count(GLCommandBuffer::Opcode opcode) const { return mCounts[opcode]; }
+
+private:
+    GLESCommandBackend mBackend;
+    unsigned int mCounts[GLCommandBuffer::NUM_OPCODES];
+};
+
+static std::string orderString(const RenderGraph &graph)
+{
+    std::string order;
+    for (size_t i = 0; i < graph.order().size(); ++i)
+    {
+        order += i ? ", " : "";
+        order += graph.passName(graph.order()[i]);
+    }
+    return order;
+}
+
+// Executes the compiled graph for a few frames on a fresh pool and checks
+// the recorded binds and discards and the pool's memory against stats().
+static bool execute(RenderGraph &graph, ShaderBatch &shaderBatch, GLsizei width, GLsizei height)
+{
+    Pool pool;
+    pool.init(shaderBatch);
+
+    bool ok = true;
+    for (int frame = 0; frame < 3; ++frame)
+    {
+        GLCommandBuffer commands;
+        CountingBackend backend;
+        graph.execute(pool, commands, width, height);
+        commands.replay(backend);
+        pool.endFrame();
+
+        const RenderGraph::Stats &stats = graph.stats();
+        const unsigned int binds = backend.count(GLCommandBuffer::CMD_BIND_FRAMEBUFFER);
+        const unsigned int discards = backend.count(GLCommandBuffer::CMD_DISCARD_FRAMEBUFFER);
+        if (binds != stats.framebufferBinds || discards != stats.discards ||
+            pool.stats().peakBytes != stats.peakBytes || pool.stats().inUse != 0)
+        {
+            printf("  frame %d recorded %u binds, %u discards, pool peak %.1f KB, %u in use\n", frame, binds,
+                   discards, pool.stats().peakBytes / 1024.0, pool.stats().inUse);
+            ok = false;
+        }
+    }
+    pool.destroy();
+    glFinish();
+    return ok;
+}
+
+// The scene and the composite reading it are skipped, the overlay runs.
+static bool executeWithoutTarget(ShaderBatch &shaderBatch)
+{
+    RenderGraph graph;
+    buildRenderer(graph, 0, 0);
+    graph.compile();
+
+    Pool pool;
+    pool.init(shaderBatch);
+    GLCommandBuffer commands;
+    CountingBackend backend;
+    graph.execute(pool, commands, 64, 64);
+    commands.replay(backend);
+    pool.endFrame();
+
+    const unsigned int clears = backend.count(GLCommandBuffer::CMD_CLEAR);
+    const unsigned int draws = backend.count(GLCommandBuffer::CMD_DRAW_ARRAYS);
+    const bool ok = clears == 1 && draws == 0 && pool.stats().inUse == 0;
+    if (!ok)
+    {
+        printf("  recorded %u clears, %u draws, %u targets in use\n", clears, draws, pool.stats().inUse);
+    }
+    pool.destroy();
+    glFinish();
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    const GLsizei width = argc > 1 ? atoi(argv[1]) : 1080;
+    const GLsizei height = argc > 2 ? atoi(argv[2]) : 1920;
+
+    RenderGraph graph;
+    printf("%dx%d window\n", width, height);
+    printf(" %-12s %6s %6s %11s %11s %9s %10s %10s\n", "", "passes", "culled", "decl binds", "graph binds",
+           "discards", "own KB", "peak KB");
+    for (int s = 0; s < kSampleCount; ++s)
+    {
+        graph.reset();
+        graph.setReordering(false);
+        kSamples[s].build(graph, width, height);
+        graph.compile();
+        const uint32_t declaredBinds = graph.stats().framebufferBinds;
+
+        graph.setReordering(true);
+        if (!graph.compile())
+        {
+            printf(" %-12s does not compile\n", kSamples[s].name);
+            return 1;
+        }
+        const RenderGraph::Stats &stats = graph.stats();
+        printf(" %-12s %6u %6u %11u %11u %9u %10.1f %10.1f\n", kSamples[s].name, stats.passes, stats.culledPasses,
+               declaredBinds, stats.framebufferBinds, stats.discards, stats.transientBytes / 1024.0,
+               stats.peakBytes / 1024.0);
+        printf("   order: %s\n", orderString(graph).c_str());
+    }
+
+    if (!createOffscreenContext(false, 64, 64))
+    {
+        printf("no offscreen context, graphs not executed\n");
+        return 0;
+    }
+    GLDebug::initialize();
+    GLESCommandBackend::initialize();
+
+    ShaderBatch shaderBatch;
+    shaderBatch.initialize();
+
+    bool ok = true;
+    for (int s = 0; s < kSampleCount; ++s)
+    {
+        graph.reset();
+        kSamples[s].build(graph, width, height);
+        graph.compile();
+        const bool executed = execute(graph, shaderBatch, width, height);
+        printf("executed %-12s %s\n", kSamples[s].name, executed ? "ok" : "MISMATCH");
+        ok = ok && executed;
+    }
+    const bool skipped = executeWithoutTarget(shaderBatch);
+    printf("executed %-12s %s\n", "no target", skipped ? "ok" : "MISMATCH");
+    ok = ok && skipped;
+    printf("discard %s, GL errors %u\n", GLESCommandBackend::hasDiscard() ? "available" : "not available",
+           GLDebug::errorCount());
+    return ok && GLDebug::errorCount() == 0 ? 0 : 1;
+}
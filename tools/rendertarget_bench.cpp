@@ -0,0 +1,220 @@
+//
+//  rendertarget_bench.cpp
+//
+//  RenderTargetPool under a post-processing style frame: a scene pass at
+//  window size with depth, a half-size downsample, two quarter-size blur
+//  passes ping-ponging between targets and a composite of the last one to
+//  the window. The window is resized halfway through, so the first size's
+//  targets must go away. Runs the same frames pooled (targets kept for
+//  'idle' frames) and unpooled (idle 0, every target created and deleted
+//  each frame) and prints the allocation churn, estimated GPU memory and
+//  time of each.
+//
+//  Before that, composites a target cleared to red into a rectangle of a
+//  blue window and reads the pixels back. Exits with 1 if they are wrong,
+//  or if the pooled run creates targets once a size has been seen.
+//
+//      rendertarget_bench [frames] [idle]
+//
+
+#include "RenderTargetPool.h"
+#include "ShaderBatch.h"
+#include "GLDebug.h"
+#include "Clock.h"
+#include "OffscreenGLES.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static const int kSurfaceWidth = 256;
+static const int kSurfaceHeight = 256;
+
+static bool checkPixel(int x, int y, const GLubyte expected[3])
+{
+    GLubyte pixel[4] = { 0, 0, 0, 0 };
+    glReadPixels(x, y, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixel);
+    if (pixel[0] != expected[0] || pixel[1] != expected[1] || pixel[2] != expected[2])
+    {
+        printf("  pixel (%d, %d) is %u %u %u, expected %u %u %u\n", x, y, pixel[0], pixel[1], pixel[2], expected[0],
+               expected[1], expected[2]);
+        return false;
+    }
+    return true;
+}
+
+static bool checkComposite(RenderTargetPool &pool, GLCommandBuffer &commands, GLESCommandBackend &backend)
+{
+    const RenderTargetPool::Desc desc = { 16, 16, RenderTargetPool::COLOR_RGBA8, RenderTargetPool::DEPTH_16 };
+    const int target = pool.acquire(desc);
+    if (target < 0)
+    {
+        return false;
+    }
+
+    pool.bind(commands, target);
+    commands.clearColor(1.0f, 0.0f, 0.0f, 1.0f);
+    commands.clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    RenderTargetPool::bindWindow(commands, kSurfaceWidth, kSurfaceHeight);
+    commands.clearColor(0.0f, 0.0f, 1.0f, 1.0f);
+    commands.clear(GL_COLOR_BUFFER_BIT);
+    pool.composite(commands, target, 32, 64, 96, 48);
+    pool.release(target);
+    commands.replay(backend);
+    commands.reset();
+    pool.endFrame();
+
+    static const GLubyte red[3] = { 255, 0, 0 };
+    static const GLubyte blue[3] = { 0, 0, 255 };
+    bool ok = true;
+    ok = checkPixel(32, 64, red) && ok;
+    ok = checkPixel(32 + 95, 64 + 47, red) && ok;
+    ok = checkPixel(31, 64, blue) && ok;
+    ok = checkPixel(32, 64 + 48, blue) && ok;
+    return ok;
+}
+
+struct Run {
+    double ms;
+    uint64_t created;
+    uint64_t destroyed;
+    uint64_t createdAfterWarmup;
+    size_t peakBytes;
+    size_t endBytes;
+};
+
+static void pass(RenderTargetPool &pool, GLCommandBuffer &commands, int target, float shade)
+{
+    pool.bind(commands, target);
+    commands.clearColor(shade, shade, shade, 1.0f);
+    commands.clear(GL_COLOR_BUFFER_BIT);
+}
+
+static Run runFrames(RenderTargetPool &pool, GLCommandBuffer &commands, GLESCommandBackend &backend, int frames,
+                     unsigned int idle)
+{
+    pool.setMaxIdleFrames(idle);
+    const uint64_t createdBefore = pool.stats().totalCreated;
+    const uint64_t destroyedBefore = pool.stats().totalDestroyed;
+
+    Run run = { 0.0, 0, 0, 0, 0, 0 };
+    const double start = nowMillis();
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        // The window turns sideways halfway through.
+        const bool resized = frame >= frames / 2;
+        const GLsizei width = resized ? 192 : 160;
+        const GLsizei height = resized ? 160 : 192;
+        const bool warmup = frame == 0 || frame == frames / 2;
+
+        const RenderTargetPool::Desc sceneDesc = { width, height, RenderTargetPool::COLOR_RGBA8,
+                                                   RenderTargetPool::DEPTH_16 };
+        const RenderTargetPool::Desc halfDesc = { width / 2, height / 2, RenderTargetPool::COLOR_RGBA8,
+                                                  RenderTargetPool::DEPTH_NONE };
+        const RenderTargetPool::Desc quarterDesc = { width / 4, height / 4, RenderTargetPool::COLOR_RGB565,
+                                                     RenderTargetPool::DEPTH_NONE };
+
+        const int scene = pool.acquire(sceneDesc);
+        pass(pool, commands, scene, 0.25f);
+        commands.clear(GL_DEPTH_BUFFER_BIT);
+
+        const int half = pool.acquire(halfDesc);
+        pass(pool, commands, half, 0.5f);
+        pool.release(scene);
+
+        const int blurA = pool.acquire(quarterDesc);
+        pass(pool, commands, blurA, 0.75f);
+        pool.release(half);
+
+        const int blurB = pool.acquire(quarterDesc);
+        pass(pool, commands, blurB, 1.0f);
+        pool.release(blurA);
+
+        RenderTargetPool::bindWindow(commands, width, height);
+        pool.composite(commands, blurB, 0, 0, width, height);
+        pool.release(blurB);
+
+        commands.replay(backend);
+        commands.reset();
+        glFinish();
+        pool.endFrame();
+
+        if (!warmup)
+        {
+            run.createdAfterWarmup += pool.stats().created;
+        }
+        if (pool.stats().peakBytes > run.peakBytes)
+        {
+            run.peakBytes = pool.stats().peakBytes;
+        }
+    }
+    run.ms = (nowMillis() - start) / frames;
+    run.created = pool.stats().totalCreated - createdBefore;
+    run.destroyed = pool.stats().totalDestroyed - destroyedBefore;
+    run.endBytes = pool.stats().bytes;
+    return run;
+}
+
+static void printRun(const char *name, const Run &run, int frames)
+{
+    printf("  %-9s %9.2f %9.2f %10.3f %10.1f %10.1f %10.3f\n", name, double(run.created) / frames,
+           double(run.destroyed) / frames, double(run.createdAfterWarmup) / frames, run.peakBytes / 1024.0,
+           run.endBytes / 1024.0, run.ms);
+}
+
+int main(int argc, char **argv)
+{
+    const int frames = argc > 1 ? atoi(argv[1]) : 200;
+    const unsigned int idle = argc > 2 ? (unsigned int)atoi(argv[2]) : RenderTargetPool::DEFAULT_MAX_IDLE_FRAMES;
+
+    if (!createOffscreenContext(false, kSurfaceWidth, kSurfaceHeight))
+    {
+        return 1;
+    }
+    GLDebug::initialize();
+    GLESCommandBackend::initialize();
+
+    ShaderBatch shaderBatch;
+    shaderBatch.initialize();
+
+    RenderTargetPool pool;
+    pool.init(shaderBatch);
+    shaderBatch.submit();
+    while (!shaderBatch.poll())
+    {
+    }
+    if (!pool.canComposite())
+    {
+        printf("composite program failed\n");
+        return 1;
+    }
+
+    GLCommandBuffer commands;
+    GLESCommandBackend backend;
+
+    const bool composited = checkComposite(pool, commands, backend);
+    printf("composite check %s\n", composited ? "ok" : "FAILED");
+
+    pool.setMaxIdleFrames(0);
+    pool.endFrame();
+    const Run unpooled = runFrames(pool, commands, backend, frames, 0);
+    const Run pooled = runFrames(pool, commands, backend, frames, idle);
+
+    printf("%d frames, 4 offscreen passes each, resized at frame %d\n", frames, frames / 2);
+    printf("  %-9s %9s %9s %10s %10s %10s %10s\n", "", "created", "deleted", "created", "peak KB", "end KB",
+           "ms/frame");
+    printf("  %-9s %9s %9s %10s\n", "", "/frame", "/frame", "post-warm");
+    printRun("unpooled", unpooled, frames);
+    char name[32];
+    snprintf(name, sizeof(name), "idle %u", idle);
+    printRun(name, pooled, frames);
+    printf("  GL errors %u\n", GLDebug::errorCount());
+
+    pool.destroy();
+
+    const bool steady = idle == 0 || pooled.createdAfterWarmup == 0;
+    if (!steady)
+    {
+        printf("pooled run kept creating targets\n");
+    }
+    return composited && steady && GLDebug::errorCount() == 0 ? 0 : 1;
+}